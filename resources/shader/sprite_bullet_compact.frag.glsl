@@ -0,0 +1,10 @@
+#version 330 core
+
+#define SPRITE_COMPACT
+
+#include "interface/sprite.glslh"
+
+void main(void) {
+    vec4 texel = spriteTexture(texCoord);
+    fragColor = (texel.g * color + vec4(texel.b)) * (1 - customParams.r);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+
+#define SPRITE_COMPACT
+#define SPRITE_OUT_COLOR
+#define SPRITE_OUT_TEXCOORD
+#define SPRITE_OUT_CUSTOM
+
+#include "lib/sprite_default.vert.glslh"
@@ -0,0 +1,9 @@
+#version 330 core
+
+#define SPRITE_COMPACT
+
+#include "interface/sprite.glslh"
+
+void main(void) {
+    fragColor = color * spriteTexture(texCoord);
+}
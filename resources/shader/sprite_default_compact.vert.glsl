@@ -0,0 +1,7 @@
+#version 330 core
+
+#define SPRITE_COMPACT
+#define SPRITE_OUT_COLOR
+#define SPRITE_OUT_TEXCOORD
+
+#include "lib/sprite_default.vert.glslh"
@@ -4,6 +4,8 @@ import rectpack
 import argparse
 import shutil
 import subprocess
+import struct
+import zlib
 import re
 
 from pathlib import (
@@ -52,6 +54,63 @@ def write_sprite_def(dst, texture, region, size, overrides=None):
 
     update_text_file(dst, text)
 
+    # The game only trusts the sprite index while the .spr file keeps this size and checksum
+    data = dst.read_bytes()
+    return len(data), zlib.crc32(data) & 0xffffffff
+
+
+def parse_override_size(overrides):
+    size = [0, 0]
+
+    if overrides is None:
+        return size
+
+    for line in overrides.splitlines():
+        line = line.split('#', 1)[0]
+
+        if '=' not in line:
+            continue
+
+        key, val = (s.strip() for s in line.split('=', 1))
+
+        if key == 'w':
+            size[0] = float(val)
+        elif key == 'h':
+            size[1] = float(val)
+
+    return size
+
+
+def write_sprite_index(dst, sprites):
+    """
+    Writes a binary index of all the sprites in an atlas, so that the game doesn't
+    have to parse the .spr files one by one. See src/resource/sprite_index.c for
+    the format.
+    """
+
+    dst.parent.mkdir(exist_ok=True, parents=True)
+
+    def pack_str(s):
+        b = s.encode('utf-8')
+        return struct.pack('<H', len(b)) + b
+
+    textures = sorted(set(s['texture'] for s in sprites))
+    texture_ids = {t: i for i, t in enumerate(textures)}
+
+    data = bytearray(b'TSPRIDX\0')
+    data += struct.pack('<III', 2, len(textures), len(sprites))
+
+    for texture in textures:
+        data += pack_str(texture)
+
+    for sprite in sorted(sprites, key=lambda s: s['name']):
+        data += pack_str(sprite['name'])
+        data += struct.pack('<HII', texture_ids[sprite['texture']], sprite['def_size'], sprite['def_crc'])
+        data += struct.pack('<6f', *sprite['region'], *sprite['size'])
+
+    dst.write_bytes(bytes(data))
+
+
 def write_texture_def(dst, texture, global_overrides=None, local_overrides=None):
     dst.parent.mkdir(exist_ok=True, parents=True)
 
@@ -178,6 +237,7 @@ def gen_atlas(overrides, src, dst, binsize, atlasname, border=1, force_single=Fa
     with ExitStack() as stack:
         # Do everything in a temporary directory first
         temp_dst = Path(stack.enter_context(TemporaryDirectory(prefix='taisei-atlas-{}'.format(atlasname))))
+        indexed_sprites = []
 
         # Run multiple leanify processes in parallel, in case we end up with multiple pages
         # Yeah I'm too lazy to use Popen properly
@@ -235,20 +295,33 @@ def gen_atlas(overrides, src, dst, binsize, atlasname, border=1, force_single=Fa
                     override_contents = None
                     write_override_template(override_path, img.size)
 
-                write_sprite_def(
+                sprite_region = (region[0], region[1], region[2] - region[0], region[3] - region[1])
+
+                def_size, def_crc = write_sprite_def(
                     temp_dst / '{}.spr'.format(name),
                     textureid,
-                    (region[0], region[1], region[2] - region[0], region[3] - region[1]),
+                    sprite_region,
                     img.size,
                     overrides=override_contents
                 )
 
+                indexed_sprites.append({
+                    'name': name,
+                    'texture': textureid,
+                    'region': sprite_region,
+                    'size': parse_override_size(override_contents),
+                    'def_size': def_size,
+                    'def_crc': def_crc,
+                })
+
             print('Atlas texture area: ', rootimg.size[0] * rootimg.size[1])
             rootimg.save(dstfile)
 
             if leanify:
                 executor.submit(lambda: subprocess.check_call(["leanify", '-v', str(dstfile)]))
 
+        write_sprite_index(temp_dst / 'atlas_{}.spridx'.format(atlasname), indexed_sprites)
+
         # Wait for leanify to complete
         executor.shutdown(wait=True)
 
@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+
+# Builds a Taisei package (.tpk) out of the resource directories.
+# See src/vfs/tpkfile_impl.h for a description of the format.
+
+from taiseilib.common import (
+    add_common_args,
+    run_main,
+    write_depfile,
+)
+
+from pathlib import (
+    Path,
+)
+
+import argparse
+import re
+import struct
+import zlib
+
+
+TPK_MAGIC = b'TAISEIPK'
+TPK_VERSION = 2
+TPK_ALIGN = 4096
+
+TPK_HEADER = struct.Struct('<8sIIIIQQQQQ')
+TPK_ENTRY = struct.Struct('<QQQQIHBBIIq')
+TPK_GROUP = struct.Struct('<QQ')
+
+TPK_METHOD_RAW = 0
+TPK_METHOD_DEFLATE = 1
+
+TPK_FLAG_DIR = 1
+
+# Text and other uncompressed formats get deflated. Everything else (ogg, png, webp) is already compressed
+# and is stored raw, so it can be read straight out of the mapped package.
+COMPRESSED_EXTENSIONS = {
+    '.spr', '.tex', '.ani', '.spridx', '.glsl', '.glslh', '.prog', '.bgm', '.font', '.conf', '.obj', '.ttf', '.otf'
+}
+
+# Files belonging to the same texture atlas are loaded together; keep them adjacent and prefetch them as a unit.
+ATLAS_GROUP_RE = re.compile(r'^(.*/atlas_.+?)(?:_\d+)?\.[^/]+$')
+
+
+def fnv1a64(data):
+    h = 0xcbf29ce484222325
+
+    for b in data:
+        h ^= b
+        h = (h * 0x100000001b3) & 0xffffffffffffffff
+
+    return h
+
+
+def align(ofs, alignment):
+    return (ofs + alignment - 1) // alignment * alignment
+
+
+def load_order(trace):
+    # The trace is a list of VFS paths in the order they were first opened (see TAISEI_VFS_TRACE).
+    order = {}
+
+    if trace is None:
+        return order
+
+    with trace.open('r') as f:
+        for line in f:
+            path = line.strip()
+
+            if path.startswith('res/'):
+                path = path[len('res/'):]
+
+            if path and path not in order:
+                order[path] = len(order)
+
+    return order
+
+
+class Entry(object):
+    def __init__(self, name, source=None):
+        self.name = name
+        self.source = source
+        self.is_dir = source is None
+        self.group = None
+        self.data = b''
+        self.size = 0
+        self.crc = 0
+        self.method = TPK_METHOD_RAW
+        self.offset = 0
+        self.mtime = 0
+
+        if not self.is_dir:
+            self.mtime = int(source.stat().st_mtime)
+            raw = source.read_bytes()
+            self.size = len(raw)
+            self.crc = zlib.crc32(raw) & 0xffffffff
+            self.data = raw
+
+            if source.suffix.lower() in COMPRESSED_EXTENSIONS and raw:
+                c = zlib.compressobj(9, zlib.DEFLATED, -zlib.MAX_WBITS)
+                packed = c.compress(raw) + c.flush()
+
+                if len(packed) < len(raw):
+                    self.data = packed
+                    self.method = TPK_METHOD_DEFLATE
+
+            m = ATLAS_GROUP_RE.match(name)
+
+            if m:
+                self.group = m.group(1)
+
+    @property
+    def hash(self):
+        return fnv1a64(self.name.encode('utf-8'))
+
+
+def collect(directories):
+    entries = {}
+
+    for directory in directories:
+        directory = Path(directory)
+
+        for path in sorted(directory.rglob('*')):
+            if path.name == 'meson.build' or path.is_dir():
+                continue
+
+            rel = Path(directory.name) / path.relative_to(directory)
+            name = rel.as_posix()
+            entries[name] = Entry(name, path)
+
+            for parent in rel.parents:
+                pname = parent.as_posix()
+
+                if pname != '.' and pname not in entries:
+                    entries[pname] = Entry(pname)
+
+    return list(entries.values())
+
+
+def layout(entries, order):
+    # Data is laid out in first-use order, so a cold start reads the package sequentially.
+    # Files that were never used during the trace go last, in name order.
+    files = [e for e in entries if not e.is_dir]
+    unordered = len(order)
+
+    def first_use(e):
+        return (order.get(e.name, unordered), e.name)
+
+    files.sort(key=first_use)
+
+    # Pull the members of each group to the position of the group's earliest member.
+    group_pos = {}
+    keys = {}
+
+    for i, e in enumerate(files):
+        if e.group is not None:
+            group_pos.setdefault(e.group, i)
+
+        keys[e.name] = (group_pos.get(e.group, i), i)
+
+    files.sort(key=lambda e: keys[e.name])
+    return files
+
+
+def write_package(output, entries, order):
+    files = layout(entries, order)
+    table = sorted(entries, key=lambda e: (e.hash, e.name))
+
+    group_names = []
+
+    for e in files:
+        if e.group is not None and e.group not in group_names:
+            group_names.append(e.group)
+
+    group_index = {name: i + 1 for i, name in enumerate(group_names)}
+
+    strings = bytearray()
+    name_offsets = {}
+
+    for e in table:
+        name_offsets[e.name] = len(strings)
+        strings += e.name.encode('utf-8') + b'\0'
+
+    entries_offset = TPK_HEADER.size
+    groups_offset = entries_offset + TPK_ENTRY.size * len(table)
+    strings_offset = groups_offset + TPK_GROUP.size * len(group_names)
+    data_offset = align(strings_offset + len(strings), TPK_ALIGN)
+
+    # Raw entries start on a page boundary so that they can be used in place from a memory mapping.
+    # Compressed entries always get inflated into a separate buffer, so they are packed tightly.
+    ofs = data_offset
+    group_ranges = {}
+
+    for e in files:
+        if e.method == TPK_METHOD_RAW or (e.group is not None and e.group not in group_ranges):
+            ofs = align(ofs, TPK_ALIGN)
+
+        e.offset = ofs
+        ofs += len(e.data)
+
+        if e.group is not None:
+            start, end = group_ranges.get(e.group, (e.offset, ofs))
+            group_ranges[e.group] = (min(start, e.offset), max(end, ofs))
+
+    with output.open('wb') as out:
+        out.write(TPK_HEADER.pack(
+            TPK_MAGIC, TPK_VERSION, len(table), len(group_names), 0,
+            entries_offset, groups_offset, strings_offset, len(strings), data_offset,
+        ))
+
+        for e in table:
+            out.write(TPK_ENTRY.pack(
+                e.hash, e.offset, e.size, len(e.data),
+                name_offsets[e.name], len(e.name.encode('utf-8')),
+                e.method, TPK_FLAG_DIR if e.is_dir else 0,
+                group_index.get(e.group, 0), e.crc, e.mtime,
+            ))
+
+        for name in group_names:
+            start, end = group_ranges[name]
+            out.write(TPK_GROUP.pack(start, end - start))
+
+        out.write(strings)
+
+        for e in files:
+            out.write(b'\0' * (e.offset - out.tell()))
+            out.write(e.data)
+
+    return files
+
+
+def main(args):
+    parser = argparse.ArgumentParser(description='Generate a Taisei package.', prog=args[0])
+
+    parser.add_argument('output',
+        help='The output file path',
+        type=Path,
+    )
+
+    parser.add_argument('sourcedir',
+        help='The resources source directory',
+        type=Path,
+    )
+
+    parser.add_argument('depfile',
+        help='Path to the depfile to generate',
+        type=Path,
+    )
+
+    parser.add_argument('directories',
+        help='Resource directories to pack',
+        nargs='+',
+    )
+
+    parser.add_argument('--order',
+        help='Startup trace recorded with TAISEI_VFS_TRACE, used to order the package contents',
+        type=Path,
+        default=None,
+    )
+
+    add_common_args(parser)
+    args = parser.parse_args(args[1:])
+
+    entries = collect(args.directories)
+    files = write_package(args.output, entries, load_order(args.order))
+
+    deps = [args.sourcedir / e.name for e in files] + [Path(__file__)]
+
+    if args.order is not None:
+        deps.append(args.order)
+
+    write_depfile(args.depfile, args.output, deps)
+
+
+if __name__ == '__main__':
+    run_main(main)
@@ -57,11 +57,27 @@ bool audio_backend_sound_stop_all(AudioBackendSoundGroup group);
 void audio_init(void);
 void audio_shutdown(void);
 
-void play_sound(const char *name) attr_nonnull(1);
-void play_sound_ex(const char *name, int cooldown, bool replace) attr_nonnull(1);
-void play_sound_delayed(const char *name, int cooldown, bool replace, int delay) attr_nonnull(1);
-void play_loop(const char *name) attr_nonnull(1);
-void play_ui_sound(const char *name) attr_nonnull(1);
+// These all accept either a sound name or a ResourceAtom.
+
+void _play_sound(const char *name) attr_nonnull(1);
+void _play_sound_atom(ResourceAtom *name) attr_nonnull(1);
+#define play_sound(name) RES_NAME_GENERIC(name, _play_sound, _play_sound_atom)(name)
+
+void _play_sound_ex(const char *name, int cooldown, bool replace) attr_nonnull(1);
+void _play_sound_ex_atom(ResourceAtom *name, int cooldown, bool replace) attr_nonnull(1);
+#define play_sound_ex(name, ...) RES_NAME_GENERIC(name, _play_sound_ex, _play_sound_ex_atom)(name, __VA_ARGS__)
+
+void _play_sound_delayed(const char *name, int cooldown, bool replace, int delay) attr_nonnull(1);
+void _play_sound_delayed_atom(ResourceAtom *name, int cooldown, bool replace, int delay) attr_nonnull(1);
+#define play_sound_delayed(name, ...) RES_NAME_GENERIC(name, _play_sound_delayed, _play_sound_delayed_atom)(name, __VA_ARGS__)
+
+void _play_loop(const char *name) attr_nonnull(1);
+void _play_loop_atom(ResourceAtom *name) attr_nonnull(1);
+#define play_loop(name) RES_NAME_GENERIC(name, _play_loop, _play_loop_atom)(name)
+
+void _play_ui_sound(const char *name) attr_nonnull(1);
+void _play_ui_sound_atom(ResourceAtom *name) attr_nonnull(1);
+#define play_ui_sound(name) RES_NAME_GENERIC(name, _play_ui_sound, _play_ui_sound_atom)(name)
 void reset_sounds(void);
 void pause_sounds(void);
 void resume_sounds(void);
@@ -70,8 +86,13 @@ void update_sounds(void); // checks if loops need to be stopped
 
 int get_default_sfx_volume(const char *sfx);
 
-Sound* get_sound(const char *name) attr_nonnull(1);
-Music* get_music(const char *music) attr_nonnull(1);
+Sound* _get_sound(const char *name) attr_nonnull(1);
+Sound* _get_sound_atom(ResourceAtom *name) attr_nonnull(1);
+#define get_sound(name) RES_NAME_GENERIC(name, _get_sound, _get_sound_atom)(name)
+
+Music* _get_music(const char *music) attr_nonnull(1);
+Music* _get_music_atom(ResourceAtom *music) attr_nonnull(1);
+#define get_music(music) RES_NAME_GENERIC(music, _get_music, _get_music_atom)(music)
 
 void start_bgm(const char *name);
 void stop_bgm(bool force);
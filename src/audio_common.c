@@ -22,17 +22,17 @@ static ht_str2int_t sfx_volumes;
 
 static struct enqueued_sound {
 	LIST_INTERFACE(struct enqueued_sound);
-	char *name;
+	ResourceAtom *name;
 	int time;
 	int cooldown;
 	bool replace;
 } *sound_queue;
 
-static void play_sound_internal(const char *name, bool is_ui, int cooldown, bool replace, int delay) {
+static void play_sound_internal(ResourceAtom *name, bool is_ui, int cooldown, bool replace, int delay) {
 	if(delay > 0) {
 		struct enqueued_sound *s = malloc(sizeof(struct enqueued_sound));
 		s->time = global.frames + delay;
-		s->name = strdup(name);
+		s->name = name;
 		s->cooldown = cooldown;
 		s->replace = replace;
 		list_push(&sound_queue, s);
@@ -56,36 +56,49 @@ static void play_sound_internal(const char *name, bool is_ui, int cooldown, bool
 }
 
 static void* discard_enqueued_sound(List **queue, List *vsnd, void *arg) {
-	struct enqueued_sound *snd = (struct enqueued_sound*)vsnd;
-	free(snd->name);
 	free(list_unlink(queue, vsnd));
 	return NULL;
 }
 
 static void* play_enqueued_sound(struct enqueued_sound **queue, struct enqueued_sound *snd, void *arg) {
 	play_sound_internal(snd->name, false, snd->cooldown, snd->replace, 0);
-	free(snd->name);
 	free(list_unlink(queue, snd));
 	return NULL;
 }
 
-void play_sound(const char *name) {
+void _play_sound(const char *name) {
+	play_sound_internal(res_atom(name), false, 0, false, 0);
+}
+
+void _play_sound_atom(ResourceAtom *name) {
 	play_sound_internal(name, false, 0, false, 0);
 }
 
-void play_sound_ex(const char *name, int cooldown, bool replace) {
+void _play_sound_ex(const char *name, int cooldown, bool replace) {
+	play_sound_internal(res_atom(name), false, cooldown, replace, 0);
+}
+
+void _play_sound_ex_atom(ResourceAtom *name, int cooldown, bool replace) {
 	play_sound_internal(name, false, cooldown, replace, 0);
 }
 
-void play_sound_delayed(const char *name, int cooldown, bool replace, int delay) {
+void _play_sound_delayed(const char *name, int cooldown, bool replace, int delay) {
+	play_sound_internal(res_atom(name), false, cooldown, replace, delay);
+}
+
+void _play_sound_delayed_atom(ResourceAtom *name, int cooldown, bool replace, int delay) {
 	play_sound_internal(name, false, cooldown, replace, delay);
 }
 
-void play_ui_sound(const char *name) {
+void _play_ui_sound(const char *name) {
+	play_sound_internal(res_atom(name), true, 0, true, 0);
+}
+
+void _play_ui_sound_atom(ResourceAtom *name) {
 	play_sound_internal(name, true, 0, true, 0);
 }
 
-void play_loop(const char *name) {
+static void play_loop_internal(ResourceAtom *name) {
 	if(!audio_backend_initialized() || global.frameskip) {
 		return;
 	}
@@ -105,6 +118,14 @@ void play_loop(const char *name) {
 	}
 }
 
+void _play_loop(const char *name) {
+	play_loop_internal(res_atom(name));
+}
+
+void _play_loop_atom(ResourceAtom *name) {
+	play_loop_internal(name);
+}
+
 static void* reset_sounds_callback(const char *name, Resource *res, void *arg) {
 	bool reset = (intptr_t)arg;
 	Sound *snd = res->data;
@@ -156,11 +177,19 @@ void stop_sounds(void) {
 	audio_backend_sound_stop_all(SNDGROUP_MAIN);
 }
 
-Sound* get_sound(const char *name) {
+Sound* _get_sound(const char *name) {
 	return get_resource_data(RES_SFX, name, RESF_OPTIONAL);
 }
 
-Music* get_music(const char *name) {
+Sound* _get_sound_atom(ResourceAtom *name) {
+	return get_resource_data(RES_SFX, name, RESF_OPTIONAL);
+}
+
+Music* _get_music(const char *name) {
+	return get_resource_data(RES_BGM, name, RESF_OPTIONAL);
+}
+
+Music* _get_music_atom(ResourceAtom *name) {
 	return get_resource_data(RES_BGM, name, RESF_OPTIONAL);
 }
 
@@ -0,0 +1,347 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "benchmark.h"
+#include "global.h"
+#include "replay.h"
+#include "stageobjects.h"
+#include "version.h"
+
+#define NUM_STAGE_OBJPOOLS (sizeof(StageObjectPools) / sizeof(ObjectPool*))
+
+typedef struct SampleArray {
+	double *samples;
+	size_t num;
+	size_t capacity;
+} SampleArray;
+
+typedef struct BenchmarkReplay {
+	char *path;
+	Replay replay;
+	int firstidx;
+
+	SampleArray phases[NUM_BENCHMARK_PHASES];
+	SampleArray frames;
+	SampleArray runs;
+
+	ObjectPoolStats objpools[NUM_STAGE_OBJPOOLS];
+	double objpool_alloc_time_total[NUM_STAGE_OBJPOOLS];
+} BenchmarkReplay;
+
+static struct {
+	BenchmarkReplay *replays;
+	int num_replays;
+	int num_runs;
+	char *output;
+
+	BenchmarkReplay *current;
+	BenchmarkPhase phase;
+	hrtime_t phase_start;
+	hrtime_t frame_start;
+	double frame_phase_times[NUM_BENCHMARK_PHASES];
+	bool active;
+} bench;
+
+static const char *phase_names[] = {
+	#define BENCHMARK_PHASE(id, name) #name,
+	BENCHMARK_PHASES
+	#undef BENCHMARK_PHASE
+};
+
+static void samples_add(SampleArray *a, double sample) {
+	if(a->num == a->capacity) {
+		a->capacity = a->capacity ? a->capacity * 2 : 4096;
+		a->samples = realloc(a->samples, a->capacity * sizeof(*a->samples));
+	}
+
+	a->samples[a->num++] = sample;
+}
+
+static void samples_free(SampleArray *a) {
+	free(a->samples);
+	memset(a, 0, sizeof(*a));
+}
+
+bool benchmark_prepare(CLIAction *a) {
+	assert(a->type == CLI_Benchmark);
+
+	memset(&bench, 0, sizeof(bench));
+	bench.num_runs = a->benchmark.runs > 0 ? a->benchmark.runs : 1;
+	bench.replays = calloc(a->benchmark.num_replays, sizeof(*bench.replays));
+
+	if(a->benchmark.output) {
+		bench.output = strdup(a->benchmark.output);
+	}
+
+	for(int i = 0; i < a->benchmark.num_replays; ++i) {
+		BenchmarkReplay *r = bench.replays + i;
+
+		if(!replay_load_syspath(&r->replay, a->benchmark.replays[i], REPLAY_READ_ALL)) {
+			benchmark_shutdown();
+			return false;
+		}
+
+		++bench.num_replays;
+		r->path = strdup(a->benchmark.replays[i]);
+		r->firstidx = a->stageid ? replay_find_stage_idx(&r->replay, a->stageid) : 0;
+
+		if(r->firstidx < 0) {
+			benchmark_shutdown();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void benchmark_shutdown(void) {
+	for(int i = 0; i < bench.num_replays; ++i) {
+		BenchmarkReplay *r = bench.replays + i;
+
+		for(int p = 0; p < NUM_BENCHMARK_PHASES; ++p) {
+			samples_free(r->phases + p);
+		}
+
+		samples_free(&r->frames);
+		samples_free(&r->runs);
+		replay_destroy(&r->replay);
+		free(r->path);
+	}
+
+	free(bench.replays);
+	free(bench.output);
+	memset(&bench, 0, sizeof(bench));
+}
+
+static void benchmark_end_frame(hrtime_t now) {
+	if(bench.frame_start == 0) {
+		return;
+	}
+
+	BenchmarkReplay *r = bench.current;
+
+	for(int p = 0; p < NUM_BENCHMARK_PHASES; ++p) {
+		samples_add(r->phases + p, bench.frame_phase_times[p]);
+	}
+
+	samples_add(&r->frames, now - bench.frame_start);
+
+	ObjectPool **pools = &stage_object_pools.first;
+
+	for(int i = 0; i < NUM_STAGE_OBJPOOLS; ++i) {
+		ObjectPoolStats stats;
+		ObjectPoolStats *peak = r->objpools + i;
+		objpool_get_stats(pools[i], &stats);
+
+		peak->num_slabs = max(peak->num_slabs, stats.num_slabs);
+		peak->fragmentation = max(peak->fragmentation, stats.fragmentation);
+	}
+
+	memset(bench.frame_phase_times, 0, sizeof(bench.frame_phase_times));
+	bench.frame_start = 0;
+}
+
+void benchmark_frame(void) {
+	if(!bench.active) {
+		return;
+	}
+
+	hrtime_t now = time_get();
+	benchmark_end_frame(now);
+	bench.frame_start = now;
+}
+
+void benchmark_phase(BenchmarkPhase phase) {
+	if(!bench.active) {
+		return;
+	}
+
+	hrtime_t now = time_get();
+
+	if(bench.phase != BENCHMARK_PHASE_NONE) {
+		bench.frame_phase_times[bench.phase] += now - bench.phase_start;
+	}
+
+	bench.phase = phase;
+	bench.phase_start = now;
+}
+
+void benchmark_stage_end(void) {
+	if(!bench.active) {
+		return;
+	}
+
+	benchmark_phase(BENCHMARK_PHASE_NONE);
+	benchmark_end_frame(time_get());
+
+	ObjectPool **pools = &stage_object_pools.first;
+
+	for(int i = 0; i < NUM_STAGE_OBJPOOLS; ++i) {
+		ObjectPoolStats stats;
+		ObjectPoolStats *peak = bench.current->objpools + i;
+		objpool_get_stats(pools[i], &stats);
+
+		peak->tag = stats.tag;
+		peak->capacity = max(peak->capacity, stats.capacity);
+		peak->peak_usage = max(peak->peak_usage, stats.peak_usage);
+		peak->slab_size = stats.slab_size;
+		peak->alloc_time_max = max(peak->alloc_time_max, stats.alloc_time_max);
+		peak->alloc_samples += stats.alloc_samples;
+
+		bench.current->objpool_alloc_time_total[i] += stats.alloc_time_avg * stats.alloc_samples;
+		peak->alloc_time_avg = peak->alloc_samples ? bench.current->objpool_alloc_time_total[i] / peak->alloc_samples : 0;
+	}
+}
+
+static int sample_cmp(const void *a, const void *b) {
+	double s1 = *(const double*)a;
+	double s2 = *(const double*)b;
+	return (s1 > s2) - (s1 < s2);
+}
+
+static void write_json_string(SDL_RWops *out, const char *str) {
+	SDL_RWprintf(out, "\"");
+
+	for(const char *c = str; *c; ++c) {
+		if(*c == '"' || *c == '\\') {
+			SDL_RWprintf(out, "\\%c", *c);
+		} else if((uchar)*c < 0x20) {
+			SDL_RWprintf(out, "\\u%04x", (uchar)*c);
+		} else {
+			SDL_RWprintf(out, "%c", *c);
+		}
+	}
+
+	SDL_RWprintf(out, "\"");
+}
+
+static double write_json_stats(SDL_RWops *out, SampleArray *a) {
+	double total = 0;
+
+	if(a->num == 0) {
+		SDL_RWprintf(out, "null");
+		return total;
+	}
+
+	double *sorted = memdup(a->samples, a->num * sizeof(*sorted));
+	qsort(sorted, a->num, sizeof(*sorted), sample_cmp);
+
+	for(size_t i = 0; i < a->num; ++i) {
+		total += sorted[i];
+	}
+
+	size_t p99 = (size_t)ceil(a->num * 0.99) - 1;
+
+	SDL_RWprintf(out,
+		"{ \"min_ms\": %.4f, \"median_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"mean_ms\": %.4f, \"total_ms\": %.4f }",
+		sorted[0] * 1000,
+		sorted[a->num / 2] * 1000,
+		sorted[p99] * 1000,
+		sorted[a->num - 1] * 1000,
+		total / a->num * 1000,
+		total * 1000
+	);
+
+	free(sorted);
+	return total;
+}
+
+static void write_report(SDL_RWops *out) {
+	SDL_RWprintf(out, "{\n");
+	SDL_RWprintf(out, "  \"version\": ");
+	write_json_string(out, TAISEI_VERSION_FULL);
+	SDL_RWprintf(out, ",\n  \"build_type\": ");
+	write_json_string(out, TAISEI_VERSION_BUILD_TYPE);
+	SDL_RWprintf(out, ",\n  \"runs\": %i,\n  \"replays\": [\n", bench.num_runs);
+
+	for(int i = 0; i < bench.num_replays; ++i) {
+		BenchmarkReplay *r = bench.replays + i;
+
+		SDL_RWprintf(out, "    {\n      \"file\": ");
+		write_json_string(out, r->path);
+		SDL_RWprintf(out, ",\n      \"frames\": %zu", r->frames.num);
+		SDL_RWprintf(out, ",\n      \"run_time\": ");
+		write_json_stats(out, &r->runs);
+		SDL_RWprintf(out, ",\n      \"frame_time\": ");
+		double total = write_json_stats(out, &r->frames);
+		SDL_RWprintf(out, ",\n      \"fps\": %.2f", total > 0 ? r->frames.num / total : 0);
+		SDL_RWprintf(out, ",\n      \"phases\": {\n");
+
+		for(int p = 0; p < NUM_BENCHMARK_PHASES; ++p) {
+			SDL_RWprintf(out, "        \"%s\": ", phase_names[p]);
+			write_json_stats(out, r->phases + p);
+			SDL_RWprintf(out, "%s\n", p == NUM_BENCHMARK_PHASES - 1 ? "" : ",");
+		}
+
+		SDL_RWprintf(out, "      },\n      \"objpools\": {\n");
+
+		for(int p = 0; p < NUM_STAGE_OBJPOOLS; ++p) {
+			ObjectPoolStats *s = r->objpools + p;
+			SDL_RWprintf(out, "        ");
+			write_json_string(out, s->tag ? s->tag : "");
+			SDL_RWprintf(out,
+				": { \"peak_usage\": %zu, \"capacity\": %zu, \"slabs\": %zu, \"slab_size\": %zu, "
+				"\"fragmentation\": %.4f, \"alloc_us_avg\": %.4f, \"alloc_us_max\": %.4f }%s\n",
+				s->peak_usage,
+				s->capacity,
+				s->num_slabs,
+				s->slab_size,
+				s->fragmentation,
+				s->alloc_time_avg * 1e6,
+				s->alloc_time_max * 1e6,
+				p == NUM_STAGE_OBJPOOLS - 1 ? "" : ","
+			);
+		}
+
+		SDL_RWprintf(out, "      }\n    }%s\n", i == bench.num_replays - 1 ? "" : ",");
+	}
+
+	SDL_RWprintf(out, "  ]\n}\n");
+}
+
+int benchmark_run(void) {
+	for(int i = 0; i < bench.num_replays && !taisei_quit_requested(); ++i) {
+		BenchmarkReplay *r = bench.current = bench.replays + i;
+
+		for(int run = 0; run < bench.num_runs && !taisei_quit_requested(); ++run) {
+			log_info("Benchmarking %s: run %i of %i", r->path, run + 1, bench.num_runs);
+
+			bench.active = true;
+			bench.phase = BENCHMARK_PHASE_NONE;
+			bench.frame_start = 0;
+
+			hrtime_t start_time = time_get();
+			replay_play(&r->replay, r->firstidx);
+			samples_add(&r->runs, time_get() - start_time);
+
+			bench.active = false;
+		}
+	}
+
+	bench.current = NULL;
+
+	SDL_RWops *out;
+
+	if(bench.output && strcmp(bench.output, "-")) {
+		out = SDL_RWFromFile(bench.output, "w");
+	} else {
+		out = SDL_RWFromFP(stdout, false);
+	}
+
+	if(!out) {
+		log_warn("Couldn't open benchmark output: %s", SDL_GetError());
+		return 1;
+	}
+
+	write_report(out);
+	SDL_RWclose(out);
+
+	return 0;
+}
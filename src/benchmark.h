@@ -0,0 +1,46 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "cli.h"
+
+/*
+ * Headless benchmark mode (--benchmark). Plays back replays like --verify-replay
+ * does, but renders every frame with the null renderer, times each part of the
+ * frame and writes a JSON report at the end.
+ */
+
+#define BENCHMARK_PHASES \
+	BENCHMARK_PHASE(PLAYER, player) \
+	BENCHMARK_PHASE(BOSS, boss) \
+	BENCHMARK_PHASE(ENEMIES, enemies) \
+	BENCHMARK_PHASE(PROJECTILES, projectiles) \
+	BENCHMARK_PHASE(ITEMS, items) \
+	BENCHMARK_PHASE(LASERS, lasers) \
+	BENCHMARK_PHASE(PARTICLES, particles) \
+	BENCHMARK_PHASE(RENDER, render) \
+
+typedef enum BenchmarkPhase {
+	#define BENCHMARK_PHASE(id, name) BENCHMARK_PHASE_##id,
+	BENCHMARK_PHASES
+	#undef BENCHMARK_PHASE
+	NUM_BENCHMARK_PHASES,
+	BENCHMARK_PHASE_NONE = NUM_BENCHMARK_PHASES,
+} BenchmarkPhase;
+
+// Must be called before free_cli_action(); loads all the replays up front.
+bool benchmark_prepare(CLIAction *a);
+int benchmark_run(void);
+void benchmark_shutdown(void);
+
+// Hooks for the game loop; these do nothing unless a benchmark is running.
+void benchmark_frame(void);
+void benchmark_phase(BenchmarkPhase phase);
+void benchmark_stage_end(void);
@@ -402,7 +402,7 @@ void draw_boss_hud(Boss *boss) {
 
 		// remaining spells
 		r_color4(0.7, 0.7, 0.7, 0.7);
-		Sprite *star = get_sprite("star");
+		Sprite *star = get_sprite(RES_ATOM("star"));
 
 		for(int x = 0, i = boss->acount-1; i > nextspell; i--) {
 			if(
@@ -488,9 +488,9 @@ static DamageResult ent_damage_boss(EntityInterface *ent, const DamageInfo *dmg)
 	boss->current->hp -= dmg->amount*factor;
 
 	if(boss->current->hp < boss->current->maxhp * 0.1) {
-		play_loop("hit1");
+		play_loop(RES_ATOM("hit1"));
 	} else {
-		play_loop("hit0");
+		play_loop(RES_ATOM("hit0"));
 	}
 
 	return DMG_RESULT_OK;
@@ -44,6 +44,9 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 	struct TsOption taisei_opts[] = {
 		{{"replay", required_argument, 0, 'r'}, "Play a replay from %s", "FILE"},
 		{{"verify-replay", required_argument, 0, 'R'}, "Play a replay from %s in headless mode, crash as soon as it desyncs", "FILE"},
+		{{"benchmark", required_argument, 0, 'b'}, "Benchmark a replay from %s in headless mode (may be repeated)", "FILE"},
+		{{"benchmark-runs", required_argument, 0, 'N'}, "Play each benchmarked replay %s times", "N"},
+		{{"benchmark-output", required_argument, 0, 'o'}, "Write the benchmark report to %s instead of stdout", "FILE"},
 #ifdef DEBUG
 		{{"play", no_argument, 0, 'p'}, "Play a specific stage", 0},
 		{{"sid", required_argument, 0, 'i'}, "Select stage by %s", "ID"},
@@ -51,6 +54,7 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 		{{"shotmode", required_argument, 0, 's'}, "Select a shotmode (marisaA/youmuA/marisaB/youmuB)", "SMODE"},
 		{{"dumpstages", no_argument, 0, 'u'}, "Print a list of all stages in the game", 0},
 		{{"vfs-tree", required_argument, 0, 't'}, "Print the virtual filesystem tree starting from %s", "PATH"},
+		{{"microbench", required_argument, 0, 'm'}, "Run the %s microbenchmark ('list' to list them, 'all' to run all)", "NAME"},
 #endif
 		{{"frameskip", optional_argument, 0, 'f'}, "Disable FPS limiter, render only every %s frame", "FRAME"},
 		{{"credits", no_argument, 0, 'c'}, "Show the credits scene and exit"},
@@ -110,6 +114,20 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 			a->type = CLI_VerifyReplay;
 			a->filename = strdup(optarg);
 			break;
+		case 'b':
+			a->type = CLI_Benchmark;
+			a->benchmark.replays = realloc(a->benchmark.replays, (a->benchmark.num_replays + 1) * sizeof(char*));
+			a->benchmark.replays[a->benchmark.num_replays++] = strdup(optarg);
+			break;
+		case 'N':
+			a->benchmark.runs = strtol(optarg, &endptr, 10);
+			if(!*optarg || endptr == optarg || a->benchmark.runs < 1)
+				log_fatal("Invalid number of benchmark runs '%s'", optarg);
+			break;
+		case 'o':
+			free(a->benchmark.output);
+			a->benchmark.output = strdup(optarg);
+			break;
 		case 'p':
 			a->type = CLI_SelectStage;
 			break;
@@ -158,6 +176,10 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 			a->type = CLI_DumpVFSTree,
 			a->filename = strdup(optarg ? optarg : "");
 			break;
+		case 'm':
+			a->type = CLI_Microbenchmark;
+			a->filename = strdup(optarg);
+			break;
 		case 'c':
 			a->type = CLI_Credits;
 			break;
@@ -170,6 +192,7 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 		switch(a->type) {
 			case CLI_PlayReplay:
 			case CLI_VerifyReplay:
+			case CLI_Benchmark:
 			case CLI_SelectStage:
 				if(stage_get(stageid) == NULL) {
 					log_fatal("Invalid stage id: %X", stageid);
@@ -190,6 +213,10 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 		}
 	}
 
+	if(a->type != CLI_Benchmark && (a->benchmark.runs || a->benchmark.output)) {
+		log_warn("--benchmark-runs and --benchmark-output were ignored");
+	}
+
 	a->stageid = stageid;
 
 	if(a->type == CLI_SelectStage && !stageid)
@@ -200,4 +227,11 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 
 void free_cli_action(CLIAction *a) {
 	free(a->filename);
+
+	for(int i = 0; i < a->benchmark.num_replays; ++i) {
+		free(a->benchmark.replays[i]);
+	}
+
+	free(a->benchmark.replays);
+	free(a->benchmark.output);
 }
@@ -20,6 +20,8 @@ typedef enum {
 	CLI_DumpVFSTree,
 	CLI_Quit,
 	CLI_Credits,
+	CLI_Benchmark,
+	CLI_Microbenchmark,
 } CLIActionType;
 
 typedef struct CLIAction CLIAction;
@@ -30,6 +32,13 @@ struct CLIAction {
 	int diff;
 	int frameskip;
 	PlayerMode *plrmode;
+
+	struct {
+		char **replays;
+		int num_replays;
+		int runs;
+		char *output;
+	} benchmark;
 };
 
 int cli_args(int argc, char **argv, CLIAction *a);
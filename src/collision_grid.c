@@ -0,0 +1,251 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "collision_grid.h"
+#include "global.h"
+#include "hirestime.h"
+#include "stageobjects.h"
+
+#define GRID_CELL_SIZE 64
+#define GRID_COLS ((VIEWPORT_W + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE)
+#define GRID_ROWS ((VIEWPORT_H + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE)
+#define GRID_NUM_CELLS (GRID_COLS * GRID_ROWS)
+
+typedef struct GridEntry {
+	EntityInterface *ent;
+	complex *pos;
+	uint order;
+} GridEntry;
+
+static struct {
+	// Entries are counting-sorted by cell; cell i owns entries [cell_start[i], cell_start[i+1]).
+	// Within a cell they are in list order, since the lists are walked in order when building.
+	GridEntry *entries;
+	GridEntry *scratch;
+	uint cell_start[GRID_NUM_CELLS + 1];
+	uint num_entries;
+	uint capacity;
+	Boss *boss;
+	bool valid;
+
+	struct {
+		bool enabled;
+		uint depth;
+		uint frames;
+		uint queries;
+		hrtime_t begin;
+		hrtime_t frame_time;
+		hrtime_t total_time;
+		hrtime_t max_time;
+	} stats;
+} grid;
+
+static inline int grid_col(double x) {
+	return (int)clamp(floor(x / GRID_CELL_SIZE), 0, GRID_COLS - 1);
+}
+
+static inline int grid_row(double y) {
+	return (int)clamp(floor(y / GRID_CELL_SIZE), 0, GRID_ROWS - 1);
+}
+
+static inline uint grid_cell(complex pos) {
+	return grid_row(cimag(pos)) * GRID_COLS + grid_col(creal(pos));
+}
+
+void collision_grid_init(void) {
+	memset(&grid, 0, sizeof(grid));
+	grid.capacity = 64;
+	grid.entries = calloc(grid.capacity, sizeof(*grid.entries));
+	grid.scratch = calloc(grid.capacity, sizeof(*grid.scratch));
+	grid.stats.enabled = env_get("TAISEI_COLLISION_STATS", 0);
+}
+
+void collision_grid_shutdown(void) {
+	if(grid.stats.enabled && grid.stats.frames) {
+		log_info("Collision: %u frames, %.3fms per frame on average, %.3fms max, %u queries",
+			grid.stats.frames,
+			(double)(grid.stats.total_time / grid.stats.frames) * 1000,
+			(double)grid.stats.max_time * 1000,
+			grid.stats.queries
+		);
+	}
+
+	free(grid.entries);
+	free(grid.scratch);
+	memset(&grid, 0, sizeof(grid));
+}
+
+void collision_grid_invalidate(void) {
+	grid.valid = false;
+}
+
+static void grid_add(EntityInterface *ent, complex *pos) {
+	if(grid.num_entries == grid.capacity) {
+		grid.capacity *= 2;
+		grid.entries = realloc(grid.entries, grid.capacity * sizeof(*grid.entries));
+		grid.scratch = realloc(grid.scratch, grid.capacity * sizeof(*grid.scratch));
+	}
+
+	grid.scratch[grid.num_entries] = (GridEntry) {
+		.ent = ent,
+		.pos = pos,
+		.order = grid.num_entries,
+	};
+
+	++grid.num_entries;
+}
+
+void collision_grid_rebuild(void) {
+	collision_grid_stats_begin();
+
+	grid.num_entries = 0;
+
+	for(Enemy *e = global.enemies.first; e; e = e->next) {
+		grid_add(&e->ent, &e->pos);
+	}
+
+	if((grid.boss = global.boss)) {
+		grid_add(&grid.boss->ent, &grid.boss->pos);
+	}
+
+	uint counts[GRID_NUM_CELLS] = { 0 };
+	uint cells[grid.num_entries + 1];
+
+	for(uint i = 0; i < grid.num_entries; ++i) {
+		++counts[cells[i] = grid_cell(*grid.scratch[i].pos)];
+	}
+
+	grid.cell_start[0] = 0;
+
+	for(uint i = 0; i < GRID_NUM_CELLS; ++i) {
+		grid.cell_start[i + 1] = grid.cell_start[i] + counts[i];
+		counts[i] = grid.cell_start[i];
+	}
+
+	for(uint i = 0; i < grid.num_entries; ++i) {
+		grid.entries[counts[cells[i]]++] = grid.scratch[i];
+	}
+
+	grid.valid = true;
+	collision_grid_stats_end();
+}
+
+static inline void grid_ensure_valid(void) {
+	if(!grid.valid || grid.boss != global.boss) {
+		collision_grid_rebuild();
+	}
+}
+
+static inline bool grid_entry_in_range(GridEntry *e, complex origin, double radius) {
+	return cabs(*e->pos - origin) < radius;
+}
+
+EntityInterface* collision_grid_find_first(complex origin, double radius, CollisionGridPredicate predicate, void *arg) {
+	grid_ensure_valid();
+	++grid.stats.queries;
+
+	int col0 = grid_col(creal(origin) - radius), col1 = grid_col(creal(origin) + radius);
+	int row0 = grid_row(cimag(origin) - radius), row1 = grid_row(cimag(origin) + radius);
+	GridEntry *best = NULL;
+
+	for(int row = row0; row <= row1; ++row) {
+		for(int col = col0; col <= col1; ++col) {
+			uint cell = row * GRID_COLS + col;
+
+			for(uint i = grid.cell_start[cell]; i < grid.cell_start[cell + 1]; ++i) {
+				GridEntry *e = grid.entries + i;
+
+				if(best && e->order > best->order) {
+					// everything after this is later in list order as well
+					break;
+				}
+
+				if(grid_entry_in_range(e, origin, radius) && (!predicate || predicate(e->ent, arg))) {
+					best = e;
+					break;
+				}
+			}
+		}
+	}
+
+	return best ? best->ent : NULL;
+}
+
+static int grid_entry_cmp(const void *a, const void *b) {
+	uint o1 = ((const GridEntry*)a)->order;
+	uint o2 = ((const GridEntry*)b)->order;
+	return (o1 > o2) - (o1 < o2);
+}
+
+void collision_grid_foreach(complex origin, double radius, CollisionGridCallback func, void *arg) {
+	grid_ensure_valid();
+	++grid.stats.queries;
+
+	int col0 = grid_col(creal(origin) - radius), col1 = grid_col(creal(origin) + radius);
+	int row0 = grid_row(cimag(origin) - radius), row1 = grid_row(cimag(origin) + radius);
+	// Copied out, because the callbacks may cause the grid to be rebuilt.
+	GridEntry hits[grid.num_entries + 1];
+	uint num_hits = 0;
+
+	for(int row = row0; row <= row1; ++row) {
+		for(int col = col0; col <= col1; ++col) {
+			uint cell = row * GRID_COLS + col;
+
+			for(uint i = grid.cell_start[cell]; i < grid.cell_start[cell + 1]; ++i) {
+				if(grid_entry_in_range(grid.entries + i, origin, radius)) {
+					hits[num_hits++] = grid.entries[i];
+				}
+			}
+		}
+	}
+
+	if(num_hits > 1) {
+		qsort(hits, num_hits, sizeof(*hits), grid_entry_cmp);
+	}
+
+	for(uint i = 0; i < num_hits; ++i) {
+		func(hits[i].ent, arg);
+	}
+}
+
+void collision_grid_stats_begin(void) {
+	if(grid.stats.enabled && !grid.stats.depth++) {
+		grid.stats.begin = time_get();
+	}
+}
+
+void collision_grid_stats_end(void) {
+	if(grid.stats.enabled && !--grid.stats.depth) {
+		grid.stats.frame_time += time_get() - grid.stats.begin;
+	}
+}
+
+void collision_grid_stats_frame(void) {
+	if(!grid.stats.enabled) {
+		return;
+	}
+
+	hrtime_t t = grid.stats.frame_time;
+	grid.stats.frame_time = 0;
+	grid.stats.total_time += t;
+	grid.stats.max_time = max(grid.stats.max_time, t);
+
+	if(!(++grid.stats.frames % FPS)) {
+		ObjectPoolStats pstats;
+		objpool_get_stats(stage_object_pools.projectiles, &pstats);
+
+		log_debug("Collision: %.3fms this frame, %.3fms per frame on average (%u targets, %zu projectiles)",
+			(double)t * 1000,
+			(double)(grid.stats.total_time / grid.stats.frames) * 1000,
+			grid.num_entries,
+			pstats.usage
+		);
+	}
+}
@@ -0,0 +1,44 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "entity.h"
+
+/*
+ * A uniform grid over the viewport, used as a broadphase for collisions against
+ * enemies and the boss. It's rebuilt once per logic frame, right before the
+ * projectiles are processed, and lazily whenever an enemy or boss has been
+ * spawned or removed since, or the game logic has moved them (stage_logic
+ * invalidates it after every such phase). Entities are bucketed by their center point;
+ * whatever is outside of the viewport ends up in the border cells.
+ *
+ * Results are always reported in the order a linear scan over global.enemies
+ * (followed by the boss) would produce them, so replays stay in sync.
+ */
+
+typedef bool (*CollisionGridPredicate)(EntityInterface *ent, void *arg);
+typedef void (*CollisionGridCallback)(EntityInterface *ent, void *arg);
+
+void collision_grid_init(void);
+void collision_grid_shutdown(void);
+
+void collision_grid_rebuild(void);
+void collision_grid_invalidate(void);
+
+// First entity within radius of origin that satisfies the predicate (if not NULL).
+EntityInterface* collision_grid_find_first(complex origin, double radius, CollisionGridPredicate predicate, void *arg);
+
+// Calls func for every entity within radius of origin.
+void collision_grid_foreach(complex origin, double radius, CollisionGridCallback func, void *arg);
+
+// Time spent in collision detection. These are no-ops unless TAISEI_COLLISION_STATS is set.
+void collision_grid_stats_begin(void);
+void collision_grid_stats_end(void);
+void collision_grid_stats_frame(void);
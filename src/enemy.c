@@ -18,6 +18,7 @@
 #include "stageobjects.h"
 #include "util/glm.h"
 #include "entity.h"
+#include "collision_grid.h"
 
 #ifdef create_enemy_p
 #undef create_enemy_p
@@ -93,6 +94,7 @@ Enemy *create_enemy_p(EnemyList *enemies, complex pos, float hp, EnemyVisualRule
 
 	fix_pos0_visual(e);
 	ent_register(&e->ent, ENT_ENEMY);
+	collision_grid_invalidate();
 
 	e->logic_rule(e, EVENT_BIRTH);
 	return e;
@@ -123,9 +125,10 @@ void* _delete_enemy(ListAnchor *enemies, List* enemy, void *arg) {
 	}
 
 	e->logic_rule(e, EVENT_DEATH);
-	del_ref(enemy);
+	del_ref(e);
 	ent_unregister(&e->ent);
 	objpool_release(stage_object_pools.enemies, (ObjectInterface*)alist_unlink(enemies, enemy));
+	collision_grid_invalidate();
 
 	return NULL;
 }
@@ -328,9 +331,9 @@ static DamageResult ent_damage_enemy(EntityInterface *ienemy, const DamageInfo *
 	}
 
 	if(enemy->hp < enemy->spawn_hp * 0.1) {
-		play_loop("hit1");
+		play_loop(RES_ATOM("hit1"));
 	} else {
-		play_loop("hit0");
+		play_loop(RES_ATOM("hit0"));
 	}
 
 	return DMG_RESULT_OK;
@@ -12,12 +12,23 @@
 #include "util.h"
 #include "renderer/api.h"
 #include "global.h"
+#include "collision_grid.h"
+
+typedef struct EntitySortItem {
+	uint64_t key;
+	EntityInterface *ent;
+} EntitySortItem;
 
 static struct {
 	EntityInterface **array;
 	uint num;
 	uint capacity;
 	uint32_t total_spawns;
+
+	struct {
+		EntitySortItem *items[2];
+		uint capacity;
+	} sort;
 } entities;
 
 #define FOR_EACH_ENT(ent) for(EntityInterface **_ent = entities.array, *ent = *entities.array; _ent < entities.array + entities.num; ent = *(++_ent))
@@ -38,6 +49,8 @@ void ent_shutdown(void) {
 	}
 
 	free(entities.array);
+	free(entities.sort.items[0]);
+	free(entities.sort.items[1]);
 }
 
 void ent_register(EntityInterface *ent, EntityType type) {
@@ -45,6 +58,7 @@ void ent_register(EntityInterface *ent, EntityType type) {
 	ent->type = type;
 	ent->index = entities.num++;
 	ent->spawn_id = ++entities.total_spawns;
+	ent->ref_slot = 0;
 
 	if(ent->spawn_id == 0) {
 		// This is not really an error, but it may result in weird draw order
@@ -64,6 +78,31 @@ void ent_register(EntityInterface *ent, EntityType type) {
 	assert(entities.array[ent->index] == ent);
 }
 
+void ent_register_batch(uint num, EntityInterface *ents[num], EntityType type) {
+	assert(type > _ENT_TYPE_ENUM_BEGIN && type < _ENT_TYPE_ENUM_END);
+
+	if(entities.capacity < entities.num + num) {
+		do {
+			entities.capacity *= 2;
+		} while(entities.capacity < entities.num + num);
+
+		entities.array = realloc(entities.array, entities.capacity * sizeof(EntityInterface*));
+	}
+
+	for(uint i = 0; i < num; ++i) {
+		EntityInterface *ent = ents[i];
+		ent->type = type;
+		ent->index = entities.num++;
+		ent->spawn_id = ++entities.total_spawns;
+		ent->ref_slot = 0;
+		entities.array[ent->index] = ent;
+	}
+
+	if(entities.total_spawns < num) {
+		log_debug("spawn_id just overflowed. You might be spawning stuff waaaay too often");
+	}
+}
+
 void ent_unregister(EntityInterface *ent) {
 	EntityInterface *sub = entities.array[--entities.num];
 	assert(ent->index <= entities.num);
@@ -71,22 +110,81 @@ void ent_unregister(EntityInterface *ent) {
 	entities.array[sub->index = ent->index] = sub;
 }
 
-static int ent_cmp(const void *ptr1, const void *ptr2) {
-	const EntityInterface *ent1 = *(const EntityInterface**)ptr1;
-	const EntityInterface *ent2 = *(const EntityInterface**)ptr2;
+static inline uint64_t ent_sort_key(EntityInterface *ent) {
+	// Order by layer; same layer? Put whatever spawned later on top, then.
+	return ((uint64_t)ent->draw_layer << 32) | ent->spawn_id;
+}
+
+static void ent_sort(void) {
+	// LSD radix sort by (draw_layer, spawn_id), one byte per pass.
+	//
+	// The draw layer may be changed by the owner at any time, so there is no
+	// way around sorting every frame, but passes where all keys share the same
+	// digit are skipped, which is most of the spawn_id ones. The common case
+	// where nothing has been spawned or removed since the last frame costs a
+	// single linear scan.
+
+	uint n = entities.num;
+
+	if(entities.sort.capacity < n) {
+		entities.sort.capacity = entities.capacity;
+		entities.sort.items[0] = realloc(entities.sort.items[0], entities.sort.capacity * sizeof(EntitySortItem));
+		entities.sort.items[1] = realloc(entities.sort.items[1], entities.sort.capacity * sizeof(EntitySortItem));
+	}
+
+	EntitySortItem *src = entities.sort.items[0];
+	EntitySortItem *dst = entities.sort.items[1];
+	uint counts[sizeof(uint64_t)][256] = { 0 };
+	uint64_t prev_key = 0;
+	bool sorted = true;
+
+	for(uint i = 0; i < n; ++i) {
+		uint64_t key = ent_sort_key(entities.array[i]);
 
-	int r = (ent1->draw_layer > ent2->draw_layer) - (ent1->draw_layer < ent2->draw_layer);
+		src[i].key = key;
+		src[i].ent = entities.array[i];
+		sorted &= (key >= prev_key);
+		prev_key = key;
 
-	if(r == 0) {
-		// Same layer? Put whatever spawned later on top, then.
-		r = (ent1->spawn_id > ent2->spawn_id) - (ent1->spawn_id < ent2->spawn_id);
+		for(uint d = 0; d < sizeof(uint64_t); ++d) {
+			++counts[d][(key >> (d * 8)) & 0xff];
+		}
+	}
+
+	if(sorted) {
+		return;
 	}
 
-	return r;
+	for(uint d = 0; d < sizeof(uint64_t); ++d) {
+		uint *c = counts[d];
+		uint shift = d * 8;
+
+		if(c[(src[0].key >> shift) & 0xff] == n) {
+			continue;
+		}
+
+		for(uint i = 0, ofs = 0; i < 256; ++i) {
+			uint cnt = c[i];
+			c[i] = ofs;
+			ofs += cnt;
+		}
+
+		for(uint i = 0; i < n; ++i) {
+			dst[c[(src[i].key >> shift) & 0xff]++] = src[i];
+		}
+
+		EntitySortItem *tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	for(uint i = 0; i < n; ++i) {
+		entities.array[i] = src[i].ent;
+	}
 }
 
 void ent_draw(EntityPredicate predicate) {
-	qsort(entities.array, entities.num, sizeof(EntityInterface*), ent_cmp);
+	ent_sort();
 
 	if(predicate) {
 		FOR_EACH_ENT(ent) {
@@ -127,14 +225,12 @@ DamageResult ent_damage(EntityInterface *ent, const DamageInfo *damage) {
 	return res;
 }
 
-void ent_area_damage(complex origin, float radius, const DamageInfo *damage) {
-	for(Enemy *e = global.enemies.first; e; e = e->next) {
-		if(cabs(origin - e->pos) < radius) {
-			ent_damage(&e->ent, damage);
-		}
-	}
+static void ent_area_damage_callback(EntityInterface *ent, void *damage) {
+	ent_damage(ent, damage);
+}
 
-	if(global.boss && cabs(origin - global.boss->pos) < radius) {
-		ent_damage(&global.boss->ent, damage);
-	}
+void ent_area_damage(complex origin, float radius, const DamageInfo *damage) {
+	collision_grid_stats_begin();
+	collision_grid_foreach(origin, radius, ent_area_damage_callback, (void*)damage);
+	collision_grid_stats_end();
 }
@@ -80,6 +80,7 @@ typedef DamageResult (*EntityDamageFunc)(EntityInterface *target, const DamageIn
 	drawlayer_t draw_layer; \
 	uint32_t spawn_id; \
 	uint index; \
+	uint ref_slot; \
 }
 
 #define ENTITY_INTERFACE(typename) union { \
@@ -130,6 +131,7 @@ static inline attr_must_inline const char* ent_type_name(EntityType type) {
 void ent_init(void);
 void ent_shutdown(void);
 void ent_register(EntityInterface *ent, EntityType type) attr_nonnull(1);
+void ent_register_batch(uint num, EntityInterface *ents[num], EntityType type);
 void ent_unregister(EntityInterface *ent) attr_nonnull(1);
 void ent_draw(EntityPredicate predicate);
 DamageResult ent_damage(EntityInterface *ent, const DamageInfo *damage) attr_nonnull(1, 2);
@@ -162,7 +162,7 @@ begin_frame:
 			break;
 		}
 
-		if((!uncapped_rendering && frame_num % get_effective_frameskip()) || global.is_replay_verification) {
+		if((!uncapped_rendering && frame_num % get_effective_frameskip()) || (global.is_replay_verification && !global.is_benchmark)) {
 			rframe_action = RFRAME_DROP;
 		} else {
 			r_framebuffer_clear(NULL, CLEAR_ALL, RGBA(0, 0, 0, 1), 1);
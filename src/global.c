@@ -28,6 +28,11 @@ void init_global(CLIAction *cli) {
 		global.is_headless = true;
 		global.is_replay_verification = true;
 		global.frameskip = 1;
+	} else if(cli->type == CLI_Benchmark) {
+		global.is_headless = true;
+		global.is_replay_verification = true;
+		global.is_benchmark = true;
+		global.frameskip = 1;
 	} else if(global.frameskip) {
 		log_warn("FPS limiter disabled. Gotta go fast! (frameskip = %i)", global.frameskip);
 	}
@@ -177,15 +177,15 @@ void process_items(void) {
 			switch(item->type) {
 			case Power:
 				player_set_power(&global.plr, global.plr.power + POWER_VALUE);
-				play_sound("item_generic");
+				play_sound(RES_ATOM("item_generic"));
 				break;
 			case Point:
 				player_add_points(&global.plr, 100);
-				play_sound("item_generic");
+				play_sound(RES_ATOM("item_generic"));
 				break;
 			case BPoint:
 				player_add_points(&global.plr, 1);
-				play_sound("item_generic");
+				play_sound(RES_ATOM("item_generic"));
 				break;
 			case Life:
 				player_add_lives(&global.plr, 1);
@@ -19,6 +19,7 @@ static struct {
 	VertexArray *varr;
 	VertexBuffer *vbuf;
 	ShaderProgram *shader_generic;
+	Texture *tex;
 	Model quad_generic;
 } lasers;
 
@@ -29,6 +30,7 @@ typedef struct LaserInstancedAttribs {
 
 void lasers_preload(void) {
 	preload_resource(RES_SHADER_PROGRAM, "laser_generic", RESF_DEFAULT);
+	preload_resource(RES_TEXTURE, "part/lasercurve", RESF_DEFAULT);
 
 	size_t sz_vert = sizeof(GenericModelVertex);
 	size_t sz_attr = sizeof(LaserInstancedAttribs);
@@ -67,6 +69,7 @@ void lasers_preload(void) {
 	lasers.quad_generic.vertex_array = lasers.varr;
 
 	lasers.shader_generic = r_shader_get("laser_generic");
+	lasers.tex = get_tex("part/lasercurve");
 }
 
 void lasers_free(void) {
@@ -160,13 +163,13 @@ static void draw_laser_curve_specialized(Laser *l) {
 
 	r_shader_ptr(l->shader);
 	r_color(&l->color);
-	r_uniform_sampler("tex", "part/lasercurve");
-	r_uniform_vec2_complex("origin", l->pos);
-	r_uniform_vec2_array_complex("args[0]", 0, 4, l->args);
-	r_uniform_float("timeshift", timeshift);
-	r_uniform_float("width", l->width);
-	r_uniform_float("width_exponent", l->width_exponent);
-	r_uniform_int("span", instances);
+	r_uniform_sampler(r_cached_uniform("tex"), lasers.tex);
+	r_uniform_vec2_complex(r_cached_uniform("origin"), l->pos);
+	r_uniform_vec2_array_complex(r_cached_uniform("args[0]"), 0, 4, l->args);
+	r_uniform_float(r_cached_uniform("timeshift"), timeshift);
+	r_uniform_float(r_cached_uniform("width"), l->width);
+	r_uniform_float(r_cached_uniform("width_exponent"), l->width_exponent);
+	r_uniform_int(r_cached_uniform("span"), instances);
 	r_draw_quad_instanced(instances);
 }
 
@@ -180,11 +183,11 @@ static void draw_laser_curve_generic(Laser *l) {
 
 	r_shader_ptr(lasers.shader_generic);
 	r_color(&l->color);
-	r_uniform_sampler("tex", "part/lasercurve");
-	r_uniform_float("timeshift", timeshift);
-	r_uniform_float("width", l->width);
-	r_uniform_float("width_exponent", l->width_exponent);
-	r_uniform_int("span", instances);
+	r_uniform_sampler(r_cached_uniform("tex"), lasers.tex);
+	r_uniform_float(r_cached_uniform("timeshift"), timeshift);
+	r_uniform_float(r_cached_uniform("width"), l->width);
+	r_uniform_float(r_cached_uniform("width_exponent"), l->width_exponent);
+	r_uniform_int(r_cached_uniform("span"), instances);
 
 	SDL_RWops *stream = r_vertex_buffer_get_stream(lasers.vbuf);
 	r_vertex_buffer_invalidate(lasers.vbuf);
@@ -220,7 +223,7 @@ void* _delete_laser(ListAnchor *lasers, List *laser, void *arg) {
 	if(l->lrule)
 		l->lrule(l, EVENT_DEATH);
 
-	del_ref(laser);
+	del_ref(l);
 	ent_unregister(&l->ent);
 	objpool_release(stage_object_pools.lasers, (ObjectInterface*)alist_unlink(lasers, laser));
 	return NULL;
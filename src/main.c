@@ -26,6 +26,8 @@
 #include "credits.h"
 #include "renderer/api.h"
 #include "taskmanager.h"
+#include "benchmark.h"
+#include "microbench.h"
 
 static void taisei_shutdown(void) {
 	log_info("Shutting down");
@@ -157,6 +159,10 @@ int main(int argc, char **argv) {
 
 		free_cli_action(&a);
 		return 0;
+	} else if(a.type == CLI_Microbenchmark) {
+		int status = microbench_run(a.filename);
+		free_cli_action(&a);
+		return status;
 	} else if(a.type == CLI_PlayReplay || a.type == CLI_VerifyReplay) {
 		if(!replay_load_syspath(&replay, a.filename, REPLAY_READ_ALL)) {
 			free_cli_action(&a);
@@ -173,6 +179,13 @@ int main(int argc, char **argv) {
 		if(a.type == CLI_VerifyReplay) {
 			headless = true;
 		}
+	} else if(a.type == CLI_Benchmark) {
+		if(!benchmark_prepare(&a)) {
+			free_cli_action(&a);
+			return 1;
+		}
+
+		headless = true;
 	} else if(a.type == CLI_DumpVFSTree) {
 		vfs_setup(true);
 
@@ -245,6 +258,12 @@ int main(int argc, char **argv) {
 		return 0;
 	}
 
+	if(a.type == CLI_Benchmark) {
+		int status = benchmark_run();
+		benchmark_shutdown();
+		return status;
+	}
+
 	if(a.type == CLI_Credits) {
 		credits_loop();
 		return 0;
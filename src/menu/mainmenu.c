@@ -189,9 +189,26 @@ void draw_main_menu(MenuData *menu) {
 }
 
 void draw_loading_screen(void) {
+	draw_loading_screen_progress(-1);
+}
+
+void draw_loading_screen_progress(double progress) {
 	preload_resource(RES_TEXTURE, "loading", RESF_PERMANENT);
 	set_ortho(SCREEN_W, SCREEN_H);
 	fill_screen("loading");
+
+	if(progress >= 0) {
+		float w = SCREEN_W * 0.6 * clamp(progress, 0, 1);
+		r_shader_standard_notex();
+		r_mat_push();
+		r_mat_translate(SCREEN_W * 0.2 + w * 0.5, SCREEN_H - 40, 0);
+		r_mat_scale(w, 4, 1);
+		r_color4(1, 1, 1, 1);
+		r_draw_quad();
+		r_mat_pop();
+		r_shader_standard();
+	}
+
 	/*
 	text_draw(TAISEI_VERSION, &(TextParams) {
 		.align = ALIGN_RIGHT,
@@ -16,4 +16,5 @@ void draw_main_menu_bg(MenuData *m);
 void draw_main_menu(MenuData *m);
 void main_menu_update_practice_menus(void);
 void draw_loading_screen(void);
+void draw_loading_screen_progress(double progress); // progress < 0 hides the progress bar
 void menu_preload(void);
@@ -0,0 +1,806 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "microbench.h"
+#include "hashtable.h"
+#include "rcumap.h"
+#include "hirestime.h"
+#include "util.h"
+#include "util/pixmap.h"
+#include "renderer/common/backend.h"
+#include "renderer/common/cmdbuf.h"
+#include "global.h"
+#include "vfs/setup.h"
+#include "replay.h"
+#include "rwops/rwops_autobuf.h"
+
+typedef struct Microbenchmark {
+	const char *name;
+	const char *description;
+	bool (*run)(void);
+} Microbenchmark;
+
+/*
+ * hashtable: lookups in ht_str2ptr_ts vs. RCUMap
+ */
+
+#define HTBENCH_NUM_KEYS 512
+#define HTBENCH_LOOKUPS_PER_THREAD (1 << 21)
+#define HTBENCH_MAX_THREADS 8
+
+typedef enum HTBenchMapType {
+	HTBENCH_HASHTABLE,
+	HTBENCH_RCUMAP,
+} HTBenchMapType;
+
+typedef struct HTBenchState {
+	HTBenchMapType type;
+	ht_str2ptr_ts_t ht;
+	RCUMap rcumap;
+	char *keys[HTBENCH_NUM_KEYS];
+} HTBenchState;
+
+typedef struct HTBenchThread {
+	HTBenchState *state;
+	uint32_t seed;
+	uintptr_t checksum;
+} HTBenchThread;
+
+static int htbench_thread(void *arg) {
+	HTBenchThread *thread = arg;
+	HTBenchState *state = thread->state;
+	uint32_t rng = thread->seed;
+	uintptr_t checksum = 0;
+
+	if(state->type == HTBENCH_HASHTABLE) {
+		for(uint i = 0; i < HTBENCH_LOOKUPS_PER_THREAD; ++i) {
+			rng = rng * 1664525u + 1013904223u;
+			checksum += (uintptr_t)ht_get(&state->ht, state->keys[(rng >> 8) % HTBENCH_NUM_KEYS], NULL);
+		}
+	} else {
+		for(uint i = 0; i < HTBENCH_LOOKUPS_PER_THREAD; ++i) {
+			rng = rng * 1664525u + 1013904223u;
+			checksum += (uintptr_t)rcumap_get(&state->rcumap, state->keys[(rng >> 8) % HTBENCH_NUM_KEYS], NULL);
+		}
+	}
+
+	thread->checksum = checksum;
+	return 0;
+}
+
+static hrtime_t htbench_run(HTBenchState *state, HTBenchMapType type, int num_threads, uintptr_t *checksum) {
+	HTBenchThread threads[num_threads];
+	SDL_Thread *handles[num_threads];
+
+	state->type = type;
+
+	hrtime_t start = time_get();
+
+	for(int i = 0; i < num_threads; ++i) {
+		threads[i] = (HTBenchThread) { .state = state, .seed = 1234 };
+		handles[i] = SDL_CreateThread(htbench_thread, "htbench", threads + i);
+
+		if(!handles[i]) {
+			log_fatal("SDL_CreateThread() failed: %s", SDL_GetError());
+		}
+	}
+
+	*checksum = 0;
+
+	for(int i = 0; i < num_threads; ++i) {
+		SDL_WaitThread(handles[i], NULL);
+		*checksum += threads[i].checksum;
+	}
+
+	return time_get() - start;
+}
+
+static bool microbench_hashtable(void) {
+	HTBenchState state;
+	ht_create(&state.ht);
+	rcumap_create(&state.rcumap);
+
+	for(int i = 0; i < HTBENCH_NUM_KEYS; ++i) {
+		state.keys[i] = strfmt("gfx/proj/bench_sprite_%i", i);
+		ht_set(&state.ht, state.keys[i], state.keys[i]);
+		rcumap_set(&state.rcumap, state.keys[i], state.keys[i]);
+	}
+
+	int max_threads = imax(1, imin(HTBENCH_MAX_THREADS, SDL_GetCPUCount()));
+	bool ok = true;
+
+	tsfprintf(stdout, "%i keys, %i lookups per thread\n", HTBENCH_NUM_KEYS, HTBENCH_LOOKUPS_PER_THREAD);
+	tsfprintf(stdout, "%-8s %12s %12s %9s\n", "threads", "ht ns/op", "rcumap ns/op", "speedup");
+
+	for(int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+		uintptr_t sum_ht, sum_rcu;
+		double t_ht = htbench_run(&state, HTBENCH_HASHTABLE, num_threads, &sum_ht);
+		double t_rcu = htbench_run(&state, HTBENCH_RCUMAP, num_threads, &sum_rcu);
+		double ops = (double)num_threads * HTBENCH_LOOKUPS_PER_THREAD;
+
+		if(sum_ht != sum_rcu) {
+			log_warn("Checksum mismatch: the maps disagree");
+			ok = false;
+		}
+
+		// per-thread latency, as seen by one lookup
+		tsfprintf(stdout, "%-8i %12.2f %12.2f %8.2fx\n",
+			num_threads,
+			t_ht * num_threads / ops * 1e9,
+			t_rcu * num_threads / ops * 1e9,
+			t_ht / t_rcu
+		);
+	}
+
+	for(int i = 0; i < HTBENCH_NUM_KEYS; ++i) {
+		free(state.keys[i]);
+	}
+
+	ht_destroy(&state.ht);
+	rcumap_destroy(&state.rcumap);
+
+	return ok;
+}
+
+/*
+ * pixmap: specialized pixmap conversion kernels vs. the generic code
+ */
+
+#define PXBENCH_WIDTH 1024
+#define PXBENCH_HEIGHT 1024
+#define PXBENCH_ITERATIONS 16
+
+typedef struct PXBenchCase {
+	const char *name;
+	PixmapFormat format_in;
+	PixmapFormat format_out;
+} PXBenchCase;
+
+static void pxbench_fill(Pixmap *px, uint32_t seed) {
+	uint32_t rng = seed;
+	size_t num_elements = px->width * px->height * PIXMAP_FORMAT_LAYOUT(px->format);
+
+	for(size_t i = 0; i < num_elements; ++i) {
+		rng = rng * 1664525u + 1013904223u;
+
+		if(PIXMAP_FORMAT_IS_FLOAT(px->format)) {
+			if(i & 1) {
+				// values right at the rounding boundaries of the 8-bit conversion
+				((float*)px->data.untyped)[i] = ((rng >> 8) % 255 + 0.5f) / 255.0f;
+			} else {
+				// includes out of range values to exercise clamping
+				((float*)px->data.untyped)[i] = (rng >> 8) / (float)(1 << 24) * 1.5f - 0.25f;
+			}
+		} else switch(PIXMAP_FORMAT_DEPTH(px->format)) {
+			case 8:  ((uint8_t*)px->data.untyped)[i] = rng >> 24; break;
+			// sequential, so every 16-bit value gets tested
+			case 16: ((uint16_t*)px->data.untyped)[i] = i; break;
+			default: UNREACHABLE;
+		}
+	}
+}
+
+static bool microbench_pixmap(void) {
+	static const PXBenchCase cases[] = {
+		{ "RGB8 -> RGBA8",     PIXMAP_FORMAT_RGB8,    PIXMAP_FORMAT_RGBA8   },
+		{ "RGBA8 -> R8",       PIXMAP_FORMAT_RGBA8,   PIXMAP_FORMAT_R8      },
+		{ "RGBA8 -> RGBA32F",  PIXMAP_FORMAT_RGBA8,   PIXMAP_FORMAT_RGBA32F },
+		{ "R8 -> R32F",        PIXMAP_FORMAT_R8,      PIXMAP_FORMAT_R32F    },
+		{ "RGBA32F -> RGBA8",  PIXMAP_FORMAT_RGBA32F, PIXMAP_FORMAT_RGBA8   },
+		{ "RGB32F -> RGB8",    PIXMAP_FORMAT_RGB32F,  PIXMAP_FORMAT_RGB8    },
+		{ "RGBA16 -> RGBA8",   PIXMAP_FORMAT_RGBA16,  PIXMAP_FORMAT_RGBA8   },
+		{ "R16 -> R8",         PIXMAP_FORMAT_R16,     PIXMAP_FORMAT_R8      },
+	};
+
+	static const char *path_names[] = { "generic", "scalar", "simd" };
+	bool ok = true;
+
+	tsfprintf(stdout, "%ix%i pixels, %i iterations\n", PXBENCH_WIDTH, PXBENCH_HEIGHT, PXBENCH_ITERATIONS);
+	tsfprintf(stdout, "%-18s %-8s %10s %9s %s\n", "conversion", "path", "Mpx/s", "speedup", "result");
+
+	for(uint c = 0; c < sizeof(cases)/sizeof(*cases); ++c) {
+		const PXBenchCase *bc = cases + c;
+		Pixmap src = { .width = PXBENCH_WIDTH, .height = PXBENCH_HEIGHT, .format = bc->format_in };
+		Pixmap ref = { 0 }, dst = { 0 };
+
+		src.data.untyped = pixmap_alloc_buffer_for_copy(&src);
+		ref.data.untyped = pixmap_alloc_buffer_for_conversion(&src, bc->format_out);
+		dst.data.untyped = pixmap_alloc_buffer_for_conversion(&src, bc->format_out);
+		pxbench_fill(&src, 1234 + c);
+
+		double generic_time = 0;
+
+		for(PixmapConversionPath path = PIXMAP_CONVERSION_GENERIC; path <= PIXMAP_CONVERSION_SIMD; ++path) {
+			Pixmap *out = path == PIXMAP_CONVERSION_GENERIC ? &ref : &dst;
+
+			if(!pixmap_convert_via(&src, out, bc->format_out, path)) {
+				tsfprintf(stdout, "%-18s %-8s %10s %9s %s\n", bc->name, path_names[path], "-", "-", "unavailable");
+				continue;
+			}
+
+			hrtime_t start = time_get();
+
+			for(int i = 0; i < PXBENCH_ITERATIONS; ++i) {
+				attr_unused bool converted = pixmap_convert_via(&src, out, bc->format_out, path);
+				assert(converted);
+			}
+
+			double t = time_get() - start;
+			const char *result = "reference";
+
+			if(path == PIXMAP_CONVERSION_GENERIC) {
+				generic_time = t;
+			} else if(memcmp(ref.data.untyped, dst.data.untyped, pixmap_data_size(&ref))) {
+				result = "MISMATCH";
+				ok = false;
+			} else {
+				result = "ok";
+			}
+
+			tsfprintf(stdout, "%-18s %-8s %10.1f %8.2fx %s\n",
+				bc->name,
+				path_names[path],
+				(double)PXBENCH_WIDTH * PXBENCH_HEIGHT * PXBENCH_ITERATIONS / t * 1e-6,
+				generic_time / t,
+				result
+			);
+		}
+
+		free(src.data.untyped);
+		free(ref.data.untyped);
+		free(dst.data.untyped);
+	}
+
+	return ok;
+}
+
+/*
+ * rcmd: render command recording overhead, against the null backend
+ */
+
+#define RCBENCH_FRAMES 2000
+#define RCBENCH_DRAWS_PER_FRAME 500
+#define RCBENCH_VERTEX_SIZE 64
+
+typedef enum RCBenchMode {
+	RCBENCH_DIRECT,
+	RCBENCH_RECORDED,
+	RCBENCH_THREADED,
+} RCBenchMode;
+
+static void rcbench_frames(RendererFuncs *f) {
+	ShaderProgram *prog = f->shader_program_link(0, NULL);
+	Uniform *u_color = f->shader_uniform(prog, "color");
+	Uniform *u_matrix = f->shader_uniform(prog, "modelViewMatrix");
+	VertexBuffer *vbuf = f->vertex_buffer_create(1 << 16, NULL);
+	VertexArray *varr = f->vertex_array_create();
+	SDL_RWops *stream = f->vertex_buffer_get_stream(vbuf);
+	float matrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	char vertex[RCBENCH_VERTEX_SIZE] = { 0 };
+
+	f->vertex_array_attach_vertex_buffer(varr, vbuf, 0);
+	f->shader(prog);
+
+	for(int frame = 0; frame < RCBENCH_FRAMES; ++frame) {
+		f->vertex_buffer_invalidate(vbuf);
+		f->blend(frame & 1 ? BLEND_PREMUL_ALPHA : BLEND_NONE);
+
+		for(int i = 0; i < RCBENCH_DRAWS_PER_FRAME; ++i) {
+			float color[4] = { i / (float)RCBENCH_DRAWS_PER_FRAME, 1, 1, 1 };
+			matrix[12] = i;
+			matrix[13] = frame;
+			f->uniform(u_color, 0, 1, UNIFORM_VEC4, color);
+			f->uniform(u_matrix, 0, 1, UNIFORM_MAT4, matrix);
+
+			if(SDL_RWtell(stream) + sizeof(vertex) > SDL_RWsize(stream)) {
+				f->vertex_buffer_invalidate(vbuf);
+			}
+
+			SDL_RWwrite(stream, vertex, sizeof(vertex), 1);
+			f->draw(varr, PRIM_TRIANGLE_STRIP, 0, 4, 1, 0);
+		}
+
+		f->swap(NULL);
+	}
+
+	f->vertex_array_destroy(varr);
+	f->vertex_buffer_destroy(vbuf);
+	f->shader_program_destroy(prog);
+}
+
+static bool microbench_rcmd(void) {
+	RendererBackend *null_backend = NULL;
+
+	for(RendererBackend **b = _r_backends; *b; ++b) {
+		if(!strcmp((*b)->name, "null")) {
+			null_backend = *b;
+		}
+	}
+
+	if(null_backend == NULL) {
+		tsfprintf(stdout, "unavailable: the null renderer is not built\n");
+		return true;
+	}
+
+	static const char *mode_names[] = { "direct", "recorded", "threaded" };
+	RendererBackend backend;
+	memcpy(&backend, null_backend, sizeof(backend));
+	backend.funcs.init();
+
+	tsfprintf(stdout, "%i frames, %i draws per frame\n", RCBENCH_FRAMES, RCBENCH_DRAWS_PER_FRAME);
+	tsfprintf(stdout, "%-10s %12s %10s %12s %8s\n", "mode", "us/frame", "cmds/frame", "KiB/frame", "syncs");
+
+	for(RCBenchMode mode = RCBENCH_DIRECT; mode <= RCBENCH_THREADED; ++mode) {
+		RCmdBufStats stats = { 0 };
+
+		if(mode != RCBENCH_DIRECT) {
+			_r_cmdbuf_install(&backend, mode == RCBENCH_THREADED);
+		}
+
+		// only the time spent on the calling thread
+		hrtime_t start = time_get();
+		rcbench_frames(&backend.funcs);
+		double t = time_get() - start;
+
+		if(mode != RCBENCH_DIRECT) {
+			_r_cmdbuf_get_stats(&stats);
+			_r_cmdbuf_uninstall(&backend);
+		}
+
+		tsfprintf(stdout, "%-10s %12.2f %10.1f %12.2f %8"PRIu64"\n",
+			mode_names[mode],
+			t / RCBENCH_FRAMES * 1e6,
+			stats.commands / (double)RCBENCH_FRAMES,
+			stats.bytes / 1024.0 / RCBENCH_FRAMES,
+			stats.syncs
+		);
+	}
+
+	backend.funcs.shutdown();
+	return true;
+}
+
+/*
+ * refs: stress test for the entity reference table
+ */
+
+#define REFBENCH_NUM_OBJECTS 100000
+#define REFBENCH_ROUNDS 4
+
+typedef struct RefBenchObject {
+	ENTITY_INTERFACE_NAMED(struct RefBenchObject, ent);
+} RefBenchObject;
+
+static bool microbench_refs(void) {
+	RefBenchObject *ents = calloc(REFBENCH_NUM_OBJECTS, sizeof(*ents));
+	RefHandle *refs = calloc(REFBENCH_NUM_OBJECTS, sizeof(*refs));
+	RefHandle *stale = calloc(REFBENCH_NUM_OBJECTS, sizeof(*stale));
+	bool ok = true;
+
+	tsfprintf(stdout, "%i objects, %i rounds\n", REFBENCH_NUM_OBJECTS, REFBENCH_ROUNDS);
+	tsfprintf(stdout, "%-6s %10s %10s %10s %10s\n", "round", "add ns", "get ns", "kill ns", "free ns");
+
+	for(int round = 0; round < REFBENCH_ROUNDS; ++round) {
+		hrtime_t t0 = time_get();
+
+		// every object is referenced twice; the second add_ref must return the same handle
+		for(int i = 0; i < REFBENCH_NUM_OBJECTS; ++i) {
+			ents[i].ent.ref_slot = 0;
+			refs[i] = add_ref(ents + i);
+
+			if(add_ref(ents + i) != refs[i]) {
+				ok = false;
+			}
+		}
+
+		hrtime_t t1 = time_get();
+
+		for(int i = 0; i < REFBENCH_NUM_OBJECTS; ++i) {
+			if(REF(refs[i]) != ents + i) {
+				ok = false;
+			}
+
+			// handles from the previous round point to reused slots
+			if(round > 0 && REF(stale[i]) != NULL) {
+				ok = false;
+			}
+		}
+
+		hrtime_t t2 = time_get();
+
+		// kill every object, like _delete_projectile does
+		for(int i = 0; i < REFBENCH_NUM_OBJECTS; ++i) {
+			del_ref(ents + i);
+		}
+
+		hrtime_t t3 = time_get();
+
+		for(int i = 0; i < REFBENCH_NUM_OBJECTS; ++i) {
+			if(REF(refs[i]) != NULL) {
+				ok = false;
+			}
+
+			free_ref(refs[i]);
+			free_ref(refs[i]);
+			stale[i] = refs[i];
+		}
+
+		hrtime_t t4 = time_get();
+
+		if(!ok) {
+			log_warn("Round %i: a reference resolved to the wrong object", round);
+			break;
+		}
+
+		tsfprintf(stdout, "%-6i %10.2f %10.2f %10.2f %10.2f\n",
+			round,
+			(double)(t1 - t0) / (2 * REFBENCH_NUM_OBJECTS) * 1e9,
+			(double)(t2 - t1) / (REFBENCH_NUM_OBJECTS * (round > 0 ? 2 : 1)) * 1e9,
+			(double)(t3 - t2) / REFBENCH_NUM_OBJECTS * 1e9,
+			(double)(t4 - t3) / (2 * REFBENCH_NUM_OBJECTS) * 1e9
+		);
+	}
+
+	if(global.refs.count > REFBENCH_NUM_OBJECTS) {
+		log_warn("Reference table grew to %u slots; freed slots are not reused", global.refs.count);
+		ok = false;
+	}
+
+	// stage code keeps pairs of handles in complex args; by now the generations are well above zero
+	for(int i = 0; i + 1 < REFBENCH_NUM_OBJECTS; i += 2) {
+		ents[i].ent.ref_slot = ents[i + 1].ent.ref_slot = 0;
+		complex double arg = CMPLX(add_ref(ents + i), add_ref(ents + i + 1));
+
+		if(REF(creal(arg)) != ents + i || REF(cimag(arg)) != ents + i + 1) {
+			log_warn("Reference handles don't survive a round trip through complex args");
+			ok = false;
+			break;
+		}
+
+		free_ref(creal(arg));
+		free_ref(cimag(arg));
+	}
+
+	free_all_refs();
+	free(ents);
+	free(refs);
+	free(stale);
+
+	return ok;
+}
+
+/*
+ * vfs: resource lookups with and without the VFS lookup cache
+ */
+
+#define VFSBENCH_ROUNDS 8
+
+typedef struct VFSBenchNames {
+	char **names;
+	size_t num;
+	size_t capacity;
+} VFSBenchNames;
+
+static void* vfsbench_collect(const char *path, void *arg) {
+	VFSBenchNames *n = arg;
+
+	if(n->num == n->capacity) {
+		n->capacity = n->capacity ? n->capacity * 2 : 256;
+		n->names = realloc(n->names, n->capacity * sizeof(*n->names));
+	}
+
+	// strip the extension; the lookups will probe for it like the resource loaders do
+	char *name = strdup(path);
+	char *dot = strrchr(name, '.');
+
+	if(dot && dot > strrchr(name, '/')) {
+		*dot = 0;
+	}
+
+	n->names[n->num++] = name;
+	return NULL;
+}
+
+static bool microbench_vfs(void) {
+	static const char *exts[] = {
+		".png", ".webp", ".tex", ".spr", ".ani", ".frag.glsl", ".vert.glsl", ".prog", ".ogg", ".wav", ".ttf", ".obj",
+	};
+
+	static const char *mode_names[] = { "uncached", "cached" };
+	size_t found[2] = { 0 };
+	bool ok = true;
+
+	tsfprintf(stdout, "%-10s %10s %10s %10s %10s %10s\n", "mode", "setup ms", "lookups", "hits", "ns/lookup", "found");
+
+	for(int cached = 0; cached < 2; ++cached) {
+		env_set("TAISEI_VFS_CACHE", cached, true);
+
+		hrtime_t start = time_get();
+		vfs_setup(true);
+		double t_setup = time_get() - start;
+
+		VFSBenchNames names = { 0 };
+		vfs_dir_walk("res", vfsbench_collect, &names);
+		vfs_reset_stats();
+
+		for(int round = 0; round < VFSBENCH_ROUNDS; ++round) {
+			for(size_t i = 0; i < names.num; ++i) {
+				for(size_t e = 0; e < sizeof(exts)/sizeof(*exts); ++e) {
+					char path[strlen(names.names[i]) + strlen(exts[e]) + 1];
+					snprintf(path, sizeof(path), "%s%s", names.names[i], exts[e]);
+
+					if(vfs_query(path).exists) {
+						++found[cached];
+					}
+				}
+			}
+		}
+
+		VFSStats stats;
+		vfs_get_stats(&stats);
+
+		tsfprintf(stdout, "%-10s %10.2f %10"PRIu64" %10"PRIu64" %10.1f %10zu\n",
+			mode_names[cached],
+			t_setup * 1000,
+			stats.lookups,
+			stats.cache_hits,
+			stats.lookups ? stats.time / stats.lookups * 1e9 : 0,
+			found[cached]
+		);
+
+		for(size_t i = 0; i < names.num; ++i) {
+			free(names.names[i]);
+		}
+
+		free(names.names);
+		vfs_shutdown();
+	}
+
+	env_set("TAISEI_VFS_CACHE", true, true);
+
+	if(found[0] != found[1]) {
+		log_warn("The cached lookups found %zu files, the uncached ones %zu", found[1], found[0]);
+		ok = false;
+	}
+
+	return ok;
+}
+
+/*
+ * replay: event stream encoding and decoding, on synthetic and stored replays
+ */
+
+#define RPYBENCH_NUM_STAGES 8
+#define RPYBENCH_EVENTS_PER_STAGE 60000
+#define RPYBENCH_ROUNDS 8
+
+static void rpybench_generate(Replay *rpy) {
+	uint32_t rng = 0x5eed;
+
+	replay_init(rpy);
+	rpy->numstages = RPYBENCH_NUM_STAGES;
+	rpy->stages = calloc(rpy->numstages, sizeof(ReplayStage));
+
+	for(int i = 0; i < rpy->numstages; ++i) {
+		ReplayStage *stg = rpy->stages + i;
+		uint32_t frame = 0;
+
+		stg->stage = i + 1;
+		stg->seed = i;
+		stg->capacity = RPYBENCH_EVENTS_PER_STAGE;
+		stg->events = calloc(stg->capacity, sizeof(ReplayEvent));
+
+		// key press/release pairs a few frames apart, like a real input stream
+		while(stg->numevents < RPYBENCH_EVENTS_PER_STAGE - 2) {
+			rng = rng * 1664525u + 1013904223u;
+			frame += (rng >> 28);
+
+			ReplayEvent *e = stg->events + stg->numevents++;
+			e->frame = frame;
+			e->type = (rng >> 8) & 1 ? EV_PRESS : EV_RELEASE;
+			e->value = (rng >> 16) % KEYIDX_LAST;
+		}
+
+		stg->events[stg->numevents++] = (ReplayEvent) { frame + 1, EV_OVER, 0 };
+	}
+}
+
+static bool rpybench_compare(Replay *a, Replay *b) {
+	if(a->numstages != b->numstages) {
+		return false;
+	}
+
+	for(int i = 0; i < a->numstages; ++i) {
+		ReplayStage *sa = a->stages + i, *sb = b->stages + i;
+
+		if(sa->numevents != sb->numevents) {
+			return false;
+		}
+
+		for(int j = 0; j < sa->numevents; ++j) {
+			ReplayEvent *ea = sa->events + j, *eb = sb->events + j;
+
+			if(ea->frame != eb->frame || ea->type != eb->type || ea->value != eb->value) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void* rpybench_collect(const char *path, void *arg) {
+	VFSBenchNames *n = arg;
+
+	if(!strendswith(path, "." REPLAY_EXTENSION)) {
+		return NULL;
+	}
+
+	if(n->num == n->capacity) {
+		n->capacity = n->capacity ? n->capacity * 2 : 32;
+		n->names = realloc(n->names, n->capacity * sizeof(*n->names));
+	}
+
+	n->names[n->num++] = strdup(path);
+	return NULL;
+}
+
+static bool microbench_replay(void) {
+	static const uint16_t versions[] = {
+		REPLAY_STRUCT_VERSION_TS102000_REV2,
+		REPLAY_STRUCT_VERSION_TS102000_REV2 | REPLAY_VERSION_COMPRESSION_BIT,
+		REPLAY_STRUCT_VERSION_TS102000_REV3,
+		REPLAY_STRUCT_VERSION_TS102000_REV3 | REPLAY_VERSION_COMPRESSION_BIT,
+	};
+
+	Replay src;
+	size_t num_events = (size_t)RPYBENCH_NUM_STAGES * RPYBENCH_EVENTS_PER_STAGE;
+	bool ok = true;
+
+	config_init();
+	rpybench_generate(&src);
+
+	tsfprintf(stdout, "%zu events, %i rounds\n", num_events, RPYBENCH_ROUNDS);
+	tsfprintf(stdout, "%-8s %-12s %10s %12s %12s %12s\n", "version", "stream", "bytes", "write ms", "read ms", "Mevents/s");
+
+	for(size_t v = 0; v < sizeof(versions)/sizeof(*versions); ++v) {
+		void *buf;
+		SDL_RWops *abuf = SDL_RWAutoBuffer(&buf, 4096);
+
+		hrtime_t t0 = time_get();
+
+		if(!replay_write(&src, abuf, versions[v])) {
+			log_warn("replay_write() failed");
+			SDL_RWclose(abuf);
+			ok = false;
+			break;
+		}
+
+		hrtime_t t1 = time_get();
+		size_t size = SDL_RWtell(abuf);
+		hrtime_t t_read = 0;
+
+		for(int round = 0; round < RPYBENCH_ROUNDS; ++round) {
+			Replay dst = { 0 };
+			SDL_RWops *rw = SDL_RWFromConstMem(buf, size);
+
+			hrtime_t t = time_get();
+			bool read_ok = replay_read(&dst, rw, REPLAY_READ_ALL, "<microbench>");
+			t_read += time_get() - t;
+
+			SDL_RWclose(rw);
+
+			if(!read_ok || !rpybench_compare(&src, &dst)) {
+				log_warn("The replay did not survive a write/read round trip");
+				ok = false;
+			}
+
+			replay_destroy(&dst);
+		}
+
+		SDL_RWclose(abuf);
+
+		tsfprintf(stdout, "%-8u %-12s %10zu %12.2f %12.2f %12.2f\n",
+			versions[v] & ~REPLAY_VERSION_COMPRESSION_BIT,
+			versions[v] & REPLAY_VERSION_COMPRESSION_BIT ? "compressed" : "raw",
+			size,
+			(double)(t1 - t0) * 1000,
+			(double)t_read / RPYBENCH_ROUNDS * 1000,
+			num_events * RPYBENCH_ROUNDS / (double)t_read * 1e-6
+		);
+	}
+
+	replay_destroy(&src);
+
+	// replays the user has saved, read from memory so only decoding is measured
+	vfs_setup(true);
+
+	VFSBenchNames names = { 0 };
+	vfs_dir_walk("storage/replays", rpybench_collect, &names);
+
+	size_t stored_events = 0;
+	hrtime_t t_stored = 0;
+
+	for(size_t i = 0; i < names.num; ++i) {
+		SDL_RWops *file = vfs_open(names.names[i], VFS_MODE_READ | VFS_MODE_SEEKABLE);
+
+		if(!file) {
+			log_warn("VFS error: %s", vfs_get_error());
+			continue;
+		}
+
+		SDL_RWops *mem = SDL_RWCopyToBuffer(file);
+		SDL_RWclose(file);
+
+		Replay rpy = { 0 };
+		hrtime_t t = time_get();
+
+		if(replay_read(&rpy, mem, REPLAY_READ_ALL, names.names[i])) {
+			t_stored += time_get() - t;
+
+			for(int s = 0; s < rpy.numstages; ++s) {
+				stored_events += rpy.stages[s].numevents;
+			}
+		}
+
+		replay_destroy(&rpy);
+		SDL_RWclose(mem);
+		free(names.names[i]);
+	}
+
+	tsfprintf(stdout, "stored: %zu files, %zu events, %.2f ms\n", names.num, stored_events, (double)t_stored * 1000);
+
+	free(names.names);
+	vfs_shutdown();
+	config_shutdown();
+
+	return ok;
+}
+
+static Microbenchmark microbenchmarks[] = {
+	{ "hashtable", "Resource name lookups: ht_str2ptr_ts vs. RCUMap", microbench_hashtable },
+	{ "pixmap", "Pixmap format conversion kernels, with equivalence checks", microbench_pixmap },
+	{ "rcmd", "Render command recording and replay on a render thread", microbench_rcmd },
+	{ "replay", "Replay event stream write/read throughput and stored replay load times", microbench_replay },
+	{ "refs", "Entity references: spawn, resolve and kill 100k referenced objects", microbench_refs },
+	{ "vfs", "Resource path lookups with and without the VFS lookup cache", microbench_vfs },
+	{ NULL },
+};
+
+int microbench_run(const char *name) {
+	bool all = !strcmp(name, "all");
+	bool found = false;
+	bool ok = true;
+
+	time_init();
+
+	for(Microbenchmark *b = microbenchmarks; b->name; ++b) {
+		if(!strcmp(name, "list")) {
+			tsfprintf(stdout, "%-16s %s\n", b->name, b->description);
+			found = true;
+			continue;
+		}
+
+		if(all || !strcmp(name, b->name)) {
+			tsfprintf(stdout, "== %s: %s ==\n", b->name, b->description);
+			ok = b->run() && ok;
+			found = true;
+		}
+	}
+
+	time_shutdown();
+
+	if(!found) {
+		log_warn("Unknown microbenchmark '%s'; try 'list'", name);
+		return 1;
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+/*
+ * Microbenchmarks for isolated subsystems (--microbench NAME). These run before
+ * the game is initialized and print their results to stdout. Use "list" to see
+ * what's available, or "all" to run everything.
+ */
+
+int microbench_run(const char *name);
@@ -11,114 +11,268 @@
 #include "objectpool.h"
 #include "util.h"
 #include "list.h"
+#include "hirestime.h"
+
+// Slabs are sized to a multiple of the page size, large enough for at least
+// OBJPOOL_MIN_SLAB_OBJECTS objects. Absurdly large objects get hugepage-sized slabs.
+#define OBJPOOL_PAGE_SIZE            4096
+#define OBJPOOL_HUGEPAGE_SIZE        (2 * 1024 * 1024)
+#define OBJPOOL_MIN_SLAB_OBJECTS     16
+
+// Slab storage and the per-object stride are both rounded up to this, so every object
+// starts on its own cache line.
+#define OBJPOOL_ALIGNMENT            64
+
+// Fully free slabs are released after staying free for this many objpool_collect() calls.
+#define OBJPOOL_SLAB_GRACE_PERIOD    300
+
+// Time every Nth acquisition (plus every one that has to allocate a new slab).
+#define OBJPOOL_LATENCY_SAMPLE_INTERVAL 32
+
+typedef struct ObjectPoolSlab ObjectPoolSlab;
+
+struct ObjectPoolSlab {
+	LIST_INTERFACE(ObjectPoolSlab);
+	ObjectInterface *free_objects;
+	char *objects;
+	size_t usage;
+	uint64_t empty_since;
+};
 
 struct ObjectPool {
 	char *tag;
 	size_t size_of_object;
-	size_t max_objects;
+	size_t object_stride;
+	size_t slab_size;
+	size_t slab_capacity;
+	size_t min_capacity;
 	size_t usage;
 	size_t peak_usage;
-	size_t num_extents;
-	char **extents;
-	ObjectInterface *free_objects;
-	char objects[];
+
+	// all slabs, sorted by address of the object storage
+	ObjectPoolSlab **slabs;
+	size_t num_slabs;
+	size_t slabs_alloc;
+
+	// slabs with some objects in use and some free
+	ObjectPoolSlab *partial_slabs;
+
+	// slabs with no objects in use
+	ObjectPoolSlab *empty_slabs;
+
+	uint64_t clock;
+
+	struct {
+		uint64_t acquisitions;
+		uint64_t samples;
+		hrtime_t total;
+		hrtime_t max;
+	} latency;
 };
 
 static inline ObjectInterface* obj_ptr(ObjectPool *pool, char *objects, size_t idx) {
-	return (ObjectInterface*)(void*)(objects + idx * pool->size_of_object);
+	return (ObjectInterface*)(void*)(objects + idx * pool->object_stride);
 }
 
-static void objpool_register_objects(ObjectPool *pool, char *objects) {
-	for(size_t i = 0; i < pool->max_objects; ++i) {
-		list_push(&pool->free_objects, obj_ptr(pool, objects, i));
+static size_t objpool_slab_size(size_t obj_size) {
+	size_t min_size = obj_size * OBJPOOL_MIN_SLAB_OBJECTS;
+	size_t page = min_size > OBJPOOL_HUGEPAGE_SIZE ? OBJPOOL_HUGEPAGE_SIZE : OBJPOOL_PAGE_SIZE;
+	return ((min_size + page - 1) / page) * page;
+}
+
+static size_t objpool_find_slab_index(ObjectPool *pool, const void *ptr) {
+	// returns the index of the first slab whose storage starts above ptr
+	uintptr_t addr = (uintptr_t)ptr;
+	size_t lo = 0, hi = pool->num_slabs;
+
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if((uintptr_t)pool->slabs[mid]->objects <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
 	}
+
+	return lo;
 }
 
-ObjectPool *objpool_alloc(size_t obj_size, size_t max_objects, const char *tag) {
-	// TODO: overflow handling
+static ObjectPoolSlab *objpool_find_slab(ObjectPool *pool, const void *ptr) {
+	size_t idx = objpool_find_slab_index(pool, ptr);
+
+	if(idx == 0) {
+		return NULL;
+	}
+
+	ObjectPoolSlab *slab = pool->slabs[idx - 1];
+
+	if((uintptr_t)ptr >= (uintptr_t)(slab->objects + pool->slab_capacity * pool->object_stride)) {
+		return NULL;
+	}
+
+	return slab;
+}
+
+static ObjectPoolSlab *objpool_add_slab(ObjectPool *pool) {
+	ObjectPoolSlab *slab = malloc(sizeof(ObjectPoolSlab) + OBJPOOL_ALIGNMENT - 1 + pool->slab_size);
+	memset(slab, 0, sizeof(*slab));
 
-	ObjectPool *pool = malloc(sizeof(ObjectPool) + (obj_size * max_objects));
+	uintptr_t objects = (uintptr_t)(slab + 1);
+	objects = (objects + OBJPOOL_ALIGNMENT - 1) & ~(uintptr_t)(OBJPOOL_ALIGNMENT - 1);
+	slab->objects = (char*)objects;
+
+	for(size_t i = pool->slab_capacity; i > 0; --i) {
+		ObjectInterface *obj = obj_ptr(pool, slab->objects, i - 1);
+		obj->next = slab->free_objects;
+		slab->free_objects = obj;
+	}
+
+	if(pool->num_slabs == pool->slabs_alloc) {
+		pool->slabs_alloc = pool->slabs_alloc ? pool->slabs_alloc * 2 : 8;
+		pool->slabs = realloc(pool->slabs, pool->slabs_alloc * sizeof(*pool->slabs));
+	}
+
+	size_t idx = objpool_find_slab_index(pool, slab->objects);
+	memmove(pool->slabs + idx + 1, pool->slabs + idx, (pool->num_slabs - idx) * sizeof(*pool->slabs));
+	pool->slabs[idx] = slab;
+	++pool->num_slabs;
+
+	slab->empty_since = pool->clock;
+	list_push(&pool->empty_slabs, slab);
+
+	return slab;
+}
+
+static void objpool_remove_slab(ObjectPool *pool, ObjectPoolSlab *slab) {
+	assert(slab->usage == 0);
+
+	size_t idx = objpool_find_slab_index(pool, slab->objects) - 1;
+	assert(pool->slabs[idx] == slab);
+	memmove(pool->slabs + idx, pool->slabs + idx + 1, (pool->num_slabs - idx - 1) * sizeof(*pool->slabs));
+	--pool->num_slabs;
+
+	list_unlink(&pool->empty_slabs, slab);
+	free(slab);
+}
+
+ObjectPool *objpool_alloc(size_t obj_size, size_t max_objects, const char *tag) {
+	ObjectPool *pool = calloc(1, sizeof(ObjectPool));
 	pool->size_of_object = obj_size;
-	pool->max_objects = max_objects;
-	pool->free_objects = NULL;
-	pool->usage = 0;
-	pool->peak_usage = 0;
-	pool->num_extents = 0;
-	pool->extents = NULL;
+	pool->object_stride = (obj_size + OBJPOOL_ALIGNMENT - 1) & ~(size_t)(OBJPOOL_ALIGNMENT - 1);
+	pool->slab_size = objpool_slab_size(pool->object_stride);
+	pool->slab_capacity = pool->slab_size / pool->object_stride;
 	pool->tag = strdup(tag);
 
-	memset(pool->objects, 0, obj_size * max_objects);
-	objpool_register_objects(pool, pool->objects);
+	size_t num_slabs = (max_objects + pool->slab_capacity - 1) / pool->slab_capacity;
+	pool->min_capacity = num_slabs * pool->slab_capacity;
+
+	for(size_t i = 0; i < num_slabs; ++i) {
+		objpool_add_slab(pool);
+	}
 
-	log_debug("[%s] Allocated pool for %zu objects, %zu bytes each",
+	log_debug("[%s] Allocated pool for %zu objects, %zu bytes each (%zu with padding), in %zu slabs of %zu bytes",
 		pool->tag,
-		pool->max_objects,
-		pool->size_of_object
+		pool->min_capacity,
+		pool->size_of_object,
+		pool->object_stride,
+		num_slabs,
+		pool->slab_size
 	);
 
 	return pool;
 }
 
-static char *objpool_add_extent(ObjectPool *pool) {
-	pool->extents = realloc(pool->extents, (++pool->num_extents) * sizeof(*pool->extents));
-	char *extent = pool->extents[pool->num_extents - 1] = calloc(pool->max_objects, pool->size_of_object);
-	objpool_register_objects(pool, extent);
-	return extent;
-}
+static ObjectInterface *objpool_take(ObjectPool *pool) {
+	ObjectPoolSlab *slab = pool->partial_slabs;
 
-static char* objpool_fmt_size(ObjectPool *pool) {
-	switch(pool->num_extents) {
-		case 0:
-			return strfmt("%zu objects, %zu bytes each",
-				pool->max_objects,
-				pool->size_of_object
+	if(!slab) {
+		if(!(slab = pool->empty_slabs)) {
+			log_debug("[%s] Object pool full (%zu objects), adding a slab",
+				pool->tag,
+				pool->num_slabs * pool->slab_capacity
 			);
 
-		case 1:
-			return strfmt("%zu objects, %zu bytes each, with 1 extent",
-				pool->max_objects * 2,
-				pool->size_of_object
-			);
+			slab = objpool_add_slab(pool);
+		}
 
-		default:
-			return strfmt("%zu objects, %zu bytes each, with %zu extents",
-				pool->max_objects * (1 + pool->num_extents),
-				pool->size_of_object,
-				pool->num_extents
-			);
+		list_unlink(&pool->empty_slabs, slab);
+		list_push(&pool->partial_slabs, slab);
+	}
+
+	ObjectInterface *obj = slab->free_objects;
+	assert(obj != NULL);
+	slab->free_objects = obj->next;
+
+	if(++slab->usage == pool->slab_capacity) {
+		list_unlink(&pool->partial_slabs, slab);
+	}
+
+	IF_OBJPOOL_DEBUG({
+		obj->_object_private.used = true;
+	})
+
+	return obj;
+}
+
+static inline bool objpool_latency_sample_begin(ObjectPool *pool, size_t num) {
+	return
+		!(pool->latency.acquisitions++ % OBJPOOL_LATENCY_SAMPLE_INTERVAL) ||
+		pool->num_slabs * pool->slab_capacity - pool->usage < num;
+}
+
+static void objpool_latency_sample_end(ObjectPool *pool, hrtime_t start) {
+	hrtime_t t = time_get() - start;
+	pool->latency.total += t;
+	pool->latency.max = max(pool->latency.max, t);
+	++pool->latency.samples;
+}
+
+static void objpool_update_usage(ObjectPool *pool, size_t num) {
+	pool->usage += num;
+
+	if(pool->usage > pool->peak_usage) {
+		pool->peak_usage = pool->usage;
 	}
 }
 
 ObjectInterface *objpool_acquire(ObjectPool *pool) {
-	ObjectInterface *obj = list_pop(&pool->free_objects);
+	bool sample = objpool_latency_sample_begin(pool, 1);
+	hrtime_t start = sample ? time_get() : 0;
 
-	if(obj) {
-acquired:
-		memset(obj, 0, pool->size_of_object);
+	ObjectInterface *obj = objpool_take(pool);
+	memset(obj, 0, pool->size_of_object);
 
-		IF_OBJPOOL_DEBUG({
-			obj->_object_private.used = true;
-		})
+	IF_OBJPOOL_DEBUG({
+		obj->_object_private.used = true;
+	})
 
-		if(++pool->usage > pool->peak_usage) {
-			pool->peak_usage = pool->usage;
-		}
+	objpool_update_usage(pool, 1);
 
-		// log_debug("[%s] Usage: %zu", pool->tag, pool->usage);
-		return obj;
+	if(sample) {
+		objpool_latency_sample_end(pool, start);
 	}
 
-	char *tmp = objpool_fmt_size(pool);
-	log_warn("[%s] Object pool exhausted (%s), extending",
-		pool->tag,
-		tmp
-	);
-	free(tmp);
+	return obj;
+}
 
-	objpool_add_extent(pool);
-	obj = list_pop(&pool->free_objects);
-	assert(obj != NULL);
-	goto acquired;
+void objpool_acquire_batch(ObjectPool *pool, size_t num, ObjectInterface *objects[num]) {
+	if(num == 0) {
+		return;
+	}
+
+	bool sample = objpool_latency_sample_begin(pool, num);
+	hrtime_t start = sample ? time_get() : 0;
+
+	for(size_t i = 0; i < num; ++i) {
+		objects[i] = objpool_take(pool);
+	}
+
+	objpool_update_usage(pool, num);
+
+	if(sample) {
+		objpool_latency_sample_end(pool, start);
+	}
 }
 
 void objpool_release(ObjectPool *pool, ObjectInterface *object) {
@@ -135,10 +289,42 @@ void objpool_release(ObjectPool *pool, ObjectInterface *object) {
 		object->_object_private.used = false;
 	})
 
-	list_push(&pool->free_objects, object);
+	ObjectPoolSlab *slab = objpool_find_slab(pool, object);
+	assert(slab != NULL);
+
+	object->next = slab->free_objects;
+	slab->free_objects = object;
+
+	if(slab->usage-- == pool->slab_capacity) {
+		list_push(&pool->partial_slabs, slab);
+	}
+
+	if(slab->usage == 0) {
+		list_unlink(&pool->partial_slabs, slab);
+		list_push(&pool->empty_slabs, slab);
+		slab->empty_since = pool->clock;
+	}
 
 	pool->usage--;
-	// log_debug("[%s] Usage: %zu", pool->tag, pool->usage);
+}
+
+void objpool_collect(ObjectPool *pool) {
+	++pool->clock;
+
+	size_t capacity = pool->num_slabs * pool->slab_capacity;
+
+	for(ObjectPoolSlab *slab = pool->empty_slabs, *next; slab; slab = next) {
+		next = slab->next;
+
+		if(capacity - pool->slab_capacity < pool->min_capacity) {
+			break;
+		}
+
+		if(pool->clock - slab->empty_since > OBJPOOL_SLAB_GRACE_PERIOD) {
+			objpool_remove_slab(pool, slab);
+			capacity -= pool->slab_capacity;
+		}
+	}
 }
 
 void objpool_free(ObjectPool *pool) {
@@ -150,11 +336,11 @@ void objpool_free(ObjectPool *pool) {
 		log_warn("[%s] %zu objects still in use", pool->tag, pool->usage);
 	}
 
-	for(size_t i = 0; i < pool->num_extents; ++i) {
-		free(pool->extents[i]);
+	for(size_t i = 0; i < pool->num_slabs; ++i) {
+		free(pool->slabs[i]);
 	}
 
-	free(pool->extents);
+	free(pool->slabs);
 	free(pool->tag);
 	free(pool);
 }
@@ -164,48 +350,22 @@ size_t objpool_object_size(ObjectPool *pool) {
 }
 
 void objpool_get_stats(ObjectPool *pool, ObjectPoolStats *stats) {
-	stats->tag = pool->tag;
-	stats->capacity = pool->max_objects * (1 + pool->num_extents);
-	stats->usage = pool->usage;
-	stats->peak_usage = pool->peak_usage;
-}
-
-attr_unused
-static bool objpool_object_in_subpool(ObjectPool *pool, ObjectInterface *object, char *objects) {
-	char *objofs = (char*)object;
-	char *minofs = objects;
-	char *maxofs = objects + (pool->max_objects - 1) * pool->size_of_object;
-
-	if(objofs < minofs || objofs > maxofs) {
-		return false;
-	}
-
-	ptrdiff_t misalign = (ptrdiff_t)(objofs - objects) % pool->size_of_object;
-
-	if(misalign) {
-		log_fatal("[%s] Object pointer %p is misaligned by %zi",
-			pool->tag,
-			(void*)objofs,
-			(ssize_t)misalign
-		);
-	}
-
-	return true;
-}
-
-attr_unused
-static bool objpool_object_in_pool(ObjectPool *pool, ObjectInterface *object) {
-	if(objpool_object_in_subpool(pool, object, pool->objects)) {
-		return true;
-	}
+	size_t stranded = 0;
 
-	for(size_t i = 0; i < pool->num_extents; ++i) {
-		if(objpool_object_in_subpool(pool, object, pool->extents[i])) {
-			return true;
-		}
+	for(ObjectPoolSlab *slab = pool->partial_slabs; slab; slab = slab->next) {
+		stranded += pool->slab_capacity - slab->usage;
 	}
 
-	return false;
+	stats->tag = pool->tag;
+	stats->capacity = pool->num_slabs * pool->slab_capacity;
+	stats->usage = pool->usage;
+	stats->peak_usage = pool->peak_usage;
+	stats->num_slabs = pool->num_slabs;
+	stats->slab_size = pool->slab_size;
+	stats->fragmentation = stats->capacity ? (double)stranded / stats->capacity : 0;
+	stats->alloc_samples = pool->latency.samples;
+	stats->alloc_time_avg = pool->latency.samples ? (double)(pool->latency.total / pool->latency.samples) : 0;
+	stats->alloc_time_max = (double)pool->latency.max;
 }
 
 void objpool_memtest(ObjectPool *pool, ObjectInterface *object) {
@@ -213,11 +373,23 @@ void objpool_memtest(ObjectPool *pool, ObjectInterface *object) {
 	assert(object != NULL);
 
 	IF_OBJPOOL_DEBUG({
-		if(!objpool_object_in_pool(pool, object)) {
+		ObjectPoolSlab *slab = objpool_find_slab(pool, object);
+
+		if(!slab) {
 			log_fatal("[%s] Object pointer %p does not belong to this pool",
 				pool->tag,
 				(void*)object
 			);
 		}
+
+		ptrdiff_t misalign = ((char*)object - slab->objects) % pool->object_stride;
+
+		if(misalign) {
+			log_fatal("[%s] Object pointer %p is misaligned by %zi",
+				pool->tag,
+				(void*)object,
+				(ssize_t)misalign
+			);
+		}
 	})
 }
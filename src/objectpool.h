@@ -32,6 +32,16 @@ struct ObjectPoolStats {
 	size_t capacity;
 	size_t usage;
 	size_t peak_usage;
+	size_t num_slabs;
+	size_t slab_size;
+
+	// fraction of the capacity that is free, but held by partially used slabs
+	double fragmentation;
+
+	// sampled objpool_acquire/objpool_acquire_batch timings, in seconds
+	uint64_t alloc_samples;
+	double alloc_time_avg;
+	double alloc_time_max;
 };
 
 #define OBJECT_INTERFACE_BASE(typename) struct { \
@@ -66,10 +76,21 @@ struct ObjectInterface {
 	#define OBJPOOL_ALLOC(typename,max_objects) objpool_alloc(sizeof(typename), max_objects, #typename)
 #endif
 
+/*
+ * Objects are allocated from slabs of a few pages each. The pool starts with
+ * enough slabs for max_objects, and grows by one slab at a time when needed.
+ * Slabs that have been completely free for a while are released again by
+ * objpool_collect(), as long as the capacity stays at or above max_objects.
+ */
 ObjectPool *objpool_alloc(size_t obj_size, size_t max_objects, const char *tag);
 void objpool_free(ObjectPool *pool);
 ObjectInterface *objpool_acquire(ObjectPool *pool);
+// Acquires num objects at once. Unlike objpool_acquire, this doesn't clear them:
+// everything past the object interface must be initialized by the caller.
+void objpool_acquire_batch(ObjectPool *pool, size_t num, ObjectInterface *objects[num]);
 void objpool_release(ObjectPool *pool, ObjectInterface *object);
 void objpool_get_stats(ObjectPool *pool, ObjectPoolStats *stats);
+// Should be called once per frame; releases slabs that stayed free for long enough.
+void objpool_collect(ObjectPool *pool);
 void objpool_memtest(ObjectPool *pool, ObjectInterface *object);
 size_t objpool_object_size(ObjectPool *pool);
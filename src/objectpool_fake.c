@@ -25,6 +25,12 @@ ObjectInterface *objpool_acquire(ObjectPool *pool) {
 	return calloc(1, pool->size_of_object);
 }
 
+void objpool_acquire_batch(ObjectPool *pool, size_t num, ObjectInterface *objects[num]) {
+	for(size_t i = 0; i < num; ++i) {
+		objects[i] = malloc(pool->size_of_object);
+	}
+}
+
 void objpool_release(ObjectPool *pool, ObjectInterface *object) {
 	free(object);
 }
@@ -33,6 +39,9 @@ void objpool_free(ObjectPool *pool) {
 	free(pool);
 }
 
+void objpool_collect(ObjectPool *pool) {
+}
+
 void objpool_get_stats(ObjectPool *pool, ObjectPoolStats *stats) {
 	memset(stats, 0, sizeof(ObjectPoolStats));
 	stats->tag = "<N/A>";
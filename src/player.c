@@ -914,7 +914,7 @@ void player_graze(Player *plr, complex pos, int pts, int effect_intensity) {
 	}
 
 	player_add_points(plr, pts);
-	play_sound("graze");
+	play_sound(RES_ATOM("graze"));
 
 	for(int i = 0; i < effect_intensity; ++i) {
 		tsrand_fill(3);
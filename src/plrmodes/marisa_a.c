@@ -287,7 +287,7 @@ static Enemy* spawn_laser_fader(Enemy *e, double alpha) {
 	memcpy(ld, (MarisaLaserData*)REF(e->args[3]), sizeof(MarisaLaserData));
 
 	return create_enemy_p(&global.plr.slaves, e->pos, ENEMY_IMMUNE, marisa_laser_fader_visual, marisa_laser_fader,
-		e->args[0], alpha, e->args[2], add_ref(ld));
+		e->args[0], alpha, e->args[2], add_ptr_ref(ld));
 }
 
 static int marisa_laser_renderer(Enemy *renderer, int t) {
@@ -547,7 +547,7 @@ static void marisa_laser_respawn_slaves(Player *plr, short npow) {
 		if(e->logic_rule == marisa_laser_slave) {
 			MarisaLaserData *ld = calloc(1, sizeof(MarisaLaserData));
 			ld->prev_pos = e->pos;
-			e->args[3] = add_ref(ld);
+			e->args[3] = add_ptr_ref(ld);
 			e->ent.draw_layer = LAYER_PLAYER_SLAVE;
 		}
 	}
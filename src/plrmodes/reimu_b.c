@@ -149,8 +149,8 @@ static int reimu_dream_gap(Enemy *e, int t) {
 }
 
 static void reimu_dream_gap_link(Enemy *g0, Enemy *g1) {
-	int ref0 = add_ref(g0);
-	int ref1 = add_ref(g1);
+	RefHandle ref0 = add_ref(g0);
+	RefHandle ref1 = add_ref(g1);
 	g0->args[3] = ref1;
 	g1->args[3] = ref0;
 }
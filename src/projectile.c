@@ -14,6 +14,7 @@
 #include "global.h"
 #include "list.h"
 #include "stageobjects.h"
+#include "collision_grid.h"
 
 static ProjArgs defaults_proj = {
 	.sprite = "proj/",
@@ -203,12 +204,15 @@ static double projectile_rect_area(Projectile *p) {
 	return w * h;
 }
 
-static Projectile* _create_projectile(ProjArgs *args) {
-	if(IN_DRAW_CODE) {
-		log_fatal("Tried to spawn a projectile while in drawing code");
-	}
-
-	Projectile *p = (Projectile*)objpool_acquire(stage_object_pools.projectiles);
+/*
+ * The memory comes from objpool_acquire_batch, which doesn't clear it, so this
+ * must set every field of the projectile, except for the object interface and
+ * the ones ent_register takes care of.
+ */
+static void init_projectile(Projectile *p, ProjArgs *args) {
+	p->ent.draw_layer = args->layer;
+	p->ent.draw_func = ent_draw_projectile;
+	p->ent.damage_func = NULL;
 
 	p->birthtime = global.frames;
 	p->pos = p->pos0 = p->prevpos = args->pos;
@@ -227,16 +231,22 @@ static Projectile* _create_projectile(ProjArgs *args) {
 	p->timeout = args->timeout;
 	p->damage = args->damage;
 	p->damage_type = args->damage_type;
+	p->graze_counter = 0;
+	p->graze_counter_reset_timer = 0;
 
 	if(args->shader_params != NULL) {
 		p->shader_params = *args->shader_params;
+	} else {
+		memset(&p->shader_params, 0, sizeof(p->shader_params));
 	}
 
 	memcpy(p->args, args->args, sizeof(p->args));
 
-	p->ent.draw_layer = args->layer;
-	p->ent.draw_func = ent_draw_projectile;
+#ifdef PROJ_DEBUG
+	memset(&p->debug, 0, sizeof(p->debug));
+#endif
 
+	p->proto = NULL;
 	projectile_set_prototype(p, args->proto);
 
 	// p->collision_size *= 10;
@@ -262,7 +272,16 @@ static Projectile* _create_projectile(ProjArgs *args) {
 			}
 		}
 	}
+}
+
+static Projectile* _create_projectile(ProjArgs *args) {
+	if(IN_DRAW_CODE) {
+		log_fatal("Tried to spawn a projectile while in drawing code");
+	}
 
+	Projectile *p;
+	objpool_acquire_batch(stage_object_pools.projectiles, 1, (ObjectInterface**)&p);
+	init_projectile(p, args);
 	ent_register(&p->ent, ENT_PROJECTILE);
 
 	// TODO: Maybe allow ACTION_DESTROY here?
@@ -278,6 +297,54 @@ Projectile* create_projectile(ProjArgs *args) {
 	return _create_projectile(args);
 }
 
+#define PROJ_BATCH_SIZE 64
+
+void create_projectiles(ProjArgs *tmpl, uint num, ProjArgsInitializer init, void *userdata, Projectile **out_projs) {
+	if(IN_DRAW_CODE) {
+		log_fatal("Tried to spawn a projectile while in drawing code");
+	}
+
+	process_projectile_args(tmpl, &defaults_proj);
+
+	// in chunks, to keep the scratch arrays on the stack
+	for(uint base = 0; base < num; base += PROJ_BATCH_SIZE) {
+		uint batch = min(num - base, PROJ_BATCH_SIZE);
+		Projectile *projs[PROJ_BATCH_SIZE];
+
+		objpool_acquire_batch(stage_object_pools.projectiles, batch, (ObjectInterface**)projs);
+
+		for(uint i = 0; i < batch; ++i) {
+			ProjArgs args = *tmpl;
+
+			if(init) {
+				init(&args, base + i, userdata);
+			}
+
+			init_projectile(projs[i], &args);
+
+#ifdef PROJ_DEBUG
+			memcpy(&projs[i]->debug, get_debug_info(), sizeof(DebugInfo));
+#endif
+		}
+
+		ent_register_batch(batch, (EntityInterface**)projs, ENT_PROJECTILE);
+
+		for(uint i = 0; i < batch; ++i) {
+			proj_call_rule(projs[i], EVENT_BIRTH);
+			alist_append(tmpl->dest, projs[i]);
+
+			if(out_projs) {
+				out_projs[base + i] = projs[i];
+			}
+		}
+	}
+}
+
+void proj_init_ring(ProjArgs *args, uint index, void *userdata) {
+	ProjRingParams *ring = userdata;
+	args->args[0] = ring->speed * cexp(I*(ring->angle + ring->step * (ring->first + (int)index)));
+}
+
 Projectile* create_particle(ProjArgs *args) {
 	process_projectile_args(args, &defaults_part);
 	return _create_projectile(args);
@@ -301,7 +368,7 @@ static void* _delete_projectile(ListAnchor *projlist, List *proj, void *arg) {
 		*&out_list_pointers->list_interface = p->list_interface;
 	}
 
-	del_ref(proj);
+	del_ref(p);
 	ent_unregister(&p->ent);
 	objpool_release(stage_object_pools.projectiles, (ObjectInterface*)alist_unlink(projlist, proj));
 
@@ -316,6 +383,14 @@ void delete_projectiles(ProjectileList *projlist) {
 	alist_foreach(projlist, _delete_projectile, NULL);
 }
 
+static bool plrproj_enemy_predicate(EntityInterface *ent, void *arg) {
+	return ent->type == ENT_ENEMY && ENT_CAST(ent, Enemy)->hp != ENEMY_IMMUNE;
+}
+
+static bool plrproj_boss_predicate(EntityInterface *ent, void *arg) {
+	return ent->type == ENT_BOSS && boss_is_vulnerable(ENT_CAST(ent, Boss));
+}
+
 void calc_projectile_collision(Projectile *p, ProjCollisionResult *out_col) {
 	assert(out_col != NULL);
 
@@ -366,22 +441,18 @@ void calc_projectile_collision(Projectile *p, ProjCollisionResult *out_col) {
 			}
 		}
 	} else if(p->type == PlrProj) {
-		for(Enemy *e = global.enemies.first; e; e = e->next) {
-			if(e->hp != ENEMY_IMMUNE && cabs(e->pos - p->pos) < 30) {
-				out_col->type = PCOL_ENTITY;
-				out_col->entity = &e->ent;
-				out_col->fatal = true;
+		EntityInterface *ent = collision_grid_find_first(p->pos, 30, plrproj_enemy_predicate, NULL);
 
-				return;
-			}
+		if(ent == NULL) {
+			ent = collision_grid_find_first(p->pos, 42, plrproj_boss_predicate, NULL);
 		}
 
-		if(global.boss && cabs(global.boss->pos - p->pos) < 42) {
-			if(boss_is_vulnerable(global.boss)) {
-				out_col->type = PCOL_ENTITY;
-				out_col->entity = &global.boss->ent;
-				out_col->fatal = true;
-			}
+		if(ent != NULL) {
+			out_col->type = PCOL_ENTITY;
+			out_col->entity = ent;
+			out_col->fatal = true;
+
+			return;
 		}
 	}
 
@@ -526,6 +597,202 @@ bool clear_projectile(ProjectileList *projlist, Projectile *proj, bool force, bo
 	return true;
 }
 
+/*
+ * Batched fast path for projectiles driven by the built-in linear, accelerated
+ * and asymptotic rules.
+ *
+ * When process_projectiles runs into such a projectile, it gathers the hot
+ * fields of it and every consecutive projectile with a built-in rule into
+ * the structure-of-arrays below, advances all of them at once (one straight
+ * loop per rule, no indirect calls), and writes the results back. The main
+ * loop then just picks up the precomputed rule result for each of them.
+ *
+ * Only consecutive runs are batched, and the math is exactly the same as in
+ * the rule functions, so the results are identical to calling the rules one
+ * by one in list order.
+ */
+
+enum {
+	PROJ_BATCH_MAX = 512,
+};
+
+typedef enum ProjBatchRule {
+	PBRULE_LINEAR,
+	PBRULE_ACCELERATED,
+	PBRULE_ASYMPTOTIC,
+	PBRULE_NUM,
+	PBRULE_NONE = PBRULE_NUM,
+} ProjBatchRule;
+
+static struct {
+	// In list order.
+	Projectile *projs[PROJ_BATCH_MAX];
+	uint32_t spawn_ids[PROJ_BATCH_MAX];
+	int actions[PROJ_BATCH_MAX];
+	uint num;
+	uint next;
+
+	// Hot data, grouped by rule: lane r occupies [lane_start[r], lane_start[r+1]).
+	uint lane_start[PBRULE_NUM + 1];
+	uint slot[PROJ_BATCH_MAX];
+	complex pos[PROJ_BATCH_MAX];
+	complex pos0[PROJ_BATCH_MAX];
+	complex vel[PROJ_BATCH_MAX];
+	complex acc[PROJ_BATCH_MAX];
+	double t[PROJ_BATCH_MAX];
+	float angle[PROJ_BATCH_MAX];
+} proj_batch;
+
+static inline ProjBatchRule proj_batch_rule(Projectile *p) {
+	if(p->rule == linear) {
+		return PBRULE_LINEAR;
+	}
+
+	if(p->rule == accelerated) {
+		return PBRULE_ACCELERATED;
+	}
+
+	if(p->rule == asymptotic) {
+		return PBRULE_ASYMPTOTIC;
+	}
+
+	return PBRULE_NONE;
+}
+
+static void proj_batch_gather(Projectile *first) {
+	ProjBatchRule rules[PROJ_BATCH_MAX];
+	uint lane_size[PBRULE_NUM] = { 0 };
+	uint n = 0;
+
+	for(Projectile *p = first; p && n < PROJ_BATCH_MAX; p = p->next, ++n) {
+		if((rules[n] = proj_batch_rule(p)) == PBRULE_NONE) {
+			break;
+		}
+
+		int t = global.frames - p->birthtime;
+		proj_batch.projs[n] = p;
+		proj_batch.spawn_ids[n] = p->ent.spawn_id;
+
+		if(p->timeout > 0 && t >= p->timeout) {
+			proj_batch.actions[n] = ACTION_DESTROY;
+			rules[n] = PBRULE_NONE;
+		} else {
+			proj_batch.actions[n] = rules[n] == PBRULE_LINEAR ? ACTION_NONE : 1;
+			++lane_size[rules[n]];
+		}
+	}
+
+	proj_batch.num = n;
+	proj_batch.next = 0;
+	proj_batch.lane_start[0] = 0;
+
+	for(uint r = 0; r < PBRULE_NUM; ++r) {
+		proj_batch.lane_start[r + 1] = proj_batch.lane_start[r] + lane_size[r];
+		lane_size[r] = proj_batch.lane_start[r];
+	}
+
+	for(uint i = 0; i < n; ++i) {
+		if(rules[i] == PBRULE_NONE) {
+			continue;
+		}
+
+		Projectile *p = proj_batch.projs[i];
+		uint j = lane_size[rules[i]]++;
+
+		proj_batch.slot[j] = i;
+		proj_batch.pos[j] = p->pos;
+		proj_batch.pos0[j] = p->pos0;
+		proj_batch.vel[j] = p->args[0];
+		proj_batch.acc[j] = p->args[1];
+		proj_batch.t[j] = global.frames - p->birthtime;
+	}
+}
+
+static void proj_batch_step(void) {
+	complex *restrict pos = proj_batch.pos;
+	complex *restrict pos0 = proj_batch.pos0;
+	complex *restrict vel = proj_batch.vel;
+	complex *restrict acc = proj_batch.acc;
+	double *restrict t = proj_batch.t;
+	float *restrict angle = proj_batch.angle;
+	uint *lane = proj_batch.lane_start;
+
+	// NOTE: must match linear(), accelerated() and asymptotic() exactly.
+
+	for(uint i = lane[PBRULE_LINEAR]; i < lane[PBRULE_LINEAR + 1]; ++i) {
+		angle[i] = carg(vel[i]);
+		pos[i] = pos0[i] + vel[i] * t[i];
+	}
+
+	for(uint i = lane[PBRULE_ACCELERATED]; i < lane[PBRULE_ACCELERATED + 1]; ++i) {
+		angle[i] = carg(vel[i]);
+		pos[i] += vel[i];
+		vel[i] += acc[i];
+	}
+
+	for(uint i = lane[PBRULE_ASYMPTOTIC]; i < lane[PBRULE_ASYMPTOTIC + 1]; ++i) {
+		angle[i] = carg(vel[i]);
+		acc[i] *= 0.8;
+		pos[i] += vel[i] * (acc[i] + 1);
+	}
+}
+
+static void proj_batch_scatter(void) {
+	for(uint j = 0; j < proj_batch.lane_start[PBRULE_NUM]; ++j) {
+		Projectile *p = proj_batch.projs[proj_batch.slot[j]];
+		p->prevpos = p->pos;
+		p->pos = proj_batch.pos[j];
+		p->args[0] = proj_batch.vel[j];
+		p->args[1] = proj_batch.acc[j];
+		p->angle = proj_batch.angle[j];
+	}
+
+	// Timed out projectiles are not stepped, but prevpos is still updated as usual.
+	for(uint i = 0; i < proj_batch.num; ++i) {
+		if(proj_batch.actions[i] == ACTION_DESTROY) {
+			proj_batch.projs[i]->prevpos = proj_batch.projs[i]->pos;
+		}
+	}
+}
+
+static bool proj_batch_consume(Projectile *p, int *out_action) {
+	// Entries skipped over here have been deleted during processing of an earlier projectile.
+	// Once the main loop moves past the batched run, this simply drains the batch.
+	while(proj_batch.next < proj_batch.num) {
+		uint i = proj_batch.next++;
+
+		if(proj_batch.projs[i] == p && proj_batch.spawn_ids[i] == p->ent.spawn_id) {
+			*out_action = proj_batch.actions[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int proj_update(Projectile *p) {
+	int action;
+
+	if(proj_batch_consume(p, &action)) {
+		return action;
+	}
+
+	if(proj_batch_rule(p) != PBRULE_NONE) {
+		proj_batch_gather(p);
+		proj_batch_step();
+		proj_batch_scatter();
+
+		if(proj_batch_consume(p, &action)) {
+			return action;
+		}
+
+		UNREACHABLE;
+	}
+
+	p->prevpos = p->pos;
+	return proj_call_rule(p, global.frames - p->birthtime);
+}
+
 void process_projectiles(ProjectileList *projlist, bool collision) {
 	ProjCollisionResult col = { 0 };
 	ProjectileListInterface list_ptrs;
@@ -533,9 +800,10 @@ void process_projectiles(ProjectileList *projlist, bool collision) {
 	char killed = 0;
 	int action;
 
+	proj_batch.num = proj_batch.next = 0;
+
 	for(Projectile *proj = projlist->first; proj; proj = list_ptrs.next) {
-		proj->prevpos = proj->pos;
-		action = proj_call_rule(proj, global.frames - proj->birthtime);
+		action = proj_update(proj);
 		*&list_ptrs.list_interface = proj->list_interface;
 
 		if(proj->graze_counter && proj->graze_counter_reset_timer - global.frames <= -90) {
@@ -553,7 +821,9 @@ void process_projectiles(ProjectileList *projlist, bool collision) {
 		}
 
 		if(collision) {
+			collision_grid_stats_begin();
 			calc_projectile_collision(proj, &col);
+			collision_grid_stats_end();
 
 			if(col.fatal && col.type != PCOL_VOID) {
 				spawn_projectile_collision_effect(proj);
@@ -158,6 +158,27 @@ typedef struct ProjCollisionResult {
 Projectile* create_projectile(ProjArgs *args);
 Projectile* create_particle(ProjArgs *args);
 
+/*
+ * Spawns num projectiles from one template, which is processed only once.
+ * For each projectile, init (if not NULL) gets a copy of the template to adjust
+ * the per-projectile fields: position, rule arguments, angle, color, etc.
+ * It must not change the prototype, sprite, shader, type or destination list,
+ * and must not spawn anything itself. If out_projs is not NULL, it receives
+ * the spawned projectiles, in order.
+ */
+typedef void (*ProjArgsInitializer)(ProjArgs *args, uint index, void *userdata);
+void create_projectiles(ProjArgs *tmpl, uint num, ProjArgsInitializer init, void *userdata, Projectile **out_projs);
+
+// For rings and fans: sets args[0] to speed * cexp(I*(angle + step * (first + index))).
+typedef struct ProjRingParams {
+	double speed;
+	double angle;
+	double step;
+	int first;
+} ProjRingParams;
+
+void proj_init_ring(ProjArgs *args, uint index, void *userdata);
+
 #ifdef PROJ_DEBUG
 	Projectile* _proj_attach_dbginfo(Projectile *p, DebugInfo *dbg, const char *callsite_str);
 	#define _PROJ_WRAP_SPAWN(p) _proj_attach_dbginfo((p), _DEBUG_INFO_PTR_, #p)
@@ -170,6 +191,18 @@ Projectile* create_particle(ProjArgs *args);
 #define PROJECTILE(...) _PROJ_GENERIC_SPAWN(create_projectile, __VA_ARGS__)
 #define PARTICLE(...) _PROJ_GENERIC_SPAWN(create_particle, __VA_ARGS__)
 
+#ifdef PROJ_DEBUG
+	#define _PROJ_SET_SPAWN_DBGINFO() set_debug_info(_DEBUG_INFO_PTR_)
+#else
+	#define _PROJ_SET_SPAWN_DBGINFO() ((void)0)
+#endif
+
+// Like PROJECTILE, but for num projectiles at once; see create_projectiles.
+#define PROJECTILES(num, init, userdata, ...) do { \
+	_PROJ_SET_SPAWN_DBGINFO(); \
+	create_projectiles((&(ProjArgs) { __VA_ARGS__ }), (num), (init), (userdata), NULL); \
+} while(0)
+
 void delete_projectile(ProjectileList *projlist, Projectile *proj, ProjectileListInterface *out_list_pointers);
 void delete_projectiles(ProjectileList *projlist);
 
@@ -0,0 +1,234 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "rcumap.h"
+#include "util.h"
+
+#define RCUMAP_MIN_SIZE 32
+
+typedef struct RCUMapEntry {
+	_Atomic(char*) key;
+	_Atomic(void*) value;
+	hash_t hash;
+} RCUMapEntry;
+
+struct RCUMapTable {
+	RCUMapTable *next_retired;
+	size_t size;
+	size_t hash_mask;
+	size_t num_keys; // including tombstones
+	RCUMapEntry entries[];
+};
+
+static RCUMapTable* table_new(size_t size) {
+	RCUMapTable *t = calloc(1, sizeof(*t) + size * sizeof(*t->entries));
+	t->size = size;
+	t->hash_mask = size - 1;
+	return t;
+}
+
+void rcumap_create(RCUMap *map) {
+	memset(map, 0, sizeof(*map));
+	atomic_init(&map->table, table_new(RCUMAP_MIN_SIZE));
+	map->write_mutex = SDL_CreateMutex();
+}
+
+void rcumap_destroy(RCUMap *map) {
+	RCUMapTable *t = atomic_load(&map->table);
+
+	for(size_t i = 0; i < t->size; ++i) {
+		free(atomic_load_explicit(&t->entries[i].key, memory_order_relaxed));
+	}
+
+	free(t);
+
+	for(RCUMapTable *next; map->retired; map->retired = next) {
+		next = map->retired->next_retired;
+		free(map->retired);
+	}
+
+	SDL_DestroyMutex(map->write_mutex);
+	memset(map, 0, sizeof(*map));
+}
+
+static RCUMapEntry* find_entry(RCUMapTable *t, const char *key, hash_t hash) {
+	// The load factor is kept at or below 1/2, so there is always a free slot to stop at.
+	for(size_t i = hash & t->hash_mask;; i = (i + 1) & t->hash_mask) {
+		RCUMapEntry *e = t->entries + i;
+		char *ekey = atomic_load_explicit(&e->key, memory_order_acquire);
+
+		if(ekey == NULL) {
+			return NULL;
+		}
+
+		if(e->hash == hash && !strcmp(ekey, key)) {
+			return e;
+		}
+	}
+}
+
+void* rcumap_get(RCUMap *map, const char *key, void *fallback) {
+	RCUMapTable *t = atomic_load_explicit(&map->table, memory_order_acquire);
+	RCUMapEntry *e = find_entry(t, key, htutil_hashfunc_string(0, key));
+
+	if(e != NULL) {
+		void *value = atomic_load_explicit(&e->value, memory_order_acquire);
+		return value ? value : fallback;
+	}
+
+	return fallback;
+}
+
+static RCUMapEntry* insert_key(RCUMapTable *t, char *key, hash_t hash, void *value) {
+	size_t i = hash & t->hash_mask;
+
+	while(atomic_load_explicit(&t->entries[i].key, memory_order_relaxed) != NULL) {
+		i = (i + 1) & t->hash_mask;
+	}
+
+	RCUMapEntry *e = t->entries + i;
+	e->hash = hash;
+	atomic_store_explicit(&e->value, value, memory_order_relaxed);
+	// publish the slot last; readers will see the hash and value once they see the key
+	atomic_store_explicit(&e->key, key, memory_order_release);
+	++t->num_keys;
+
+	return e;
+}
+
+static RCUMapTable* grow(RCUMap *map, RCUMapTable *old) {
+	RCUMapTable *t = table_new(old->size * 2);
+
+	for(size_t i = 0; i < old->size; ++i) {
+		RCUMapEntry *e = old->entries + i;
+		char *key = atomic_load_explicit(&e->key, memory_order_relaxed);
+
+		if(key != NULL) {
+			insert_key(t, key, e->hash, atomic_load_explicit(&e->value, memory_order_relaxed));
+		}
+	}
+
+	atomic_store_explicit(&map->table, t, memory_order_release);
+
+	old->next_retired = map->retired;
+	map->retired = old;
+
+	log_debug("Resized RCUMap at %p: %zu -> %zu", (void*)map, old->size, t->size);
+	return t;
+}
+
+static bool set(RCUMap *map, const char *key, void *value, void* (*value_transform)(void*), bool allow_overwrite, void **out_value) {
+	hash_t hash = htutil_hashfunc_string(0, key);
+	bool inserted = false;
+
+	SDL_LockMutex(map->write_mutex);
+
+	RCUMapTable *t = atomic_load_explicit(&map->table, memory_order_relaxed);
+	RCUMapEntry *e = find_entry(t, key, hash);
+	void *old_value = e ? atomic_load_explicit(&e->value, memory_order_relaxed) : NULL;
+
+	if(old_value != NULL && !allow_overwrite) {
+		if(out_value != NULL) {
+			*out_value = old_value;
+		}
+
+		goto end;
+	}
+
+	if(value_transform != NULL) {
+		value = value_transform(value);
+	}
+
+	assert(value != NULL);
+
+	if(out_value != NULL) {
+		*out_value = value;
+	}
+
+	if(e != NULL) {
+		// overwrite, or revive a tombstone
+		atomic_store_explicit(&e->value, value, memory_order_release);
+	} else {
+		if((t->num_keys + 1) * 2 > t->size) {
+			t = grow(map, t);
+		}
+
+		insert_key(t, strdup(key), hash, value);
+	}
+
+	if(old_value == NULL) {
+		++map->num_elements;
+		inserted = true;
+	}
+
+end:
+	SDL_UnlockMutex(map->write_mutex);
+	return inserted;
+}
+
+bool rcumap_set(RCUMap *map, const char *key, void *value) {
+	return set(map, key, value, NULL, true, NULL);
+}
+
+bool rcumap_try_set(RCUMap *map, const char *key, void *value, void* (*value_transform)(void*), void **out_value) {
+	return set(map, key, value, value_transform, false, out_value);
+}
+
+bool rcumap_unset(RCUMap *map, const char *key) {
+	hash_t hash = htutil_hashfunc_string(0, key);
+	bool unset = false;
+
+	SDL_LockMutex(map->write_mutex);
+
+	RCUMapEntry *e = find_entry(atomic_load_explicit(&map->table, memory_order_relaxed), key, hash);
+
+	if(e != NULL && atomic_load_explicit(&e->value, memory_order_relaxed) != NULL) {
+		atomic_store_explicit(&e->value, NULL, memory_order_release);
+		--map->num_elements;
+		unset = true;
+	}
+
+	SDL_UnlockMutex(map->write_mutex);
+	return unset;
+}
+
+void* rcumap_foreach(RCUMap *map, RCUMapForeachCallback callback, void *arg) {
+	RCUMapTable *t = atomic_load_explicit(&map->table, memory_order_acquire);
+
+	for(size_t i = 0; i < t->size; ++i) {
+		RCUMapEntry *e = t->entries + i;
+		char *key = atomic_load_explicit(&e->key, memory_order_acquire);
+
+		if(key == NULL) {
+			continue;
+		}
+
+		void *value = atomic_load_explicit(&e->value, memory_order_acquire);
+
+		if(value == NULL) {
+			continue;
+		}
+
+		void *ret = callback(key, value, arg);
+
+		if(ret != NULL) {
+			return ret;
+		}
+	}
+
+	return NULL;
+}
+
+size_t rcumap_size(RCUMap *map) {
+	SDL_LockMutex(map->write_mutex);
+	size_t size = map->num_elements;
+	SDL_UnlockMutex(map->write_mutex);
+	return size;
+}
@@ -0,0 +1,62 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <stdatomic.h>
+#include <SDL_mutex.h>
+
+#include "hashtable.h"
+
+/*
+ * RCUMap
+ *
+ * A read-mostly concurrent map of strings to non-NULL void pointers.
+ *
+ * Lookups never lock or block: they work on an open-addressing table snapshot
+ * that is published atomically. Writers are serialized by a mutex. New keys are
+ * published into free slots of the current snapshot; when that fills up, a
+ * bigger copy is made and swapped in. Old snapshots are kept alive until the
+ * map is destroyed, since lock-free readers may still be looking at them.
+ *
+ * Removing a key only clears its value; the key stays in the table as a
+ * tombstone and is revived if it's set again. This map is meant for sets of
+ * names that are reused a lot, such as resource names.
+ *
+ * Readers may observe a slightly stale view, but never a torn one.
+ */
+
+typedef struct RCUMapTable RCUMapTable;
+
+typedef struct RCUMap {
+	// All of these fields are private.
+	_Atomic(RCUMapTable*) table;
+	RCUMapTable *retired;
+	SDL_mutex *write_mutex;
+	size_t num_elements;
+} RCUMap;
+
+typedef void* (*RCUMapForeachCallback)(const char *key, void *value, void *arg);
+
+void rcumap_create(RCUMap *map) attr_nonnull(1);
+void rcumap_destroy(RCUMap *map) attr_nonnull(1);
+
+// Lock-free. Returns fallback if key is not mapped.
+void* rcumap_get(RCUMap *map, const char *key, void *fallback) attr_nonnull(1, 2);
+
+// Same semantics as ht_XXX_set and ht_XXX_try_set. value must not be NULL.
+bool rcumap_set(RCUMap *map, const char *key, void *value) attr_nonnull(1, 2, 3);
+bool rcumap_try_set(RCUMap *map, const char *key, void *value, void* (*value_transform)(void*), void **out_value) attr_nonnull(1, 2);
+
+bool rcumap_unset(RCUMap *map, const char *key) attr_nonnull(1, 2);
+
+// Iterates over a snapshot of the map; it's fine to modify the map from the callback.
+void* rcumap_foreach(RCUMap *map, RCUMapForeachCallback callback, void *arg) attr_nonnull(1, 2);
+
+size_t rcumap_size(RCUMap *map) attr_nonnull(1);
@@ -8,11 +8,11 @@
 
 #include "taisei.h"
 
+#include <float.h>
+
 #include "global.h"
 #include "refs.h"
 
-void *_FREEREF;
-
 #ifdef DEBUG
 	// #define DEBUG_REFS
 #endif
@@ -23,61 +23,141 @@ void *_FREEREF;
 	#define REFLOG(...)
 #endif
 
-int add_ref(void *ptr) {
-	int i, firstfree = -1;
+#define REF_GENERATION_MASK ((1u << REF_GENERATION_BITS) - 1)
 
-	for(i = 0; i < global.refs.count; i++) {
-		if(global.refs.ptrs[i].ptr == ptr) {
-			global.refs.ptrs[i].refs++;
-			REFLOG("increased refcount for %p (ref %i): %i", ptr, i, global.refs.ptrs[i].refs);
-			return i;
-		} else if(firstfree < 0 && global.refs.ptrs[i].ptr == FREEREF) {
-			firstfree = i;
-		}
+static_assert(32 + REF_GENERATION_BITS <= DBL_MANT_DIG, "Reference handles must be exactly representable as doubles");
+
+static inline RefHandle ref_make_handle(uint32_t index, uint32_t generation) {
+	return ((RefHandle)generation << 32) | index;
+}
+
+static Reference *ref_lookup_owner(void *ptr, uint *owner_slot) {
+	uint slot = *owner_slot;
+
+	if(!slot || slot > global.refs.count) {
+		return NULL;
+	}
+
+	Reference *r = global.refs.ptrs + slot - 1;
+	return r->ptr == ptr ? r : NULL;
+}
+
+static Reference *ref_lookup(RefHandle ref) {
+	if(ref <= 0) {
+		return NULL;
+	}
+
+	uint32_t index = (uint32_t)ref;
+	uint32_t generation = (uint32_t)(ref >> 32);
+
+	if(index >= global.refs.count) {
+		return NULL;
+	}
+
+	Reference *r = global.refs.ptrs + index;
+
+	if(r->generation != generation || r->refs <= 0) {
+		return NULL;
+	}
+
+	return r;
+}
+
+RefHandle _add_ref(void *ptr, uint *owner_slot) {
+	Reference *r;
+	uint32_t index;
+
+	if(owner_slot && (r = ref_lookup_owner(ptr, owner_slot))) {
+		index = *owner_slot - 1;
+		r->refs++;
+		REFLOG("increased refcount for %p (ref %u): %i", ptr, index, r->refs);
+		return ref_make_handle(index, r->generation);
 	}
 
-	if(firstfree >= 0) {
-		global.refs.ptrs[firstfree].ptr = ptr;
-		global.refs.ptrs[firstfree].refs = 1;
-		REFLOG("found free ref for %p: %i", ptr, firstfree);
-		return firstfree;
+	if(global.refs.first_free) {
+		index = global.refs.first_free - 1;
+		r = global.refs.ptrs + index;
+		global.refs.first_free = r->next_free;
+		REFLOG("found free ref for %p: %u", ptr, index);
+	} else {
+		if(global.refs.count == global.refs.capacity) {
+			global.refs.capacity = global.refs.capacity ? global.refs.capacity * 2 : 64;
+			global.refs.ptrs = realloc(global.refs.ptrs, global.refs.capacity * sizeof(Reference));
+		}
+
+		index = global.refs.count++;
+		r = global.refs.ptrs + index;
+		r->generation = 1;
+		REFLOG("new ref for %p: %u", ptr, index);
 	}
 
-	global.refs.ptrs = realloc(global.refs.ptrs, (++global.refs.count)*sizeof(Reference));
-	global.refs.ptrs[global.refs.count - 1].ptr = ptr;
-	global.refs.ptrs[global.refs.count - 1].refs = 1;
-	REFLOG("new ref for %p: %i", ptr, global.refs.count - 1);
+	r->ptr = ptr;
+	r->owner_slot = owner_slot;
+	r->refs = 1;
+	r->next_free = 0;
+
+	if(owner_slot) {
+		*owner_slot = index + 1;
+	}
 
-	return global.refs.count - 1;
+	return ref_make_handle(index, r->generation);
 }
 
-void del_ref(void *ptr) {
-	int i;
+void _del_ref(void *ptr, uint *owner_slot) {
+	Reference *r = ref_lookup_owner(ptr, owner_slot);
+
+	if(!r) {
+		return;
+	}
+
+	// the slot stays allocated until every holder calls free_ref
+	r->ptr = NULL;
+	r->owner_slot = NULL;
+	*owner_slot = 0;
+}
 
-	for(i = 0; i < global.refs.count; i++)
-		if(global.refs.ptrs[i].ptr == ptr)
-			global.refs.ptrs[i].ptr = NULL;
+void *get_ref(RefHandle ref) {
+	Reference *r = ref_lookup(ref);
+	return r ? r->ptr : NULL;
 }
 
-void free_ref(int i) {
-	if(i < 0)
+void free_ref(RefHandle ref) {
+	Reference *r = ref_lookup(ref);
+
+	if(!r) {
+		return;
+	}
+
+	r->refs--;
+	REFLOG("decreased refcount for %p (ref %u): %i", r->ptr, (uint32_t)ref, r->refs);
+
+	if(r->refs > 0) {
 		return;
+	}
 
-	global.refs.ptrs[i].refs--;
-	REFLOG("decreased refcount for %p (ref %i): %i", global.refs.ptrs[i].ptr, i, global.refs.ptrs[i].refs);
+	if(r->owner_slot) {
+		*r->owner_slot = 0;
+	}
 
-	if(global.refs.ptrs[i].refs <= 0) {
-		global.refs.ptrs[i].ptr = FREEREF;
-		global.refs.ptrs[i].refs = 0;
-		REFLOG("ref %i is now free", i);
+	// invalidate all outstanding handles to this slot; generation 0 is never used
+	r->ptr = NULL;
+	r->owner_slot = NULL;
+	r->refs = 0;
+
+	if(!(r->generation = (r->generation + 1) & REF_GENERATION_MASK)) {
+		r->generation = 1;
 	}
+
+	r->next_free = global.refs.first_free;
+	global.refs.first_free = (uint32_t)(r - global.refs.ptrs) + 1;
+	REFLOG("ref %u is now free", (uint32_t)ref);
 }
 
 void free_all_refs(void) {
 	int inuse = 0;
 	int inuse_unique = 0;
 
-	for(int i = 0; i < global.refs.count; i++) {
+	for(uint32_t i = 0; i < global.refs.count; i++) {
 		if(global.refs.ptrs[i].refs) {
 			inuse += global.refs.ptrs[i].refs;
 			inuse_unique += 1;
@@ -85,7 +165,7 @@ void free_all_refs(void) {
 	}
 
 	if(inuse) {
-		log_warn("%i refs were still in use (%i unique, %i total allocated)", inuse, inuse_unique, global.refs.count);
+		log_warn("%i refs were still in use (%i unique, %u total allocated)", inuse, inuse_unique, global.refs.count);
 	}
 
 	free(global.refs.ptrs);
@@ -9,20 +9,57 @@
 #pragma once
 #include "taisei.h"
 
+#include "entity.h"
+
+/*
+ * Weak references to entities.
+ *
+ * A reference handle combines an index into the reference table with the
+ * generation of that slot. The slot's generation changes when the slot is
+ * freed, so stale handles resolve to NULL instead of to whatever reuses the
+ * slot. Entities remember their slot (EntityInterface.ref_slot), so taking
+ * another reference to an entity and invalidating its references when it
+ * dies are O(1), just like resolving a handle.
+ *
+ * add_ptr_ref() references arbitrary memory. Such references are never
+ * shared or invalidated; they only go away with free_ref().
+ *
+ * Handles are stored in the complex args of stage objects, so they must be
+ * exactly representable as doubles: the generation is limited to
+ * REF_GENERATION_BITS bits. When packing two handles into one complex value,
+ * use CMPLX(a, b): a + I*b goes through _Complex float and loses precision.
+ */
+
+typedef int64_t RefHandle;
+
+#define REF_GENERATION_BITS 20
+#define REF_NONE ((RefHandle)0)
+
 typedef struct {
 	void *ptr;
+	uint *owner_slot;
 	int refs;
+	uint32_t generation;
+	uint32_t next_free;
 } Reference;
 
 typedef struct {
 	Reference *ptrs;
-	int count;
+	uint32_t count;
+	uint32_t capacity;
+
+	// 1-based index of the first free slot; 0 if none
+	uint32_t first_free;
 } RefArray;
 
-extern void *_FREEREF;
-#define FREEREF &_FREEREF
-#define REF(p) (global.refs.ptrs[(int)(p)].ptr)
-int add_ref(void *ptr);
-void del_ref(void *ptr);
-void free_ref(int i);
+#define REF(p) get_ref((RefHandle)(p))
+
+#define add_ref(ent) _add_ref((ent), &(ent)->entity_interface.ref_slot)
+#define add_ptr_ref(ptr) _add_ref((ptr), NULL)
+#define del_ref(ent) _del_ref((ent), &(ent)->entity_interface.ref_slot)
+
+RefHandle _add_ref(void *ptr, uint *owner_slot);
+void _del_ref(void *ptr, uint *owner_slot);
+void *get_ref(RefHandle ref);
+void free_ref(RefHandle ref);
 void free_all_refs(void);
@@ -10,6 +10,7 @@
 
 #include "api.h"
 #include "common/backend.h"
+#include "common/cmdbuf.h"
 #include "common/matstack.h"
 #include "common/sprite_batch.h"
 #include "common/models.h"
@@ -26,6 +27,9 @@ static struct {
 		ShaderProgram *standard;
 		ShaderProgram *standardnotex;
 	} progs;
+
+	// bumped whenever a shader program is destroyed, to invalidate UniformHandles
+	uint shader_generation;
 } R;
 
 void r_init(void) {
@@ -80,10 +84,18 @@ void r_post_init(void) {
 	r_blend(BLEND_PREMUL_ALPHA);
 	r_framebuffer_clear(NULL, CLEAR_ALL, RGBA(0, 0, 0, 1), 1);
 
+	if(env_get("TAISEI_RENDER_THREAD", false)) {
+		_r_cmdbuf_install(&_r_backend, true);
+	}
+
 	log_info("Rendering subsystem initialized (%s)", _r_backend.name);
 }
 
 void r_shutdown(void) {
+	if(_r_cmdbuf_installed()) {
+		_r_cmdbuf_uninstall(&_r_backend);
+	}
+
 	_r_state_shutdown();
 	_r_sprite_batch_shutdown();
 	_r_models_shutdown();
@@ -215,6 +227,7 @@ static VertexAttribTypeInfo va_type_info[] = {
 	[VA_USHORT] = VATYPE(uint16_t),
 	[VA_INT]    = VATYPE(int32_t),
 	[VA_UINT]   = VATYPE(uint32_t),
+	[VA_HALF]   = VATYPE(uint16_t),
 };
 
 const VertexAttribTypeInfo* r_vertex_attrib_type_info(VertexAttribType type) {
@@ -352,6 +365,7 @@ ShaderProgram* r_shader_program_link(uint num_objects, ShaderObject *shobjs[num_
 
 void r_shader_program_destroy(ShaderProgram *prog) {
 	B.shader_program_destroy(prog);
+	++R.shader_generation;
 }
 
 void r_shader_program_set_debug_label(ShaderProgram *prog, const char *label) {
@@ -375,15 +389,42 @@ Uniform* r_shader_uniform(ShaderProgram *prog, const char *uniform_name) {
 	return B.shader_uniform(prog, uniform_name);
 }
 
+Uniform* r_shader_current_uniform_handle(UniformHandle *handle, const char *uniform_name) {
+	ShaderProgram *prog = r_shader_current();
+
+	if(handle->prog != prog || handle->generation != R.shader_generation) {
+		handle->prog = prog;
+		handle->generation = R.shader_generation;
+		handle->uniform = B.shader_uniform(prog, uniform_name);
+	}
+
+	return handle->uniform;
+}
+
 UniformType r_uniform_type(Uniform *uniform) {
 	return B.uniform_type(uniform);
 }
 
+/*
+ * Frontend state that every draw call depends on. This is done here rather than
+ * in the backend, so that the backend never has to look at the frontend's state
+ * while executing a draw (which may happen on the render thread).
+ */
+static void r_prepare_draw(void) {
+	r_flush_sprites();
+	r_uniform_mat4(r_cached_uniform("r_modelViewMatrix"), *_r_matrices.modelview.head);
+	r_uniform_mat4(r_cached_uniform("r_projectionMatrix"), *_r_matrices.projection.head);
+	r_uniform_mat4(r_cached_uniform("r_textureMatrix"), *_r_matrices.texture.head);
+	r_uniform_vec4_rgba(r_cached_uniform("r_color"), r_color_current());
+}
+
 void r_draw(VertexArray *varr, Primitive prim, uint firstvert, uint count, uint instances, uint base_instance) {
+	r_prepare_draw();
 	B.draw(varr, prim, firstvert, count, instances, base_instance);
 }
 
 void r_draw_indexed(VertexArray* varr, Primitive prim, uint firstidx, uint count, uint instances, uint base_instance) {
+	r_prepare_draw();
 	B.draw_indexed(varr, prim, firstidx, count, instances, base_instance);
 }
 
@@ -440,6 +481,7 @@ void r_texture_invalidate(Texture *tex) {
 }
 
 void r_texture_clear(Texture *tex, const Color *clr) {
+	r_flush_sprites();
 	B.texture_clear(tex, clr);
 }
 
@@ -472,6 +514,7 @@ uint r_framebuffer_get_attachment_mipmap(Framebuffer *fb, FramebufferAttachment
 }
 
 void r_framebuffer_clear(Framebuffer *fb, ClearBufferFlags flags, const Color *colorval, float depthval) {
+	r_flush_sprites();
 	B.framebuffer_clear(fb, flags, colorval, depthval);
 }
 
@@ -526,6 +569,10 @@ SDL_RWops* r_vertex_buffer_get_stream(VertexBuffer *vbuf) {
 	return B.vertex_buffer_get_stream(vbuf);
 }
 
+void* r_vertex_buffer_map(VertexBuffer *vbuf, size_t size) {
+	return B.vertex_buffer_map(vbuf, size);
+}
+
 IndexBuffer* r_index_buffer_create(size_t max_elements) {
 	return B.index_buffer_create(max_elements);
 }
@@ -605,24 +652,30 @@ VsyncMode r_vsync_current(void) {
 
 void r_swap(SDL_Window *window) {
 	_r_sprite_batch_end_frame();
+	r_flush_sprites();
 	B.swap(window);
 }
 
+void r_frame_stats(RendererFrameStats *stats) {
+	B.frame_stats(stats);
+}
+
 bool r_screenshot(Pixmap *out) {
 	return B.screenshot(out);
 }
 
 // uniforms garbage; hope your compiler is smart enough to inline most of this
 
-#define ASSERT_UTYPE(uniform, type) do { if(uniform) assert(r_uniform_type(uniform) == type); } while(0)
+// UNIFORM_UNKNOWN is allowed here because the null backend only learns the types of uniforms as they get set.
+#define ASSERT_UTYPE(uniform, type) do { if(uniform) assert(r_uniform_type(uniform) == type || r_uniform_type(uniform) == UNIFORM_UNKNOWN); } while(0)
 
 void r_uniform_ptr_unsafe(Uniform *uniform, uint offset, uint count, void *data) {
-	if(uniform) B.uniform(uniform, offset, count, data);
+	if(uniform) B.uniform(uniform, offset, count, UNIFORM_UNKNOWN, data);
 }
 
 void _r_uniform_ptr_float(Uniform *uniform, float value) {
 	ASSERT_UTYPE(uniform, UNIFORM_FLOAT);
-	if(uniform) B.uniform(uniform, 0, 1, &value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_FLOAT, &value);
 }
 
 void _r_uniform_float(const char *uniform, float value) {
@@ -631,7 +684,7 @@ void _r_uniform_float(const char *uniform, float value) {
 
 void _r_uniform_ptr_float_array(Uniform *uniform, uint offset, uint count, float elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_FLOAT);
-	if(uniform && count) B.uniform(uniform, offset, count, elements);
+	if(uniform && count) B.uniform(uniform, offset, count, UNIFORM_FLOAT, elements);
 }
 
 void _r_uniform_float_array(const char *uniform, uint offset, uint count, float elements[count]) {
@@ -648,7 +701,7 @@ void _r_uniform_vec2(const char *uniform, float x, float y) {
 
 void _r_uniform_ptr_vec2_vec(Uniform *uniform, vec2_noalign value) {
 	ASSERT_UTYPE(uniform, UNIFORM_VEC2);
-	if(uniform) B.uniform(uniform, 0, 1, value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_VEC2, value);
 }
 
 void _r_uniform_vec2_vec(const char *uniform, vec2_noalign value) {
@@ -657,7 +710,7 @@ void _r_uniform_vec2_vec(const char *uniform, vec2_noalign value) {
 
 void _r_uniform_ptr_vec2_complex(Uniform *uniform, complex value) {
 	ASSERT_UTYPE(uniform, UNIFORM_VEC2);
-	if(uniform) B.uniform(uniform, 0, 1, (vec2_noalign) { creal(value), cimag(value) });
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_VEC2, (vec2_noalign) { creal(value), cimag(value) });
 }
 
 void _r_uniform_vec2_complex(const char *uniform, complex value) {
@@ -666,7 +719,7 @@ void _r_uniform_vec2_complex(const char *uniform, complex value) {
 
 void _r_uniform_ptr_vec2_array(Uniform *uniform, uint offset, uint count, vec2_noalign elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_VEC2);
-	if(uniform && count) B.uniform(uniform, offset, count, elements);
+	if(uniform && count) B.uniform(uniform, offset, count, UNIFORM_VEC2, elements);
 }
 
 void _r_uniform_vec2_array(const char *uniform, uint offset, uint count, vec2_noalign elements[count]) {
@@ -685,7 +738,7 @@ void _r_uniform_ptr_vec2_array_complex(Uniform *uniform, uint offset, uint count
 			*aptr++ = cimag(*eptr++);
 		} while(aptr < aend);
 
-		B.uniform(uniform, offset, count, arr);
+		B.uniform(uniform, offset, count, UNIFORM_VEC2, arr);
 	}
 }
 
@@ -695,7 +748,7 @@ void _r_uniform_vec2_array_complex(const char *uniform, uint offset, uint count,
 
 void _r_uniform_ptr_vec3(Uniform *uniform, float x, float y, float z) {
 	ASSERT_UTYPE(uniform, UNIFORM_VEC3);
-	if(uniform) B.uniform(uniform, 0, 1, (vec3_noalign) { x, y, z });
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_VEC3, (vec3_noalign) { x, y, z });
 }
 
 void _r_uniform_vec3(const char *uniform, float x, float y, float z) {
@@ -704,7 +757,7 @@ void _r_uniform_vec3(const char *uniform, float x, float y, float z) {
 
 void _r_uniform_ptr_vec3_vec(Uniform *uniform, vec3_noalign value) {
 	ASSERT_UTYPE(uniform, UNIFORM_VEC3);
-	if(uniform) B.uniform(uniform, 0, 1, value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_VEC3, value);
 }
 
 void _r_uniform_vec3_vec(const char *uniform, vec3_noalign value) {
@@ -721,7 +774,7 @@ void _r_uniform_vec3_rgb(const char *uniform, const Color *rgb) {
 
 void _r_uniform_ptr_vec3_array(Uniform *uniform, uint offset, uint count, vec3_noalign elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_VEC3);
-	if(uniform) B.uniform(uniform, offset, count, elements);
+	if(uniform) B.uniform(uniform, offset, count, UNIFORM_VEC3, elements);
 }
 
 void _r_uniform_vec3_array(const char *uniform, uint offset, uint count, vec3_noalign elements[count]) {
@@ -730,7 +783,7 @@ void _r_uniform_vec3_array(const char *uniform, uint offset, uint count, vec3_no
 
 void _r_uniform_ptr_vec4(Uniform *uniform, float x, float y, float z, float w) {
 	ASSERT_UTYPE(uniform, UNIFORM_VEC4);
-	if(uniform) B.uniform(uniform, 0, 1, (vec4_noalign) { x, y, z, w });
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_VEC4, (vec4_noalign) { x, y, z, w });
 }
 
 void _r_uniform_vec4(const char *uniform, float x, float y, float z, float w) {
@@ -739,7 +792,7 @@ void _r_uniform_vec4(const char *uniform, float x, float y, float z, float w) {
 
 void _r_uniform_ptr_vec4_vec(Uniform *uniform, vec4_noalign value) {
 	ASSERT_UTYPE(uniform, UNIFORM_VEC4);
-	if(uniform) B.uniform(uniform, 0, 1, value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_VEC4, value);
 }
 
 void _r_uniform_vec4_vec(const char *uniform, vec4_noalign value) {
@@ -756,7 +809,7 @@ void _r_uniform_vec4_rgba(const char *uniform, const Color *rgba) {
 
 void _r_uniform_ptr_vec4_array(Uniform *uniform, uint offset, uint count, vec4_noalign elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_VEC4);
-	if(uniform) B.uniform(uniform, offset, count, elements);
+	if(uniform) B.uniform(uniform, offset, count, UNIFORM_VEC4, elements);
 }
 
 void _r_uniform_vec4_array(const char *uniform, uint offset, uint count, vec4_noalign elements[count]) {
@@ -765,7 +818,7 @@ void _r_uniform_vec4_array(const char *uniform, uint offset, uint count, vec4_no
 
 void _r_uniform_ptr_mat3(Uniform *uniform, mat3_noalign value) {
 	ASSERT_UTYPE(uniform, UNIFORM_MAT3);
-	if(uniform) B.uniform(uniform, 0, 1, value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_MAT3, value);
 }
 
 void _r_uniform_mat3(const char *uniform, mat3_noalign value) {
@@ -774,7 +827,7 @@ void _r_uniform_mat3(const char *uniform, mat3_noalign value) {
 
 void _r_uniform_ptr_mat3_array(Uniform *uniform, uint offset, uint count, mat3_noalign elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_MAT3);
-	if(uniform) B.uniform(uniform, offset, count, elements);
+	if(uniform) B.uniform(uniform, offset, count, UNIFORM_MAT3, elements);
 }
 
 void _r_uniform_mat3_array(const char *uniform, uint offset, uint count, mat3_noalign elements[count]) {
@@ -783,7 +836,7 @@ void _r_uniform_mat3_array(const char *uniform, uint offset, uint count, mat3_no
 
 void _r_uniform_ptr_mat4(Uniform *uniform, mat4_noalign value) {
 	ASSERT_UTYPE(uniform, UNIFORM_MAT4);
-	if(uniform) B.uniform(uniform, 0, 1, value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_MAT4, value);
 }
 
 void _r_uniform_mat4(const char *uniform, mat4_noalign value) {
@@ -792,7 +845,7 @@ void _r_uniform_mat4(const char *uniform, mat4_noalign value) {
 
 void _r_uniform_ptr_mat4_array(Uniform *uniform, uint offset, uint count, mat4_noalign elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_MAT4);
-	if(uniform) B.uniform(uniform, offset, count, elements);
+	if(uniform) B.uniform(uniform, offset, count, UNIFORM_MAT4, elements);
 }
 
 void _r_uniform_mat4_array(const char *uniform, uint offset, uint count, mat4_noalign elements[count]) {
@@ -801,7 +854,7 @@ void _r_uniform_mat4_array(const char *uniform, uint offset, uint count, mat4_no
 
 void _r_uniform_ptr_int(Uniform *uniform, int value) {
 	ASSERT_UTYPE(uniform, UNIFORM_INT);
-	if(uniform) B.uniform(uniform, 0, 1, &value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_INT, &value);
 }
 
 void _r_uniform_int(const char *uniform, int value) {
@@ -810,7 +863,7 @@ void _r_uniform_int(const char *uniform, int value) {
 
 void _r_uniform_ptr_int_array(Uniform *uniform, uint offset, uint count, int elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_INT);
-	if(uniform) B.uniform(uniform, offset, count, elements);
+	if(uniform) B.uniform(uniform, offset, count, UNIFORM_INT, elements);
 }
 
 void _r_uniform_int_array(const char *uniform, uint offset, uint count, int elements[count]) {
@@ -827,7 +880,7 @@ void _r_uniform_ivec2(const char *uniform, int x, int y) {
 
 void _r_uniform_ptr_ivec2_vec(Uniform *uniform, ivec2_noalign value) {
 	ASSERT_UTYPE(uniform, UNIFORM_IVEC2);
-	if(uniform) B.uniform(uniform, 0, 1, value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_IVEC2, value);
 }
 
 void _r_uniform_ivec2_vec(const char *uniform, ivec2_noalign value) {
@@ -836,7 +889,7 @@ void _r_uniform_ivec2_vec(const char *uniform, ivec2_noalign value) {
 
 void _r_uniform_ptr_ivec2_array(Uniform *uniform, uint offset, uint count, ivec2_noalign elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_IVEC2);
-	if(uniform && count) B.uniform(uniform, offset, count, elements);
+	if(uniform && count) B.uniform(uniform, offset, count, UNIFORM_IVEC2, elements);
 }
 
 void _r_uniform_ivec2_array(const char *uniform, uint offset, uint count, ivec2_noalign elements[count]) {
@@ -845,7 +898,7 @@ void _r_uniform_ivec2_array(const char *uniform, uint offset, uint count, ivec2_
 
 void _r_uniform_ptr_ivec3(Uniform *uniform, int x, int y, int z) {
 	ASSERT_UTYPE(uniform, UNIFORM_IVEC3);
-	if(uniform) B.uniform(uniform, 0, 1, (ivec3_noalign) { x, y, z });
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_IVEC3, (ivec3_noalign) { x, y, z });
 }
 
 void _r_uniform_ivec3(const char *uniform, int x, int y, int z) {
@@ -854,7 +907,7 @@ void _r_uniform_ivec3(const char *uniform, int x, int y, int z) {
 
 void _r_uniform_ptr_ivec3_vec(Uniform *uniform, ivec3_noalign value) {
 	ASSERT_UTYPE(uniform, UNIFORM_IVEC3);
-	if(uniform) B.uniform(uniform, 0, 1, value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_IVEC3, value);
 }
 
 void _r_uniform_ivec3_vec(const char *uniform, ivec3_noalign value) {
@@ -863,7 +916,7 @@ void _r_uniform_ivec3_vec(const char *uniform, ivec3_noalign value) {
 
 void _r_uniform_ptr_ivec3_array(Uniform *uniform, uint offset, uint count, ivec3_noalign elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_IVEC3);
-	if(uniform) B.uniform(uniform, offset, count, elements);
+	if(uniform) B.uniform(uniform, offset, count, UNIFORM_IVEC3, elements);
 }
 
 void _r_uniform_ivec3_array(const char *uniform, uint offset, uint count, ivec3_noalign elements[count]) {
@@ -872,7 +925,7 @@ void _r_uniform_ivec3_array(const char *uniform, uint offset, uint count, ivec3_
 
 void _r_uniform_ptr_ivec4(Uniform *uniform, int x, int y, int z, int w) {
 	ASSERT_UTYPE(uniform, UNIFORM_IVEC4);
-	if(uniform) B.uniform(uniform, 0, 1, (ivec4_noalign) { x, y, z, w });
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_IVEC4, (ivec4_noalign) { x, y, z, w });
 }
 
 void _r_uniform_ivec4(const char *uniform, int x, int y, int z, int w) {
@@ -881,7 +934,7 @@ void _r_uniform_ivec4(const char *uniform, int x, int y, int z, int w) {
 
 void _r_uniform_ptr_ivec4_vec(Uniform *uniform, ivec4_noalign value) {
 	ASSERT_UTYPE(uniform, UNIFORM_IVEC4);
-	if(uniform) B.uniform(uniform, 0, 1, value);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_IVEC4, value);
 }
 
 void _r_uniform_ivec4_vec(const char *uniform, ivec4_noalign value) {
@@ -890,7 +943,7 @@ void _r_uniform_ivec4_vec(const char *uniform, ivec4_noalign value) {
 
 void _r_uniform_ptr_ivec4_array(Uniform *uniform, uint offset, uint count, ivec4_noalign elements[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_IVEC4);
-	if(uniform) B.uniform(uniform, offset, count, elements);
+	if(uniform) B.uniform(uniform, offset, count, UNIFORM_IVEC4, elements);
 }
 
 void _r_uniform_ivec4_array(const char *uniform, uint offset, uint count, ivec4_noalign elements[count]) {
@@ -899,7 +952,7 @@ void _r_uniform_ivec4_array(const char *uniform, uint offset, uint count, ivec4_
 
 void _r_uniform_ptr_sampler_ptr(Uniform *uniform, Texture *tex) {
 	ASSERT_UTYPE(uniform, UNIFORM_SAMPLER);
-	if(uniform) B.uniform(uniform, 0, 1, &tex);
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_SAMPLER, &tex);
 }
 
 void _r_uniform_sampler_ptr(const char *uniform, Texture *tex) {
@@ -908,7 +961,7 @@ void _r_uniform_sampler_ptr(const char *uniform, Texture *tex) {
 
 void _r_uniform_ptr_sampler(Uniform *uniform, const char *tex) {
 	ASSERT_UTYPE(uniform, UNIFORM_SAMPLER);
-	if(uniform) B.uniform(uniform, 0, 1, (Texture*[]) { get_tex(tex) });
+	if(uniform) B.uniform(uniform, 0, 1, UNIFORM_SAMPLER, (Texture*[]) { get_tex(tex) });
 }
 
 void _r_uniform_sampler(const char *uniform, const char *tex) {
@@ -917,7 +970,7 @@ void _r_uniform_sampler(const char *uniform, const char *tex) {
 
 void _r_uniform_ptr_sampler_array_ptr(Uniform *uniform, uint offset, uint count, Texture *values[count]) {
 	ASSERT_UTYPE(uniform, UNIFORM_SAMPLER);
-	if(uniform && count) B.uniform(uniform, offset, count, values);
+	if(uniform && count) B.uniform(uniform, offset, count, UNIFORM_SAMPLER, values);
 }
 
 void _r_uniform_sampler_array_ptr(const char *uniform, uint offset, uint count, Texture *values[count]) {
@@ -934,7 +987,7 @@ void _r_uniform_ptr_sampler_array(Uniform *uniform, uint offset, uint count, con
 			*aptr++ = get_tex(*vptr++);
 		} while(aptr < aend);
 
-		B.uniform(uniform, 0, 1, arr);
+		B.uniform(uniform, 0, 1, UNIFORM_SAMPLER, arr);
 	}
 }
 
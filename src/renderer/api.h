@@ -36,6 +36,7 @@ typedef enum RendererFeature {
 	RFEAT_DEPTH_TEXTURE,
 	RFEAT_FRAMEBUFFER_MULTIPLE_OUTPUTS,
 	RFEAT_TEXTURE_BOTTOMLEFT_ORIGIN,
+	RFEAT_VERTEX_HALF_FLOAT,
 
 	NUM_RFEATS,
 } RendererFeature;
@@ -166,6 +167,7 @@ typedef enum VertexAttribType {
 	VA_USHORT,
 	VA_INT,
 	VA_UINT,
+	VA_HALF, // IEEE half precision float; requires RFEAT_VERTEX_HALF_FLOAT
 } VertexAttribType;
 
 typedef struct VertexAttribTypeInfo {
@@ -226,6 +228,12 @@ typedef struct UniformTypeInfo {
 
 typedef struct Uniform Uniform;
 
+typedef struct UniformHandle {
+	ShaderProgram *prog;
+	Uniform *uniform;
+	uint generation;
+} UniformHandle;
+
 typedef enum ClearBufferFlags {
 	CLEAR_COLOR = (1 << 0),
 	CLEAR_DEPTH = (1 << 1),
@@ -347,6 +355,21 @@ typedef enum VsyncMode {
 	VSYNC_ADAPTIVE,
 } VsyncMode;
 
+/*
+ * Per-frame statistics, as counted by the backend. The state counters are about
+ * calls made to the underlying API (e.g. OpenGL); "filtered" ones were dropped
+ * because they wouldn't have changed anything.
+ */
+typedef struct RendererFrameStats {
+	uint draws;
+	uint shader_switches;
+	uint texture_binds;
+	uint framebuffer_switches;
+	uint uniform_updates;
+	uint state_calls;
+	uint filtered_calls;
+} RendererFrameStats;
+
 typedef union ShaderCustomParams {
 	float vector[4];
 	Color color;
@@ -440,6 +463,7 @@ void r_shader_ptr(ShaderProgram *prog) attr_nonnull(1);
 ShaderProgram* r_shader_current(void) attr_returns_nonnull;
 
 Uniform* r_shader_uniform(ShaderProgram *prog, const char *uniform_name) attr_nonnull(1, 2);
+Uniform* r_shader_current_uniform_handle(UniformHandle *handle, const char *uniform_name) attr_nonnull(1, 2);
 UniformType r_uniform_type(Uniform *uniform);
 void r_uniform_ptr_unsafe(Uniform *uniform, uint offset, uint count, void *data);
 
@@ -637,6 +661,7 @@ void r_vertex_buffer_set_debug_label(VertexBuffer *vbuf, const char* label) attr
 void r_vertex_buffer_destroy(VertexBuffer *vbuf) attr_nonnull(1);
 void r_vertex_buffer_invalidate(VertexBuffer *vbuf) attr_nonnull(1);
 SDL_RWops* r_vertex_buffer_get_stream(VertexBuffer *vbuf) attr_nonnull(1);
+void* r_vertex_buffer_map(VertexBuffer *vbuf, size_t size) attr_nonnull(1);
 
 IndexBuffer* r_index_buffer_create(size_t max_elements);
 size_t r_index_buffer_get_capacity(IndexBuffer *ibuf) attr_nonnull(1);
@@ -664,6 +689,9 @@ VsyncMode r_vsync_current(void);
 
 void r_swap(SDL_Window *window);
 
+// Statistics of the last completed frame.
+void r_frame_stats(RendererFrameStats *stats) attr_nonnull(1);
+
 bool r_screenshot(Pixmap *dest) attr_nodiscard attr_nonnull(1);
 
 void r_mat_mode(MatrixMode mode);
@@ -730,10 +758,17 @@ void r_disable(RendererCapability cap) {
 }
 
 static inline attr_must_inline
-ShaderProgram* r_shader_get(const char *name) {
+ShaderProgram* _r_shader_get(const char *name) {
+	return get_resource_data(RES_SHADER_PROGRAM, name, RESF_DEFAULT | RESF_UNSAFE);
+}
+
+static inline attr_must_inline
+ShaderProgram* _r_shader_get_atom(ResourceAtom *name) {
 	return get_resource_data(RES_SHADER_PROGRAM, name, RESF_DEFAULT | RESF_UNSAFE);
 }
 
+#define r_shader_get(name) RES_NAME_GENERIC(name, _r_shader_get, _r_shader_get_atom)(name)
+
 static inline attr_must_inline
 ShaderProgram* r_shader_get_optional(const char *name) {
 	ShaderProgram *prog = get_resource_data(RES_SHADER_PROGRAM, name, RESF_OPTIONAL | RESF_UNSAFE);
@@ -746,10 +781,17 @@ ShaderProgram* r_shader_get_optional(const char *name) {
 }
 
 static inline attr_must_inline
-Texture* r_texture_get(const char *name) {
+Texture* _r_texture_get(const char *name) {
 	return get_resource_data(RES_TEXTURE, name, RESF_DEFAULT | RESF_UNSAFE);
 }
 
+static inline attr_must_inline
+Texture* _r_texture_get_atom(ResourceAtom *name) {
+	return get_resource_data(RES_TEXTURE, name, RESF_DEFAULT | RESF_UNSAFE);
+}
+
+#define r_texture_get(name) RES_NAME_GENERIC(name, _r_texture_get, _r_texture_get_atom)(name)
+
 static inline attr_must_inline
 void r_mat_translate(float x, float y, float z) {
 	r_mat_translate_v((vec3) { x, y, z });
@@ -786,15 +828,33 @@ void r_color3(float r, float g, float b) {
 }
 
 static inline attr_must_inline attr_nonnull(1)
-void r_shader(const char *prog) {
+void _r_shader(const char *prog) {
 	r_shader_ptr(r_shader_get(prog));
 }
 
+static inline attr_must_inline attr_nonnull(1)
+void _r_shader_atom(ResourceAtom *prog) {
+	r_shader_ptr(r_shader_get(prog));
+}
+
+#define r_shader(prog) RES_NAME_GENERIC(prog, _r_shader, _r_shader_atom)(prog)
+
 static inline attr_must_inline
 Uniform* r_shader_current_uniform(const char *name) {
 	return r_shader_uniform(r_shader_current(), name);
 }
 
+/*
+ * Like r_shader_current_uniform, but the lookup is cached per call site. It's
+ * only repeated when a different shader program is bound, or after any program
+ * has been destroyed. Use this in hot paths instead of passing a name string to
+ * the r_uniform_* functions.
+ */
+#define r_cached_uniform(name) (__extension__({ \
+	static UniformHandle _r_uniform_handle; \
+	r_shader_current_uniform_handle(&_r_uniform_handle, (name)); \
+}))
+
 static inline attr_must_inline
 void r_clear(ClearBufferFlags flags, const Color *colorval, float depthval) {
 	r_framebuffer_clear(r_framebuffer_current(), flags, colorval, depthval);
@@ -54,7 +54,7 @@ typedef struct RendererFuncs {
 	ShaderProgram* (*shader_current)(void);
 
 	Uniform* (*shader_uniform)(ShaderProgram *prog, const char *uniform_name);
-	void (*uniform)(Uniform *uniform, uint offset, uint count, const void *data);
+	void (*uniform)(Uniform *uniform, uint offset, uint count, UniformType type, const void *data);
 	UniformType (*uniform_type)(Uniform *uniform);
 
 	Texture* (*texture_create)(const TextureParams *params);
@@ -91,6 +91,20 @@ typedef struct RendererFuncs {
 	void (*vertex_buffer_invalidate)(VertexBuffer *vbuf);
 	SDL_RWops* (*vertex_buffer_get_stream)(VertexBuffer *vbuf);
 
+	// Returns where the next size bytes written to the stream would go, and moves the
+	// stream past them; or NULL if they can't be written in place. They must be filled
+	// in before the next draw, invalidation, or frame swap.
+	void* (*vertex_buffer_map)(VertexBuffer *vbuf, size_t size);
+
+	// For the command recorder (cmdbuf.c). vertex_buffer_share returns a persistent
+	// mapping of a streaming buffer's whole storage, or NULL if the backend can't
+	// provide one. Until vertex_buffer_unshare, the caller writes to the storage
+	// directly, places the stream window with vertex_buffer_set_window and fences
+	// the storage itself.
+	void* (*vertex_buffer_share)(VertexBuffer *vbuf, size_t *storage_size);
+	void (*vertex_buffer_set_window)(VertexBuffer *vbuf, size_t offset);
+	void (*vertex_buffer_unshare)(VertexBuffer *vbuf, size_t stream_offset);
+
 	IndexBuffer* (*index_buffer_create)(size_t max_elements);
 	size_t (*index_buffer_get_capacity)(IndexBuffer *ibuf);
 	const char* (*index_buffer_get_debug_label)(IndexBuffer *ibuf);
@@ -114,6 +128,13 @@ typedef struct RendererFuncs {
 	VsyncMode (*vsync_current)(void);
 
 	void (*swap)(SDL_Window *window);
+	void (*frame_stats)(RendererFrameStats *stats);
+
+	// GPU fences, signaled once all commands issued before them are complete.
+	// fence_wait returns false if that didn't happen within timeout_ns.
+	void* (*fence_create)(void);
+	bool (*fence_wait)(void *fence, uint64_t timeout_ns);
+	void (*fence_destroy)(void *fence);
 
 	bool (*screenshot)(Pixmap *dst);
 } RendererFuncs;
@@ -0,0 +1,1541 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include <stdatomic.h>
+
+#include "cmdbuf.h"
+#include "hashtable.h"
+#include "util.h"
+
+#define T (CB.target)
+
+#define RCMD_ALIGN 16
+#define RCMD_BLOCK_SIZE (1 << 16)
+
+// windows in shared vertex buffer storage start at multiples of this
+#define RCMD_STREAM_ALIGNMENT 64
+#define RCMD_STREAM_MAX_PARTITIONS 8
+
+typedef enum RCmdType {
+	RCMD_CAPABILITIES,
+	RCMD_COLOR,
+	RCMD_BLEND,
+	RCMD_CULL,
+	RCMD_DEPTH_FUNC,
+	RCMD_SHADER,
+	RCMD_UNIFORM,
+	RCMD_DRAW,
+	RCMD_DRAW_INDEXED,
+	RCMD_TEXTURE_SET_FILTER,
+	RCMD_TEXTURE_SET_WRAP,
+	RCMD_TEXTURE_INVALIDATE,
+	RCMD_FRAMEBUFFER,
+	RCMD_FRAMEBUFFER_VIEWPORT,
+	RCMD_FRAMEBUFFER_CLEAR,
+	RCMD_VERTEX_BUFFER_INVALIDATE,
+	RCMD_VERTEX_BUFFER_WRITE,
+	RCMD_VERTEX_BUFFER_WINDOW,
+	RCMD_VSYNC,
+	RCMD_SWAP,
+	RCMD_CALL,
+} RCmdType;
+
+/*
+ * Commands are packed back to back, each only as big as its own arguments plus
+ * any trailing data (uniform values, vertex data), rounded up to RCMD_ALIGN.
+ */
+typedef struct RCmd {
+	uint32_t type;
+	uint32_t size; // of the whole command, including trailing data
+
+	union {
+		r_capability_bits_t capabilities;
+		Color color;
+		BlendMode blend;
+		CullFaceMode cull;
+		DepthTestFunc depth_func;
+		ShaderProgram *shader;
+		Framebuffer *framebuffer;
+		VsyncMode vsync;
+		SDL_Window *window;
+		Texture *texture;
+		VertexBuffer *vbuf;
+
+		struct {
+			Uniform *uniform;
+			uint offset;
+			uint count;
+			UniformType type;
+		} uniform; // followed by the values
+
+		struct {
+			VertexArray *varr;
+			Primitive prim;
+			uint first;
+			uint count;
+			uint instances;
+			uint base_instance;
+		} draw;
+
+		struct {
+			Texture *tex;
+			uint modes[2]; // min/mag filter, or s/t wrap
+		} texture_modes;
+
+		struct {
+			Framebuffer *fb;
+			IntRect viewport;
+		} framebuffer_viewport;
+
+		struct {
+			Framebuffer *fb;
+			ClearBufferFlags flags;
+			Color color;
+			float depth;
+			bool has_color;
+		} framebuffer_clear;
+
+		struct {
+			VertexBuffer *vbuf;
+			size_t offset;
+			size_t size;
+		} vbuf_write; // followed by the data
+
+		struct {
+			struct RCmdStream *stream;
+			size_t base;
+			uint leaving; // partitions to fence
+		} vbuf_window;
+
+		struct {
+			void (*func)(void *arg);
+			void *arg;
+		} call;
+	};
+} RCmd;
+
+#define RCMD_FIXED_SIZE(member) (offsetof(RCmd, member) + sizeof(((RCmd*)NULL)->member))
+#define RCMD_DATA(cmd, member) ((char*)(cmd) + rcmd_align(RCMD_FIXED_SIZE(member)))
+#define RCMD_PUSH(type, member) rcmd_push(type, RCMD_FIXED_SIZE(member), 0)
+#define RCMD_PUSH_DATA(type, member, data_size) rcmd_push(type, RCMD_FIXED_SIZE(member), data_size)
+
+/*
+ * A command buffer is a chain of blocks. Resetting the buffer keeps all of them, so
+ * recording only allocates when a frame needs more space than any frame before it,
+ * and a recorded command never moves.
+ */
+typedef struct RCmdBlock {
+	struct RCmdBlock *next;
+	size_t size;
+	size_t capacity;
+} RCmdBlock;
+
+#define RCMD_BLOCK_DATA(block) ((char*)(block) + rcmd_align(sizeof(RCmdBlock)))
+
+typedef struct RCmdBuffer {
+	RCmdBlock *first;
+	RCmdBlock *current;
+	size_t size; // of all commands in the buffer
+	uint num_commands;
+} RCmdBuffer;
+
+/*
+ * Stands in for a vertex buffer's stream on the recording side. Keeps track of
+ * the write position, so that callers can still check how much space is left.
+ */
+typedef struct RCmdStream {
+	SDL_RWops rw; // must be first
+	VertexBuffer *vbuf;
+	size_t offset;
+	size_t size;
+
+	/*
+	 * If the backend shares the buffer's storage (see vertex_buffer_share), data is
+	 * written straight into it and only the window moves are recorded. The storage is
+	 * split into partitions of the window size. Those the window leaves are fenced when
+	 * the move is replayed, and can be written to again once the fence has signaled.
+	 *
+	 * As with the backend's own ring, data in the current window must not be overwritten
+	 * after a draw has used it.
+	 */
+	struct {
+		char *mapping;
+		size_t storage_size;
+		size_t base;
+		size_t head;
+		uint num_partitions;
+		uint busy_partitions; // covered by the recorded window
+		_Atomic uint free_partitions; // taken by the recording side, given back by the replay
+		void *fences[RCMD_STREAM_MAX_PARTITIONS]; // replay side only
+		bool tried;
+	} shared;
+} RCmdStream;
+
+static struct {
+	RendererBackend *backend;
+	RendererFuncs target;
+	RendererFuncs funcs;
+
+	RCmdBuffer buffers[2];
+	RCmdBuffer *recording;
+	RCmdBuffer *submitted;
+
+	bool threaded;
+	bool in_flight;
+	bool quit;
+	SDL_Thread *thread;
+	SDL_sem *submit_sem;
+	SDL_sem *done_sem;
+	SDL_Window *window;
+	SDL_GLContext context;
+
+	ht_int2int_t streams;
+
+	// streams with shared storage; only changed in synchronous calls, read by the replay
+	RCmdStream **shared_streams;
+	uint num_shared_streams;
+
+	// what the backend's state will be once everything recorded so far is replayed
+	struct {
+		r_capability_bits_t capabilities;
+		Color color;
+		BlendMode blend;
+		CullFaceMode cull;
+		DepthTestFunc depth_func;
+		ShaderProgram *shader;
+		Framebuffer *framebuffer;
+		VsyncMode vsync;
+	} shadow;
+
+	RCmdBufStats stats;
+
+	// the backend's stats of the last replayed frame; replayed_frame_stats is written by the replay
+	RendererFrameStats frame_stats;
+	RendererFrameStats replayed_frame_stats;
+} CB;
+
+static inline size_t rcmd_align(size_t size) {
+	return (size + RCMD_ALIGN - 1) & ~(size_t)(RCMD_ALIGN - 1);
+}
+
+static RCmdBlock* rcmd_block_alloc(size_t min_capacity) {
+	size_t capacity = max(min_capacity, RCMD_BLOCK_SIZE);
+	RCmdBlock *block = malloc(rcmd_align(sizeof(RCmdBlock)) + capacity);
+	block->next = NULL;
+	block->size = 0;
+	block->capacity = capacity;
+	return block;
+}
+
+static void rcmd_buffer_init(RCmdBuffer *buf) {
+	buf->first = buf->current = rcmd_block_alloc(RCMD_BLOCK_SIZE);
+	buf->size = 0;
+	buf->num_commands = 0;
+}
+
+static void rcmd_buffer_free(RCmdBuffer *buf) {
+	for(RCmdBlock *block = buf->first, *next; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+}
+
+static void* rcmd_push(RCmdType type, size_t fixed_size, size_t data_size) {
+	RCmdBuffer *buf = CB.recording;
+	RCmdBlock *block = buf->current;
+	size_t size = rcmd_align(fixed_size) + rcmd_align(data_size);
+
+	if(block->size + size > block->capacity) {
+		if(block->next == NULL || block->next->capacity < size) {
+			// The blocks are kept, so this stops happening after the first few frames.
+			RCmdBlock *new_block = rcmd_block_alloc(size);
+			new_block->next = block->next;
+			block->next = new_block;
+		}
+
+		block = buf->current = block->next;
+		block->size = 0;
+	}
+
+	RCmd *cmd = (RCmd*)(RCMD_BLOCK_DATA(block) + block->size);
+	cmd->type = type;
+	cmd->size = size;
+
+	block->size += size;
+	buf->size += size;
+	buf->num_commands++;
+
+	return cmd;
+}
+
+static void rcmd_refresh_shadow(void) {
+	CB.shadow.capabilities = T.capabilities_current();
+	CB.shadow.color = *T.color_current();
+	CB.shadow.blend = T.blend_current();
+	CB.shadow.cull = T.cull_current();
+	CB.shadow.depth_func = T.depth_func_current();
+	CB.shadow.shader = T.shader_current();
+	CB.shadow.framebuffer = T.framebuffer_current();
+	CB.shadow.vsync = T.vsync_current();
+}
+
+/*
+ * Shared vertex buffer storage, replay side
+ */
+
+static void rcmd_stream_replay_window(RCmdStream *s, size_t base, uint leaving) {
+	T.vertex_buffer_set_window(s->vbuf, base);
+
+	// the draws that read from these have been issued already
+	for(uint i = 0; i < s->shared.num_partitions; ++i) {
+		if(leaving & (1u << i)) {
+			assert(s->shared.fences[i] == NULL);
+			s->shared.fences[i] = T.fence_create();
+		}
+	}
+}
+
+static void rcmd_stream_reclaim(RCmdStream *s, uint partitions, bool wait) {
+	for(uint i = 0; i < s->shared.num_partitions; ++i) {
+		void *fence = s->shared.fences[i];
+
+		if(!(partitions & (1u << i)) || fence == NULL) {
+			continue;
+		}
+
+		if(wait) {
+			while(!T.fence_wait(fence, 1000000));
+		} else if(!T.fence_wait(fence, 0)) {
+			continue;
+		}
+
+		T.fence_destroy(fence);
+		s->shared.fences[i] = NULL;
+		atomic_fetch_or_explicit(&s->shared.free_partitions, 1u << i, memory_order_release);
+	}
+}
+
+static void rcmd_execute(RCmd *cmd) {
+	switch(cmd->type) {
+		case RCMD_CAPABILITIES:
+			T.capabilities(cmd->capabilities);
+			break;
+
+		case RCMD_COLOR:
+			T.color4(cmd->color.r, cmd->color.g, cmd->color.b, cmd->color.a);
+			break;
+
+		case RCMD_BLEND:
+			T.blend(cmd->blend);
+			break;
+
+		case RCMD_CULL:
+			T.cull(cmd->cull);
+			break;
+
+		case RCMD_DEPTH_FUNC:
+			T.depth_func(cmd->depth_func);
+			break;
+
+		case RCMD_SHADER:
+			T.shader(cmd->shader);
+			break;
+
+		case RCMD_UNIFORM:
+			T.uniform(
+				cmd->uniform.uniform,
+				cmd->uniform.offset,
+				cmd->uniform.count,
+				cmd->uniform.type,
+				RCMD_DATA(cmd, uniform)
+			);
+			break;
+
+		case RCMD_DRAW:
+			T.draw(
+				cmd->draw.varr,
+				cmd->draw.prim,
+				cmd->draw.first,
+				cmd->draw.count,
+				cmd->draw.instances,
+				cmd->draw.base_instance
+			);
+			break;
+
+		case RCMD_DRAW_INDEXED:
+			T.draw_indexed(
+				cmd->draw.varr,
+				cmd->draw.prim,
+				cmd->draw.first,
+				cmd->draw.count,
+				cmd->draw.instances,
+				cmd->draw.base_instance
+			);
+			break;
+
+		case RCMD_TEXTURE_SET_FILTER:
+			T.texture_set_filter(cmd->texture_modes.tex, cmd->texture_modes.modes[0], cmd->texture_modes.modes[1]);
+			break;
+
+		case RCMD_TEXTURE_SET_WRAP:
+			T.texture_set_wrap(cmd->texture_modes.tex, cmd->texture_modes.modes[0], cmd->texture_modes.modes[1]);
+			break;
+
+		case RCMD_TEXTURE_INVALIDATE:
+			T.texture_invalidate(cmd->texture);
+			break;
+
+		case RCMD_FRAMEBUFFER:
+			T.framebuffer(cmd->framebuffer);
+			break;
+
+		case RCMD_FRAMEBUFFER_VIEWPORT:
+			T.framebuffer_viewport(cmd->framebuffer_viewport.fb, cmd->framebuffer_viewport.viewport);
+			break;
+
+		case RCMD_FRAMEBUFFER_CLEAR:
+			T.framebuffer_clear(
+				cmd->framebuffer_clear.fb,
+				cmd->framebuffer_clear.flags,
+				cmd->framebuffer_clear.has_color ? &cmd->framebuffer_clear.color : NULL,
+				cmd->framebuffer_clear.depth
+			);
+			break;
+
+		case RCMD_VERTEX_BUFFER_INVALIDATE:
+			T.vertex_buffer_invalidate(cmd->vbuf);
+			break;
+
+		case RCMD_VERTEX_BUFFER_WRITE: {
+			SDL_RWops *stream = T.vertex_buffer_get_stream(cmd->vbuf_write.vbuf);
+			SDL_RWseek(stream, cmd->vbuf_write.offset, RW_SEEK_SET);
+			SDL_RWwrite(stream, RCMD_DATA(cmd, vbuf_write), cmd->vbuf_write.size, 1);
+			break;
+		}
+
+		case RCMD_VERTEX_BUFFER_WINDOW:
+			rcmd_stream_replay_window(cmd->vbuf_window.stream, cmd->vbuf_window.base, cmd->vbuf_window.leaving);
+			break;
+
+		case RCMD_VSYNC:
+			T.vsync(cmd->vsync);
+			break;
+
+		case RCMD_SWAP:
+			T.swap(cmd->window);
+			T.frame_stats(&CB.replayed_frame_stats);
+
+			for(uint i = 0; i < CB.num_shared_streams; ++i) {
+				rcmd_stream_reclaim(CB.shared_streams[i], ~0u, false);
+			}
+
+			break;
+
+		case RCMD_CALL:
+			/*
+			 * The caller is blocked until this returns, so the backend may call back
+			 * into the renderer API here (e.g. to create a temporary framebuffer).
+			 * Those calls must not be recorded; let them through.
+			 *
+			 * Other threads only ever use the functions that aren't overridden, and
+			 * those pointers are the same in both tables.
+			 */
+			CB.backend->funcs = CB.target;
+			cmd->call.func(cmd->call.arg);
+			CB.backend->funcs = CB.funcs;
+
+			// the call may have changed the current state (e.g. destroyed the current shader)
+			rcmd_refresh_shadow();
+			break;
+
+		default: UNREACHABLE;
+	}
+
+}
+
+static void rcmd_replay(RCmdBuffer *buf) {
+	for(RCmdBlock *block = buf->first;; block = block->next) {
+		for(size_t pos = 0; pos < block->size;) {
+			RCmd *cmd = (RCmd*)(RCMD_BLOCK_DATA(block) + pos);
+			rcmd_execute(cmd);
+			pos += cmd->size;
+		}
+
+		// blocks past the current one are left over from bigger frames
+		if(block == buf->current) {
+			break;
+		}
+	}
+}
+
+static int rcmd_thread(void *arg) {
+	if(CB.context) {
+		SDL_GL_MakeCurrent(CB.window, CB.context);
+	}
+
+	for(;;) {
+		SDL_SemWait(CB.submit_sem);
+
+		if(CB.quit) {
+			break;
+		}
+
+		rcmd_replay(CB.submitted);
+		SDL_SemPost(CB.done_sem);
+	}
+
+	if(CB.context) {
+		SDL_GL_MakeCurrent(CB.window, NULL);
+	}
+
+	return 0;
+}
+
+static void rcmd_wait(void) {
+	if(CB.in_flight) {
+		SDL_SemWait(CB.done_sem);
+		CB.in_flight = false;
+		CB.frame_stats = CB.replayed_frame_stats;
+	}
+}
+
+static void rcmd_reset(RCmdBuffer *buf) {
+	// the others are reset by rcmd_push as it moves on to them
+	buf->current = buf->first;
+	buf->first->size = 0;
+	buf->size = 0;
+	buf->num_commands = 0;
+}
+
+static void rcmd_submit(bool wait) {
+	RCmdBuffer *buf = CB.recording;
+
+	CB.stats.commands += buf->num_commands;
+	CB.stats.bytes += buf->size;
+
+	if(!CB.threaded) {
+		rcmd_replay(buf);
+		rcmd_reset(buf);
+		CB.frame_stats = CB.replayed_frame_stats;
+		return;
+	}
+
+	// At most one buffer is in flight; the other one is free to record into after this.
+	rcmd_wait();
+
+	CB.submitted = buf;
+	CB.in_flight = true;
+	SDL_SemPost(CB.submit_sem);
+
+	CB.recording = (buf == CB.buffers) ? CB.buffers + 1 : CB.buffers;
+	rcmd_reset(CB.recording);
+
+	if(wait) {
+		rcmd_wait();
+	}
+}
+
+static void rcmd_start_thread(void) {
+	CB.context = SDL_GL_GetCurrentContext();
+	CB.window = SDL_GL_GetCurrentWindow();
+
+	if(CB.context) {
+		// the render thread takes over the context
+		SDL_GL_MakeCurrent(CB.window, NULL);
+	}
+
+	CB.quit = false;
+	CB.thread = SDL_CreateThread(rcmd_thread, "render", NULL);
+
+	if(CB.thread == NULL) {
+		log_sdl_error("SDL_CreateThread");
+		log_warn("Replaying render commands on the main thread");
+
+		if(CB.context) {
+			SDL_GL_MakeCurrent(CB.window, CB.context);
+		}
+
+		CB.threaded = false;
+	}
+}
+
+static void rcmd_stop_thread(void) {
+	rcmd_submit(true);
+
+	CB.quit = true;
+	SDL_SemPost(CB.submit_sem);
+	SDL_WaitThread(CB.thread, NULL);
+	CB.thread = NULL;
+
+	if(CB.context) {
+		SDL_GL_MakeCurrent(CB.window, CB.context);
+	}
+}
+
+static void rcmd_sync(void (*func)(void *arg), void *arg) {
+	RCmd *cmd = RCMD_PUSH(RCMD_CALL, call);
+	cmd->call.func = func;
+	cmd->call.arg = arg;
+	CB.stats.syncs++;
+	rcmd_submit(true);
+}
+
+/*
+ * Recorded calls
+ */
+
+static void rcmd_capabilities(r_capability_bits_t capbits) {
+	RCmd *cmd = RCMD_PUSH(RCMD_CAPABILITIES, capabilities);
+	cmd->capabilities = CB.shadow.capabilities = capbits;
+}
+
+static r_capability_bits_t rcmd_capabilities_current(void) {
+	return CB.shadow.capabilities;
+}
+
+static void rcmd_color4(float r, float g, float b, float a) {
+	RCmd *cmd = RCMD_PUSH(RCMD_COLOR, color);
+	cmd->color = CB.shadow.color = (Color) { r, g, b, a };
+}
+
+static const Color* rcmd_color_current(void) {
+	return &CB.shadow.color;
+}
+
+static void rcmd_blend(BlendMode mode) {
+	RCmd *cmd = RCMD_PUSH(RCMD_BLEND, blend);
+	cmd->blend = CB.shadow.blend = mode;
+}
+
+static BlendMode rcmd_blend_current(void) {
+	return CB.shadow.blend;
+}
+
+static void rcmd_cull(CullFaceMode mode) {
+	RCmd *cmd = RCMD_PUSH(RCMD_CULL, cull);
+	cmd->cull = CB.shadow.cull = mode;
+}
+
+static CullFaceMode rcmd_cull_current(void) {
+	return CB.shadow.cull;
+}
+
+static void rcmd_depth_func(DepthTestFunc func) {
+	RCmd *cmd = RCMD_PUSH(RCMD_DEPTH_FUNC, depth_func);
+	cmd->depth_func = CB.shadow.depth_func = func;
+}
+
+static DepthTestFunc rcmd_depth_func_current(void) {
+	return CB.shadow.depth_func;
+}
+
+static void rcmd_shader(ShaderProgram *prog) {
+	RCmd *cmd = RCMD_PUSH(RCMD_SHADER, shader);
+	cmd->shader = CB.shadow.shader = prog;
+}
+
+static ShaderProgram* rcmd_shader_current(void) {
+	return CB.shadow.shader;
+}
+
+static void rcmd_uniform(Uniform *uniform, uint offset, uint count, UniformType type, const void *data) {
+	// the backend knows the type of a uniform from the moment it's created
+	UniformType data_type = (type == UNIFORM_UNKNOWN) ? T.uniform_type(uniform) : type;
+
+	if(data_type == UNIFORM_UNKNOWN) {
+		// no way to tell how big the data is; the backend would ignore this too
+		return;
+	}
+
+	const UniformTypeInfo *typeinfo = r_uniform_type_info(data_type);
+	size_t data_size = count * typeinfo->elements * typeinfo->element_size;
+
+	RCmd *cmd = RCMD_PUSH_DATA(RCMD_UNIFORM, uniform, data_size);
+	cmd->uniform.uniform = uniform;
+	cmd->uniform.offset = offset;
+	cmd->uniform.count = count;
+	cmd->uniform.type = type;
+	memcpy(RCMD_DATA(cmd, uniform), data, data_size);
+}
+
+static void rcmd_record_draw(RCmdType type, VertexArray *varr, Primitive prim, uint first, uint count, uint instances, uint base_instance) {
+	RCmd *cmd = RCMD_PUSH(type, draw);
+	cmd->draw.varr = varr;
+	cmd->draw.prim = prim;
+	cmd->draw.first = first;
+	cmd->draw.count = count;
+	cmd->draw.instances = instances;
+	cmd->draw.base_instance = base_instance;
+}
+
+static void rcmd_draw(VertexArray *varr, Primitive prim, uint firstvert, uint count, uint instances, uint base_instance) {
+	rcmd_record_draw(RCMD_DRAW, varr, prim, firstvert, count, instances, base_instance);
+}
+
+static void rcmd_draw_indexed(VertexArray *varr, Primitive prim, uint firstidx, uint count, uint instances, uint base_instance) {
+	rcmd_record_draw(RCMD_DRAW_INDEXED, varr, prim, firstidx, count, instances, base_instance);
+}
+
+static void rcmd_texture_set_filter(Texture *tex, TextureFilterMode fmin, TextureFilterMode fmag) {
+	RCmd *cmd = RCMD_PUSH(RCMD_TEXTURE_SET_FILTER, texture_modes);
+	cmd->texture_modes.tex = tex;
+	cmd->texture_modes.modes[0] = fmin;
+	cmd->texture_modes.modes[1] = fmag;
+}
+
+static void rcmd_texture_set_wrap(Texture *tex, TextureWrapMode ws, TextureWrapMode wt) {
+	RCmd *cmd = RCMD_PUSH(RCMD_TEXTURE_SET_WRAP, texture_modes);
+	cmd->texture_modes.tex = tex;
+	cmd->texture_modes.modes[0] = ws;
+	cmd->texture_modes.modes[1] = wt;
+}
+
+static void rcmd_texture_invalidate(Texture *tex) {
+	RCmd *cmd = RCMD_PUSH(RCMD_TEXTURE_INVALIDATE, texture);
+	cmd->texture = tex;
+}
+
+static void rcmd_framebuffer(Framebuffer *fb) {
+	RCmd *cmd = RCMD_PUSH(RCMD_FRAMEBUFFER, framebuffer);
+	cmd->framebuffer = CB.shadow.framebuffer = fb;
+}
+
+static Framebuffer* rcmd_framebuffer_current(void) {
+	return CB.shadow.framebuffer;
+}
+
+static void rcmd_framebuffer_viewport(Framebuffer *fb, IntRect vp) {
+	RCmd *cmd = RCMD_PUSH(RCMD_FRAMEBUFFER_VIEWPORT, framebuffer_viewport);
+	cmd->framebuffer_viewport.fb = fb;
+	cmd->framebuffer_viewport.viewport = vp;
+}
+
+static void rcmd_framebuffer_clear(Framebuffer *fb, ClearBufferFlags flags, const Color *colorval, float depthval) {
+	RCmd *cmd = RCMD_PUSH(RCMD_FRAMEBUFFER_CLEAR, framebuffer_clear);
+	cmd->framebuffer_clear.fb = fb;
+	cmd->framebuffer_clear.flags = flags;
+	cmd->framebuffer_clear.depth = depthval;
+	cmd->framebuffer_clear.has_color = colorval != NULL;
+
+	if(colorval != NULL) {
+		cmd->framebuffer_clear.color = *colorval;
+	}
+}
+
+static void rcmd_vsync(VsyncMode mode) {
+	RCmd *cmd = RCMD_PUSH(RCMD_VSYNC, vsync);
+	cmd->vsync = CB.shadow.vsync = mode;
+}
+
+static VsyncMode rcmd_vsync_current(void) {
+	return CB.shadow.vsync;
+}
+
+static void rcmd_swap(SDL_Window *window) {
+	RCmd *cmd = RCMD_PUSH(RCMD_SWAP, window);
+	cmd->window = window;
+	CB.stats.frames++;
+	rcmd_submit(false);
+}
+
+static void rcmd_frame_stats(RendererFrameStats *stats) {
+	// lags behind by up to one frame in threaded mode
+	*stats = CB.frame_stats;
+}
+
+/*
+ * Vertex buffer streams
+ */
+
+#define RCMD_STREAM(rw) ((RCmdStream*)(rw))
+
+static int64_t rcmd_stream_seek(SDL_RWops *rw, int64_t offset, int whence) {
+	RCmdStream *s = RCMD_STREAM(rw);
+
+	switch(whence) {
+		case RW_SEEK_CUR: s->offset += offset;          break;
+		case RW_SEEK_END: s->offset = s->size + offset; break;
+		case RW_SEEK_SET: s->offset = offset;           break;
+	}
+
+	assert(s->offset <= s->size);
+	return s->offset;
+}
+
+static int64_t rcmd_stream_size(SDL_RWops *rw) {
+	return RCMD_STREAM(rw)->size;
+}
+
+static char* rcmd_stream_map(RCmdStream *s, size_t size) {
+	assert(s->offset + size <= s->size);
+
+	char *dst;
+
+	if(s->shared.mapping != NULL) {
+		dst = s->shared.mapping + s->shared.base + s->offset;
+		s->shared.head = max(s->shared.head, s->shared.base + s->offset + size);
+	} else {
+		// recorded commands never move, so the data can be filled in after pushing
+		RCmd *cmd = RCMD_PUSH_DATA(RCMD_VERTEX_BUFFER_WRITE, vbuf_write, size);
+		cmd->vbuf_write.vbuf = s->vbuf;
+		cmd->vbuf_write.offset = s->offset;
+		cmd->vbuf_write.size = size;
+		dst = RCMD_DATA(cmd, vbuf_write);
+	}
+
+	s->offset += size;
+	return dst;
+}
+
+static size_t rcmd_stream_write(SDL_RWops *rw, const void *data, size_t size, size_t num) {
+	size_t total_size = size * num;
+
+	if(total_size > 0) {
+		memcpy(rcmd_stream_map(RCMD_STREAM(rw), total_size), data, total_size);
+	}
+
+	return num;
+}
+
+static size_t rcmd_stream_read(SDL_RWops *rw, void *data, size_t size, size_t num) {
+	SDL_SetError("Stream is write-only");
+	return 0;
+}
+
+static int rcmd_stream_close(SDL_RWops *rw) {
+	SDL_SetError("Can't close a vertex buffer stream");
+	return -1;
+}
+
+static RCmdStream* rcmd_stream_get(VertexBuffer *vbuf) {
+	return (RCmdStream*)(uintptr_t)ht_get(&CB.streams, (uintptr_t)vbuf, 0);
+}
+
+static SDL_RWops* rcmd_vertex_buffer_get_stream(VertexBuffer *vbuf) {
+	RCmdStream *s = rcmd_stream_get(vbuf);
+
+	if(s == NULL) {
+		s = calloc(1, sizeof(*s));
+		s->rw.type = SDL_RWOPS_UNKNOWN;
+		s->rw.seek = rcmd_stream_seek;
+		s->rw.size = rcmd_stream_size;
+		s->rw.write = rcmd_stream_write;
+		s->rw.read = rcmd_stream_read;
+		s->rw.close = rcmd_stream_close;
+		s->vbuf = vbuf;
+
+		// The size of a buffer never changes, and neither does its stream object.
+		SDL_RWops *real_stream = T.vertex_buffer_get_stream(vbuf);
+		s->size = SDL_RWsize(real_stream);
+		s->offset = SDL_RWtell(real_stream);
+
+		ht_set(&CB.streams, (uintptr_t)vbuf, (uintptr_t)s);
+	}
+
+	return &s->rw;
+}
+
+static void* rcmd_vertex_buffer_map(VertexBuffer *vbuf, size_t size) {
+	return rcmd_stream_map(RCMD_STREAM(rcmd_vertex_buffer_get_stream(vbuf)), size);
+}
+
+static uint rcmd_stream_window_partitions(RCmdStream *s, size_t base) {
+	uint first = base / s->size;
+	uint last = (base + s->size - 1) / s->size;
+	uint window = 0;
+
+	for(uint i = first; i <= last; ++i) {
+		window |= 1u << i;
+	}
+
+	return window;
+}
+
+typedef struct RCmdArgsReclaim {
+	RCmdStream *stream;
+	uint partitions;
+} RCmdArgsReclaim;
+
+static void call_stream_reclaim(void *a) {
+	RCmdArgsReclaim *args = a;
+	rcmd_stream_reclaim(args->stream, args->partitions, true);
+}
+
+static void rcmd_stream_move_window(RCmdStream *s) {
+	size_t base = (s->shared.head + RCMD_STREAM_ALIGNMENT - 1) & ~(size_t)(RCMD_STREAM_ALIGNMENT - 1);
+
+	if(base + s->size > s->shared.storage_size) {
+		base = 0;
+	}
+
+	uint window = rcmd_stream_window_partitions(s, base);
+	uint entering = window & ~s->shared.busy_partitions;
+	uint leaving = s->shared.busy_partitions & ~window;
+
+	if(entering & ~atomic_load_explicit(&s->shared.free_partitions, memory_order_acquire)) {
+		// The fences of these are only created once this frame is replayed; flush it
+		// and wait for the GPU on the render thread.
+		RCmdArgsReclaim args = { s, entering };
+		rcmd_sync(call_stream_reclaim, &args);
+		assert(!(entering & ~atomic_load_explicit(&s->shared.free_partitions, memory_order_acquire)));
+	}
+
+	atomic_fetch_and_explicit(&s->shared.free_partitions, ~entering, memory_order_relaxed);
+
+	RCmd *cmd = RCMD_PUSH(RCMD_VERTEX_BUFFER_WINDOW, vbuf_window);
+	cmd->vbuf_window.stream = s;
+	cmd->vbuf_window.base = base;
+	cmd->vbuf_window.leaving = leaving;
+
+	s->shared.busy_partitions = window;
+	s->shared.base = s->shared.head = base;
+}
+
+static void call_vertex_buffer_share(void *a) {
+	RCmdStream *s = a;
+	size_t storage_size = 0;
+	char *mapping = T.vertex_buffer_share(s->vbuf, &storage_size);
+
+	if(mapping == NULL) {
+		return;
+	}
+
+	uint num_partitions = storage_size / s->size;
+
+	if(num_partitions < 2 || num_partitions > RCMD_STREAM_MAX_PARTITIONS) {
+		T.vertex_buffer_unshare(s->vbuf, 0);
+		return;
+	}
+
+	s->shared.mapping = mapping;
+	s->shared.storage_size = storage_size;
+	s->shared.num_partitions = num_partitions;
+	s->shared.base = s->shared.head = 0;
+	s->shared.busy_partitions = rcmd_stream_window_partitions(s, 0);
+	atomic_init(&s->shared.free_partitions, ((1u << num_partitions) - 1) & ~s->shared.busy_partitions);
+
+	CB.shared_streams = realloc(CB.shared_streams, sizeof(*CB.shared_streams) * (CB.num_shared_streams + 1));
+	CB.shared_streams[CB.num_shared_streams++] = s;
+}
+
+// called by whichever thread replays the commands
+static void rcmd_stream_unshare(RCmdStream *s) {
+	rcmd_stream_reclaim(s, ~0u, true);
+	T.vertex_buffer_unshare(s->vbuf, s->offset);
+	s->shared.mapping = NULL;
+
+	for(uint i = 0; i < CB.num_shared_streams; ++i) {
+		if(CB.shared_streams[i] == s) {
+			CB.shared_streams[i] = CB.shared_streams[--CB.num_shared_streams];
+			break;
+		}
+	}
+}
+
+static void rcmd_vertex_buffer_invalidate(VertexBuffer *vbuf) {
+	RCmdStream *s = RCMD_STREAM(rcmd_vertex_buffer_get_stream(vbuf));
+
+	if(!s->shared.tried) {
+		// Buffers that are never invalidated aren't worth sharing.
+		s->shared.tried = true;
+		rcmd_sync(call_vertex_buffer_share, s);
+
+		if(s->shared.mapping != NULL) {
+			s->offset = 0;
+			return;
+		}
+	}
+
+	if(s->shared.mapping != NULL) {
+		rcmd_stream_move_window(s);
+	} else {
+		RCmd *cmd = RCMD_PUSH(RCMD_VERTEX_BUFFER_INVALIDATE, vbuf);
+		cmd->vbuf = vbuf;
+	}
+
+	s->offset = 0;
+}
+
+/*
+ * Synchronous calls
+ *
+ * These are executed by whichever thread replays the commands, after all the
+ * ones recorded before them.
+ */
+
+typedef struct RCmdArgsObject {
+	void *obj;
+	const char *label;
+	void *ret;
+} RCmdArgsObject;
+
+static void call_shader_object_compile(void *a) {
+	RCmdArgsObject *args = a;
+	args->ret = T.shader_object_compile(args->obj);
+}
+
+static ShaderObject* rcmd_shader_object_compile(ShaderSource *source) {
+	RCmdArgsObject args = { .obj = source };
+	rcmd_sync(call_shader_object_compile, &args);
+	return args.ret;
+}
+
+static void call_shader_object_destroy(void *a) {
+	T.shader_object_destroy(((RCmdArgsObject*)a)->obj);
+}
+
+static void rcmd_shader_object_destroy(ShaderObject *shobj) {
+	rcmd_sync(call_shader_object_destroy, &(RCmdArgsObject) { .obj = shobj });
+}
+
+static void call_shader_object_set_debug_label(void *a) {
+	RCmdArgsObject *args = a;
+	T.shader_object_set_debug_label(args->obj, args->label);
+}
+
+static void rcmd_shader_object_set_debug_label(ShaderObject *shobj, const char *label) {
+	rcmd_sync(call_shader_object_set_debug_label, &(RCmdArgsObject) { .obj = shobj, .label = label });
+}
+
+typedef struct RCmdArgsProgramLink {
+	uint num_objects;
+	ShaderObject **shobjs;
+	ShaderProgram *ret;
+} RCmdArgsProgramLink;
+
+static void call_shader_program_link(void *a) {
+	RCmdArgsProgramLink *args = a;
+	args->ret = T.shader_program_link(args->num_objects, args->shobjs);
+}
+
+static ShaderProgram* rcmd_shader_program_link(uint num_objects, ShaderObject *shobjs[num_objects]) {
+	RCmdArgsProgramLink args = { num_objects, shobjs };
+	rcmd_sync(call_shader_program_link, &args);
+	return args.ret;
+}
+
+static void call_shader_program_destroy(void *a) {
+	T.shader_program_destroy(((RCmdArgsObject*)a)->obj);
+}
+
+static void rcmd_shader_program_destroy(ShaderProgram *prog) {
+	rcmd_sync(call_shader_program_destroy, &(RCmdArgsObject) { .obj = prog });
+}
+
+static void call_shader_program_set_debug_label(void *a) {
+	RCmdArgsObject *args = a;
+	T.shader_program_set_debug_label(args->obj, args->label);
+}
+
+static void rcmd_shader_program_set_debug_label(ShaderProgram *prog, const char *label) {
+	rcmd_sync(call_shader_program_set_debug_label, &(RCmdArgsObject) { .obj = prog, .label = label });
+}
+
+static void call_texture_create(void *a) {
+	RCmdArgsObject *args = a;
+	args->ret = T.texture_create(args->obj);
+}
+
+static Texture* rcmd_texture_create(const TextureParams *params) {
+	RCmdArgsObject args = { .obj = (void*)params };
+	rcmd_sync(call_texture_create, &args);
+	return args.ret;
+}
+
+typedef struct RCmdArgsTextureParams {
+	Texture *tex;
+	TextureParams *params;
+} RCmdArgsTextureParams;
+
+static void call_texture_get_params(void *a) {
+	RCmdArgsTextureParams *args = a;
+	T.texture_get_params(args->tex, args->params);
+}
+
+static void rcmd_texture_get_params(Texture *tex, TextureParams *params) {
+	// synchronous because the filter and wrap modes may have pending changes
+	rcmd_sync(call_texture_get_params, &(RCmdArgsTextureParams) { tex, params });
+}
+
+static void call_texture_set_debug_label(void *a) {
+	RCmdArgsObject *args = a;
+	T.texture_set_debug_label(args->obj, args->label);
+}
+
+static void rcmd_texture_set_debug_label(Texture *tex, const char *label) {
+	rcmd_sync(call_texture_set_debug_label, &(RCmdArgsObject) { .obj = tex, .label = label });
+}
+
+static void call_texture_destroy(void *a) {
+	T.texture_destroy(((RCmdArgsObject*)a)->obj);
+}
+
+static void rcmd_texture_destroy(Texture *tex) {
+	rcmd_sync(call_texture_destroy, &(RCmdArgsObject) { .obj = tex });
+}
+
+typedef struct RCmdArgsTextureFill {
+	Texture *tex;
+	uint mipmap;
+	uint x, y;
+	const Pixmap *image_data;
+} RCmdArgsTextureFill;
+
+static void call_texture_fill(void *a) {
+	RCmdArgsTextureFill *args = a;
+	T.texture_fill(args->tex, args->mipmap, args->image_data);
+}
+
+static void rcmd_texture_fill(Texture *tex, uint mipmap, const Pixmap *image_data) {
+	rcmd_sync(call_texture_fill, &(RCmdArgsTextureFill) { tex, mipmap, 0, 0, image_data });
+}
+
+static void call_texture_fill_region(void *a) {
+	RCmdArgsTextureFill *args = a;
+	T.texture_fill_region(args->tex, args->mipmap, args->x, args->y, args->image_data);
+}
+
+static void rcmd_texture_fill_region(Texture *tex, uint mipmap, uint x, uint y, const Pixmap *image_data) {
+	rcmd_sync(call_texture_fill_region, &(RCmdArgsTextureFill) { tex, mipmap, x, y, image_data });
+}
+
+typedef struct RCmdArgsTextureClear {
+	Texture *tex;
+	const Color *clr;
+} RCmdArgsTextureClear;
+
+static void call_texture_clear(void *a) {
+	RCmdArgsTextureClear *args = a;
+	T.texture_clear(args->tex, args->clr);
+}
+
+static void rcmd_texture_clear(Texture *tex, const Color *clr) {
+	// the backends implement this with a temporary framebuffer
+	rcmd_sync(call_texture_clear, &(RCmdArgsTextureClear) { tex, clr });
+}
+
+static void call_framebuffer_create(void *a) {
+	((RCmdArgsObject*)a)->ret = T.framebuffer_create();
+}
+
+static Framebuffer* rcmd_framebuffer_create(void) {
+	RCmdArgsObject args = { 0 };
+	rcmd_sync(call_framebuffer_create, &args);
+	return args.ret;
+}
+
+static void call_framebuffer_set_debug_label(void *a) {
+	RCmdArgsObject *args = a;
+	T.framebuffer_set_debug_label(args->obj, args->label);
+}
+
+static void rcmd_framebuffer_set_debug_label(Framebuffer *fb, const char *label) {
+	rcmd_sync(call_framebuffer_set_debug_label, &(RCmdArgsObject) { .obj = fb, .label = label });
+}
+
+static void call_framebuffer_destroy(void *a) {
+	T.framebuffer_destroy(((RCmdArgsObject*)a)->obj);
+}
+
+static void rcmd_framebuffer_destroy(Framebuffer *fb) {
+	rcmd_sync(call_framebuffer_destroy, &(RCmdArgsObject) { .obj = fb });
+}
+
+typedef struct RCmdArgsFramebufferAttach {
+	Framebuffer *fb;
+	Texture *tex;
+	uint mipmap;
+	FramebufferAttachment attachment;
+} RCmdArgsFramebufferAttach;
+
+static void call_framebuffer_attach(void *a) {
+	RCmdArgsFramebufferAttach *args = a;
+	T.framebuffer_attach(args->fb, args->tex, args->mipmap, args->attachment);
+}
+
+static void rcmd_framebuffer_attach(Framebuffer *fb, Texture *tex, uint mipmap, FramebufferAttachment attachment) {
+	rcmd_sync(call_framebuffer_attach, &(RCmdArgsFramebufferAttach) { fb, tex, mipmap, attachment });
+}
+
+typedef struct RCmdArgsViewport {
+	Framebuffer *fb;
+	IntRect *vp;
+} RCmdArgsViewport;
+
+static void call_framebuffer_viewport_current(void *a) {
+	RCmdArgsViewport *args = a;
+	T.framebuffer_viewport_current(args->fb, args->vp);
+}
+
+static void rcmd_framebuffer_viewport_current(Framebuffer *fb, IntRect *vp) {
+	rcmd_sync(call_framebuffer_viewport_current, &(RCmdArgsViewport) { fb, vp });
+}
+
+typedef struct RCmdArgsBufferCreate {
+	size_t capacity;
+	void *data;
+	void *ret;
+} RCmdArgsBufferCreate;
+
+static void call_vertex_buffer_create(void *a) {
+	RCmdArgsBufferCreate *args = a;
+	args->ret = T.vertex_buffer_create(args->capacity, args->data);
+}
+
+static VertexBuffer* rcmd_vertex_buffer_create(size_t capacity, void *data) {
+	RCmdArgsBufferCreate args = { capacity, data };
+	rcmd_sync(call_vertex_buffer_create, &args);
+	return args.ret;
+}
+
+static void call_vertex_buffer_set_debug_label(void *a) {
+	RCmdArgsObject *args = a;
+	T.vertex_buffer_set_debug_label(args->obj, args->label);
+}
+
+static void rcmd_vertex_buffer_set_debug_label(VertexBuffer *vbuf, const char *label) {
+	rcmd_sync(call_vertex_buffer_set_debug_label, &(RCmdArgsObject) { .obj = vbuf, .label = label });
+}
+
+static void call_vertex_buffer_destroy(void *a) {
+	VertexBuffer *vbuf = ((RCmdArgsObject*)a)->obj;
+
+	for(uint i = 0; i < CB.num_shared_streams; ++i) {
+		if(CB.shared_streams[i]->vbuf == vbuf) {
+			rcmd_stream_unshare(CB.shared_streams[i]);
+			break;
+		}
+	}
+
+	T.vertex_buffer_destroy(vbuf);
+}
+
+static void rcmd_vertex_buffer_destroy(VertexBuffer *vbuf) {
+	RCmdStream *s = rcmd_stream_get(vbuf);
+
+	if(s != NULL) {
+		ht_unset(&CB.streams, (uintptr_t)vbuf);
+	}
+
+	// the replay may still need the stream until then
+	rcmd_sync(call_vertex_buffer_destroy, &(RCmdArgsObject) { .obj = vbuf });
+	free(s);
+}
+
+static void call_index_buffer_create(void *a) {
+	RCmdArgsBufferCreate *args = a;
+	args->ret = T.index_buffer_create(args->capacity);
+}
+
+static IndexBuffer* rcmd_index_buffer_create(size_t max_elements) {
+	RCmdArgsBufferCreate args = { max_elements };
+	rcmd_sync(call_index_buffer_create, &args);
+	return args.ret;
+}
+
+static void call_index_buffer_set_debug_label(void *a) {
+	RCmdArgsObject *args = a;
+	T.index_buffer_set_debug_label(args->obj, args->label);
+}
+
+static void rcmd_index_buffer_set_debug_label(IndexBuffer *ibuf, const char *label) {
+	rcmd_sync(call_index_buffer_set_debug_label, &(RCmdArgsObject) { .obj = ibuf, .label = label });
+}
+
+typedef struct RCmdArgsIndices {
+	IndexBuffer *ibuf;
+	size_t offset;
+	uint index_ofs;
+	uint *indices;
+} RCmdArgsIndices;
+
+static void call_index_buffer_set_offset(void *a) {
+	RCmdArgsIndices *args = a;
+	T.index_buffer_set_offset(args->ibuf, args->offset);
+}
+
+static void rcmd_index_buffer_set_offset(IndexBuffer *ibuf, size_t offset) {
+	rcmd_sync(call_index_buffer_set_offset, &(RCmdArgsIndices) { .ibuf = ibuf, .offset = offset });
+}
+
+static void call_index_buffer_get_offset(void *a) {
+	RCmdArgsIndices *args = a;
+	args->offset = T.index_buffer_get_offset(args->ibuf);
+}
+
+static size_t rcmd_index_buffer_get_offset(IndexBuffer *ibuf) {
+	RCmdArgsIndices args = { .ibuf = ibuf };
+	rcmd_sync(call_index_buffer_get_offset, &args);
+	return args.offset;
+}
+
+static void call_index_buffer_add_indices(void *a) {
+	RCmdArgsIndices *args = a;
+	T.index_buffer_add_indices(args->ibuf, args->index_ofs, args->offset, args->indices);
+}
+
+static void rcmd_index_buffer_add_indices(IndexBuffer *ibuf, uint index_ofs, size_t num_indices, uint indices[num_indices]) {
+	rcmd_sync(call_index_buffer_add_indices, &(RCmdArgsIndices) {
+		.ibuf = ibuf,
+		.offset = num_indices,
+		.index_ofs = index_ofs,
+		.indices = indices,
+	});
+}
+
+static void call_index_buffer_destroy(void *a) {
+	T.index_buffer_destroy(((RCmdArgsObject*)a)->obj);
+}
+
+static void rcmd_index_buffer_destroy(IndexBuffer *ibuf) {
+	rcmd_sync(call_index_buffer_destroy, &(RCmdArgsObject) { .obj = ibuf });
+}
+
+static void call_vertex_array_create(void *a) {
+	((RCmdArgsObject*)a)->ret = T.vertex_array_create();
+}
+
+static VertexArray* rcmd_vertex_array_create(void) {
+	RCmdArgsObject args = { 0 };
+	rcmd_sync(call_vertex_array_create, &args);
+	return args.ret;
+}
+
+static void call_vertex_array_set_debug_label(void *a) {
+	RCmdArgsObject *args = a;
+	T.vertex_array_set_debug_label(args->obj, args->label);
+}
+
+static void rcmd_vertex_array_set_debug_label(VertexArray *varr, const char *label) {
+	rcmd_sync(call_vertex_array_set_debug_label, &(RCmdArgsObject) { .obj = varr, .label = label });
+}
+
+static void call_vertex_array_destroy(void *a) {
+	T.vertex_array_destroy(((RCmdArgsObject*)a)->obj);
+}
+
+static void rcmd_vertex_array_destroy(VertexArray *varr) {
+	rcmd_sync(call_vertex_array_destroy, &(RCmdArgsObject) { .obj = varr });
+}
+
+typedef struct RCmdArgsVertexArray {
+	VertexArray *varr;
+	void *obj;
+	uint num;
+	VertexAttribFormat *attribs;
+} RCmdArgsVertexArray;
+
+static void call_vertex_array_layout(void *a) {
+	RCmdArgsVertexArray *args = a;
+	T.vertex_array_layout(args->varr, args->num, args->attribs);
+}
+
+static void rcmd_vertex_array_layout(VertexArray *varr, uint nattribs, VertexAttribFormat attribs[nattribs]) {
+	rcmd_sync(call_vertex_array_layout, &(RCmdArgsVertexArray) { .varr = varr, .num = nattribs, .attribs = attribs });
+}
+
+static void call_vertex_array_attach_vertex_buffer(void *a) {
+	RCmdArgsVertexArray *args = a;
+	T.vertex_array_attach_vertex_buffer(args->varr, args->obj, args->num);
+}
+
+static void rcmd_vertex_array_attach_vertex_buffer(VertexArray *varr, VertexBuffer *vbuf, uint attachment) {
+	rcmd_sync(call_vertex_array_attach_vertex_buffer, &(RCmdArgsVertexArray) { .varr = varr, .obj = vbuf, .num = attachment });
+}
+
+static void call_vertex_array_attach_index_buffer(void *a) {
+	RCmdArgsVertexArray *args = a;
+	T.vertex_array_attach_index_buffer(args->varr, args->obj);
+}
+
+static void rcmd_vertex_array_attach_index_buffer(VertexArray *varr, IndexBuffer *ibuf) {
+	rcmd_sync(call_vertex_array_attach_index_buffer, &(RCmdArgsVertexArray) { .varr = varr, .obj = ibuf });
+}
+
+typedef struct RCmdArgsScreenshot {
+	Pixmap *dst;
+	bool ret;
+} RCmdArgsScreenshot;
+
+static void call_screenshot(void *a) {
+	RCmdArgsScreenshot *args = a;
+	args->ret = T.screenshot(args->dst);
+}
+
+static bool rcmd_screenshot(Pixmap *dst) {
+	RCmdArgsScreenshot args = { dst };
+	rcmd_sync(call_screenshot, &args);
+	return args.ret;
+}
+
+static SDL_Window* rcmd_create_window(const char *title, int x, int y, int w, int h, uint32_t flags) {
+	SDL_Window *window;
+
+	if(CB.threaded) {
+		// Windows should be created on the main thread, so take the context back for this.
+		rcmd_stop_thread();
+		window = T.create_window(title, x, y, w, h, flags);
+		rcmd_start_thread();
+	} else {
+		rcmd_submit(true);
+		window = T.create_window(title, x, y, w, h, flags);
+	}
+
+	return window;
+}
+
+/*
+ * Public interface
+ */
+
+void _r_cmdbuf_install(RendererBackend *backend, bool threaded) {
+	assert(CB.backend == NULL);
+
+	CB.backend = backend;
+	CB.target = backend->funcs;
+
+	for(uint i = 0; i < sizeof(CB.buffers)/sizeof(*CB.buffers); ++i) {
+		rcmd_buffer_init(CB.buffers + i);
+	}
+
+	CB.recording = CB.buffers;
+	ht_create(&CB.streams);
+	rcmd_refresh_shadow();
+
+	RendererFuncs *f = &backend->funcs;
+
+	f->create_window = rcmd_create_window;
+	f->capabilities = rcmd_capabilities;
+	f->capabilities_current = rcmd_capabilities_current;
+	f->draw = rcmd_draw;
+	f->draw_indexed = rcmd_draw_indexed;
+	f->color4 = rcmd_color4;
+	f->color_current = rcmd_color_current;
+	f->blend = rcmd_blend;
+	f->blend_current = rcmd_blend_current;
+	f->cull = rcmd_cull;
+	f->cull_current = rcmd_cull_current;
+	f->depth_func = rcmd_depth_func;
+	f->depth_func_current = rcmd_depth_func_current;
+	f->shader_object_compile = rcmd_shader_object_compile;
+	f->shader_object_destroy = rcmd_shader_object_destroy;
+	f->shader_object_set_debug_label = rcmd_shader_object_set_debug_label;
+	f->shader_program_link = rcmd_shader_program_link;
+	f->shader_program_destroy = rcmd_shader_program_destroy;
+	f->shader_program_set_debug_label = rcmd_shader_program_set_debug_label;
+	f->shader = rcmd_shader;
+	f->shader_current = rcmd_shader_current;
+	f->uniform = rcmd_uniform;
+	f->texture_create = rcmd_texture_create;
+	f->texture_get_params = rcmd_texture_get_params;
+	f->texture_set_debug_label = rcmd_texture_set_debug_label;
+	f->texture_set_filter = rcmd_texture_set_filter;
+	f->texture_set_wrap = rcmd_texture_set_wrap;
+	f->texture_destroy = rcmd_texture_destroy;
+	f->texture_invalidate = rcmd_texture_invalidate;
+	f->texture_fill = rcmd_texture_fill;
+	f->texture_fill_region = rcmd_texture_fill_region;
+	f->texture_clear = rcmd_texture_clear;
+	f->framebuffer_create = rcmd_framebuffer_create;
+	f->framebuffer_set_debug_label = rcmd_framebuffer_set_debug_label;
+	f->framebuffer_destroy = rcmd_framebuffer_destroy;
+	f->framebuffer_attach = rcmd_framebuffer_attach;
+	f->framebuffer_viewport = rcmd_framebuffer_viewport;
+	f->framebuffer_viewport_current = rcmd_framebuffer_viewport_current;
+	f->framebuffer_clear = rcmd_framebuffer_clear;
+	f->framebuffer = rcmd_framebuffer;
+	f->framebuffer_current = rcmd_framebuffer_current;
+	f->vertex_buffer_create = rcmd_vertex_buffer_create;
+	f->vertex_buffer_set_debug_label = rcmd_vertex_buffer_set_debug_label;
+	f->vertex_buffer_destroy = rcmd_vertex_buffer_destroy;
+	f->vertex_buffer_invalidate = rcmd_vertex_buffer_invalidate;
+	f->vertex_buffer_get_stream = rcmd_vertex_buffer_get_stream;
+	f->vertex_buffer_map = rcmd_vertex_buffer_map;
+	f->index_buffer_create = rcmd_index_buffer_create;
+	f->index_buffer_set_debug_label = rcmd_index_buffer_set_debug_label;
+	f->index_buffer_set_offset = rcmd_index_buffer_set_offset;
+	f->index_buffer_get_offset = rcmd_index_buffer_get_offset;
+	f->index_buffer_add_indices = rcmd_index_buffer_add_indices;
+	f->index_buffer_destroy = rcmd_index_buffer_destroy;
+	f->vertex_array_create = rcmd_vertex_array_create;
+	f->vertex_array_set_debug_label = rcmd_vertex_array_set_debug_label;
+	f->vertex_array_destroy = rcmd_vertex_array_destroy;
+	f->vertex_array_layout = rcmd_vertex_array_layout;
+	f->vertex_array_attach_vertex_buffer = rcmd_vertex_array_attach_vertex_buffer;
+	f->vertex_array_attach_index_buffer = rcmd_vertex_array_attach_index_buffer;
+	f->vsync = rcmd_vsync;
+	f->vsync_current = rcmd_vsync_current;
+	f->swap = rcmd_swap;
+	f->frame_stats = rcmd_frame_stats;
+	f->screenshot = rcmd_screenshot;
+
+	CB.funcs = *f;
+
+	if(threaded) {
+		CB.submit_sem = SDL_CreateSemaphore(0);
+		CB.done_sem = SDL_CreateSemaphore(0);
+		CB.threaded = true;
+		rcmd_start_thread();
+	}
+
+	log_info("Recording render commands, replaying them on the %s thread", CB.threaded ? "render" : "main");
+}
+
+static void* rcmd_free_stream(int64_t key, int64_t value, void *arg) {
+	free((void*)(uintptr_t)value);
+	return NULL;
+}
+
+void _r_cmdbuf_uninstall(RendererBackend *backend) {
+	assert(CB.backend == backend);
+
+	if(CB.threaded) {
+		rcmd_stop_thread();
+	} else {
+		rcmd_submit(true);
+	}
+
+	// these also exist if starting the thread failed
+	SDL_DestroySemaphore(CB.submit_sem);
+	SDL_DestroySemaphore(CB.done_sem);
+
+	// the context is back on this thread
+	while(CB.num_shared_streams > 0) {
+		rcmd_stream_unshare(CB.shared_streams[CB.num_shared_streams - 1]);
+	}
+
+	free(CB.shared_streams);
+
+	backend->funcs = CB.target;
+
+	for(uint i = 0; i < sizeof(CB.buffers)/sizeof(*CB.buffers); ++i) {
+		rcmd_buffer_free(CB.buffers + i);
+	}
+
+	ht_foreach(&CB.streams, rcmd_free_stream, NULL);
+	ht_destroy(&CB.streams);
+
+	log_debug("%"PRIu64" frames, %"PRIu64" commands (%"PRIu64" KiB), %"PRIu64" synchronous calls",
+		CB.stats.frames,
+		CB.stats.commands,
+		CB.stats.bytes / 1024,
+		CB.stats.syncs
+	);
+
+	memset(&CB, 0, sizeof(CB));
+}
+
+bool _r_cmdbuf_installed(void) {
+	return CB.backend != NULL;
+}
+
+void _r_cmdbuf_get_stats(RCmdBufStats *stats) {
+	*stats = CB.stats;
+}
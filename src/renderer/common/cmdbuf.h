@@ -0,0 +1,48 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "backend.h"
+
+/*
+ * Command recording layer between the renderer API and a backend.
+ *
+ * When installed, it replaces the backend's function table. Calls that only
+ * change state, set uniforms, draw, or write to vertex buffers are appended to
+ * a command buffer instead of being executed. The buffer is replayed against
+ * the real backend when a frame is swapped. Everything else (object creation,
+ * texture uploads, screenshots...) is synchronous: the recorded commands are
+ * replayed first, then the call itself.
+ *
+ * If the backend can share a streamed vertex buffer's storage, vertex data is
+ * written straight into it while recording, and only the moves of the buffer's
+ * window are recorded. Otherwise, the data is copied into the command buffer.
+ *
+ * In threaded mode, the replay happens on a dedicated render thread that owns
+ * the GL context. There are two command buffers: one is recorded while the
+ * other one is replayed, so submitting a frame overlaps with the logic and
+ * recording of the next one.
+ *
+ * Getters for functions that are safe to call concurrently with the replay
+ * (because they only read data that recorded commands never modify) go to the
+ * backend directly. The current state (blend mode, shader, etc.) is shadowed.
+ */
+
+typedef struct RCmdBufStats {
+	uint64_t frames;
+	uint64_t commands;
+	uint64_t bytes;
+	uint64_t syncs;
+} RCmdBufStats;
+
+void _r_cmdbuf_install(RendererBackend *backend, bool threaded);
+void _r_cmdbuf_uninstall(RendererBackend *backend);
+bool _r_cmdbuf_installed(void);
+void _r_cmdbuf_get_stats(RCmdBufStats *stats);
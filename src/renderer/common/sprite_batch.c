@@ -13,6 +13,9 @@
 #include "util/glm.h"
 #include "resource/sprite.h"
 #include "resource/model.h"
+#include "resource/shader_program.h"
+#include "taskmanager.h"
+#include "util.h"
 
 typedef struct SpriteAttribs {
 	mat4 transform;
@@ -28,11 +31,94 @@ typedef struct SpriteAttribs {
 
 #define SIZEOF_SPRITE_ATTRIBS (offsetof(SpriteAttribs, end_of_fields))
 
-static struct SpriteBatchState {
+/*
+ * Used instead of SpriteAttribs when the modelview transform is a 2D affine one
+ * and the texture matrix is the identity, which is true for most sprites. Needs
+ * a shader variant compiled with SPRITE_COMPACT (see interface/sprite.glslh).
+ */
+typedef struct SpriteAttribsCompact {
+	float affine[2][3];  // first two rows of the modelview matrix, without the z column
+	uint16_t rgba[4];    // half floats, so that colors above 1.0 still work
+	uint16_t texrect[4]; // normalized corners: x0, y0, x1, y1 (swapped when flipped)
+	uint16_t sprite_size[2]; // half floats
+	uint16_t page;       // index into the batch's texture pages
+	uint16_t padding;
+	float custom[4];
+
+	char end_of_fields;
+} SpriteAttribsCompact;
+
+#define SIZEOF_SPRITE_ATTRIBS_COMPACT (offsetof(SpriteAttribsCompact, end_of_fields))
+
+/*
+ * The compact layout can sample from up to this many textures in one draw call;
+ * see spriteTexture in interface/sprite.glslh. Sprites from different atlas
+ * pages can then share a batch instead of forcing a flush on every switch.
+ */
+#define SPRITE_BATCH_MAX_PAGES 4
+
+typedef enum SpriteLayout {
+	SPRITE_LAYOUT_FULL,
+	SPRITE_LAYOUT_COMPACT,
+	NUM_SPRITE_LAYOUTS,
+} SpriteLayout;
+
+typedef struct SpriteLayoutState {
 	VertexArray *varr;
 	VertexBuffer *vbuf;
 	uint base_instance;
-	Texture *primary_texture;
+	size_t attribs_size;
+	Model quad;
+} SpriteLayoutState;
+
+/*
+ * Sprites are not expanded into SpriteAttribs as they are submitted. Instead,
+ * r_draw_sprite appends one of these compact records, and the expensive part
+ * (matrix math, texrect normalization) is done for the whole batch at flush
+ * time, split across the TaskManager workers if the batch is big enough.
+ *
+ * The matrices are stored separately and referenced by index, because most
+ * consecutive sprites share the same ones.
+ */
+typedef struct SpriteDrawRecord {
+	Sprite *sprite;
+	float pos[2];
+	float scale[2];
+	float rotation_angle;
+	vec3 rotation_vector;
+	float rgba[4];
+	float custom[4];
+	uint32_t modelview;
+	uint32_t tex_transform;
+	uint8_t page;
+	bool flip_x;
+	bool flip_y;
+} SpriteDrawRecord;
+
+typedef struct SpriteMatrixTable {
+	mat4 *matrices;
+	uint num_matrices;
+	uint capacity;
+} SpriteMatrixTable;
+
+typedef struct SpriteExpandJob {
+	uint begin;
+	uint end;
+	float tex_size[SPRITE_BATCH_MAX_PAGES][2];
+	SpriteLayout layout;
+	char *dst;
+} SpriteExpandJob;
+
+// Don't bother the workers with less than this many sprites each.
+#define SPRITE_BATCH_MIN_SPRITES_PER_JOB 256
+#define SPRITE_BATCH_MAX_JOBS 8
+
+static struct SpriteBatchState {
+	SpriteLayoutState layouts[NUM_SPRITE_LAYOUTS];
+	SpriteLayout layout;
+	Texture *pages[SPRITE_BATCH_MAX_PAGES]; // pages[0] is the primary texture
+	uint num_pages;
+	uint max_pages;
 	Texture *aux_textures[R_NUM_SPRITE_AUX_TEXTURES];
 	ShaderProgram *shader;
 	BlendMode blend;
@@ -45,16 +131,57 @@ static struct SpriteBatchState {
 	uint depth_write_enabled : 1;
 	uint num_pending;
 
-	Model quad;
+	SpriteDrawRecord *records;
+	char *staging; // expanded attributes, attribs_size of the current layout apart
+	uint records_capacity;
+	SpriteMatrixTable modelview_matrices;
+	SpriteMatrixTable tex_matrices;
+	uint max_jobs;
+	bool compact_enabled;
+
+	// the last compact variant lookup; reset every frame, since shaders may be reloaded
+	struct {
+		ShaderProgram *prog;
+		ShaderProgram *variant;
+	} compact_cache;
 
 	struct {
 		uint flushes;
 		uint sprites;
 		uint best_batch;
 		uint worst_batch;
+		size_t bytes;
 	} frame_stats;
 } _r_sprite_batch;
 
+static void sprite_layout_init(SpriteLayoutState *l, size_t attribs_size, uint num_attribs, VertexAttribFormat attribs[num_attribs], const char *vbuf_label, const char *varr_label) {
+	uint capacity;
+
+	if(r_supports(RFEAT_DRAW_INSTANCED_BASE_INSTANCE)) {
+		capacity = 1 << 15;
+	} else {
+		capacity = 1 << 11;
+	}
+
+	l->attribs_size = attribs_size;
+
+	l->vbuf = r_vertex_buffer_create(attribs_size * capacity, NULL);
+	r_vertex_buffer_set_debug_label(l->vbuf, vbuf_label);
+	r_vertex_buffer_invalidate(l->vbuf);
+
+	l->varr = r_vertex_array_create();
+	r_vertex_array_set_debug_label(l->varr, varr_label);
+	r_vertex_array_layout(l->varr, num_attribs, attribs);
+	r_vertex_array_attach_vertex_buffer(l->varr, r_vertex_buffer_static_models(), 0);
+	r_vertex_array_attach_vertex_buffer(l->varr, l->vbuf, 1);
+
+	l->quad.indexed = false;
+	l->quad.num_vertices = 4;
+	l->quad.offset = 0;
+	l->quad.primitive = PRIM_TRIANGLE_STRIP;
+	l->quad.vertex_array = l->varr;
+}
+
 void _r_sprite_batch_init(void) {
 	#ifdef DEBUG
 	preload_resource(RES_FONT, "monotiny", RESF_PERMANENT);
@@ -62,9 +189,11 @@ void _r_sprite_batch_init(void) {
 
 	size_t sz_vert = sizeof(GenericModelVertex);
 	size_t sz_attr = SIZEOF_SPRITE_ATTRIBS;
+	size_t sz_attr_compact = SIZEOF_SPRITE_ATTRIBS_COMPACT;
 
 	#define VERTEX_OFS(attr)   offsetof(GenericModelVertex,  attr)
 	#define INSTANCE_OFS(attr) offsetof(SpriteAttribs, attr)
+	#define COMPACT_OFS(attr)  offsetof(SpriteAttribsCompact, attr)
 
 	VertexAttribFormat fmt[] = {
 		// Per-vertex attributes (for the static models buffer, bound at 0)
@@ -87,37 +216,250 @@ void _r_sprite_batch_init(void) {
 		{ { 4, VA_FLOAT, VA_CONVERT_FLOAT, 1 }, sz_attr, INSTANCE_OFS(custom),           1 },
 	};
 
+	VertexAttribFormat fmt_compact[] = {
+		// Per-vertex attributes (for the static models buffer, bound at 0)
+		{ { 3, VA_FLOAT,  VA_CONVERT_FLOAT, 0 }, sz_vert, VERTEX_OFS(position), 0 },
+		{ { 3, VA_FLOAT,  VA_CONVERT_FLOAT, 0 }, sz_vert, VERTEX_OFS(normal),   0 },
+		{ { 2, VA_FLOAT,  VA_CONVERT_FLOAT, 0 }, sz_vert, VERTEX_OFS(uv),       0 },
+
+		// Per-instance attributes (for our own sprites buffer, bound at 1)
+		{ { 3, VA_FLOAT,  VA_CONVERT_FLOAT,            1 }, sz_attr_compact, COMPACT_OFS(affine[0]),   1 },
+		{ { 3, VA_FLOAT,  VA_CONVERT_FLOAT,            1 }, sz_attr_compact, COMPACT_OFS(affine[1]),   1 },
+		{ { 4, VA_HALF,   VA_CONVERT_FLOAT,            1 }, sz_attr_compact, COMPACT_OFS(rgba),        1 },
+		{ { 4, VA_USHORT, VA_CONVERT_FLOAT_NORMALIZED, 1 }, sz_attr_compact, COMPACT_OFS(texrect),     1 },
+		{ { 2, VA_HALF,   VA_CONVERT_FLOAT,            1 }, sz_attr_compact, COMPACT_OFS(sprite_size), 1 },
+		{ { 4, VA_FLOAT,  VA_CONVERT_FLOAT,            1 }, sz_attr_compact, COMPACT_OFS(custom),      1 },
+		{ { 1, VA_USHORT, VA_CONVERT_INT,              1 }, sz_attr_compact, COMPACT_OFS(page),        1 },
+	};
+
 	#undef VERTEX_OFS
 	#undef INSTANCE_OFS
+	#undef COMPACT_OFS
 
-	uint capacity;
+	_r_sprite_batch.compact_enabled = r_supports(RFEAT_VERTEX_HALF_FLOAT) && env_get("TAISEI_SPRITE_BATCH_COMPACT", true);
 
-	if(r_supports(RFEAT_DRAW_INSTANCED_BASE_INSTANCE)) {
-		capacity = 1 << 15;
+	sprite_layout_init(
+		_r_sprite_batch.layouts + SPRITE_LAYOUT_FULL, sz_attr, sizeof(fmt)/sizeof(*fmt), fmt,
+		"Sprite batch vertex buffer", "Sprite batch vertex array"
+	);
+
+	if(_r_sprite_batch.compact_enabled) {
+		sprite_layout_init(
+			_r_sprite_batch.layouts + SPRITE_LAYOUT_COMPACT, sz_attr_compact, sizeof(fmt_compact)/sizeof(*fmt_compact), fmt_compact,
+			"Sprite batch vertex buffer (compact)", "Sprite batch vertex array (compact)"
+		);
+	}
+
+	_r_sprite_batch.layout = SPRITE_LAYOUT_FULL;
+	_r_sprite_batch.max_pages = iclamp(env_get("TAISEI_SPRITE_BATCH_PAGES", SPRITE_BATCH_MAX_PAGES), 1, SPRITE_BATCH_MAX_PAGES);
+
+	if(env_get("TAISEI_SPRITE_BATCH_PARALLEL", true)) {
+		_r_sprite_batch.max_jobs = iclamp(SDL_GetCPUCount(), 1, SPRITE_BATCH_MAX_JOBS);
 	} else {
-		capacity = 1 << 11;
+		_r_sprite_batch.max_jobs = 1;
 	}
+}
 
-	_r_sprite_batch.vbuf = r_vertex_buffer_create(sz_attr * capacity, NULL);
-	r_vertex_buffer_set_debug_label(_r_sprite_batch.vbuf, "Sprite batch vertex buffer");
-	r_vertex_buffer_invalidate(_r_sprite_batch.vbuf);
+void _r_sprite_batch_shutdown(void) {
+	for(uint i = 0; i < NUM_SPRITE_LAYOUTS; ++i) {
+		SpriteLayoutState *l = _r_sprite_batch.layouts + i;
 
-	_r_sprite_batch.varr = r_vertex_array_create();
-	r_vertex_array_set_debug_label(_r_sprite_batch.varr, "Sprite batch vertex array");
-	r_vertex_array_layout(_r_sprite_batch.varr, sizeof(fmt)/sizeof(*fmt), fmt);
-	r_vertex_array_attach_vertex_buffer(_r_sprite_batch.varr, r_vertex_buffer_static_models(), 0);
-	r_vertex_array_attach_vertex_buffer(_r_sprite_batch.varr, _r_sprite_batch.vbuf, 1);
+		if(l->varr != NULL) {
+			r_vertex_array_destroy(l->varr);
+			r_vertex_buffer_destroy(l->vbuf);
+		}
+	}
 
-	_r_sprite_batch.quad.indexed = false;
-	_r_sprite_batch.quad.num_vertices = 4;
-	_r_sprite_batch.quad.offset = 0;
-	_r_sprite_batch.quad.primitive = PRIM_TRIANGLE_STRIP;
-	_r_sprite_batch.quad.vertex_array = _r_sprite_batch.varr;
+	memset(_r_sprite_batch.layouts, 0, sizeof(_r_sprite_batch.layouts));
+	free(_r_sprite_batch.records);
+	free(_r_sprite_batch.staging);
+	free(_r_sprite_batch.modelview_matrices.matrices);
+	free(_r_sprite_batch.tex_matrices.matrices);
+	memset(&_r_sprite_batch.modelview_matrices, 0, sizeof(_r_sprite_batch.modelview_matrices));
+	memset(&_r_sprite_batch.tex_matrices, 0, sizeof(_r_sprite_batch.tex_matrices));
+	_r_sprite_batch.records = NULL;
+	_r_sprite_batch.staging = NULL;
+	_r_sprite_batch.records_capacity = 0;
 }
 
-void _r_sprite_batch_shutdown(void) {
-	r_vertex_array_destroy(_r_sprite_batch.varr);
-	r_vertex_buffer_destroy(_r_sprite_batch.vbuf);
+static uint sprite_matrix_table_add(SpriteMatrixTable *t, mat4 m) {
+	if(t->num_matrices && !memcmp(t->matrices[t->num_matrices - 1], m, sizeof(mat4))) {
+		return t->num_matrices - 1;
+	}
+
+	if(t->num_matrices == t->capacity) {
+		t->capacity = t->capacity ? t->capacity * 2 : 64;
+		t->matrices = realloc(t->matrices, t->capacity * sizeof(*t->matrices));
+	}
+
+	memcpy(t->matrices[t->num_matrices], m, sizeof(mat4));
+	return t->num_matrices++;
+}
+
+static void sprite_record_transform(const SpriteDrawRecord *rec, mat4 transform) {
+	Sprite *spr = rec->sprite;
+
+	// the tables are only 16-byte aligned, so no glm_mat4_copy here
+	memcpy(transform, _r_sprite_batch.modelview_matrices.matrices[rec->modelview], sizeof(mat4));
+
+	if(rec->pos[0] || rec->pos[1]) {
+		glm_translate(transform, (vec3) { rec->pos[0], rec->pos[1] });
+	}
+
+	if(rec->rotation_angle) {
+		glm_rotate(transform, rec->rotation_angle, (float*)rec->rotation_vector);
+	}
+
+	glm_scale(transform, (vec3) { rec->scale[0] * spr->w, rec->scale[1] * spr->h, 1 });
+}
+
+static void sprite_record_texrect(const SpriteDrawRecord *rec, float tex_w, float tex_h, FloatRect *texrect) {
+	Sprite *spr = rec->sprite;
+
+	texrect->x = spr->tex_area.x / tex_w;
+	texrect->y = spr->tex_area.y / tex_h;
+	texrect->w = spr->tex_area.w / tex_w;
+	texrect->h = spr->tex_area.h / tex_h;
+
+	if(rec->flip_x) {
+		texrect->x += texrect->w;
+		texrect->w *= -1;
+	}
+
+	if(rec->flip_y) {
+		texrect->y += texrect->h;
+		texrect->h *= -1;
+	}
+}
+
+static void sprite_expand_record(const SpriteDrawRecord *rec, const float tex_size[2], char *dst) {
+	SpriteAttribs alignas(32) attribs;
+	Sprite *spr = rec->sprite;
+
+	sprite_record_transform(rec, attribs.transform);
+	memcpy(attribs.tex_transform, _r_sprite_batch.tex_matrices.matrices[rec->tex_transform], sizeof(mat4));
+	memcpy(attribs.rgba, rec->rgba, sizeof(attribs.rgba));
+	sprite_record_texrect(rec, tex_size[0], tex_size[1], &attribs.texrect);
+
+	attribs.sprite_size[0] = spr->w;
+	attribs.sprite_size[1] = spr->h;
+
+	memcpy(attribs.custom, rec->custom, sizeof(attribs.custom));
+	memcpy(dst, &attribs, SIZEOF_SPRITE_ATTRIBS);
+}
+
+static inline uint16_t sprite_texcoord_unorm16(float x) {
+	return clamp(x, 0, 1) * 65535 + 0.5;
+}
+
+static void sprite_expand_record_compact(const SpriteDrawRecord *rec, const float tex_size[2], char *dst) {
+	SpriteAttribsCompact attribs;
+	mat4 alignas(32) transform;
+	FloatRect texrect;
+	Sprite *spr = rec->sprite;
+
+	sprite_record_transform(rec, transform);
+
+	// cglm matrices are column-major
+	attribs.affine[0][0] = transform[0][0];
+	attribs.affine[0][1] = transform[1][0];
+	attribs.affine[0][2] = transform[3][0];
+	attribs.affine[1][0] = transform[0][1];
+	attribs.affine[1][1] = transform[1][1];
+	attribs.affine[1][2] = transform[3][1];
+
+	for(uint i = 0; i < 4; ++i) {
+		attribs.rgba[i] = f32_to_f16(rec->rgba[i]);
+	}
+
+	sprite_record_texrect(rec, tex_size[0], tex_size[1], &texrect);
+	attribs.texrect[0] = sprite_texcoord_unorm16(texrect.x);
+	attribs.texrect[1] = sprite_texcoord_unorm16(texrect.y);
+	attribs.texrect[2] = sprite_texcoord_unorm16(texrect.x + texrect.w);
+	attribs.texrect[3] = sprite_texcoord_unorm16(texrect.y + texrect.h);
+
+	attribs.sprite_size[0] = f32_to_f16(spr->w);
+	attribs.sprite_size[1] = f32_to_f16(spr->h);
+	attribs.page = rec->page;
+	attribs.padding = 0;
+
+	memcpy(attribs.custom, rec->custom, sizeof(attribs.custom));
+	memcpy(dst, &attribs, SIZEOF_SPRITE_ATTRIBS_COMPACT);
+}
+
+static void* sprite_expand_task(void *arg) {
+	SpriteExpandJob *job = arg;
+
+	if(job->layout == SPRITE_LAYOUT_COMPACT) {
+		for(uint i = job->begin; i < job->end; ++i) {
+			sprite_expand_record_compact(
+				_r_sprite_batch.records + i,
+				job->tex_size[_r_sprite_batch.records[i].page],
+				job->dst + i * SIZEOF_SPRITE_ATTRIBS_COMPACT
+			);
+		}
+	} else {
+		for(uint i = job->begin; i < job->end; ++i) {
+			sprite_expand_record(
+				_r_sprite_batch.records + i,
+				job->tex_size[0],
+				job->dst + i * SIZEOF_SPRITE_ATTRIBS
+			);
+		}
+	}
+
+	return NULL;
+}
+
+static void sprite_expand_pending(uint num_sprites, char *dst) {
+	float tex_size[SPRITE_BATCH_MAX_PAGES][2] = { 0 };
+
+	for(uint i = 0; i < _r_sprite_batch.num_pages; ++i) {
+		uint tw, th;
+		r_texture_get_size(_r_sprite_batch.pages[i], 0, &tw, &th);
+		tex_size[i][0] = tw;
+		tex_size[i][1] = th;
+	}
+
+	uint num_jobs = iclamp(num_sprites / SPRITE_BATCH_MIN_SPRITES_PER_JOB, 1, _r_sprite_batch.max_jobs);
+	SpriteExpandJob jobs[num_jobs];
+	Task *tasks[num_jobs];
+
+	for(uint i = 0; i < num_jobs; ++i) {
+		jobs[i] = (SpriteExpandJob) {
+			.begin = num_sprites * i / num_jobs,
+			.end = num_sprites * (i + 1) / num_jobs,
+			.layout = _r_sprite_batch.layout,
+			.dst = dst,
+		};
+
+		memcpy(jobs[i].tex_size, tex_size, sizeof(tex_size));
+	}
+
+	// the main thread takes the first chunk itself instead of just waiting
+	for(uint i = 1; i < num_jobs; ++i) {
+		tasks[i] = taskmgr_global_submit((TaskParams) {
+			.callback = sprite_expand_task,
+			.userdata = jobs + i,
+			.prio = -1,
+			.topmost = true,
+		});
+
+		if(tasks[i] == NULL) {
+			sprite_expand_task(jobs + i);
+		}
+	}
+
+	sprite_expand_task(jobs);
+
+	for(uint i = 1; i < num_jobs; ++i) {
+		if(tasks[i] != NULL) {
+			task_finish(tasks[i], NULL);
+		}
+	}
+
+	_r_sprite_batch.modelview_matrices.num_matrices = 0;
+	_r_sprite_batch.tex_matrices.num_matrices = 0;
 }
 
 void r_flush_sprites(void) {
@@ -126,6 +468,7 @@ void r_flush_sprites(void) {
 	}
 
 	uint pending = _r_sprite_batch.num_pending;
+	SpriteLayoutState *layout = _r_sprite_batch.layouts + _r_sprite_batch.layout;
 
 	// needs to be done early to thwart recursive callss
 
@@ -143,6 +486,17 @@ void r_flush_sprites(void) {
 
 	_r_sprite_batch.num_pending = 0;
 	_r_sprite_batch.frame_stats.flushes++;
+	_r_sprite_batch.frame_stats.bytes += pending * layout->attribs_size;
+
+	// expand straight into the buffer if the backend allows it, saving a copy
+	char *dst = r_vertex_buffer_map(layout->vbuf, pending * layout->attribs_size);
+
+	if(dst != NULL) {
+		sprite_expand_pending(pending, dst);
+	} else {
+		sprite_expand_pending(pending, _r_sprite_batch.staging);
+		SDL_RWwrite(r_vertex_buffer_get_stream(layout->vbuf), _r_sprite_batch.staging, layout->attribs_size, pending);
+	}
 
 	r_state_push();
 
@@ -151,8 +505,13 @@ void r_flush_sprites(void) {
 	glm_mat4_copy(_r_sprite_batch.projection, *r_mat_current_ptr(MM_PROJECTION));
 
 	r_shader_ptr(_r_sprite_batch.shader);
-	r_uniform_sampler("tex", _r_sprite_batch.primary_texture);
-	r_uniform_sampler_array("tex_aux[0]", 0, R_NUM_SPRITE_AUX_TEXTURES, _r_sprite_batch.aux_textures);
+	r_uniform_sampler(r_cached_uniform("tex"), _r_sprite_batch.pages[0]);
+
+	if(_r_sprite_batch.layout == SPRITE_LAYOUT_COMPACT) {
+		r_uniform_sampler_array(r_cached_uniform("tex_pages[0]"), 0, SPRITE_BATCH_MAX_PAGES - 1, _r_sprite_batch.pages + 1);
+	}
+
+	r_uniform_sampler_array(r_cached_uniform("tex_aux[0]"), 0, R_NUM_SPRITE_AUX_TEXTURES, _r_sprite_batch.aux_textures);
 	r_framebuffer(_r_sprite_batch.framebuffer);
 	r_blend(_r_sprite_batch.blend);
 	r_capability(RCAP_DEPTH_TEST, _r_sprite_batch.depth_test_enabled);
@@ -162,86 +521,150 @@ void r_flush_sprites(void) {
 	r_cull(_r_sprite_batch.cull_mode);
 
 	if(r_supports(RFEAT_DRAW_INSTANCED_BASE_INSTANCE)) {
-		r_draw_model_ptr(&_r_sprite_batch.quad, pending, _r_sprite_batch.base_instance);
-		_r_sprite_batch.base_instance += pending;
+		r_draw_model_ptr(&layout->quad, pending, layout->base_instance);
+		layout->base_instance += pending;
 
-		SDL_RWops *stream = r_vertex_buffer_get_stream(_r_sprite_batch.vbuf);
+		SDL_RWops *stream = r_vertex_buffer_get_stream(layout->vbuf);
 		size_t remaining = SDL_RWsize(stream) - SDL_RWtell(stream);
 
-		if(remaining < SIZEOF_SPRITE_ATTRIBS) {
-			// log_debug("Invalidating after %u sprites", _r_sprite_batch.base_instance);
-			r_vertex_buffer_invalidate(_r_sprite_batch.vbuf);
-			_r_sprite_batch.base_instance = 0;
+		if(remaining < layout->attribs_size) {
+			// log_debug("Invalidating after %u sprites", layout->base_instance);
+			r_vertex_buffer_invalidate(layout->vbuf);
+			layout->base_instance = 0;
 		}
 	} else {
-		r_draw_model_ptr(&_r_sprite_batch.quad, pending, 0);
-		r_vertex_buffer_invalidate(_r_sprite_batch.vbuf);
+		r_draw_model_ptr(&layout->quad, pending, 0);
+		r_vertex_buffer_invalidate(layout->vbuf);
 	}
 
 	r_mat_pop();
 	r_state_pop();
 }
 
-static void _r_sprite_batch_add(Sprite *spr, const SpriteParams *params, SDL_RWops *stream) {
-	SpriteAttribs alignas(32) attribs;
-	r_mat_current(MM_MODELVIEW, attribs.transform);
-	r_mat_current(MM_TEXTURE, attribs.tex_transform);
-
-	float scale_x = params->scale.x ? params->scale.x : 1;
-	float scale_y = params->scale.y ? params->scale.y : scale_x;
+static void _r_sprite_batch_add(Sprite *spr, const SpriteParams *params, uint page) {
+	uint idx = _r_sprite_batch.num_pending;
 
-	if(params->pos.x || params->pos.y) {
-		glm_translate(attribs.transform, (vec3) { params->pos.x, params->pos.y });
+	if(idx == _r_sprite_batch.records_capacity) {
+		uint capacity = _r_sprite_batch.records_capacity ? _r_sprite_batch.records_capacity * 2 : 1024;
+		_r_sprite_batch.records = realloc(_r_sprite_batch.records, capacity * sizeof(*_r_sprite_batch.records));
+		_r_sprite_batch.staging = realloc(_r_sprite_batch.staging, capacity * SIZEOF_SPRITE_ATTRIBS);
+		_r_sprite_batch.records_capacity = capacity;
 	}
 
+	SpriteDrawRecord *rec = _r_sprite_batch.records + idx;
+	rec->sprite = spr;
+	rec->modelview = sprite_matrix_table_add(&_r_sprite_batch.modelview_matrices, *r_mat_current_ptr(MM_MODELVIEW));
+	rec->tex_transform = sprite_matrix_table_add(&_r_sprite_batch.tex_matrices, *r_mat_current_ptr(MM_TEXTURE));
+
+	rec->pos[0] = params->pos.x;
+	rec->pos[1] = params->pos.y;
+	rec->scale[0] = params->scale.x ? params->scale.x : 1;
+	rec->scale[1] = params->scale.y ? params->scale.y : rec->scale[0];
+	rec->rotation_angle = params->rotation.angle;
+
 	if(params->rotation.angle) {
-		float *rvec = (float*)params->rotation.vector;
+		const float *rvec = params->rotation.vector;
 
 		if(rvec[0] == 0 && rvec[1] == 0 && rvec[2] == 0) {
-			glm_rotate(attribs.transform, params->rotation.angle, (vec3) { 0, 0, 1 });
+			glm_vec3_copy((vec3) { 0, 0, 1 }, rec->rotation_vector);
 		} else {
-			glm_rotate(attribs.transform, params->rotation.angle, rvec);
+			glm_vec3_copy((float*)rvec, rec->rotation_vector);
 		}
 	}
 
-	glm_scale(attribs.transform, (vec3) { scale_x * spr->w, scale_y * spr->h, 1 });
-
 	if(params->color == NULL) {
 		// XXX: should we use r_color_current here?
-		attribs.rgba[0] = attribs.rgba[1] = attribs.rgba[2] = attribs.rgba[3] = 1;
+		rec->rgba[0] = rec->rgba[1] = rec->rgba[2] = rec->rgba[3] = 1;
+	} else {
+		memcpy(rec->rgba, params->color, sizeof(rec->rgba));
+	}
+
+	if(params->shader_params != NULL) {
+		memcpy(rec->custom, params->shader_params, sizeof(rec->custom));
 	} else {
-		memcpy(attribs.rgba, params->color, sizeof(attribs.rgba));
+		memset(rec->custom, 0, sizeof(rec->custom));
 	}
 
-	uint tw, th;
-	r_texture_get_size(spr->tex, 0, &tw, &th);
+	rec->page = page;
+	rec->flip_x = params->flip.x;
+	rec->flip_y = params->flip.y;
 
-	attribs.texrect.x = spr->tex_area.x / tw;
-	attribs.texrect.y = spr->tex_area.y / th;
-	attribs.texrect.w = spr->tex_area.w / tw;
-	attribs.texrect.h = spr->tex_area.h / th;
+	_r_sprite_batch.num_pending++;
+	_r_sprite_batch.frame_stats.sprites++;
+}
 
-	if(params->flip.x) {
-		attribs.texrect.x += attribs.texrect.w;
-		attribs.texrect.w *= -1;
+static bool sprite_can_use_compact_layout(const SpriteParams *params) {
+	static const mat4 identity = {
+		{ 1, 0, 0, 0 },
+		{ 0, 1, 0, 0 },
+		{ 0, 0, 1, 0 },
+		{ 0, 0, 0, 1 },
+	};
+
+	if(params->rotation.angle && (params->rotation.vector[0] || params->rotation.vector[1])) {
+		return false;
 	}
 
-	if(params->flip.y) {
-		attribs.texrect.y += attribs.texrect.h;
-		attribs.texrect.h *= -1;
+	// must map the xy plane onto itself, without any perspective
+	mat4 *mv = r_mat_current_ptr(MM_MODELVIEW);
+
+	if(
+		(*mv)[0][2] || (*mv)[0][3] ||
+		(*mv)[1][2] || (*mv)[1][3] ||
+		(*mv)[3][2] || (*mv)[3][3] != 1
+	) {
+		return false;
 	}
 
-	attribs.sprite_size[0] = spr->w;
-	attribs.sprite_size[1] = spr->h;
+	return !memcmp(*r_mat_current_ptr(MM_TEXTURE), identity, sizeof(mat4));
+}
 
-	if(params->shader_params != NULL) {
-		memcpy(attribs.custom, params->shader_params, sizeof(attribs.custom));
-	} else {
-		memset(attribs.custom, 0, sizeof(attribs.custom));
+static void sprite_batch_reset_pages(Texture *tex) {
+	memset(_r_sprite_batch.pages, 0, sizeof(_r_sprite_batch.pages));
+	_r_sprite_batch.pages[0] = tex;
+	_r_sprite_batch.num_pages = 1;
+}
+
+static uint sprite_batch_page(Texture *tex, SpriteLayout layout) {
+	if(layout != SPRITE_LAYOUT_COMPACT) {
+		// the full layout has no page attribute, so only the primary texture is usable
+		if(tex != _r_sprite_batch.pages[0]) {
+			r_flush_sprites();
+			sprite_batch_reset_pages(tex);
+		}
+
+		return 0;
 	}
 
-	SDL_RWwrite(stream, &attribs, SIZEOF_SPRITE_ATTRIBS, 1);
-	_r_sprite_batch.frame_stats.sprites++;
+	for(uint i = 0; i < _r_sprite_batch.num_pages; ++i) {
+		if(_r_sprite_batch.pages[i] == tex) {
+			return i;
+		}
+	}
+
+	if(_r_sprite_batch.num_pending == 0) {
+		// nothing references the old pages anymore; start over
+		sprite_batch_reset_pages(tex);
+		return 0;
+	}
+
+	if(_r_sprite_batch.num_pages < _r_sprite_batch.max_pages) {
+		_r_sprite_batch.pages[_r_sprite_batch.num_pages] = tex;
+		return _r_sprite_batch.num_pages++;
+	}
+
+	r_flush_sprites();
+	sprite_batch_reset_pages(tex);
+	return 0;
+}
+
+static ShaderProgram* sprite_compact_variant(ShaderProgram *prog) {
+	if(_r_sprite_batch.compact_cache.prog != prog) {
+		_r_sprite_batch.compact_cache.prog = prog;
+		_r_sprite_batch.compact_cache.variant = shader_program_get_compact_variant(prog);
+	}
+
+	return _r_sprite_batch.compact_cache.variant;
 }
 
 void r_draw_sprite(const SpriteParams *params) {
@@ -255,11 +678,6 @@ void r_draw_sprite(const SpriteParams *params) {
 		spr = get_sprite(params->sprite);
 	}
 
-	if(spr->tex != _r_sprite_batch.primary_texture) {
-		r_flush_sprites();
-		_r_sprite_batch.primary_texture = spr->tex;
-	}
-
 	for(uint i = 0; i < R_NUM_SPRITE_AUX_TEXTURES; ++i) {
 		Texture *aux_tex = params->aux_textures[i];
 
@@ -281,6 +699,24 @@ void r_draw_sprite(const SpriteParams *params) {
 
 	assert(prog != NULL);
 
+	SpriteLayout layout = SPRITE_LAYOUT_FULL;
+
+	if(_r_sprite_batch.compact_enabled && sprite_can_use_compact_layout(params)) {
+		ShaderProgram *variant = sprite_compact_variant(prog);
+
+		if(variant != NULL) {
+			prog = variant;
+			layout = SPRITE_LAYOUT_COMPACT;
+		}
+	}
+
+	if(layout != _r_sprite_batch.layout) {
+		r_flush_sprites();
+		_r_sprite_batch.layout = layout;
+	}
+
+	uint page = sprite_batch_page(spr->tex, layout);
+
 	if(prog != _r_sprite_batch.shader) {
 		r_flush_sprites();
 		_r_sprite_batch.shader = prog;
@@ -342,24 +778,27 @@ void r_draw_sprite(const SpriteParams *params) {
 		glm_mat4_copy(*current_projection, _r_sprite_batch.projection);
 	}
 
-	SDL_RWops *stream = r_vertex_buffer_get_stream(_r_sprite_batch.vbuf);
-	size_t remaining = SDL_RWsize(stream) - SDL_RWtell(stream);
+	// pending sprites haven't been written to the stream yet
+	SpriteLayoutState *l = _r_sprite_batch.layouts + layout;
+	SDL_RWops *stream = r_vertex_buffer_get_stream(l->vbuf);
+	size_t remaining = SDL_RWsize(stream) - SDL_RWtell(stream) - _r_sprite_batch.num_pending * l->attribs_size;
 
-	if(remaining < SIZEOF_SPRITE_ATTRIBS) {
+	if(remaining < l->attribs_size) {
 		if(!r_supports(RFEAT_DRAW_INSTANCED_BASE_INSTANCE)) {
-			log_warn("Vertex buffer exhausted (%zu needed for next sprite, %zu remaining), flush forced", SIZEOF_SPRITE_ATTRIBS, remaining);
+			log_warn("Vertex buffer exhausted (%zu needed for next sprite, %zu remaining), flush forced", l->attribs_size, remaining);
 		}
 
 		r_flush_sprites();
 	}
 
-	_r_sprite_batch.num_pending++;
-	_r_sprite_batch_add(spr, params, stream);
+	_r_sprite_batch_add(spr, params, page);
 }
 
 #include "resource/font.h"
 
 void _r_sprite_batch_end_frame(void) {
+	memset(&_r_sprite_batch.compact_cache, 0, sizeof(_r_sprite_batch.compact_cache));
+
 #ifdef DEBUG
 	if(!_r_sprite_batch.frame_stats.flushes) {
 		return;
@@ -368,12 +807,13 @@ void _r_sprite_batch_end_frame(void) {
 	r_flush_sprites();
 
 	static char buf[512];
-	snprintf(buf, sizeof(buf), "%6i sprites %6i flushes %9.02f spr/flush %6i best %6i worst",
+	snprintf(buf, sizeof(buf), "%6i sprites %6i flushes %9.02f spr/flush %6i best %6i worst %8.01f KiB",
 		_r_sprite_batch.frame_stats.sprites,
 		_r_sprite_batch.frame_stats.flushes,
 		_r_sprite_batch.frame_stats.sprites / (double)_r_sprite_batch.frame_stats.flushes,
 		_r_sprite_batch.frame_stats.best_batch,
-		_r_sprite_batch.frame_stats.worst_batch
+		_r_sprite_batch.frame_stats.worst_batch,
+		_r_sprite_batch.frame_stats.bytes / 1024.0
 	);
 
 	Font *font = get_font("monotiny");
@@ -384,14 +824,36 @@ void _r_sprite_batch_end_frame(void) {
 		.shader = "text_default",
 	});
 
+	RendererFrameStats rstats;
+	r_frame_stats(&rstats);
+
+	snprintf(buf, sizeof(buf), "%6i draws %6i progs %6i binds %6i fbos %6i uniforms %6i state %6i filtered",
+		rstats.draws,
+		rstats.shader_switches,
+		rstats.texture_binds,
+		rstats.framebuffer_switches,
+		rstats.uniform_updates,
+		rstats.state_calls,
+		rstats.filtered_calls
+	);
+
+	text_draw(buf, &(TextParams) {
+		.pos = { 0, 2 * font_get_lineskip(font) },
+		.font_ptr = font,
+		.color = RGB(1, 1, 1),
+		.shader = "text_default",
+	});
+
 	memset(&_r_sprite_batch.frame_stats, 0, sizeof(_r_sprite_batch.frame_stats));
 
 #endif
 }
 
 void _r_sprite_batch_texture_deleted(Texture *tex) {
-	if(_r_sprite_batch.primary_texture == tex) {
-		_r_sprite_batch.primary_texture = NULL;
+	for(uint i = 0; i < SPRITE_BATCH_MAX_PAGES; ++i) {
+		if(_r_sprite_batch.pages[i] == tex) {
+			_r_sprite_batch.pages[i] = NULL;
+		}
 	}
 
 	for(uint i = 0; i < R_NUM_SPRITE_AUX_TEXTURES; ++i) {
@@ -13,6 +13,204 @@
 
 #define STREAM_CBUF(rw) ((CommonBuffer*)rw)
 
+// new windows in the ring start at multiples of this, to keep attributes aligned
+#define RING_ALIGNMENT 64
+
+static int max_stream_mode = -1;
+
+static CommonBufferStreamMode gl33_buffer_max_stream_mode(void) {
+	if(max_stream_mode < 0) {
+		if(!env_get("TAISEI_GL_BUFFER_MAPPING", true)) {
+			max_stream_mode = GL33_BUFFER_STREAM_CACHED;
+		} else if(!(GL_ATLEAST(3, 2) || GLES_ATLEAST(3, 0))) {
+			// need glMapBufferRange and sync objects
+			max_stream_mode = GL33_BUFFER_STREAM_CACHED;
+		} else if(glext.buffer_storage) {
+			max_stream_mode = GL33_BUFFER_STREAM_PERSISTENT;
+		} else {
+			max_stream_mode = GL33_BUFFER_STREAM_MAPPED;
+		}
+	}
+
+	return max_stream_mode;
+}
+
+static void gl33_buffer_ring_unmap(CommonBuffer *cbuf) {
+	assert(cbuf->stream_mode == GL33_BUFFER_STREAM_MAPPED);
+
+	if(cbuf->ring.mapped == NULL) {
+		return;
+	}
+
+	GL33_BUFFER_TEMP_BIND(cbuf, {
+		if(!glUnmapBuffer(gl33_bindidx_to_glenum(cbuf->bindidx))) {
+			log_warn("%s: buffer contents lost while mapped", cbuf->debug_label);
+		}
+	});
+
+	gl33_count_call(GL33_CALL_BUFFER_UPLOAD);
+
+	cbuf->ring.mapped = NULL;
+}
+
+static char* gl33_buffer_ring_ptr(CommonBuffer *cbuf, size_t offset, size_t size) {
+	size_t begin = cbuf->ring.base + offset;
+	size_t end = begin + size;
+
+	if(
+		cbuf->stream_mode == GL33_BUFFER_STREAM_MAPPED &&
+		(cbuf->ring.mapped == NULL || begin < cbuf->ring.map_begin || end > cbuf->ring.map_end)
+	) {
+		gl33_buffer_ring_unmap(cbuf);
+
+		// map the rest of the window, so that consecutive writes don't need to remap
+		cbuf->ring.map_begin = begin;
+		cbuf->ring.map_end = cbuf->ring.base + cbuf->size;
+
+		GL33_BUFFER_TEMP_BIND(cbuf, {
+			cbuf->ring.mapped = glMapBufferRange(
+				gl33_bindidx_to_glenum(cbuf->bindidx),
+				cbuf->ring.map_begin,
+				cbuf->ring.map_end - cbuf->ring.map_begin,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+			);
+		});
+
+		if(cbuf->ring.mapped == NULL) {
+			log_fatal("%s: glMapBufferRange() failed", cbuf->debug_label);
+		}
+	}
+
+	assert(cbuf->ring.mapped != NULL);
+	assert(begin >= cbuf->ring.map_begin && end <= cbuf->ring.map_end);
+	return cbuf->ring.mapped + (begin - cbuf->ring.map_begin);
+}
+
+static void gl33_buffer_ring_wait(CommonBuffer *cbuf, uint partition) {
+	GLsync *fence = cbuf->ring.fences + partition;
+
+	if(*fence == NULL) {
+		return;
+	}
+
+	GLenum status;
+
+	do {
+		status = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	} while(status == GL_TIMEOUT_EXPIRED);
+
+	if(status == GL_WAIT_FAILED) {
+		log_warn("%s: glClientWaitSync() failed", cbuf->debug_label);
+	}
+
+	glDeleteSync(*fence);
+	*fence = NULL;
+}
+
+static uint gl33_buffer_ring_window_partitions(CommonBuffer *cbuf, size_t base) {
+	uint first = base / cbuf->size;
+	uint last = (base + cbuf->size - 1) / cbuf->size;
+	uint window = 0;
+
+	for(uint i = first; i <= last; ++i) {
+		window |= 1u << i;
+	}
+
+	return window;
+}
+
+static void gl33_buffer_ring_enter_window(CommonBuffer *cbuf, size_t base) {
+	uint window = gl33_buffer_ring_window_partitions(cbuf, base);
+
+	// the GPU is done with these once it gets past the commands issued so far
+	for(uint i = 0; i < GL33_BUFFER_RING_PARTITIONS; ++i) {
+		if((cbuf->ring.busy_partitions & ~window) & (1u << i)) {
+			assert(cbuf->ring.fences[i] == NULL);
+			cbuf->ring.fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+
+	// ...and these may still have commands reading from them in flight
+	for(uint i = 0; i < GL33_BUFFER_RING_PARTITIONS; ++i) {
+		if((window & ~cbuf->ring.busy_partitions) & (1u << i)) {
+			gl33_buffer_ring_wait(cbuf, i);
+		}
+	}
+
+	cbuf->ring.busy_partitions = window;
+	cbuf->ring.base = cbuf->ring.head = base;
+}
+
+static void gl33_buffer_ring_advance(CommonBuffer *cbuf) {
+	size_t base = (cbuf->ring.head + RING_ALIGNMENT - 1) & ~(size_t)(RING_ALIGNMENT - 1);
+
+	if(base + cbuf->size > cbuf->size * GL33_BUFFER_RING_PARTITIONS) {
+		base = 0;
+	}
+
+	if(cbuf->stream_mode == GL33_BUFFER_STREAM_MAPPED) {
+		gl33_buffer_ring_unmap(cbuf);
+	}
+
+	gl33_buffer_ring_enter_window(cbuf, base);
+}
+
+static void gl33_buffer_ring_init(CommonBuffer *cbuf, CommonBufferStreamMode mode) {
+	GLenum target = gl33_bindidx_to_glenum(cbuf->bindidx);
+	size_t ring_size = cbuf->size * GL33_BUFFER_RING_PARTITIONS;
+
+	GL33_BUFFER_TEMP_BIND(cbuf, {
+		if(mode == GL33_BUFFER_STREAM_PERSISTENT) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, ring_size, NULL, flags);
+			cbuf->ring.mapped = glMapBufferRange(target, 0, ring_size, flags);
+
+			if(cbuf->ring.mapped == NULL) {
+				// the storage is still usable with glMapBufferRange
+				log_warn("%s: persistent mapping failed, falling back to unsynchronized mapping", cbuf->debug_label);
+				mode = GL33_BUFFER_STREAM_MAPPED;
+			}
+		} else {
+			glBufferData(target, ring_size, NULL, GL_STREAM_DRAW);
+		}
+	});
+
+	cbuf->ring.map_begin = 0;
+	cbuf->ring.map_end = cbuf->ring.mapped ? ring_size : 0;
+	cbuf->stream_mode = mode;
+
+	// the CPU-side copy is no longer needed; all writes go straight to the buffer
+	free(cbuf->cache.buffer);
+	cbuf->cache.buffer = NULL;
+	cbuf->cache.update_begin = cbuf->size;
+	cbuf->cache.update_end = 0;
+
+	gl33_buffer_ring_enter_window(cbuf, 0);
+
+	log_debug("%s: streaming through a %zukb ring (%s)",
+		cbuf->debug_label, ring_size / 1024,
+		mode == GL33_BUFFER_STREAM_PERSISTENT ? "persistent" : "unsynchronized"
+	);
+}
+
+static void gl33_buffer_ring_destroy(CommonBuffer *cbuf) {
+	if(cbuf->ring.mapped != NULL) {
+		// also needed for persistent mappings
+		GL33_BUFFER_TEMP_BIND(cbuf, {
+			glUnmapBuffer(gl33_bindidx_to_glenum(cbuf->bindidx));
+		});
+
+		cbuf->ring.mapped = NULL;
+	}
+
+	for(uint i = 0; i < GL33_BUFFER_RING_PARTITIONS; ++i) {
+		if(cbuf->ring.fences[i] != NULL) {
+			glDeleteSync(cbuf->ring.fences[i]);
+			cbuf->ring.fences[i] = NULL;
+		}
+	}
+}
+
 static int64_t gl33_buffer_stream_seek(SDL_RWops *rw, int64_t offset, int whence) {
 	CommonBuffer *cbuf = STREAM_CBUF(rw);
 
@@ -44,13 +242,9 @@ static int64_t gl33_buffer_stream_size(SDL_RWops *rw) {
 static size_t gl33_buffer_stream_write(SDL_RWops *rw, const void *data, size_t size, size_t num) {
 	CommonBuffer *cbuf = STREAM_CBUF(rw);
 	size_t total_size = size * num;
-	assert(cbuf->offset + total_size <= cbuf->size);
 
 	if(total_size > 0) {
-		memcpy(cbuf->cache.buffer + cbuf->offset, data, total_size);
-		cbuf->cache.update_begin = min(cbuf->offset, cbuf->cache.update_begin);
-		cbuf->cache.update_end = max(cbuf->offset + total_size, cbuf->cache.update_end);
-		cbuf->offset += total_size;
+		memcpy(gl33_buffer_map(cbuf, total_size), data, total_size);
 	}
 
 	return num;
@@ -95,20 +289,58 @@ CommonBuffer* gl33_buffer_create(uint bindidx, size_t capacity, GLenum usage_hin
 }
 
 void gl33_buffer_destroy(CommonBuffer *cbuf) {
+	if(cbuf->stream_mode != GL33_BUFFER_STREAM_CACHED) {
+		gl33_buffer_ring_destroy(cbuf);
+	}
+
 	free(cbuf->cache.buffer);
 	gl33_buffer_deleted(cbuf);
 	glDeleteBuffers(1, &cbuf->gl_handle);
 	free(cbuf);
 }
 
+void* gl33_buffer_map(CommonBuffer *cbuf, size_t size) {
+	assert(cbuf->offset + size <= cbuf->size);
+	assert(!cbuf->ring.shared);
+
+	char *dst;
+
+	if(cbuf->stream_mode == GL33_BUFFER_STREAM_CACHED) {
+		dst = cbuf->cache.buffer + cbuf->offset;
+		cbuf->cache.update_begin = min(cbuf->offset, cbuf->cache.update_begin);
+		cbuf->cache.update_end = max(cbuf->offset + size, cbuf->cache.update_end);
+	} else {
+		dst = gl33_buffer_ring_ptr(cbuf, cbuf->offset, size);
+		cbuf->ring.head = max(cbuf->ring.base + cbuf->offset + size, cbuf->ring.head);
+	}
+
+	cbuf->offset += size;
+	return dst;
+}
+
 void gl33_buffer_invalidate(CommonBuffer *cbuf) {
-	GL33_BUFFER_TEMP_BIND(cbuf, {
-		glBufferData(gl33_bindidx_to_glenum(cbuf->bindidx), cbuf->size, NULL, GL_DYNAMIC_DRAW);
-	});
+	assert(!cbuf->ring.shared);
+
+	if(cbuf->stream_mode != GL33_BUFFER_STREAM_CACHED) {
+		gl33_buffer_ring_advance(cbuf);
+	} else if(gl33_buffer_max_stream_mode() != GL33_BUFFER_STREAM_CACHED) {
+		gl33_buffer_ring_init(cbuf, gl33_buffer_max_stream_mode());
+	} else {
+		GL33_BUFFER_TEMP_BIND(cbuf, {
+			glBufferData(gl33_bindidx_to_glenum(cbuf->bindidx), cbuf->size, NULL, GL_DYNAMIC_DRAW);
+		});
+	}
+
 	cbuf->offset = 0;
 }
 
 void gl33_buffer_flush(CommonBuffer *cbuf) {
+	if(cbuf->stream_mode == GL33_BUFFER_STREAM_MAPPED) {
+		// can't draw from a buffer while it's mapped without GL_MAP_PERSISTENT_BIT
+		gl33_buffer_ring_unmap(cbuf);
+		return;
+	}
+
 	if(cbuf->cache.update_begin >= cbuf->cache.update_end) {
 		return;
 	}
@@ -125,7 +357,63 @@ void gl33_buffer_flush(CommonBuffer *cbuf) {
 		);
 	});
 
+	gl33_count_call(GL33_CALL_BUFFER_UPLOAD);
+
 	cbuf->cache.update_begin = cbuf->size;
 	cbuf->cache.update_end = 0;
 }
 
+void* gl33_buffer_share(CommonBuffer *cbuf, size_t *storage_size) {
+	assert(!cbuf->ring.shared);
+
+	if(cbuf->stream_mode == GL33_BUFFER_STREAM_CACHED) {
+		if(gl33_buffer_max_stream_mode() != GL33_BUFFER_STREAM_PERSISTENT) {
+			return NULL;
+		}
+
+		gl33_buffer_ring_init(cbuf, GL33_BUFFER_STREAM_PERSISTENT);
+	} else if(cbuf->stream_mode == GL33_BUFFER_STREAM_PERSISTENT) {
+		// The caller starts over at the beginning of the ring, so the GPU must be done with all of it.
+		for(uint i = 0; i < GL33_BUFFER_RING_PARTITIONS; ++i) {
+			if(cbuf->ring.busy_partitions & (1u << i)) {
+				cbuf->ring.fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			}
+
+			gl33_buffer_ring_wait(cbuf, i);
+		}
+	}
+
+	if(cbuf->stream_mode != GL33_BUFFER_STREAM_PERSISTENT) {
+		// the persistent mapping failed, or the ring was already set up without one
+		return NULL;
+	}
+
+	cbuf->ring.shared = true;
+	cbuf->ring.base = cbuf->ring.head = 0;
+	cbuf->ring.busy_partitions = 0;
+	cbuf->offset = 0;
+
+	*storage_size = cbuf->size * GL33_BUFFER_RING_PARTITIONS;
+	return cbuf->ring.mapped;
+}
+
+void gl33_buffer_set_window(CommonBuffer *cbuf, size_t offset) {
+	assert(cbuf->ring.shared);
+	assert(offset + cbuf->size <= cbuf->size * GL33_BUFFER_RING_PARTITIONS);
+
+	// vertex arrays pick up the new base before the next draw
+	cbuf->ring.base = cbuf->ring.head = offset;
+	cbuf->offset = 0;
+}
+
+void gl33_buffer_unshare(CommonBuffer *cbuf, size_t stream_offset) {
+	assert(cbuf->ring.shared);
+	assert(stream_offset <= cbuf->size);
+
+	// The caller has waited for everything outside the window. It may have written
+	// anywhere inside it, so the next invalidation moves past all of it.
+	cbuf->ring.shared = false;
+	cbuf->ring.head = cbuf->ring.base + cbuf->size;
+	cbuf->ring.busy_partitions = gl33_buffer_ring_window_partitions(cbuf, cbuf->ring.base);
+	cbuf->offset = stream_offset;
+}
@@ -12,6 +12,22 @@
 #include "opengl.h"
 #include "../api.h"
 
+typedef enum CommonBufferStreamMode {
+	// Writes go to a CPU-side copy, which is uploaded with glBufferSubData before
+	// drawing. Invalidation orphans the buffer. This is the only mode on GLES 2.0.
+	GL33_BUFFER_STREAM_CACHED,
+
+	// Writes go directly into a ring buffer, mapped with GL_MAP_UNSYNCHRONIZED_BIT
+	// and unmapped before drawing.
+	GL33_BUFFER_STREAM_MAPPED,
+
+	// Like GL33_BUFFER_STREAM_MAPPED, but the ring is mapped persistently, once.
+	// Requires ARB_buffer_storage.
+	GL33_BUFFER_STREAM_PERSISTENT,
+} CommonBufferStreamMode;
+
+#define GL33_BUFFER_RING_PARTITIONS 3
+
 typedef struct CommonBuffer {
 	union {
 		SDL_RWops stream;
@@ -24,6 +40,27 @@ typedef struct CommonBuffer {
 				size_t update_end;
 			} cache;
 
+			// Streaming buffers (those that were invalidated at least once) switch to
+			// a ring of GL33_BUFFER_RING_PARTITIONS times the buffer size, if the
+			// context supports it. The stream then exposes a window of the original
+			// size, starting at ring.base, and each invalidation moves the window
+			// past the data written so far instead of orphaning the buffer. Fences
+			// keep us from overwriting a partition that's still being read by the GPU.
+			struct {
+				char *mapped;
+				size_t map_begin;
+				size_t map_end;
+				size_t base;
+				size_t head;
+				GLsync fences[GL33_BUFFER_RING_PARTITIONS];
+				uint busy_partitions;
+
+				// Set while the command recorder writes to the ring on its own and
+				// places the window (see gl33_buffer_share). The fences are its job then.
+				bool shared;
+			} ring;
+
+			CommonBufferStreamMode stream_mode;
 			size_t offset;
 			size_t size;
 			GLuint gl_handle;
@@ -43,6 +80,10 @@ void gl33_buffer_destroy(CommonBuffer *cbuf);
 void gl33_buffer_invalidate(CommonBuffer *cbuf);
 SDL_RWops* gl33_buffer_get_stream(CommonBuffer *cbuf);
 void gl33_buffer_flush(CommonBuffer *cbuf);
+void* gl33_buffer_map(CommonBuffer *cbuf, size_t size);
+void* gl33_buffer_share(CommonBuffer *cbuf, size_t *storage_size);
+void gl33_buffer_set_window(CommonBuffer *cbuf, size_t offset);
+void gl33_buffer_unshare(CommonBuffer *cbuf, size_t stream_offset);
 
 #define GL33_BUFFER_TEMP_BIND(cbuf, code) do { \
 	CommonBuffer *_tempbind_cbuf = (cbuf); \
@@ -34,15 +34,15 @@ void gl33_framebuffer_attach(Framebuffer *framebuffer, Texture *tex, uint mipmap
 	assert(!tex || mipmap < tex->params.mipmaps);
 
 	GLuint gl_tex = tex ? tex->gl_handle : 0;
-	Framebuffer *prev_fb = r_framebuffer_current();
+	Framebuffer *prev_fb = gl33_framebuffer_current();
 
 	// make sure gl33_sync_framebuffer doesn't call gl33_framebuffer_initialize here
 	framebuffer->initialized = true;
 
-	r_framebuffer(framebuffer);
+	gl33_framebuffer(framebuffer);
 	gl33_sync_framebuffer();
 	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, r_attachment_to_gl_attachment[attachment], GL_TEXTURE_2D, gl_tex, mipmap);
-	r_framebuffer(prev_fb);
+	gl33_framebuffer(prev_fb);
 
 	framebuffer->attachments[attachment] = tex;
 	framebuffer->attachment_mipmaps[attachment] = mipmap;
@@ -119,11 +119,10 @@ void gl33_framebuffer_clear(Framebuffer *framebuffer, ClearBufferFlags flags, co
 		gl33_set_clear_depth(depthval);
 	}
 
-	r_flush_sprites();
-
-	Framebuffer *fb_saved = r_framebuffer_current();
-	r_framebuffer(framebuffer);
+	Framebuffer *fb_saved = gl33_framebuffer_current();
+	gl33_framebuffer(framebuffer);
 	gl33_sync_framebuffer();
 	glClear(glflags);
-	r_framebuffer(fb_saved);
+	gl33_count_call(GL33_CALL_CLEAR);
+	gl33_framebuffer(fb_saved);
 }
@@ -10,7 +10,6 @@
 
 #include "gl33.h"
 #include "../api.h"
-#include "../common/matstack.h"
 #include "../common/backend.h"
 #include "../common/sprite_batch.h"
 #include "texture.h"
@@ -36,6 +35,7 @@ typedef struct TextureUnit {
 		Texture *active;
 		Texture *pending;
 		bool locked;
+		bool requested;
 	} tex2d;
 } TextureUnit;
 
@@ -53,29 +53,37 @@ static struct {
 	struct {
 		Framebuffer *active;
 		Framebuffer *pending;
+		bool requested;
 	} framebuffer;
 
 	struct {
 		GLuint active;
 		GLuint pending;
+		bool requested;
 	} buffer_objects[GL33_NUM_BUFFER_BINDINGS];
 
 	struct {
 		GLuint active;
 		GLuint pending;
+		bool requested;
 	} vao;
 
 	struct {
 		GLuint gl_prog;
 		ShaderProgram *active;
 		ShaderProgram *pending;
+		bool requested;
 	} progs;
 
 	struct {
 		struct {
 			BlendMode active;
 			BlendMode pending;
+			bool requested;
 		} mode;
+		// the equations and factors change a lot less frequently than the mode
+		GLenum equations[2];
+		GLenum factors[4];
 		bool enabled;
 	} blend;
 
@@ -83,6 +91,7 @@ static struct {
 		struct {
 			CullFaceMode active;
 			CullFaceMode pending;
+			bool requested;
 		} mode;
 	} cull_face;
 
@@ -90,22 +99,30 @@ static struct {
 		struct {
 			DepthTestFunc active;
 			DepthTestFunc pending;
+			bool requested;
 		} func;
 	} depth_test;
 
 	struct {
 		r_capability_bits_t active;
 		r_capability_bits_t pending;
+		// capabilities the frontend set since the last sync
+		r_capability_bits_t requested;
 	} capabilities;
 
 	struct {
 		IntRect active;
 		IntRect default_framebuffer;
+		bool requested;
 	} viewport;
 
 	Color color;
 	Color clear_color;
 	float clear_depth;
+	struct {
+		int requested;
+		int active;
+	} swap_interval;
 	r_feature_bits_t features;
 
 	SDL_GLContext *gl_context;
@@ -117,8 +134,55 @@ static struct {
 		uint draw_calls;
 	} stats;
 	#endif
+
+	struct {
+		GL33CallStats last_frame;
+		uint frames;
+		bool log;
+	} call_stats;
 } R;
 
+GL33CallStats gl33_call_stats;
+
+/*
+ * Sync points compare the whole shadow state every time they run, so a match there is not
+ * by itself an eliminated call. The setters flag what was actually requested since the last
+ * sync, and only those requests are counted as filtered when the shadow already matched.
+ */
+static inline void gl33_count_filtered_request(bool requested, GL33CallType type) {
+	if(requested) {
+		gl33_count_filtered(type);
+	}
+}
+
+static const char *const call_type_names[] = {
+	[GL33_CALL_DRAW]              = "draw",
+	[GL33_CALL_CLEAR]             = "clear",
+	[GL33_CALL_USE_PROGRAM]       = "use program",
+	[GL33_CALL_UNIFORM]           = "uniform",
+	[GL33_CALL_ACTIVE_TEXTURE]    = "active texture",
+	[GL33_CALL_BIND_TEXTURE]      = "bind texture",
+	[GL33_CALL_TEXTURE_PARAMETER] = "texture parameter",
+	[GL33_CALL_TEXTURE_UPLOAD]    = "texture upload",
+	[GL33_CALL_BIND_FRAMEBUFFER]  = "bind framebuffer",
+	[GL33_CALL_BIND_VAO]          = "bind vertex array",
+	[GL33_CALL_BIND_BUFFER]       = "bind buffer",
+	[GL33_CALL_BUFFER_UPLOAD]     = "buffer upload",
+	[GL33_CALL_CAPABILITY]        = "enable/disable",
+	[GL33_CALL_BLEND_EQUATION]    = "blend equation",
+	[GL33_CALL_BLEND_FUNC]        = "blend func",
+	[GL33_CALL_CULL_FACE]         = "cull face",
+	[GL33_CALL_DEPTH_FUNC]        = "depth func",
+	[GL33_CALL_VIEWPORT]          = "viewport",
+	[GL33_CALL_CLEAR_VALUE]       = "clear value",
+	[GL33_CALL_SWAP_INTERVAL]     = "swap interval",
+};
+
+static_assert(sizeof(call_type_names) == sizeof(char*) * GL33_NUM_CALL_TYPES, "Fix the name table");
+
+// log the call stats once every this many frames, if enabled
+#define GL33_CALL_STATS_LOG_INTERVAL 60
+
 /*
  * Internal functions
  */
@@ -180,11 +244,35 @@ static inline void gl33_stats_post_draw(void) {
 	#endif
 }
 
+static void gl33_log_call_stats(const GL33CallStats *stats) {
+	uint issued = 0, filtered = 0;
+
+	for(GL33CallType t = 0; t < GL33_NUM_CALL_TYPES; ++t) {
+		issued += stats->issued[t];
+		filtered += stats->filtered[t];
+	}
+
+	log_debug("GL calls in the last frame: %u issued, %u filtered", issued, filtered);
+
+	for(GL33CallType t = 0; t < GL33_NUM_CALL_TYPES; ++t) {
+		if(stats->issued[t] || stats->filtered[t]) {
+			log_debug("  %-18s %6u issued %6u filtered", call_type_names[t], stats->issued[t], stats->filtered[t]);
+		}
+	}
+}
+
 static inline void gl33_stats_post_frame(void) {
 	#ifdef GL33_DRAW_STATS
 	log_debug("%.20gs spent in %u draw calls", (double)R.stats.draw_time, R.stats.draw_calls);
 	memset(&R.stats, 0, sizeof(R.stats));
 	#endif
+
+	R.call_stats.last_frame = gl33_call_stats;
+	memset(&gl33_call_stats, 0, sizeof(gl33_call_stats));
+
+	if(R.call_stats.log && !(++R.call_stats.frames % GL33_CALL_STATS_LOG_INTERVAL)) {
+		gl33_log_call_stats(&R.call_stats.last_frame);
+	}
 }
 
 static void gl33_init_texunits(void) {
@@ -250,6 +338,8 @@ static void gl33_init_context(SDL_Window *window) {
 	}
 
 	R.viewport.active = R.viewport.default_framebuffer;
+	R.swap_interval.active = R.swap_interval.requested = SDL_GL_GetSwapInterval();
+	R.call_stats.log = env_get("TAISEI_GL_STATS", false);
 
 	if(glext.instanced_arrays) {
 		R.features |= r_feature_bit(RFEAT_DRAW_INSTANCED);
@@ -269,12 +359,18 @@ static void gl33_init_context(SDL_Window *window) {
 
 	R.features |= r_feature_bit(RFEAT_TEXTURE_BOTTOMLEFT_ORIGIN);
 
+	if(GL_ATLEAST(3, 0) || GLES_ATLEAST(3, 0)) {
+		R.features |= r_feature_bit(RFEAT_VERTEX_HALF_FLOAT);
+	}
+
 	if(glext.clear_texture) {
 		_r_backend.funcs.texture_clear = gl44_texture_clear;
 	}
 }
 
 static void gl33_apply_capability(RendererCapability cap, bool value) {
+	gl33_count_call(GL33_CALL_CAPABILITY);
+
 	switch(cap) {
 		case RCAP_DEPTH_TEST:
 			(value ? glEnable : glDisable)(GL_DEPTH_TEST);
@@ -306,16 +402,17 @@ static void gl33_sync_viewport(void) {
 	if(memcmp(&R.viewport.active, vp, sizeof(IntRect))) {
 		R.viewport.active = *vp;
 		glViewport(vp->x, vp->y, vp->w, vp->h);
+		gl33_count_call(GL33_CALL_VIEWPORT);
+	} else {
+		gl33_count_filtered_request(R.viewport.requested, GL33_CALL_VIEWPORT);
 	}
+
+	R.viewport.requested = false;
 }
 
 static void gl33_sync_state(void) {
 	gl33_sync_capabilities();
 	gl33_sync_shader();
-	r_uniform_mat4("r_modelViewMatrix", *_r_matrices.modelview.head);
-	r_uniform_mat4("r_projectionMatrix", *_r_matrices.projection.head);
-	r_uniform_mat4("r_textureMatrix", *_r_matrices.texture.head);
-	r_uniform_vec4_rgba("r_color", &R.color);
 	gl33_sync_uniforms(R.progs.active);
 	gl33_sync_texunits(true);
 	gl33_sync_framebuffer();
@@ -351,17 +448,24 @@ GLenum gl33_prim_to_gl_prim(Primitive prim) {
 }
 
 void gl33_sync_capabilities(void) {
-	if(R.capabilities.active == R.capabilities.pending) {
+	r_capability_bits_t changed = R.capabilities.active ^ R.capabilities.pending;
+
+	// requested, but already in effect
+	for(r_capability_bits_t redundant = R.capabilities.requested & ~changed; redundant; redundant &= redundant - 1) {
+		gl33_count_filtered(GL33_CALL_CAPABILITY);
+	}
+
+	R.capabilities.requested = 0;
+
+	if(!changed) {
 		return;
 	}
 
 	for(RendererCapability cap = 0; cap < NUM_RCAPS; ++cap) {
 		r_capability_bits_t flag = r_capability_bit(cap);
-		bool pending = R.capabilities.pending & flag;
-		bool active = R.capabilities.active & flag;
 
-		if(pending != active) {
-			gl33_apply_capability(cap, pending);
+		if(changed & flag) {
+			gl33_apply_capability(cap, R.capabilities.pending & flag);
 		}
 	}
 
@@ -374,6 +478,7 @@ static void gl33_activate_texunit(TextureUnit *unit) {
 
 	if(R.texunits.active != unit) {
 		glActiveTexture(GL_TEXTURE0 + TU_INDEX(unit));
+		gl33_count_call(GL33_CALL_ACTIVE_TEXTURE);
 		R.texunits.active = unit;
 #ifdef GL33_DEBUG_TEXUNITS
 		log_debug("Activated unit %i", (uint)TU_INDEX(unit));
@@ -444,6 +549,7 @@ static void gl33_relocate_texuint(TextureUnit *unit) {
 attr_nonnull(1)
 static void gl33_set_texunit_binding(TextureUnit *unit, Texture *tex, bool lock) {
 	assert(!unit->tex2d.locked);
+	unit->tex2d.requested = true;
 
 	if(unit->tex2d.pending == tex) {
 		return;
@@ -483,6 +589,7 @@ void gl33_sync_texunit(TextureUnit *unit, bool prepare_rendering, bool ensure_ac
 		if(unit->tex2d.gl_handle != 0) {
 			gl33_activate_texunit(unit);
 			glBindTexture(GL_TEXTURE_2D, 0);
+			gl33_count_call(GL33_CALL_BIND_TEXTURE);
 			unit->tex2d.gl_handle = 0;
 			unit->tex2d.active = NULL;
 			gl33_relocate_texuint(unit);
@@ -490,6 +597,7 @@ void gl33_sync_texunit(TextureUnit *unit, bool prepare_rendering, bool ensure_ac
 	} else if(unit->tex2d.gl_handle != tex->gl_handle) {
 		gl33_activate_texunit(unit);
 		glBindTexture(GL_TEXTURE_2D, tex->gl_handle);
+		gl33_count_call(GL33_CALL_BIND_TEXTURE);
 		unit->tex2d.gl_handle = tex->gl_handle;
 
 		if(unit->tex2d.active == NULL) {
@@ -498,10 +606,18 @@ void gl33_sync_texunit(TextureUnit *unit, bool prepare_rendering, bool ensure_ac
 		} else {
 			unit->tex2d.active = tex;
 		}
-	} else if(ensure_active) {
-		gl33_activate_texunit(unit);
+	} else {
+		if(tex != NULL) {
+			gl33_count_filtered_request(unit->tex2d.requested, GL33_CALL_BIND_TEXTURE);
+		}
+
+		if(ensure_active) {
+			gl33_activate_texunit(unit);
+		}
 	}
 
+	unit->tex2d.requested = false;
+
 	if(prepare_rendering && unit->tex2d.active != NULL) {
 		gl33_texture_prepare(unit->tex2d.active);
 		unit->tex2d.locked = false;
@@ -518,7 +634,12 @@ void gl33_sync_vao(void) {
 	if(R.vao.active != R.vao.pending) {
 		R.vao.active = R.vao.pending;
 		glBindVertexArray(R.vao.active);
+		gl33_count_call(GL33_CALL_BIND_VAO);
+	} else {
+		gl33_count_filtered_request(R.vao.requested, GL33_CALL_BIND_VAO);
 	}
+
+	R.vao.requested = false;
 }
 
 GLenum gl33_bindidx_to_glenum(BufferBindingIndex bindidx) {
@@ -537,15 +658,25 @@ void gl33_sync_buffer(BufferBindingIndex bindidx) {
 	if(R.buffer_objects[bindidx].active != R.buffer_objects[bindidx].pending) {
 		R.buffer_objects[bindidx].active = R.buffer_objects[bindidx].pending;
 		glBindBuffer(gl33_bindidx_to_glenum(bindidx), R.buffer_objects[bindidx].active);
+		gl33_count_call(GL33_CALL_BIND_BUFFER);
+	} else {
+		gl33_count_filtered_request(R.buffer_objects[bindidx].requested, GL33_CALL_BIND_BUFFER);
 	}
+
+	R.buffer_objects[bindidx].requested = false;
 }
 
 void gl33_sync_cull_face_mode(void) {
 	if(R.cull_face.mode.pending != R.cull_face.mode.active) {
 		GLenum glcull = r_cull_to_gl_cull(R.cull_face.mode.pending);
 		glCullFace(glcull);
+		gl33_count_call(GL33_CALL_CULL_FACE);
 		R.cull_face.mode.active = R.cull_face.mode.pending;
+	} else {
+		gl33_count_filtered_request(R.cull_face.mode.requested, GL33_CALL_CULL_FACE);
 	}
+
+	R.cull_face.mode.requested = false;
 }
 
 void gl33_sync_depth_test_func(void) {
@@ -567,8 +698,13 @@ void gl33_sync_depth_test_func(void) {
 
 	if(R.depth_test.func.active != func) {
 		glDepthFunc(func_to_glfunc[idx]);
+		gl33_count_call(GL33_CALL_DEPTH_FUNC);
 		R.depth_test.func.active = func;
+	} else {
+		gl33_count_filtered_request(R.depth_test.func.requested, GL33_CALL_DEPTH_FUNC);
 	}
+
+	R.depth_test.func.requested = false;
 }
 
 static inline GLuint fbo_num(Framebuffer *fb) {
@@ -583,9 +719,14 @@ static inline GLuint fbo_num(Framebuffer *fb) {
 void gl33_sync_framebuffer(void) {
 	if(fbo_num(R.framebuffer.active) != fbo_num(R.framebuffer.pending)) {
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_num(R.framebuffer.pending));
+		gl33_count_call(GL33_CALL_BIND_FRAMEBUFFER);
 		R.framebuffer.active = R.framebuffer.pending;
+	} else {
+		gl33_count_filtered_request(R.framebuffer.requested, GL33_CALL_BIND_FRAMEBUFFER);
 	}
 
+	R.framebuffer.requested = false;
+
 	if(R.framebuffer.active) {
 		gl33_framebuffer_prepare(R.framebuffer.active);
 	}
@@ -594,18 +735,28 @@ void gl33_sync_framebuffer(void) {
 void gl33_sync_shader(void) {
 	if(R.progs.pending && R.progs.gl_prog != R.progs.pending->gl_handle) {
 		glUseProgram(R.progs.pending->gl_handle);
+		gl33_count_call(GL33_CALL_USE_PROGRAM);
 		R.progs.gl_prog = R.progs.pending->gl_handle;
 		R.progs.active = R.progs.pending;
+	} else {
+		gl33_count_filtered_request(R.progs.requested, GL33_CALL_USE_PROGRAM);
 	}
+
+	R.progs.requested = false;
 }
 
 void gl33_sync_blend_mode(void) {
 	BlendMode mode = R.blend.mode.pending;
+	bool requested = R.blend.mode.requested;
+	R.blend.mode.requested = false;
 
 	if(mode == BLEND_NONE) {
 		if(R.blend.enabled) {
 			glDisable(GL_BLEND);
+			gl33_count_call(GL33_CALL_CAPABILITY);
 			R.blend.enabled = false;
+		} else {
+			gl33_count_filtered_request(requested, GL33_CALL_CAPABILITY);
 		}
 
 		return;
@@ -614,27 +765,47 @@ void gl33_sync_blend_mode(void) {
 	if(!R.blend.enabled) {
 		R.blend.enabled = true;
 		glEnable(GL_BLEND);
+		gl33_count_call(GL33_CALL_CAPABILITY);
+	} else {
+		gl33_count_filtered_request(requested, GL33_CALL_CAPABILITY);
 	}
 
-	if(mode != R.blend.mode.active) {
-		static UnpackedBlendMode umode;
-		r_blend_unpack(mode, &umode);
-		R.blend.mode.active = mode;
+	if(mode == R.blend.mode.active) {
+		gl33_count_filtered_request(requested, GL33_CALL_BLEND_EQUATION);
+		gl33_count_filtered_request(requested, GL33_CALL_BLEND_FUNC);
+		return;
+	}
 
-		// TODO: maybe cache the funcs and factors separately,
-		// because the blend funcs change a lot less frequently.
+	UnpackedBlendMode umode;
+	r_blend_unpack(mode, &umode);
+	R.blend.mode.active = mode;
 
-		glBlendEquationSeparate(
-			blendop_to_gl_blendop(umode.color.op),
-			blendop_to_gl_blendop(umode.alpha.op)
-		);
+	GLenum equations[2] = {
+		blendop_to_gl_blendop(umode.color.op),
+		blendop_to_gl_blendop(umode.alpha.op),
+	};
+
+	GLenum factors[4] = {
+		blendfactor_to_gl_blendfactor(umode.color.src),
+		blendfactor_to_gl_blendfactor(umode.color.dst),
+		blendfactor_to_gl_blendfactor(umode.alpha.src),
+		blendfactor_to_gl_blendfactor(umode.alpha.dst),
+	};
+
+	if(memcmp(R.blend.equations, equations, sizeof(equations))) {
+		memcpy(R.blend.equations, equations, sizeof(equations));
+		glBlendEquationSeparate(equations[0], equations[1]);
+		gl33_count_call(GL33_CALL_BLEND_EQUATION);
+	} else {
+		gl33_count_filtered_request(requested, GL33_CALL_BLEND_EQUATION);
+	}
 
-		glBlendFuncSeparate(
-			blendfactor_to_gl_blendfactor(umode.color.src),
-			blendfactor_to_gl_blendfactor(umode.color.dst),
-			blendfactor_to_gl_blendfactor(umode.alpha.src),
-			blendfactor_to_gl_blendfactor(umode.alpha.dst)
-		);
+	if(memcmp(R.blend.factors, factors, sizeof(factors))) {
+		memcpy(R.blend.factors, factors, sizeof(factors));
+		glBlendFuncSeparate(factors[0], factors[1], factors[2], factors[3]);
+		gl33_count_call(GL33_CALL_BLEND_FUNC);
+	} else {
+		gl33_count_filtered_request(requested, GL33_CALL_BLEND_FUNC);
 	}
 }
 
@@ -651,6 +822,7 @@ uint gl33_bind_texture(Texture *texture, bool for_rendering) {
 
 		gl33_set_texunit_binding(R.texunits.list.first, texture, for_rendering);
 	} else /* if(for_rendering) */ {
+		texture->binding_unit->tex2d.requested = true;
 		texture->binding_unit->tex2d.locked |= for_rendering;
 		gl33_relocate_texuint(texture->binding_unit);
 	}
@@ -661,10 +833,12 @@ uint gl33_bind_texture(Texture *texture, bool for_rendering) {
 
 void gl33_bind_buffer(BufferBindingIndex bindidx, GLuint gl_handle) {
 	R.buffer_objects[bindidx].pending = gl_handle;
+	R.buffer_objects[bindidx].requested = true;
 }
 
 void gl33_bind_vao(GLuint vao) {
 	R.vao.pending = vao;
+	R.vao.requested = true;
 }
 
 GLuint gl33_buffer_current(BufferBindingIndex bindidx) {
@@ -722,7 +896,7 @@ void gl33_framebuffer_deleted(Framebuffer *fb) {
 }
 
 void gl33_shader_deleted(ShaderProgram *prog) {
-	if(R.progs.active == NULL) {
+	if(R.progs.active == prog) {
 		R.progs.active = NULL;
 	}
 
@@ -805,6 +979,7 @@ static bool gl33_supports(RendererFeature feature) {
 }
 
 static void gl33_capabilities(r_capability_bits_t capbits) {
+	R.capabilities.requested |= capbits ^ R.capabilities.pending;
 	R.capabilities.pending = capbits;
 }
 
@@ -823,7 +998,17 @@ static void gl33_vsync(VsyncMode mode) {
 			log_fatal("Unknown mode 0x%x", mode);
 	}
 
+	// r_state_pop restores this, so it's set a lot more often than it changes.
+	// Compared to what was requested, so that a failed mode isn't retried every time.
+	if(interval == R.swap_interval.requested) {
+		gl33_count_filtered(GL33_CALL_SWAP_INTERVAL);
+		return;
+	}
+
+	R.swap_interval.requested = interval;
+
 set_interval:
+	gl33_count_call(GL33_CALL_SWAP_INTERVAL);
 	result = SDL_GL_SetSwapInterval(interval);
 
 	if(result < 0) {
@@ -834,11 +1019,13 @@ set_interval:
 			interval = 1;
 			goto set_interval;
 		}
+	} else {
+		R.swap_interval.active = interval;
 	}
 }
 
 static VsyncMode gl33_vsync_current(void) {
-	int interval = SDL_GL_GetSwapInterval();
+	int interval = R.swap_interval.active;
 
 	if(interval == 0) {
 		return VSYNC_NONE;
@@ -860,7 +1047,7 @@ static const Color* gl33_color_current(void) {
 
 void gl33_begin_draw(VertexArray *varr, void **state) {
 	gl33_stats_pre_draw();
-	r_flush_sprites();
+	gl33_count_call(GL33_CALL_DRAW);
 	GLuint prev_vao = gl33_vao_current();
 	gl33_bind_vao(varr->gl_handle);
 	gl33_sync_state();
@@ -920,16 +1107,19 @@ static void gl33_draw_indexed(VertexArray *varr, Primitive prim, uint firstidx,
 	gl33_end_draw(state);
 }
 
-static void gl33_framebuffer(Framebuffer *fb) {
+void gl33_framebuffer(Framebuffer *fb) {
 	R.framebuffer.pending = fb;
+	R.framebuffer.requested = true;
+	R.viewport.requested = true;
 }
 
-static Framebuffer *gl33_framebuffer_current(void) {
+Framebuffer* gl33_framebuffer_current(void) {
 	return R.framebuffer.pending;
 }
 
 static void gl33_framebuffer_viewport(Framebuffer *fb, IntRect vp) {
 	memcpy(get_framebuffer_viewport(fb), &vp, sizeof(vp));
+	R.viewport.requested = true;
 }
 
 static void gl33_framebuffer_viewport_current(Framebuffer *fb, IntRect *out_rect) {
@@ -940,6 +1130,7 @@ static void gl33_shader(ShaderProgram *prog) {
 	assert(prog->gl_handle != 0);
 
 	R.progs.pending = prog;
+	R.progs.requested = true;
 }
 
 static ShaderProgram *gl33_shader_current(void) {
@@ -950,6 +1141,9 @@ void gl33_set_clear_color(const Color *color) {
 	if(memcmp(&R.clear_color, color, sizeof(*color))) {
 		memcpy(&R.clear_color, color, sizeof(*color));
 		glClearColor(color->r, color->g, color->b, color->a);
+		gl33_count_call(GL33_CALL_CLEAR_VALUE);
+	} else {
+		gl33_count_filtered(GL33_CALL_CLEAR_VALUE);
 	}
 }
 
@@ -957,18 +1151,68 @@ void gl33_set_clear_depth(float depth) {
 	if(R.clear_depth != depth) {
 		R.clear_depth = depth;
 		glClearDepth(depth);
+		gl33_count_call(GL33_CALL_CLEAR_VALUE);
+	} else {
+		gl33_count_filtered(GL33_CALL_CLEAR_VALUE);
 	}
 }
 
 static void gl33_swap(SDL_Window *window) {
-	r_flush_sprites();
 	gl33_sync_framebuffer();
 	SDL_GL_SwapWindow(window);
 	gl33_stats_post_frame();
 }
 
+static void* gl33_fence_create(void) {
+	return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+static bool gl33_fence_wait(void *fence, uint64_t timeout_ns) {
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout_ns);
+
+	if(status == GL_WAIT_FAILED) {
+		// nothing to wait for then
+		log_warn("glClientWaitSync() failed");
+		return true;
+	}
+
+	return status != GL_TIMEOUT_EXPIRED;
+}
+
+static void gl33_fence_destroy(void *fence) {
+	glDeleteSync(fence);
+}
+
+static void gl33_frame_stats(RendererFrameStats *stats) {
+	const GL33CallStats *s = &R.call_stats.last_frame;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->draws = s->issued[GL33_CALL_DRAW];
+	stats->shader_switches = s->issued[GL33_CALL_USE_PROGRAM];
+	stats->texture_binds = s->issued[GL33_CALL_BIND_TEXTURE];
+	stats->framebuffer_switches = s->issued[GL33_CALL_BIND_FRAMEBUFFER];
+	stats->uniform_updates = s->issued[GL33_CALL_UNIFORM];
+
+	for(GL33CallType t = 0; t < GL33_NUM_CALL_TYPES; ++t) {
+		stats->filtered_calls += s->filtered[t];
+
+		switch(t) {
+			case GL33_CALL_DRAW:
+			case GL33_CALL_CLEAR:
+			case GL33_CALL_UNIFORM:
+			case GL33_CALL_TEXTURE_UPLOAD:
+			case GL33_CALL_BUFFER_UPLOAD:
+				break;
+
+			default:
+				stats->state_calls += s->issued[t];
+		}
+	}
+}
+
 static void gl33_blend(BlendMode mode) {
 	R.blend.mode.pending = mode;
+	R.blend.mode.requested = true;
 }
 
 static BlendMode gl33_blend_current(void) {
@@ -977,6 +1221,7 @@ static BlendMode gl33_blend_current(void) {
 
 static void gl33_cull(CullFaceMode mode) {
 	R.cull_face.mode.pending = mode;
+	R.cull_face.mode.requested = true;
 }
 
 static CullFaceMode gl33_cull_current(void) {
@@ -985,6 +1230,7 @@ static CullFaceMode gl33_cull_current(void) {
 
 static void gl33_depth_func(DepthTestFunc func) {
 	R.depth_test.func.pending = func;
+	R.depth_test.func.requested = true;
 }
 
 static DepthTestFunc gl33_depth_func_current(void) {
@@ -1066,6 +1312,10 @@ RendererBackend _r_backend_gl33 = {
 		.vertex_buffer_destroy = gl33_vertex_buffer_destroy,
 		.vertex_buffer_invalidate = gl33_vertex_buffer_invalidate,
 		.vertex_buffer_get_stream = gl33_vertex_buffer_get_stream,
+		.vertex_buffer_map = gl33_vertex_buffer_map,
+		.vertex_buffer_share = gl33_vertex_buffer_share,
+		.vertex_buffer_set_window = gl33_vertex_buffer_set_window,
+		.vertex_buffer_unshare = gl33_vertex_buffer_unshare,
 		.index_buffer_create = gl33_index_buffer_create,
 		.index_buffer_get_capacity = gl33_index_buffer_get_capacity,
 		.index_buffer_get_debug_label = gl33_index_buffer_get_debug_label,
@@ -1086,6 +1336,10 @@ RendererBackend _r_backend_gl33 = {
 		.vsync = gl33_vsync,
 		.vsync_current = gl33_vsync_current,
 		.swap = gl33_swap,
+		.frame_stats = gl33_frame_stats,
+		.fence_create = gl33_fence_create,
+		.fence_wait = gl33_fence_wait,
+		.fence_destroy = gl33_fence_destroy,
 		.screenshot = gl33_screenshot,
 	},
 	.custom = &(GLBackendData) {
@@ -25,6 +25,49 @@ typedef enum BufferBindingIndex {
 	GL33_NUM_BUFFER_BINDINGS
 } BufferBindingIndex;
 
+// GL calls made by the backend, by type. Counted every frame.
+typedef enum GL33CallType {
+	GL33_CALL_DRAW,
+	GL33_CALL_CLEAR,
+	GL33_CALL_USE_PROGRAM,
+	GL33_CALL_UNIFORM,
+	GL33_CALL_ACTIVE_TEXTURE,
+	GL33_CALL_BIND_TEXTURE,
+	GL33_CALL_TEXTURE_PARAMETER,
+	GL33_CALL_TEXTURE_UPLOAD,
+	GL33_CALL_BIND_FRAMEBUFFER,
+	GL33_CALL_BIND_VAO,
+	GL33_CALL_BIND_BUFFER,
+	GL33_CALL_BUFFER_UPLOAD,
+	GL33_CALL_CAPABILITY,
+	GL33_CALL_BLEND_EQUATION,
+	GL33_CALL_BLEND_FUNC,
+	GL33_CALL_CULL_FACE,
+	GL33_CALL_DEPTH_FUNC,
+	GL33_CALL_VIEWPORT,
+	GL33_CALL_CLEAR_VALUE,
+	GL33_CALL_SWAP_INTERVAL,
+
+	GL33_NUM_CALL_TYPES
+} GL33CallType;
+
+typedef struct GL33CallStats {
+	// calls that reached the driver
+	uint issued[GL33_NUM_CALL_TYPES];
+	// calls that were skipped, because the shadowed state already matched
+	uint filtered[GL33_NUM_CALL_TYPES];
+} GL33CallStats;
+
+extern GL33CallStats gl33_call_stats;
+
+static inline void gl33_count_call(GL33CallType type) {
+	++gl33_call_stats.issued[type];
+}
+
+static inline void gl33_count_filtered(GL33CallType type) {
+	++gl33_call_stats.filtered[type];
+}
+
 // Internal helper functions
 
 GLenum gl33_prim_to_gl_prim(Primitive prim);
@@ -42,6 +85,9 @@ void gl33_sync_buffer(BufferBindingIndex bindidx);
 GLuint gl33_buffer_current(BufferBindingIndex bindidx);
 GLenum gl33_bindidx_to_glenum(BufferBindingIndex bindidx);
 
+void gl33_framebuffer(Framebuffer *fb);
+Framebuffer* gl33_framebuffer_current(void);
+
 void gl33_set_clear_color(const Color *color);
 void gl33_set_clear_depth(float depth);
 
@@ -175,7 +175,20 @@ static void gl33_update_uniform(Uniform *uniform, uint offset, uint count, const
 	assert(idx_last < uniform->array_size);
 	assert(idx_first <= idx_last);
 
-	memcpy(uniform->cache.pending + offset, data, count * uniform->elem_size);
+	size_t update_ofs = offset * uniform->elem_size;
+	size_t update_sz = count * uniform->elem_size;
+	memcpy(uniform->cache.pending + update_ofs, data, update_sz);
+
+	if(uniform->cache.update_first_idx > uniform->cache.update_last_idx) {
+		// not dirty yet; don't make it so if nothing would change
+		if(!memcmp(uniform->cache.commited + update_ofs, data, update_sz)) {
+			gl33_count_filtered(GL33_CALL_UNIFORM);
+			return;
+		}
+
+		ShaderProgram *prog = uniform->prog;
+		prog->dirty_uniforms[prog->num_dirty_uniforms++] = uniform;
+	}
 
 	if(idx_first < uniform->cache.update_first_idx) {
 		uniform->cache.update_first_idx = idx_first;
@@ -206,17 +219,22 @@ static void gl33_commit_uniform(Uniform *uniform) {
 			update_count,
 			uniform->cache.commited + update_ofs
 		);
+
+		gl33_count_call(GL33_CALL_UNIFORM);
+	} else {
+		gl33_count_filtered(GL33_CALL_UNIFORM);
 	}
 
 	uniform->cache.update_first_idx = uniform->array_size;
 	uniform->cache.update_last_idx = 0;
 }
 
-static void* gl33_sync_uniform(const char *key, void *value, void *arg) {
-	Uniform *uniform = value;
-
+void gl33_sync_uniforms(ShaderProgram *prog) {
 	// special case: for sampler uniforms, we have to construct the actual data from the texture pointers array.
-	if(uniform->type == UNIFORM_SAMPLER) {
+	// The texture units may change between draws, so these are always checked.
+	for(uint s = 0; s < prog->num_sampler_uniforms; ++s) {
+		Uniform *uniform = prog->sampler_uniforms[s];
+
 		for(uint i = 0; i < uniform->array_size; ++i) {
 			Texture *tex = uniform->textures[i];
 
@@ -229,19 +247,19 @@ static void* gl33_sync_uniform(const char *key, void *value, void *arg) {
 		}
 	}
 
-	gl33_commit_uniform(uniform);
-	return NULL;
-}
+	for(uint i = 0; i < prog->num_dirty_uniforms; ++i) {
+		gl33_commit_uniform(prog->dirty_uniforms[i]);
+	}
 
-void gl33_sync_uniforms(ShaderProgram *prog) {
-	ht_foreach(&prog->uniforms, gl33_sync_uniform, NULL);
+	prog->num_dirty_uniforms = 0;
 }
 
-void gl33_uniform(Uniform *uniform, uint offset, uint count, const void *data) {
+void gl33_uniform(Uniform *uniform, uint offset, uint count, UniformType type, const void *data) {
 	assert(count > 0);
 	assert(uniform != NULL);
 	assert(uniform->prog != NULL);
 	assert(uniform->type >= 0 && uniform->type < sizeof(type_to_accessors)/sizeof(*type_to_accessors));
+	assert(type == UNIFORM_UNKNOWN || type == uniform->type);
 
 	if(offset >= uniform->array_size) {
 		// completely out of range
@@ -275,6 +293,9 @@ static bool cache_uniforms(ShaderProgram *prog) {
 		return true;
 	}
 
+	prog->dirty_uniforms = calloc(unicount, sizeof(*prog->dirty_uniforms));
+	prog->sampler_uniforms = calloc(unicount, sizeof(*prog->sampler_uniforms));
+
 	char name[maxlen];
 
 	for(int i = 0; i < unicount; ++i) {
@@ -339,6 +360,7 @@ static bool cache_uniforms(ShaderProgram *prog) {
 
 		if(uni.type == UNIFORM_SAMPLER) {
 			list_push(&sampler_uniforms, new_uni);
+			prog->sampler_uniforms[prog->num_sampler_uniforms++] = new_uni;
 		}
 
 		ht_set(&prog->uniforms, name, new_uni);
@@ -396,6 +418,8 @@ void gl33_shader_program_destroy(ShaderProgram *prog) {
 	glDeleteProgram(prog->gl_handle);
 	ht_foreach(&prog->uniforms, free_uniform, NULL);
 	ht_destroy(&prog->uniforms);
+	free(prog->dirty_uniforms);
+	free(prog->sampler_uniforms);
 	free(prog);
 }
 
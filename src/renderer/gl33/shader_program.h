@@ -18,6 +18,14 @@
 struct ShaderProgram {
 	GLuint gl_handle;
 	ht_str2ptr_t uniforms;
+
+	// Uniforms with pending updates, committed in gl33_sync_uniforms.
+	// Both arrays are sized for the total number of uniforms in the program.
+	Uniform **dirty_uniforms;
+	Uniform **sampler_uniforms;
+	uint num_dirty_uniforms;
+	uint num_sampler_uniforms;
+
 	char debug_label[R_DEBUG_LABEL_SIZE];
 };
 
@@ -51,5 +59,5 @@ const char* gl33_shader_program_get_debug_label(ShaderProgram *prog);
 
 Uniform* gl33_shader_uniform(ShaderProgram *prog, const char *uniform_name);
 UniformType gl33_uniform_type(Uniform *uniform);
-void gl33_uniform(Uniform *uniform, uint offset, uint count, const void *data);
+void gl33_uniform(Uniform *uniform, uint offset, uint count, UniformType type, const void *data);
 void gl33_unref_texture_from_samplers(Texture *tex);
@@ -159,6 +159,7 @@ static void gl33_texture_set(Texture *tex, uint mipmap, const Pixmap *image) {
 		image_data
 	);
 
+	gl33_count_call(GL33_CALL_TEXTURE_UPLOAD);
 	free(pix.data.untyped);
 
 	if(tex->pbo) {
@@ -245,6 +246,9 @@ void gl33_texture_set_filter(Texture *tex, TextureFilterMode fmin, TextureFilter
 		gl33_sync_texunit(tex->binding_unit, false, true);
 		tex->params.filter.min = fmin;
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, r_filter_to_gl_filter(fmin));
+		gl33_count_call(GL33_CALL_TEXTURE_PARAMETER);
+	} else {
+		gl33_count_filtered(GL33_CALL_TEXTURE_PARAMETER);
 	}
 
 	if(tex->params.filter.mag != fmag) {
@@ -252,6 +256,9 @@ void gl33_texture_set_filter(Texture *tex, TextureFilterMode fmin, TextureFilter
 		gl33_sync_texunit(tex->binding_unit, false, true);
 		tex->params.filter.mag = fmag;
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, r_filter_to_gl_filter(fmag));
+		gl33_count_call(GL33_CALL_TEXTURE_PARAMETER);
+	} else {
+		gl33_count_filtered(GL33_CALL_TEXTURE_PARAMETER);
 	}
 }
 
@@ -261,6 +268,9 @@ void gl33_texture_set_wrap(Texture *tex, TextureWrapMode ws, TextureWrapMode wt)
 		gl33_sync_texunit(tex->binding_unit, false, true);
 		tex->params.wrap.s = ws;
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, r_wrap_to_gl_wrap(ws));
+		gl33_count_call(GL33_CALL_TEXTURE_PARAMETER);
+	} else {
+		gl33_count_filtered(GL33_CALL_TEXTURE_PARAMETER);
 	}
 
 	if(tex->params.wrap.t != wt) {
@@ -268,6 +278,9 @@ void gl33_texture_set_wrap(Texture *tex, TextureWrapMode ws, TextureWrapMode wt)
 		gl33_sync_texunit(tex->binding_unit, false, true);
 		tex->params.wrap.t = wt;
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, r_wrap_to_gl_wrap(wt));
+		gl33_count_call(GL33_CALL_TEXTURE_PARAMETER);
+	} else {
+		gl33_count_filtered(GL33_CALL_TEXTURE_PARAMETER);
 	}
 }
 
@@ -299,6 +312,7 @@ void gl33_texture_fill_region(Texture *tex, uint mipmap, uint x, uint y, const P
 		pix.data.untyped
 	);
 
+	gl33_count_call(GL33_CALL_TEXTURE_UPLOAD);
 	free(pix.data.untyped);
 	tex->mipmaps_outdated = true;
 }
@@ -22,6 +22,7 @@ static GLenum va_type_to_gl_type[] = {
 	[VA_USHORT] = GL_UNSIGNED_SHORT,
 	[VA_INT]    = GL_INT,
 	[VA_UINT]   = GL_UNSIGNED_INT,
+	[VA_HALF]   = GL_HALF_FLOAT,
 };
 
 VertexArray* gl33_vertex_array_create(void) {
@@ -41,6 +42,7 @@ void gl33_vertex_array_destroy(VertexArray *varr) {
 	gl33_vertex_array_deleted(varr);
 	glDeleteVertexArrays(1, &varr->gl_handle);
 	free(varr->attachments);
+	free(varr->attachment_bases);
 	free(varr->attribute_layout);
 	free(varr);
 }
@@ -82,6 +84,9 @@ static void gl33_vertex_array_update_layout(VertexArray *varr) {
 
 		glEnableVertexAttribArray(i);
 
+		size_t offset = a->offset + vbuf->cbuf.ring.base;
+		varr->attachment_bases[a->attachment] = vbuf->cbuf.ring.base;
+
 		switch(a->spec.coversion) {
 			case VA_CONVERT_FLOAT:
 			case VA_CONVERT_FLOAT_NORMALIZED:
@@ -91,7 +96,7 @@ static void gl33_vertex_array_update_layout(VertexArray *varr) {
 					va_type_to_gl_type[a->spec.type],
 					a->spec.coversion == VA_CONVERT_FLOAT_NORMALIZED,
 					a->stride,
-					(void*)a->offset
+					(void*)offset
 				);
 
 				break;
@@ -102,7 +107,7 @@ static void gl33_vertex_array_update_layout(VertexArray *varr) {
 					a->spec.elements,
 					va_type_to_gl_type[a->spec.type],
 					a->stride,
-					(void*)a->offset
+					(void*)offset
 				);
 
 				break;
@@ -135,10 +140,12 @@ void gl33_vertex_array_attach_vertex_buffer(VertexArray *varr, VertexBuffer *vbu
 	// TODO: more efficient way of handling this?
 	if(attachment >= varr->num_attachments) {
 		varr->attachments = realloc(varr->attachments, (attachment + 1) * sizeof(VertexBuffer*));
+		varr->attachment_bases = realloc(varr->attachment_bases, (attachment + 1) * sizeof(size_t));
 		varr->num_attachments = attachment + 1;
 	}
 
 	varr->attachments[attachment] = vbuf;
+	varr->attachment_bases[attachment] = vbuf ? vbuf->cbuf.ring.base : 0;
 	varr->layout_dirty_bits |= (1u << attachment);
 }
 
@@ -178,6 +185,21 @@ void gl33_vertex_array_set_debug_label(VertexArray *varr, const char *label) {
 }
 
 void gl33_vertex_array_flush_buffers(VertexArray *varr) {
+	// streaming buffers move their data around in the ring when invalidated
+	for(uint i = 0; i < varr->num_attachments; ++i) {
+		VertexBuffer *vbuf = varr->attachments[i];
+
+		if(vbuf == NULL || vbuf->cbuf.ring.base == varr->attachment_bases[i]) {
+			continue;
+		}
+
+		for(uint j = 0; j < varr->num_attributes; ++j) {
+			if(varr->attribute_layout[j].attachment == i) {
+				varr->layout_dirty_bits |= (1u << j);
+			}
+		}
+	}
+
 	if(varr->layout_dirty_bits) {
 		gl33_vertex_array_update_layout(varr);
 	}
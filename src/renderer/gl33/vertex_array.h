@@ -17,6 +17,7 @@
 
 struct VertexArray {
 	VertexBuffer **attachments;
+	size_t *attachment_bases; // ring bases the attribute pointers were set up for
 	VertexAttribFormat *attribute_layout;
 	IndexBuffer *index_attachment;
 	GLuint gl_handle;
@@ -49,3 +49,19 @@ void gl33_vertex_buffer_flush(VertexBuffer *vbuf) {
 SDL_RWops* gl33_vertex_buffer_get_stream(VertexBuffer *vbuf) {
 	return gl33_buffer_get_stream(&vbuf->cbuf);
 }
+
+void* gl33_vertex_buffer_map(VertexBuffer *vbuf, size_t size) {
+	return gl33_buffer_map(&vbuf->cbuf, size);
+}
+
+void* gl33_vertex_buffer_share(VertexBuffer *vbuf, size_t *storage_size) {
+	return gl33_buffer_share(&vbuf->cbuf, storage_size);
+}
+
+void gl33_vertex_buffer_set_window(VertexBuffer *vbuf, size_t offset) {
+	gl33_buffer_set_window(&vbuf->cbuf, offset);
+}
+
+void gl33_vertex_buffer_unshare(VertexBuffer *vbuf, size_t stream_offset) {
+	gl33_buffer_unshare(&vbuf->cbuf, stream_offset);
+}
@@ -21,4 +21,8 @@ void gl33_vertex_buffer_set_debug_label(VertexBuffer *vbuf, const char *label);
 void gl33_vertex_buffer_destroy(VertexBuffer *vbuf);
 void gl33_vertex_buffer_invalidate(VertexBuffer *vbuf);
 SDL_RWops* gl33_vertex_buffer_get_stream(VertexBuffer *vbuf);
+void* gl33_vertex_buffer_map(VertexBuffer *vbuf, size_t size);
+void* gl33_vertex_buffer_share(VertexBuffer *vbuf, size_t *storage_size);
+void gl33_vertex_buffer_set_window(VertexBuffer *vbuf, size_t offset);
+void gl33_vertex_buffer_unshare(VertexBuffer *vbuf, size_t stream_offset);
 void gl33_vertex_buffer_flush(VertexBuffer *vbuf);
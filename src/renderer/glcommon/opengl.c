@@ -169,6 +169,34 @@ static void glcommon_ext_base_instance(void) {
 	log_warn("Extension not supported");
 }
 
+static void glcommon_ext_buffer_storage(void) {
+	if(
+		GL_ATLEAST(4, 4)
+		&& (glext.BufferStorage = glad_glBufferStorage)
+	) {
+		glext.buffer_storage = TSGL_EXTFLAG_NATIVE;
+		log_info("Using core functionality");
+		return;
+	}
+
+	if((glext.buffer_storage = glcommon_check_extension("GL_ARB_buffer_storage"))
+		&& (glext.BufferStorage = glad_glBufferStorage)
+	) {
+		log_info("Using GL_ARB_buffer_storage");
+		return;
+	}
+
+	if((glext.buffer_storage = glcommon_check_extension("GL_EXT_buffer_storage"))
+		&& (glext.BufferStorage = glad_glBufferStorageEXT)
+	) {
+		log_info("Using GL_EXT_buffer_storage");
+		return;
+	}
+
+	glext.buffer_storage = 0;
+	log_warn("Extension not supported");
+}
+
 static void glcommon_ext_pixel_buffer_object(void) {
 	// TODO: verify that these requirements are correct
 	if(GL_ATLEAST(2, 0) || GLES_ATLEAST(3, 0)) {
@@ -533,6 +561,7 @@ void glcommon_check_extensions(void) {
 	}
 
 	glcommon_ext_base_instance();
+	glcommon_ext_buffer_storage();
 	glcommon_ext_clear_texture();
 	glcommon_ext_color_buffer_float();
 	glcommon_ext_debug_output();
@@ -71,6 +71,7 @@ struct glext_s {
 	} version;
 
 	ext_flag_t base_instance;
+	ext_flag_t buffer_storage;
 	ext_flag_t clear_texture;
 	ext_flag_t color_buffer_float;
 	ext_flag_t debug_output;
@@ -128,6 +129,14 @@ struct glext_s {
 	#undef glDrawElementsInstancedBaseInstance
 	#define glDrawElementsInstancedBaseInstance (glext.DrawElementsInstancedBaseInstance)
 
+	//
+	// buffer_storage
+	//
+
+	PFNGLBUFFERSTORAGEPROC BufferStorage;
+	#undef glBufferStorage
+	#define glBufferStorage (glext.BufferStorage)
+
 	//
 	// draw_buffers
 	//
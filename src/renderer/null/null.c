@@ -11,17 +11,64 @@
 #include "../api.h"
 #include "resource/shader_object.h"
 #include "../common/backend.h"
+#include "hashtable.h"
 
 static char placeholder;
 static Color dummycolor;
 
+/*
+ * Uniforms are created on demand, since there is no shader code to reflect on.
+ * Their values are kept around so that sets which wouldn't change anything can
+ * be counted; a real backend shouldn't let those reach the driver.
+ */
+struct Uniform {
+	UniformType type;
+	uint array_size;
+	size_t elem_size;
+	char *value;
+};
+
+struct ShaderProgram {
+	ht_str2ptr_t uniforms;
+};
+
+static struct {
+	ShaderProgram default_program;
+	ShaderProgram *current_program;
+
+	struct {
+		uint64_t sets;
+		uint64_t redundant_sets;
+	} stats;
+} null;
+
 SDL_Window* null_create_window(const char *title, int x, int y, int w, int h, uint32_t flags) {
 	return SDL_CreateWindow(title, x, y, w, h, flags);
 }
 
-void null_init(void) { }
+static void* null_free_uniform(const char *key, void *data, void *arg) {
+	Uniform *uniform = data;
+	free(uniform->value);
+	free(uniform);
+	return NULL;
+}
+
+static void null_program_free_uniforms(ShaderProgram *prog) {
+	ht_foreach(&prog->uniforms, null_free_uniform, NULL);
+	ht_destroy(&prog->uniforms);
+}
+
+void null_init(void) {
+	ht_create(&null.default_program.uniforms);
+	null.current_program = &null.default_program;
+}
+
 void null_post_init(void) { }
-void null_shutdown(void) { }
+
+void null_shutdown(void) {
+	log_info("%"PRIu64" uniform updates, %"PRIu64" of them redundant", null.stats.sets, null.stats.redundant_sets);
+	null_program_free_uniforms(&null.default_program);
+}
 
 bool null_supports(RendererFeature feature) {
 	return true;
@@ -49,21 +96,72 @@ void null_shader_object_destroy(ShaderObject *shobj) { }
 void null_shader_object_set_debug_label(ShaderObject *shobj, const char *label) { }
 const char* null_shader_object_get_debug_label(ShaderObject *shobj) { return "Null shader object"; }
 
-ShaderProgram* null_shader_program_link(uint num_objects, ShaderObject *shobjs[num_objects]) { return (void*)&placeholder; }
-void null_shader_program_destroy(ShaderProgram *prog) { }
+ShaderProgram* null_shader_program_link(uint num_objects, ShaderObject *shobjs[num_objects]) {
+	ShaderProgram *prog = calloc(1, sizeof(*prog));
+	ht_create(&prog->uniforms);
+	return prog;
+}
+
+void null_shader_program_destroy(ShaderProgram *prog) {
+	if(null.current_program == prog) {
+		null.current_program = &null.default_program;
+	}
+
+	null_program_free_uniforms(prog);
+	free(prog);
+}
 void null_shader_program_set_debug_label(ShaderProgram *prog, const char *label) { }
 const char* null_shader_program_get_debug_label(ShaderProgram *prog) { return "Null shader program"; }
 
-void null_shader(ShaderProgram *prog) { }
-ShaderProgram* null_shader_current(void) { return (void*)&placeholder; }
+void null_shader(ShaderProgram *prog) { null.current_program = prog; }
+ShaderProgram* null_shader_current(void) { return null.current_program; }
 
 Uniform* null_shader_uniform(ShaderProgram *prog, const char *uniform_name) {
-	return NULL;
+	Uniform *uniform = ht_get(&prog->uniforms, uniform_name, NULL);
+
+	if(uniform == NULL) {
+		uniform = calloc(1, sizeof(*uniform));
+		uniform->type = UNIFORM_UNKNOWN;
+		ht_set(&prog->uniforms, uniform_name, uniform);
+	}
+
+	return uniform;
 }
 
-void null_uniform(Uniform *uniform, uint offset, uint count, const void *data) { }
+void null_uniform(Uniform *uniform, uint offset, uint count, UniformType type, const void *data) {
+	++null.stats.sets;
+
+	if(type == UNIFORM_UNKNOWN) {
+		if(uniform->type == UNIFORM_UNKNOWN) {
+			// no way to tell how big the data is
+			return;
+		}
+	} else if(uniform->type == UNIFORM_UNKNOWN) {
+		const UniformTypeInfo *typeinfo = r_uniform_type_info(type);
+		uniform->type = type;
+		uniform->elem_size = typeinfo->elements * typeinfo->element_size;
+	} else {
+		assert(uniform->type == type);
+	}
+
+	size_t update_ofs = offset * uniform->elem_size;
+	size_t update_sz = count * uniform->elem_size;
+
+	if(offset + count > uniform->array_size) {
+		// first time these elements are set
+		size_t old_sz = uniform->array_size * uniform->elem_size;
+		uniform->array_size = offset + count;
+		uniform->value = realloc(uniform->value, uniform->array_size * uniform->elem_size);
+		memset(uniform->value + old_sz, 0, uniform->array_size * uniform->elem_size - old_sz);
+	} else if(!memcmp(uniform->value + update_ofs, data, update_sz)) {
+		++null.stats.redundant_sets;
+		return;
+	}
+
+	memcpy(uniform->value + update_ofs, data, update_sz);
+}
 
-UniformType null_uniform_type(Uniform *uniform) { return UNIFORM_FLOAT; }
+UniformType null_uniform_type(Uniform *uniform) { return uniform->type; }
 
 void null_draw(VertexArray *varr, Primitive prim, uint first, uint count, uint instances, uint base_instance) { }
 
@@ -135,6 +233,10 @@ void null_vertex_buffer_set_debug_label(VertexBuffer *vbuf, const char *label) {
 const char* null_vertex_buffer_get_debug_label(VertexBuffer *vbuf) { return "null vertex buffer"; }
 void null_vertex_buffer_destroy(VertexBuffer *vbuf) { }
 void null_vertex_buffer_invalidate(VertexBuffer *vbuf) { }
+void* null_vertex_buffer_map(VertexBuffer *vbuf, size_t size) { return NULL; }
+void* null_vertex_buffer_share(VertexBuffer *vbuf, size_t *storage_size) { return NULL; }
+void null_vertex_buffer_set_window(VertexBuffer *vbuf, size_t offset) { }
+void null_vertex_buffer_unshare(VertexBuffer *vbuf, size_t stream_offset) { }
 
 IndexBuffer* null_index_buffer_create(size_t max_elements) { return (void*)&placeholder; }
 size_t null_index_buffer_get_capacity(IndexBuffer *ibuf) { return UINT32_MAX; }
@@ -163,6 +265,11 @@ void null_vsync(VsyncMode mode) { }
 VsyncMode null_vsync_current(void) { return VSYNC_NONE; }
 
 void null_swap(SDL_Window *window) { }
+void null_frame_stats(RendererFrameStats *stats) { memset(stats, 0, sizeof(*stats)); }
+
+void* null_fence_create(void) { return NULL; }
+bool null_fence_wait(void *fence, uint64_t timeout_ns) { return true; }
+void null_fence_destroy(void *fence) { }
 
 bool null_screenshot(Pixmap *dest) { return false; }
 
@@ -230,6 +337,10 @@ RendererBackend _r_backend_null = {
 		.vertex_buffer_destroy = null_vertex_buffer_destroy,
 		.vertex_buffer_invalidate = null_vertex_buffer_invalidate,
 		.vertex_buffer_get_stream = null_vertex_buffer_get_stream,
+		.vertex_buffer_map = null_vertex_buffer_map,
+		.vertex_buffer_share = null_vertex_buffer_share,
+		.vertex_buffer_set_window = null_vertex_buffer_set_window,
+		.vertex_buffer_unshare = null_vertex_buffer_unshare,
 		.index_buffer_create = null_index_buffer_create,
 		.index_buffer_get_capacity = null_index_buffer_get_capacity,
 		.index_buffer_get_debug_label = null_index_buffer_get_debug_label,
@@ -250,6 +361,10 @@ RendererBackend _r_backend_null = {
 		.vsync = null_vsync,
 		.vsync_current = null_vsync_current,
 		.swap = null_swap,
+		.frame_stats = null_frame_stats,
+		.fence_create = null_fence_create,
+		.fence_wait = null_fence_wait,
+		.fence_destroy = null_fence_destroy,
 		.screenshot = null_screenshot,
 	},
 };
@@ -16,6 +16,7 @@
 #include <time.h>
 
 #include "global.h"
+#include "replay_sse41.h"
 
 static uint8_t replay_magic_header[] = REPLAY_MAGIC_HEADER;
 
@@ -143,10 +144,213 @@ static void replay_write_string(SDL_RWops *file, char *str, uint16_t version) {
 	SDL_RWwrite(file, str, 1, strlen(str));
 }
 
-static bool replay_write_stage_event(ReplayEvent *evt, SDL_RWops *file) {
-	SDL_WriteLE32(file, evt->frame);
-	SDL_WriteU8(file, evt->type);
-	SDL_WriteLE16(file, evt->value);
+static void replay_encode_events(const ReplayEvent *events, size_t num_events, uint8_t *out) {
+	for(size_t i = 0; i < num_events; ++i, out += REPLAY_EVENT_SIZE) {
+		const ReplayEvent *e = events + i;
+		out[0] = e->frame;
+		out[1] = e->frame >> 8;
+		out[2] = e->frame >> 16;
+		out[3] = e->frame >> 24;
+		out[4] = e->type;
+		out[5] = e->value;
+		out[6] = e->value >> 8;
+	}
+}
+
+static void replay_decode_events_scalar(const uint8_t *in, size_t num_events, ReplayEvent *events) {
+	for(size_t i = 0; i < num_events; ++i, in += REPLAY_EVENT_SIZE) {
+		ReplayEvent *e = events + i;
+		e->frame = (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+		e->type = in[4];
+		e->value = (uint16_t)in[5] | ((uint16_t)in[6] << 8);
+	}
+}
+
+static void replay_decode_events(const uint8_t *in, size_t num_events, ReplayEvent *events) {
+#ifdef TAISEI_BUILDCONF_USE_SSE41
+	static int have_sse41 = -1;
+
+	if(have_sse41 < 0) {
+		have_sse41 = SDL_HasSSE41();
+	}
+
+	if(have_sse41) {
+		replay_decode_events_sse41(in, num_events, events);
+		return;
+	}
+#endif
+
+	replay_decode_events_scalar(in, num_events, events);
+}
+
+#define REPLAY_TOKEN_TYPE_MASK 0x0f
+#define REPLAY_TOKEN_TYPE_ESCAPE 0x0f
+#define REPLAY_TOKEN_NEW_VALUE 0x10
+#define REPLAY_TOKEN_DELTA_SHIFT 5
+#define REPLAY_TOKEN_DELTA_ESCAPE 7
+
+static inline uint replay_event_context(uint8_t type) {
+	// presses and releases mostly come in pairs for the same key
+	if(type == EV_RELEASE) {
+		return EV_PRESS;
+	}
+
+	return type < REPLAY_TOKEN_TYPE_ESCAPE ? type : REPLAY_TOKEN_TYPE_ESCAPE;
+}
+
+static size_t replay_pack_varint(uint8_t *out, uint32_t val) {
+	size_t n = 0;
+
+	while(val >= 0x80) {
+		out[n++] = (val & 0x7f) | 0x80;
+		val >>= 7;
+	}
+
+	out[n++] = val;
+	return n;
+}
+
+static bool replay_unpack_varint(const uint8_t **in, const uint8_t *end, uint32_t *val) {
+	uint32_t result = 0;
+
+	for(uint shift = 0; shift < 35; shift += 7) {
+		if(*in == end) {
+			return false;
+		}
+
+		uint8_t byte = *(*in)++;
+		result |= (uint32_t)(byte & 0x7f) << shift;
+
+		if(!(byte & 0x80)) {
+			*val = result;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static size_t replay_pack_events(const ReplayEvent *events, size_t num_events, uint8_t *out) {
+	uint16_t context[REPLAY_TOKEN_TYPE_ESCAPE + 1] = { 0 };
+	uint32_t frame = 0;
+	uint8_t *p = out;
+
+	for(const ReplayEvent *e = events; e < events + num_events; ++e) {
+		uint ctx = replay_event_context(e->type);
+		uint32_t delta = e->frame - frame;
+		int16_t vdelta = (int16_t)(e->value - context[ctx]);
+		uint8_t token = e->type < REPLAY_TOKEN_TYPE_ESCAPE ? e->type : REPLAY_TOKEN_TYPE_ESCAPE;
+
+		token |= (delta < REPLAY_TOKEN_DELTA_ESCAPE ? delta : REPLAY_TOKEN_DELTA_ESCAPE) << REPLAY_TOKEN_DELTA_SHIFT;
+
+		if(vdelta) {
+			token |= REPLAY_TOKEN_NEW_VALUE;
+		}
+
+		*p++ = token;
+
+		if(e->type >= REPLAY_TOKEN_TYPE_ESCAPE) {
+			*p++ = e->type;
+		}
+
+		if(delta >= REPLAY_TOKEN_DELTA_ESCAPE) {
+			p += replay_pack_varint(p, delta - REPLAY_TOKEN_DELTA_ESCAPE);
+		}
+
+		if(vdelta) {
+			uint16_t zigzag = ((uint16_t)vdelta << 1) ^ (uint16_t)(vdelta >> 15);
+			p += replay_pack_varint(p, zigzag - 1u);
+		}
+
+		frame = e->frame;
+		context[ctx] = e->value;
+	}
+
+	return p - out;
+}
+
+static bool replay_unpack_events(const uint8_t *in, size_t size, size_t num_events, ReplayEvent *events) {
+	uint16_t context[REPLAY_TOKEN_TYPE_ESCAPE + 1] = { 0 };
+	uint32_t frame = 0;
+	const uint8_t *end = in + size;
+
+	for(ReplayEvent *e = events; e < events + num_events; ++e) {
+		if(in == end) {
+			return false;
+		}
+
+		uint8_t token = *in++;
+		uint32_t delta = token >> REPLAY_TOKEN_DELTA_SHIFT;
+		uint32_t zigzag;
+
+		e->type = token & REPLAY_TOKEN_TYPE_MASK;
+
+		if(e->type == REPLAY_TOKEN_TYPE_ESCAPE) {
+			if(in == end) {
+				return false;
+			}
+
+			e->type = *in++;
+		}
+
+		if(delta == REPLAY_TOKEN_DELTA_ESCAPE) {
+			if(!replay_unpack_varint(&in, end, &delta)) {
+				return false;
+			}
+
+			delta += REPLAY_TOKEN_DELTA_ESCAPE;
+		}
+
+		uint ctx = replay_event_context(e->type);
+		e->value = context[ctx];
+
+		if(token & REPLAY_TOKEN_NEW_VALUE) {
+			if(!replay_unpack_varint(&in, end, &zigzag) || zigzag > UINT16_MAX - 1) {
+				return false;
+			}
+
+			++zigzag;
+			e->value += (uint16_t)((zigzag >> 1) ^ -(zigzag & 1));
+		}
+
+		e->frame = frame += delta;
+		context[ctx] = e->value;
+	}
+
+	return in == end;
+}
+
+static bool replay_write_stage_events_packed(ReplayStage *stg, SDL_RWops *file) {
+	uint8_t *buf = malloc(stg->numevents * REPLAY_PACKED_EVENT_MAX_SIZE);
+	size_t size = replay_pack_events(stg->events, stg->numevents, buf);
+
+	SDL_WriteLE32(file, size);
+	bool ok = !size || SDL_RWwrite(file, buf, size, 1) == 1;
+
+	if(!ok) {
+		log_warn("SDL_RWwrite() failed: %s", SDL_GetError());
+	}
+
+	free(buf);
+	return ok;
+}
+
+static bool replay_write_stage_events(ReplayStage *stg, SDL_RWops *file, uint16_t version) {
+	if(version >= REPLAY_STRUCT_VERSION_TS102000_REV3) {
+		return replay_write_stage_events_packed(stg, file);
+	}
+
+	uint8_t block[REPLAY_EVENT_BLOCK_SIZE * REPLAY_EVENT_SIZE];
+
+	for(size_t i = 0, n; i < stg->numevents; i += n) {
+		n = imin(stg->numevents - i, REPLAY_EVENT_BLOCK_SIZE);
+		replay_encode_events(stg->events + i, n, block);
+
+		if(SDL_RWwrite(file, block, REPLAY_EVENT_SIZE, n) != n) {
+			log_warn("SDL_RWwrite() failed: %s", SDL_GetError());
+			return false;
+		}
+	}
 
 	return true;
 }
@@ -234,7 +438,7 @@ static void fix_flags(Replay *rpy) {
 bool replay_write(Replay *rpy, SDL_RWops *file, uint16_t version) {
 	uint16_t base_version = (version & ~REPLAY_VERSION_COMPRESSION_BIT);
 	bool compression = (version & REPLAY_VERSION_COMPRESSION_BIT);
-	int i, j;
+	int i;
 
 	SDL_RWwrite(file, replay_magic_header, sizeof(replay_magic_header), 1);
 	SDL_WriteLE16(file, version);
@@ -287,15 +491,12 @@ bool replay_write(Replay *rpy, SDL_RWops *file, uint16_t version) {
 	}
 
 	for(i = 0; i < rpy->numstages; ++i) {
-		ReplayStage *stg = rpy->stages + i;
-		for(j = 0; j < stg->numevents; ++j) {
-			if(!replay_write_stage_event(stg->events + j, vfile)) {
-				if(compression) {
-					SDL_RWclose(vfile);
-				}
-
-				return false;
+		if(!replay_write_stage_events(rpy->stages + i, vfile, base_version)) {
+			if(compression) {
+				SDL_RWclose(vfile);
 			}
+
+			return false;
 		}
 	}
 
@@ -361,6 +562,7 @@ static bool replay_read_header(Replay *rpy, SDL_RWops *file, int64_t filesize, s
 		case REPLAY_STRUCT_VERSION_TS102000_REV0:
 		case REPLAY_STRUCT_VERSION_TS102000_REV1:
 		case REPLAY_STRUCT_VERSION_TS102000_REV2:
+		case REPLAY_STRUCT_VERSION_TS102000_REV3:
 		{
 			if(taisei_version_read(file, &rpy->game_version) != TAISEI_VERSION_SIZE) {
 				log_warn("%s: Failed to read game version", source);
@@ -453,7 +655,38 @@ static bool replay_read_meta(Replay *rpy, SDL_RWops *file, int64_t filesize, con
 	return true;
 }
 
+static bool replay_read_events_packed(ReplayStage *stg, SDL_RWops *file, int64_t filesize, const char *source) {
+	uint32_t size;
+	CHECKPROP(size = SDL_ReadLE32(file), u);
+
+	if(size < stg->numevents || size > stg->numevents * REPLAY_PACKED_EVENT_MAX_SIZE) {
+		log_warn("%s: Invalid packed events size %u", source, size);
+		return false;
+	}
+
+	uint8_t *buf = malloc(size);
+
+	// there is always a trailing byte after the events, so reaching EOF here means the file is truncated
+	if(SDL_RWread(file, buf, size, 1) != 1 || (filesize > 0 && SDL_RWtell(file) == filesize)) {
+		log_warn("%s: Premature EOF", source);
+		free(buf);
+		return false;
+	}
+
+	bool ok = replay_unpack_events(buf, size, stg->numevents, stg->events);
+	free(buf);
+
+	if(!ok) {
+		log_warn("%s: Packed events are corrupt", source);
+	}
+
+	return ok;
+}
+
 static bool replay_read_events(Replay *rpy, SDL_RWops *file, int64_t filesize, const char *source) {
+	uint16_t version = rpy->version & ~REPLAY_VERSION_COMPRESSION_BIT;
+	uint8_t block[REPLAY_EVENT_BLOCK_SIZE * REPLAY_EVENT_SIZE];
+
 	for(int i = 0; i < rpy->numstages; ++i) {
 		ReplayStage *stg = rpy->stages + i;
 
@@ -463,14 +696,25 @@ static bool replay_read_events(Replay *rpy, SDL_RWops *file, int64_t filesize, c
 		}
 
 		stg->events = malloc(sizeof(ReplayEvent) * stg->numevents);
-		memset(stg->events, 0, sizeof(ReplayEvent) * stg->numevents);
 
-		for(int j = 0; j < stg->numevents; ++j) {
-			ReplayEvent *evt = stg->events + j;
+		if(version >= REPLAY_STRUCT_VERSION_TS102000_REV3) {
+			if(!replay_read_events_packed(stg, file, filesize, source)) {
+				return false;
+			}
+
+			continue;
+		}
+
+		for(size_t j = 0, n; j < stg->numevents; j += n) {
+			n = imin(stg->numevents - j, REPLAY_EVENT_BLOCK_SIZE);
+
+			// there is always a trailing byte after the events, so reaching EOF here means the file is truncated
+			if(SDL_RWread(file, block, REPLAY_EVENT_SIZE, n) != n || (filesize > 0 && SDL_RWtell(file) == filesize)) {
+				log_warn("%s: Premature EOF", source);
+				return false;
+			}
 
-			CHECKPROP(evt->frame = SDL_ReadLE32(file), u);
-			CHECKPROP(evt->type = SDL_ReadU8(file), u);
-			CHECKPROP(evt->value = SDL_ReadLE16(file), u);
+			replay_decode_events(block, n, stg->events + j);
 		}
 	}
 
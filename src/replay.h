@@ -38,13 +38,25 @@
 
 	// Taisei v1.2 revision 2: adds graze points
 	#define REPLAY_STRUCT_VERSION_TS102000_REV2 8
+
+	// Taisei v1.2 revision 3: packed event stream (frame deltas, context-predicted values)
+	#define REPLAY_STRUCT_VERSION_TS102000_REV3 9
 /* END supported struct versions */
 
 #define REPLAY_VERSION_COMPRESSION_BIT 0x8000
 #define REPLAY_COMPRESSION_CHUNK_SIZE 4096
 
+// Size of a stored ReplayEvent: frame (u32), type (u8), value (u16); little-endian, no padding
+#define REPLAY_EVENT_SIZE 7
+
+// Events are decoded and encoded in blocks of this many, one read/write call per block
+#define REPLAY_EVENT_BLOCK_SIZE 512
+
+// Upper bound on the size of one event in the packed stream (REPLAY_STRUCT_VERSION_TS102000_REV3 and above)
+#define REPLAY_PACKED_EVENT_MAX_SIZE 10
+
 // What struct version to use when saving recorded replays
-#define REPLAY_STRUCT_VERSION_WRITE (REPLAY_STRUCT_VERSION_TS102000_REV2 | REPLAY_VERSION_COMPRESSION_BIT)
+#define REPLAY_STRUCT_VERSION_WRITE (REPLAY_STRUCT_VERSION_TS102000_REV3 | REPLAY_VERSION_COMPRESSION_BIT)
 
 #define REPLAY_ALLOC_INITIAL 256
 
@@ -175,6 +187,25 @@ typedef struct Replay {
 	//
 	// ReplayStage input_events[];
 
+	/* BEGIN REPLAY_STRUCT_VERSION_TS102000_REV3 and above */
+
+	// The events of each stage are packed instead, preceded by the packed size:
+	//
+	//      uint32_t packed_size;
+	//      uint8_t packed_events[packed_size];
+	//
+	// Each event begins with a token byte:
+	//      bits 0-3: event type, or 15 if the type is stored in a separate byte after the token
+	//      bit 4:    value differs from the predicted one
+	//      bits 5-7: frame delta from the previous event, or 7 if (delta - 7) follows as a varint
+	//
+	// followed by the optional type byte, frame delta and value. The predicted value is the last value
+	// seen in the same context; EV_PRESS and EV_RELEASE share one, every other type has its own.
+	// A differing value is stored as a varint of (zigzag(int16_t)(value - predicted) - 1).
+	// Varints are LEB128: 7 bits per byte, least significant group first, high bit set on all but the last byte.
+
+	/* END REPLAY_STRUCT_VERSION_TS102000_REV3 and above */
+
 	// at least one trailing byte, value doesn't matter
 	// uint8_t useless;
 
@@ -0,0 +1,39 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include <immintrin.h>
+#include <stddef.h>
+#include "replay_sse41.h"
+
+// The shuffle writes events straight into ReplayEvent's in-memory layout.
+static_assert(sizeof(ReplayEvent) == 8, "ReplayEvent layout changed");
+static_assert(offsetof(ReplayEvent, frame) == 0, "ReplayEvent layout changed");
+static_assert(offsetof(ReplayEvent, type) == 4, "ReplayEvent layout changed");
+static_assert(offsetof(ReplayEvent, value) == 6, "ReplayEvent layout changed");
+
+void replay_decode_events_sse41(const uint8_t *in, size_t num_events, ReplayEvent *out) {
+	size_t i = 0;
+
+	// two packed 7-byte events -> two 8-byte structs; byte 5 of each is padding
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 3, 4, -1, 5, 6, 7, 8, 9, 10, 11, -1, 12, 13);
+
+	// 2 events per iteration, but each load reads 16 bytes (2.29 events)
+	for(; i + 3 <= num_events; i += 2) {
+		__m128i ev = _mm_loadu_si128((const __m128i*)(in + i * REPLAY_EVENT_SIZE));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_shuffle_epi8(ev, shuffle));
+	}
+
+	for(; i < num_events; ++i) {
+		const uint8_t *p = in + i * REPLAY_EVENT_SIZE;
+		out[i].frame = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+		out[i].type = p[4];
+		out[i].value = (uint16_t)p[5] | ((uint16_t)p[6] << 8);
+	}
+}
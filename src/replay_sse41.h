@@ -0,0 +1,21 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "replay.h"
+
+/*
+ * SSE4.1 version of the replay event block decoder in replay.c.
+ * Callers must check SDL_HasSSE41() first.
+ */
+
+#ifdef TAISEI_BUILDCONF_USE_SSE41
+	void replay_decode_events_sse41(const uint8_t *in, size_t num_events, ReplayEvent *out) attr_hot;
+#endif
@@ -210,6 +210,14 @@ void* load_animation_begin(const char *filename, uint flags) {
 		return NULL;
 	}
 
+	char buf[strlen(basename) + sizeof(".frame0000")];
+
+	// get the frames loading in parallel; load_animation_end will wait for them
+	for(int i = 0; i < ani->sprite_count; ++i) {
+		snprintf(buf, sizeof(buf), "%s.frame%04d", basename, i);
+		preload_resource(RES_SPRITE, buf, flags);
+	}
+
 	AnimationLoadData *data = malloc(sizeof(AnimationLoadData));
 	data->ani = ani;
 	data->basename = basename;
@@ -289,7 +297,11 @@ void unload_animation(void *vani) {
 	free(ani);
 }
 
-Animation *get_ani(const char *name) {
+Animation *_get_ani(const char *name) {
+	return get_resource(RES_ANIM, name, RESF_DEFAULT)->data;
+}
+
+Animation *_get_ani_atom(ResourceAtom *name) {
 	return get_resource(RES_ANIM, name, RESF_DEFAULT)->data;
 }
 
@@ -35,7 +35,9 @@ void* load_animation_begin(const char *filename, uint flags);
 void* load_animation_end(void *opaque, const char *filename, uint flags);
 void unload_animation(void *vani);
 
-Animation *get_ani(const char *name);
+Animation *_get_ani(const char *name);
+Animation *_get_ani_atom(ResourceAtom *name);
+#define get_ani(name) RES_NAME_GENERIC(name, _get_ani, _get_ani_atom)(name)
 AniSequence *get_ani_sequence(Animation *ani, const char *seqname);
 
 // Returns a sprite for the specified frame from an animation sequence named seqname. 
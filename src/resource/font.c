@@ -770,7 +770,11 @@ static inline void adjust_xpos(Font *font, const char *text, Alignment align, do
 	}
 }
 
-Font* get_font(const char *font) {
+Font* _get_font(const char *font) {
+	return get_resource_data(RES_FONT, font, RESF_DEFAULT);
+}
+
+Font* _get_font_atom(ResourceAtom *font) {
 	return get_resource_data(RES_FONT, font, RESF_DEFAULT);
 }
 
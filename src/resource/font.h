@@ -71,9 +71,14 @@ typedef struct TextParams {
 	Alignment align;
 } TextParams;
 
-Font* get_font(const char *font)
+Font* _get_font(const char *font)
 	attr_nonnull(1);
 
+Font* _get_font_atom(ResourceAtom *font)
+	attr_nonnull(1);
+
+#define get_font(font) RES_NAME_GENERIC(font, _get_font, _get_font_atom)(font)
+
 ShaderProgram* text_get_default_shader(void)
 	attr_returns_nonnull;
 
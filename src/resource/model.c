@@ -248,7 +248,11 @@ static void parse_obj(const char *filename, ObjFileData *data) {
 	SDL_RWclose(rw);
 }
 
-Model* get_model(const char *name) {
+Model* _get_model(const char *name) {
+	return get_resource(RES_MODEL, name, RESF_DEFAULT)->data;
+}
+
+Model* _get_model_atom(ResourceAtom *name) {
 	return get_resource(RES_MODEL, name, RESF_DEFAULT)->data;
 }
 
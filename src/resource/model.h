@@ -44,7 +44,9 @@ void* load_model_begin(const char *path, uint flags);
 void* load_model_end(void *opaque, const char *path, uint flags);
 void unload_model(void*); // Does not delete elements from the VBO, so doing this at runtime is leaking VBO space
 
-Model* get_model(const char *name);
+Model* _get_model(const char *name);
+Model* _get_model_atom(ResourceAtom *name);
+#define get_model(name) RES_NAME_GENERIC(name, _get_model, _get_model_atom)(name)
 
 extern ResourceHandler model_res_handler;
 
@@ -73,6 +73,12 @@ static bool postprocess_load_callback(const char *key, const char *value, void *
 	}
 
 	UniformType type = r_uniform_type(uni);
+
+	if(type == UNIFORM_UNKNOWN) {
+		// the null renderer doesn't know uniform types in advance
+		return true;
+	}
+
 	const UniformTypeInfo *type_info = r_uniform_type_info(type);
 
 	bool integer_type;
@@ -14,6 +14,7 @@
 #include "menu/mainmenu.h"
 #include "events.h"
 #include "taskmanager.h"
+#include "hirestime.h"
 
 #include "texture.h"
 #include "animation.h"
@@ -47,13 +48,37 @@ typedef enum ResourceStatus {
 	RES_STATUS_FAILED,
 } ResourceStatus;
 
-typedef struct InternalResource {
+typedef struct InternalResource InternalResource;
+
+struct InternalResource {
 	Resource res;
-	ResourceStatus status;
+	_Atomic ResourceStatus status; // becomes != RES_STATUS_LOADING only once res is complete
 	SDL_mutex *mutex;
 	SDL_cond *cond;
 	Task *async_task;
-} InternalResource;
+
+	// Preload statistics. Only touched by whichever thread is currently loading this resource.
+	hrtime_t load_time; // time spent in begin_load and end_load, excluding nested loads
+	InternalResource **deps; // resources preloaded while loading this one
+	uint num_deps;
+};
+
+// Tracks the resource being loaded on the current thread, see ires_begin_load and ires_end_load
+typedef struct LoadFrame {
+	InternalResource *ires;
+	hrtime_t nested_time;
+} LoadFrame;
+
+static struct {
+	SDL_mutex *mutex;
+	InternalResource **items;
+	uint num_items;
+	uint capacity;
+	bool active;
+	hrtime_t start_time;
+} preload_batch;
+
+static SDL_TLSID load_frame_tls;
 
 typedef struct ResourceAsyncLoadData {
 	InternalResource *ires;
@@ -63,6 +88,25 @@ typedef struct ResourceAsyncLoadData {
 	void *opaque;
 } ResourceAsyncLoadData;
 
+typedef struct ResourceAtomPrefix ResourceAtomPrefix;
+
+struct ResourceAtomPrefix {
+	ResourceAtomPrefix *next;
+	char *prefix;
+	ResourceAtom *atom;
+};
+
+struct ResourceAtom {
+	char *name;
+	_Atomic(InternalResource*) ires[RES_NUMTYPES]; // last successful lookup per type; cleared on unload
+	_Atomic(ResourceAtomPrefix*) prefixed; // atoms of this name with a prefix prepended
+};
+
+static struct {
+	RCUMap map;
+	SDL_mutex *prefix_mutex;
+} atoms;
+
 static SDL_threadID main_thread_id; // TODO: move this somewhere else
 
 static inline ResourceHandler* get_handler(ResourceType type) {
@@ -75,7 +119,7 @@ static inline ResourceHandler* get_ires_handler(InternalResource *ires) {
 
 static void alloc_handler(ResourceHandler *h) {
 	assert(h != NULL);
-	ht_create(&h->private.mapping);
+	rcumap_create(&h->private.mapping);
 }
 
 static const char* type_name(ResourceType type) {
@@ -101,7 +145,7 @@ static void* valfunc_begin_load_resource(void* arg) {
 static bool try_begin_load_resource(ResourceType type, const char *name, InternalResource **out_ires) {
 	ResourceHandler *handler = get_handler(type);
 	struct valfunc_arg arg = { type };
-	return ht_try_set(&handler->private.mapping, name, &arg, valfunc_begin_load_resource, (void**)out_ires);
+	return rcumap_try_set(&handler->private.mapping, name, &arg, valfunc_begin_load_resource, (void**)out_ires);
 }
 
 static void load_resource_finish(InternalResource *ires, void *opaque, const char *path, const char *name, char *allocated_path, char *allocated_name, ResourceFlags flags);
@@ -166,9 +210,78 @@ static void unload_resource(InternalResource *ires) {
 
 	SDL_DestroyCond(ires->cond);
 	SDL_DestroyMutex(ires->mutex);
+	free(ires->deps);
 	free(ires);
 }
 
+static LoadFrame* push_load_frame(LoadFrame *frame, InternalResource *ires) {
+	LoadFrame *parent = SDL_TLSGet(load_frame_tls);
+	*frame = (LoadFrame) { .ires = ires };
+	SDL_TLSSet(load_frame_tls, frame, NULL);
+	return parent;
+}
+
+static void pop_load_frame(LoadFrame *frame, LoadFrame *parent, hrtime_t elapsed) {
+	frame->ires->load_time += elapsed - frame->nested_time;
+
+	if(parent) {
+		parent->nested_time += elapsed;
+	}
+
+	SDL_TLSSet(load_frame_tls, parent, NULL);
+}
+
+static void* ires_begin_load(InternalResource *ires, const char *path, ResourceFlags flags) {
+	LoadFrame frame, *parent = push_load_frame(&frame, ires);
+	hrtime_t start = time_get();
+	void *opaque = get_ires_handler(ires)->procs.begin_load(path, flags);
+	pop_load_frame(&frame, parent, time_get() - start);
+	return opaque;
+}
+
+static void* ires_end_load(InternalResource *ires, void *opaque, const char *path, ResourceFlags flags) {
+	LoadFrame frame, *parent = push_load_frame(&frame, ires);
+	hrtime_t start = time_get();
+	void *raw = get_ires_handler(ires)->procs.end_load(opaque, path, flags);
+	pop_load_frame(&frame, parent, time_get() - start);
+	return raw;
+}
+
+// Records dep as a dependency of the resource being loaded on this thread, if any.
+static void add_dependency(InternalResource *dep) {
+	LoadFrame *frame = SDL_TLSGet(load_frame_tls);
+
+	if(frame == NULL || frame->ires == dep) {
+		return;
+	}
+
+	InternalResource *ires = frame->ires;
+
+	for(uint i = 0; i < ires->num_deps; ++i) {
+		if(ires->deps[i] == dep) {
+			return;
+		}
+	}
+
+	ires->deps = realloc(ires->deps, sizeof(*ires->deps) * (ires->num_deps + 1));
+	ires->deps[ires->num_deps++] = dep;
+}
+
+static void add_to_preload_batch(InternalResource *ires) {
+	SDL_LockMutex(preload_batch.mutex);
+
+	if(preload_batch.active) {
+		if(preload_batch.num_items == preload_batch.capacity) {
+			preload_batch.capacity = preload_batch.capacity ? preload_batch.capacity * 2 : 64;
+			preload_batch.items = realloc(preload_batch.items, sizeof(*preload_batch.items) * preload_batch.capacity);
+		}
+
+		preload_batch.items[preload_batch.num_items++] = ires;
+	}
+
+	SDL_UnlockMutex(preload_batch.mutex);
+}
+
 static char* get_name(ResourceHandler *handler, const char *path) {
 	if(handler->procs.name) {
 		return handler->procs.name(path);
@@ -181,7 +294,7 @@ static void* load_resource_async_task(void *vdata) {
 	ResourceAsyncLoadData *data = vdata;
 
 	SDL_LockMutex(data->ires->mutex);
-	data->opaque = get_ires_handler(data->ires)->procs.begin_load(data->path, data->flags);
+	data->opaque = ires_begin_load(data->ires, data->path, data->flags);
 	events_emit(TE_RESOURCE_ASYNC_LOADED, 0, data->ires, data);
 	SDL_UnlockMutex(data->ires->mutex);
 
@@ -280,7 +393,7 @@ void load_resource(InternalResource *ires, const char *path, const char *name, R
 		name = allocated_name ? allocated_name : strdup(name);
 		load_resource_async(ires, (char*)path, (char*)name, flags);
 	} else {
-		load_resource_finish(ires, handler->procs.begin_load(path, flags), path, name, allocated_path, allocated_name, flags);
+		load_resource_finish(ires, ires_begin_load(ires, path, flags), path, name, allocated_path, allocated_name, flags);
 	}
 }
 
@@ -313,7 +426,7 @@ static void finalize_resource(InternalResource *ires, const char *name, void *da
 }
 
 static void load_resource_finish(InternalResource *ires, void *opaque, const char *path, const char *name, char *allocated_path, char *allocated_name, ResourceFlags flags) {
-	void *raw = (ires->status == RES_STATUS_FAILED) ? NULL : get_ires_handler(ires)->procs.end_load(opaque, path, flags);
+	void *raw = (ires->status == RES_STATUS_FAILED) ? NULL : ires_end_load(ires, opaque, path, flags);
 
 	name = name ? name : "<name unknown>";
 	path = path ? path : "<path unknown>";
@@ -326,20 +439,114 @@ static void load_resource_finish(InternalResource *ires, void *opaque, const cha
 	free(allocated_name);
 }
 
-Resource* get_resource(ResourceType type, const char *name, ResourceFlags flags) {
-	InternalResource *ires;
-	Resource *res;
+static void* atom_new(void *name) {
+	ResourceAtom *atom = calloc(1, sizeof(*atom));
+	atom->name = strdup(name);
+	return atom;
+}
+
+static void* atom_free(const char *name, void *value, void *arg) {
+	ResourceAtom *atom = value;
+
+	for(ResourceAtomPrefix *p = atomic_load(&atom->prefixed), *next; p; p = next) {
+		next = p->next;
+		free(p->prefix);
+		free(p);
+	}
+
+	free(atom->name);
+	free(atom);
+	return NULL;
+}
+
+ResourceAtom* res_atom(const char *name) {
+	ResourceAtom *atom = rcumap_get(&atoms.map, name, NULL);
+
+	if(atom == NULL) {
+		rcumap_try_set(&atoms.map, name, (void*)name, atom_new, (void**)&atom);
+	}
+
+	return atom;
+}
+
+ResourceAtom* res_atom_prefixed(const char *prefix, const char *name) {
+	ResourceAtom *base = res_atom(name);
+	ResourceAtomPrefix *p;
+
+	for(p = atomic_load_explicit(&base->prefixed, memory_order_acquire); p; p = p->next) {
+		if(!strcmp(p->prefix, prefix)) {
+			return p->atom;
+		}
+	}
+
+	SDL_LockMutex(atoms.prefix_mutex);
+
+	// somebody may have added it while we weren't looking
+	for(p = atomic_load_explicit(&base->prefixed, memory_order_relaxed); p; p = p->next) {
+		if(!strcmp(p->prefix, prefix)) {
+			break;
+		}
+	}
+
+	if(p == NULL) {
+		char *full = strjoin(prefix, name, NULL);
+		p = calloc(1, sizeof(*p));
+		p->prefix = strdup(prefix);
+		p->atom = res_atom(full);
+		p->next = atomic_load_explicit(&base->prefixed, memory_order_relaxed);
+		atomic_store_explicit(&base->prefixed, p, memory_order_release);
+		free(full);
+	}
+
+	SDL_UnlockMutex(atoms.prefix_mutex);
+	return p->atom;
+}
 
-	if(flags & RESF_UNSAFE) {
-		// FIXME: I'm not sure we actually need this functionality.
+const char* res_atom_name(ResourceAtom *atom) {
+	return atom->name;
+}
+
+static void atom_forget_resource(ResourceType type, const char *name) {
+	ResourceAtom *atom = rcumap_get(&atoms.map, name, NULL);
+
+	if(atom != NULL) {
+		atomic_store_explicit(&atom->ires[type], NULL, memory_order_release);
+	}
+}
 
-		ires = ht_get_unsafe(&get_handler(type)->private.mapping, name, NULL);
+Resource* _get_resource_atom(ResourceType type, ResourceAtom *atom, ResourceFlags flags) {
+	if(!(flags & RESF_PERMANENT)) {
+		InternalResource *ires = atomic_load_explicit(&atom->ires[type], memory_order_acquire);
 
-		if(ires != NULL && ires->status == RES_STATUS_LOADED) {
+		if(ires != NULL && atomic_load_explicit(&ires->status, memory_order_acquire) == RES_STATUS_LOADED) {
 			return &ires->res;
 		}
 	}
 
+	Resource *res = _get_resource(type, atom->name, flags);
+
+	if(res != NULL) {
+		// res is the first member of InternalResource
+		atomic_store_explicit(&atom->ires[type], (InternalResource*)res, memory_order_release);
+	}
+
+	return res;
+}
+
+void* _get_resource_data_atom(ResourceType type, ResourceAtom *atom, ResourceFlags flags) {
+	Resource *res = _get_resource_atom(type, atom, flags);
+
+	if(res) {
+		return res->data;
+	}
+
+	return NULL;
+}
+
+static Resource* get_resource_slow(ResourceType type, const char *name, ResourceFlags flags) {
+	InternalResource *ires;
+	Resource *res;
+
 	if(try_begin_load_resource(type, name, &ires)) {
 		SDL_LockMutex(ires->mutex);
 
@@ -379,8 +586,40 @@ Resource* get_resource(ResourceType type, const char *name, ResourceFlags flags)
 	}
 }
 
-void* get_resource_data(ResourceType type, const char *name, ResourceFlags flags) {
-	Resource *res = get_resource(type, name, flags);
+Resource* _get_resource(ResourceType type, const char *name, ResourceFlags flags) {
+	// Fast path: the lookup doesn't lock anything, and neither does checking the status.
+	// Flag promotions still need the slow path. RESF_UNSAFE is no longer needed for this.
+	if(!(flags & RESF_PERMANENT)) {
+		InternalResource *ires = rcumap_get(&get_handler(type)->private.mapping, name, NULL);
+
+		if(ires != NULL && atomic_load_explicit(&ires->status, memory_order_acquire) == RES_STATUS_LOADED) {
+			return &ires->res;
+		}
+	}
+
+	LoadFrame *frame = SDL_TLSGet(load_frame_tls);
+
+	if(frame == NULL) {
+		return get_resource_slow(type, name, flags);
+	}
+
+	// We're inside a loader. Everything spent in here, including waiting for
+	// other threads, counts towards the dependency's load time rather than ours.
+	hrtime_t nested_time = frame->nested_time;
+	hrtime_t start = time_get();
+	Resource *res = get_resource_slow(type, name, flags);
+	frame->nested_time = nested_time + (time_get() - start);
+
+	if(res != NULL) {
+		// res is the first member of InternalResource
+		add_dependency((InternalResource*)res);
+	}
+
+	return res;
+}
+
+void* _get_resource_data(ResourceType type, const char *name, ResourceFlags flags) {
+	Resource *res = _get_resource(type, name, flags);
 
 	if(res) {
 		return res->data;
@@ -396,10 +635,92 @@ void preload_resource(ResourceType type, const char *name, ResourceFlags flags)
 	InternalResource *ires;
 
 	if(try_begin_load_resource(type, name, &ires)) {
+		add_to_preload_batch(ires);
 		SDL_LockMutex(ires->mutex);
 		load_resource(ires, NULL, name, flags | RESF_PRELOAD, !env_get("TAISEI_NOASYNC", false));
 		SDL_UnlockMutex(ires->mutex);
 	}
+
+	add_dependency(ires);
+}
+
+void resource_preload_begin(void) {
+	SDL_LockMutex(preload_batch.mutex);
+	assert(!preload_batch.active);
+	preload_batch.active = true;
+	preload_batch.num_items = 0;
+	preload_batch.start_time = time_get();
+	SDL_UnlockMutex(preload_batch.mutex);
+}
+
+static hrtime_t critical_path_time(InternalResource *ires, ht_int2int_t *memo) {
+	int64_t key = (uintptr_t)ires;
+	int64_t memo_ns;
+
+	if(ht_lookup(memo, key, &memo_ns)) {
+		return memo_ns * 1e-9;
+	}
+
+	// guard against cycles; shouldn't happen, but a broken resource file could cause one
+	ht_set(memo, key, 0);
+
+	hrtime_t longest_dep = 0;
+
+	for(uint i = 0; i < ires->num_deps; ++i) {
+		longest_dep = fmaxl(longest_dep, critical_path_time(ires->deps[i], memo));
+	}
+
+	hrtime_t t = ires->load_time + longest_dep;
+	ht_set(memo, key, (int64_t)(t * 1e9));
+	return t;
+}
+
+void resource_preload_finish(ResourcePreloadProgressCallback progress, void *arg, ResourcePreloadStats *stats) {
+	// Finalize everything in submission order. A loader's end_load pulls in its
+	// dependencies itself, so those get finalized first; meanwhile the workers
+	// keep chewing through the CPU-side work of everything else.
+	// New items may be appended by the workers while we're at it.
+
+	for(uint i = 0;; ++i) {
+		SDL_LockMutex(preload_batch.mutex);
+		uint total = preload_batch.num_items;
+		InternalResource *ires = i < total ? preload_batch.items[i] : NULL;
+		SDL_UnlockMutex(preload_batch.mutex);
+
+		if(ires == NULL) {
+			break;
+		}
+
+		wait_for_resource_load(ires, 0);
+
+		if(progress) {
+			progress(i + 1, total, arg);
+		}
+	}
+
+	SDL_LockMutex(preload_batch.mutex);
+	preload_batch.active = false;
+
+	ResourcePreloadStats s = {
+		.num_resources = preload_batch.num_items,
+		.total_time = time_get() - preload_batch.start_time,
+	};
+
+	ht_int2int_t memo;
+	ht_create(&memo);
+
+	for(uint i = 0; i < preload_batch.num_items; ++i) {
+		InternalResource *ires = preload_batch.items[i];
+		s.work_time += ires->load_time;
+		s.critical_path_time = fmax(s.critical_path_time, critical_path_time(ires, &memo));
+	}
+
+	ht_destroy(&memo);
+	SDL_UnlockMutex(preload_batch.mutex);
+
+	if(stats) {
+		*stats = s;
+	}
 }
 
 void preload_resources(ResourceType type, ResourceFlags flags, const char *firstname, ...) {
@@ -416,6 +737,12 @@ void preload_resources(ResourceType type, ResourceFlags flags, const char *first
 void init_resources(void) {
 	main_thread_id = SDL_ThreadID();
 
+	rcumap_create(&atoms.map);
+	atoms.prefix_mutex = SDL_CreateMutex();
+
+	preload_batch.mutex = SDL_CreateMutex();
+	load_frame_tls = SDL_TLSCreate();
+
 	for(int i = 0; i < RES_NUMTYPES; ++i) {
 		ResourceHandler *h = get_handler(i);
 		alloc_handler(h);
@@ -472,31 +799,35 @@ static void* preload_shaders(const char *path, void *arg) {
 	return NULL;
 }
 
-void* resource_for_each(ResourceType type, void* (*callback)(const char *name, Resource *res, void *arg), void *arg) {
-	ht_str2ptr_ts_iter_t iter;
-	ht_iter_begin(&get_handler(type)->private.mapping, &iter);
-	void *result = NULL;
-
-	while(iter.has_data) {
-		InternalResource *ires = iter.value;
-		char *key = iter.key;
-
-		ht_iter_next(&iter);
+struct resource_for_each_arg {
+	void* (*callback)(const char *name, Resource *res, void *arg);
+	void *arg;
+};
 
-		if(ires->res.data == NULL) {
-			continue;
-		}
+static void* resource_for_each_callback(const char *key, void *value, void *varg) {
+	struct resource_for_each_arg *arg = varg;
+	InternalResource *ires = value;
 
-		if((result = callback(key, &ires->res, arg)) != NULL) {
-			break;
-		}
+	if(ires->res.data == NULL) {
+		return NULL;
 	}
 
-	ht_iter_end(&iter);
-	return result;
+	return arg->callback(key, &ires->res, arg->arg);
+}
+
+void* resource_for_each(ResourceType type, void* (*callback)(const char *name, Resource *res, void *arg), void *arg) {
+	struct resource_for_each_arg fe_arg = { callback, arg };
+	return rcumap_foreach(&get_handler(type)->private.mapping, resource_for_each_callback, &fe_arg);
 }
 
 void load_resources(void) {
+	bool vfs_stats = env_get("TAISEI_VFS_STATS", false);
+	hrtime_t start = time_get();
+
+	if(vfs_stats) {
+		vfs_reset_stats();
+	}
+
 	for(uint i = 0; i < RES_NUMTYPES; ++i) {
 		ResourceHandler *h = get_handler(i);
 		assert(h != NULL);
@@ -512,44 +843,65 @@ void load_resources(void) {
 		log_warn("Loading all shaders now due to TAISEI_PRELOAD_SHADERS");
 		vfs_dir_walk(SHPROG_PATH_PREFIX, preload_shaders, NULL);
 	}
+
+	if(vfs_stats) {
+		VFSStats stats;
+		vfs_get_stats(&stats);
+
+		log_info("VFS: %"PRIu64" lookups (%"PRIu64" cached, %"PRIu64" uncached) in %.3fms; %.3fms total",
+			stats.lookups,
+			stats.cache_hits,
+			stats.cache_misses,
+			stats.time * 1000,
+			(double)(time_get() - start) * 1000
+		);
+	}
 }
 
-void free_resources(bool all) {
-	ht_str2ptr_ts_iter_t iter;
+typedef struct ResourceUnloadList {
+	LIST_INTERFACE(struct ResourceUnloadList);
+	const char *name;
+} ResourceUnloadList;
 
-	for(ResourceType type = 0; type < RES_NUMTYPES; ++type) {
-		ResourceHandler *handler = get_handler(type);
-		InternalResource *ires;
-		ht_str2ptr_ts_key_list_t *unset_list = NULL, *unset_entry;
+struct collect_unload_arg {
+	ResourceUnloadList *list;
+	bool all;
+};
 
-		ht_iter_begin(&handler->private.mapping, &iter);
+static void* collect_unload_callback(const char *key, void *value, void *varg) {
+	struct collect_unload_arg *arg = varg;
+	InternalResource *ires = value;
 
-		for(; iter.has_data; ht_iter_next(&iter)) {
-			ires = iter.value;
+	if(arg->all || !(ires->res.flags & RESF_PERMANENT)) {
+		ResourceUnloadList *entry = calloc(1, sizeof(*entry));
+		// the map never frees keys before it's destroyed
+		entry->name = key;
+		list_push(&arg->list, entry);
+	}
 
-			if(!all && (ires->res.flags & RESF_PERMANENT)) {
-				continue;
-			}
+	return NULL;
+}
 
-			unset_entry = calloc(1, sizeof(*unset_entry));
-			unset_entry->key = iter.key;
-			list_push(&unset_list, unset_entry);
-		}
+void free_resources(bool all) {
+	for(ResourceType type = 0; type < RES_NUMTYPES; ++type) {
+		ResourceHandler *handler = get_handler(type);
+		InternalResource *ires;
+		struct collect_unload_arg arg = { NULL, all };
 
-		ht_iter_end(&iter);
+		rcumap_foreach(&handler->private.mapping, collect_unload_callback, &arg);
 
-		for(ht_str2ptr_ts_key_list_t *c; (c = list_pop(&unset_list));) {
-			char *tmp = c->key;
-			char name[strlen(tmp) + 1];
-			strcpy(name, tmp);
+		for(ResourceUnloadList *c; (c = list_pop(&arg.list));) {
+			const char *name = c->name;
 
-			ires = ht_get(&handler->private.mapping, name, NULL);
+			ires = rcumap_get(&handler->private.mapping, name, NULL);
 			assert(ires != NULL);
 
 			attr_unused ResourceFlags flags = ires->res.flags;
 
+			atom_forget_resource(type, name);
+
 			if(!all) {
-				ht_unset(&handler->private.mapping, name);
+				rcumap_unset(&handler->private.mapping, name);
 			}
 
 			unload_resource(ires);
@@ -568,7 +920,7 @@ void free_resources(bool all) {
 				handler->procs.shutdown();
 			}
 
-			ht_destroy(&handler->private.mapping);
+			rcumap_destroy(&handler->private.mapping);
 		}
 	}
 
@@ -576,6 +928,13 @@ void free_resources(bool all) {
 		return;
 	}
 
+	rcumap_foreach(&atoms.map, atom_free, NULL);
+	rcumap_destroy(&atoms.map);
+	SDL_DestroyMutex(atoms.prefix_mutex);
+
+	SDL_DestroyMutex(preload_batch.mutex);
+	free(preload_batch.items);
+
 	if(!env_get("TAISEI_NOASYNC", 0)) {
 		events_unregister_handler(resource_asyncload_handler);
 	}
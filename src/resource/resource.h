@@ -9,7 +9,10 @@
 #pragma once
 #include "taisei.h"
 
+#include <stdatomic.h>
+
 #include "hashtable.h"
+#include "rcumap.h"
 
 typedef enum ResourceType {
 	RES_TEXTURE,
@@ -89,7 +92,7 @@ typedef struct ResourceHandler {
 	} procs;
 
 	struct {
-		ht_str2ptr_ts_t mapping;
+		RCUMap mapping;
 	} private;
 } ResourceHandler;
 
@@ -103,10 +106,78 @@ void init_resources(void);
 void load_resources(void);
 void free_resources(bool all);
 
-Resource* get_resource(ResourceType type, const char *name, ResourceFlags flags);
-void* get_resource_data(ResourceType type, const char *name, ResourceFlags flags);
+/*
+ * Resource atoms
+ *
+ * An atom is an interned resource name. Interning a name costs one lookup;
+ * after that, getting a resource through its atom is just a couple of pointer
+ * loads, as the atom remembers which resource of each type it resolved to.
+ * Atoms live until the resource subsystem is shut down.
+ *
+ * Every resource getter that takes a name also accepts an atom in its place.
+ */
+
+typedef struct ResourceAtom ResourceAtom;
+
+ResourceAtom* res_atom(const char *name) attr_nonnull(1) attr_returns_nonnull;
+ResourceAtom* res_atom_prefixed(const char *prefix, const char *name) attr_nonnull(1, 2) attr_returns_nonnull;
+const char* res_atom_name(ResourceAtom *atom) attr_nonnull(1) attr_returns_nonnull;
+
+/*
+ * Interns name once per call site and caches the atom in a static.
+ * Use this with constant names in hot paths, e.g. get_sprite(RES_ATOM("proj/ball")).
+ *
+ * Safe to use from any thread: threads that race to fill the cache intern the
+ * same name, get the same atom, and store the same pointer.
+ */
+#define RES_ATOM(name) (__extension__({ \
+	static _Atomic(ResourceAtom*) _res_atom_cache; \
+	ResourceAtom *_res_atom = atomic_load_explicit(&_res_atom_cache, memory_order_acquire); \
+	if(!_res_atom) { \
+		_res_atom = res_atom(name); \
+		atomic_store_explicit(&_res_atom_cache, _res_atom, memory_order_release); \
+	} \
+	_res_atom; \
+}))
+
+// Picks by_atom if name is a ResourceAtom*, by_name otherwise.
+#define RES_NAME_GENERIC(name, by_name, by_atom) _Generic((name), \
+	ResourceAtom* : by_atom, \
+	default       : by_name \
+)
+
+Resource* _get_resource(ResourceType type, const char *name, ResourceFlags flags);
+Resource* _get_resource_atom(ResourceType type, ResourceAtom *atom, ResourceFlags flags) attr_nonnull(2);
+#define get_resource(type, name, flags) RES_NAME_GENERIC(name, _get_resource, _get_resource_atom)(type, name, flags)
+
+void* _get_resource_data(ResourceType type, const char *name, ResourceFlags flags);
+void* _get_resource_data_atom(ResourceType type, ResourceAtom *atom, ResourceFlags flags) attr_nonnull(2);
+#define get_resource_data(type, name, flags) RES_NAME_GENERIC(name, _get_resource_data, _get_resource_data_atom)(type, name, flags)
+
 void preload_resource(ResourceType type, const char *name, ResourceFlags flags);
 void preload_resources(ResourceType type, ResourceFlags flags, const char *firstname, ...) attr_sentinel;
+
+/*
+ * Preload batches
+ *
+ * Everything preloaded between resource_preload_begin() and resource_preload_finish() is
+ * tracked, including dependencies that loaders preload on their own (a sprite preloads its
+ * texture, a shader program its objects, and so on). The CPU-side work of all of them runs on
+ * the task manager in parallel. resource_preload_finish() then finalizes them on the calling
+ * thread, which must be the main thread, dependencies first.
+ */
+
+typedef struct ResourcePreloadStats {
+	uint num_resources;
+	double total_time;          // wall-clock time from resource_preload_begin to the end of resource_preload_finish
+	double work_time;           // sum of the time spent loading each resource, on all threads
+	double critical_path_time;  // the longest chain of dependent loads; the lower bound for total_time
+} ResourcePreloadStats;
+
+typedef void (*ResourcePreloadProgressCallback)(uint num_done, uint num_total, void *arg);
+
+void resource_preload_begin(void);
+void resource_preload_finish(ResourcePreloadProgressCallback progress, void *arg, ResourcePreloadStats *stats);
 void* resource_for_each(ResourceType type, void* (*callback)(const char *name, Resource *res, void *arg), void *arg);
 
 void resource_util_strip_ext(char *path);
@@ -10,6 +10,7 @@
 
 #include "util.h"
 #include "shader_program.h"
+#include "hashtable.h"
 #include "renderer/api.h"
 
 static char* shader_program_path(const char *name) {
@@ -24,8 +25,12 @@ struct shprog_load_data {
 	int num_objects;
 	uint load_flags;
 	char *objlist;
+	char *compact_variant;
 };
 
+// ShaderProgram* -> ResourceAtom* of its compact sprite layout variant
+static ht_int2int_t compact_variants;
+
 static void* load_shader_program_begin(const char *path, uint flags) {
 	struct shprog_load_data ldata;
 	memset(&ldata, 0, sizeof(ldata));
@@ -34,14 +39,20 @@ static void* load_shader_program_begin(const char *path, uint flags) {
 	char *strobjects = NULL;
 
 	if(!parse_keyvalue_file_with_spec(path, (KVSpec[]){
-		{ "glsl_objects", .out_str = &strobjects, KVSPEC_DEPRECATED("objects") },
-		{ "objects",      .out_str = &strobjects },
+		{ "glsl_objects",           .out_str = &strobjects, KVSPEC_DEPRECATED("objects") },
+		{ "objects",                .out_str = &strobjects },
+		{ "sprite_compact_variant", .out_str = &ldata.compact_variant },
 		{ NULL }
 	})) {
 		free(ldata.objlist);
+		free(ldata.compact_variant);
 		return NULL;
 	}
 
+	if(ldata.compact_variant) {
+		preload_resource(RES_SHADER_PROGRAM, ldata.compact_variant, ldata.load_flags);
+	}
+
 	if(strobjects) {
 		ldata.objlist = calloc(1, strlen(strobjects) + 1);
 		char *listptr = ldata.objlist;
@@ -62,6 +73,7 @@ static void* load_shader_program_begin(const char *path, uint flags) {
 	if(!ldata.num_objects) {
 		log_warn("%s: no shader objects to link", path);
 		free(ldata.objlist);
+		free(ldata.compact_variant);
 		return NULL;
 	}
 
@@ -84,6 +96,7 @@ static void* load_shader_program_end(void *opaque, const char *path, uint flags)
 		if(!(objs[i] = get_resource_data(RES_SHADER_OBJECT, objname, ldata.load_flags))) {
 			log_warn("%s: couldn't load shader object '%s'", path, objname);
 			free(ldata.objlist);
+			free(ldata.compact_variant);
 			return NULL;
 		}
 
@@ -97,17 +110,42 @@ static void* load_shader_program_end(void *opaque, const char *path, uint flags)
 		char *basename = resource_util_basename(SHPROG_PATH_PREFIX, path);
 		r_shader_program_set_debug_label(prog, basename);
 		free(basename);
+
+		if(ldata.compact_variant) {
+			ResourceAtom *variant = res_atom(ldata.compact_variant);
+			ht_set(&compact_variants, (uintptr_t)prog, (uintptr_t)variant);
+		}
 	} else {
 		log_warn("%s: couldn't link shader program", path);
 	}
 
+	free(ldata.compact_variant);
 	return prog;
 }
 
 static void unload_shader_program(void *vprog) {
+	ht_unset(&compact_variants, (uintptr_t)vprog);
 	r_shader_program_destroy(vprog);
 }
 
+static void init_shader_programs(void) {
+	ht_create(&compact_variants);
+}
+
+static void shutdown_shader_programs(void) {
+	ht_destroy(&compact_variants);
+}
+
+ShaderProgram* shader_program_get_compact_variant(ShaderProgram *prog) {
+	ResourceAtom *variant = (ResourceAtom*)(uintptr_t)ht_get(&compact_variants, (uintptr_t)prog, 0);
+
+	if(variant == NULL) {
+		return NULL;
+	}
+
+	return get_resource_data(RES_SHADER_PROGRAM, variant, RESF_OPTIONAL);
+}
+
 ResourceHandler shader_program_res_handler = {
 	.type = RES_SHADER_PROGRAM,
 	.typename = "shader program",
@@ -119,5 +157,7 @@ ResourceHandler shader_program_res_handler = {
 		.begin_load = load_shader_program_begin,
 		.end_load = load_shader_program_end,
 		.unload = unload_shader_program,
+		.init = init_shader_programs,
+		.shutdown = shutdown_shader_programs,
 	},
 };
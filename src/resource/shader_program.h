@@ -15,5 +15,10 @@ typedef struct ShaderProgram ShaderProgram;
 
 extern ResourceHandler shader_program_res_handler;
 
+// Returns the variant of prog that reads the compact sprite instance layout
+// (SPRITE_COMPACT in interface/sprite.glslh), or NULL if it has none. The
+// variant is named by the sprite_compact_variant key in the .prog file.
+ShaderProgram* shader_program_get_compact_variant(ShaderProgram *prog) attr_nonnull(1);
+
 #define SHPROG_PATH_PREFIX "res/shader/"
 #define SHPROG_EXT ".prog"
@@ -9,6 +9,7 @@
 #include "taisei.h"
 
 #include "sprite.h"
+#include "sprite_index.h"
 #include "video.h"
 #include "renderer/api.h"
 
@@ -23,6 +24,8 @@ ResourceHandler sprite_res_handler = {
 		.begin_load = load_sprite_begin,
 		.end_load = load_sprite_end,
 		.unload = free,
+		.init = sprite_index_init,
+		.shutdown = sprite_index_shutdown,
 	},
 };
 
@@ -57,6 +60,20 @@ void* load_sprite_begin(const char *path, uint flags) {
 
 	if(check_texture_path(path)) {
 		state->texture_name = resource_util_basename(TEX_PATH_PREFIX, path);
+		preload_resource(RES_TEXTURE, state->texture_name, flags);
+		return state;
+	}
+
+	char *name = resource_util_basename(SPRITE_PATH_PREFIX, path);
+	const SpriteIndexEntry *indexed = sprite_index_lookup(name, path);
+	free(name);
+
+	if(indexed) {
+		state->texture_name = strdup(indexed->texture);
+		spr->tex_area = indexed->region;
+		spr->w = indexed->w;
+		spr->h = indexed->h;
+		preload_resource(RES_TEXTURE, state->texture_name, flags);
 		return state;
 	}
 
@@ -82,6 +99,9 @@ void* load_sprite_begin(const char *path, uint flags) {
 		log_warn("%s: inferred texture name from sprite name", state->texture_name);
 	}
 
+	// start decoding the texture right away; load_sprite_end will wait for it
+	preload_resource(RES_TEXTURE, state->texture_name, flags);
+
 	return state;
 }
 
@@ -142,18 +162,23 @@ void* load_sprite_end(void *opaque, const char *path, uint flags) {
 	return spr;
 }
 
-Sprite* get_sprite(const char *name) {
+Sprite* _get_sprite(const char *name) {
+	return get_resource(RES_SPRITE, name, RESF_DEFAULT | RESF_UNSAFE)->data;
+}
+
+Sprite* _get_sprite_atom(ResourceAtom *name) {
 	return get_resource(RES_SPRITE, name, RESF_DEFAULT | RESF_UNSAFE)->data;
 }
 
 Sprite* prefix_get_sprite(const char *name, const char *prefix) {
-	char *full = strjoin(prefix, name, NULL);
-	Sprite *spr = get_sprite(full);
-	free(full);
-	return spr;
+	return get_sprite(res_atom_prefixed(prefix, name));
+}
+
+void _draw_sprite(float x, float y, const char *name) {
+	draw_sprite_p(x, y, get_sprite(name));
 }
 
-void draw_sprite(float x, float y, const char *name) {
+void _draw_sprite_atom(float x, float y, ResourceAtom *name) {
 	draw_sprite_p(x, y, get_sprite(name));
 }
 
@@ -161,7 +186,11 @@ void draw_sprite_p(float x, float y, Sprite *spr) {
 	draw_sprite_ex(x, y, 1, 1, false, spr);
 }
 
-void draw_sprite_batched(float x, float y, const char *name) {
+void _draw_sprite_batched(float x, float y, const char *name) {
+	draw_sprite_ex(x, y, 1, 1, true, get_sprite(name));
+}
+
+void _draw_sprite_batched_atom(float x, float y, ResourceAtom *name) {
 	draw_sprite_ex(x, y, 1, 1, true, get_sprite(name));
 }
 
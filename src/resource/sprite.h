@@ -24,16 +24,22 @@ void* load_sprite_begin(const char *path, uint flags);
 void* load_sprite_end(void *opaque, const char *path, uint flags);
 bool check_sprite_path(const char *path);
 
-void draw_sprite(float x, float y, const char *name);
+void _draw_sprite(float x, float y, const char *name);
+void _draw_sprite_atom(float x, float y, ResourceAtom *name);
+#define draw_sprite(x, y, name) RES_NAME_GENERIC(name, _draw_sprite, _draw_sprite_atom)(x, y, name)
 void draw_sprite_p(float x, float y, Sprite *spr);
-void draw_sprite_batched(float x, float y, const char *name);
+void _draw_sprite_batched(float x, float y, const char *name);
+void _draw_sprite_batched_atom(float x, float y, ResourceAtom *name);
+#define draw_sprite_batched(x, y, name) RES_NAME_GENERIC(name, _draw_sprite_batched, _draw_sprite_batched_atom)(x, y, name)
 void draw_sprite_batched_p(float x, float y, Sprite *spr);
 void draw_sprite_ex(float x, float y, float scale_x, float scale_y, bool batched, Sprite *spr);
 
 void begin_draw_sprite(float x, float y, float scale_x, float scale_y, Sprite *spr);
 void end_draw_sprite(void);
 
-Sprite* get_sprite(const char *name);
+Sprite* _get_sprite(const char *name);
+Sprite* _get_sprite_atom(ResourceAtom *name);
+#define get_sprite(name) RES_NAME_GENERIC(name, _get_sprite, _get_sprite_atom)(name)
 Sprite* prefix_get_sprite(const char *name, const char *prefix);
 
 extern ResourceHandler sprite_res_handler;
@@ -0,0 +1,301 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include <zlib.h>
+
+#include "sprite_index.h"
+#include "sprite.h"
+#include "hashtable.h"
+#include "util.h"
+
+/*
+ * File format (little-endian):
+ *
+ *   char     magic[8]          "TSPRIDX\0"
+ *   u32      version
+ *   u32      num_textures
+ *   u32      num_sprites
+ *
+ *   num_textures times:
+ *     u16    name_len
+ *     char   name[name_len]
+ *
+ *   num_sprites times:
+ *     u16    name_len
+ *     char   name[name_len]
+ *     u16    texture           index into the texture table
+ *     u32    def_size          size of the .spr file this entry was generated with
+ *     u32    def_crc           CRC-32 of that file
+ *     f32    region_x, region_y, region_w, region_h
+ *     f32    w, h              0 if unspecified
+ */
+
+#define SPRITE_INDEX_EXTENSION ".spridx"
+#define SPRITE_INDEX_MAGIC "TSPRIDX"
+#define SPRITE_INDEX_VERSION 2
+
+typedef struct IndexedSprite {
+	SpriteIndexEntry entry;
+	uint32_t def_size;
+	uint32_t def_crc;
+} IndexedSprite;
+
+typedef struct SpriteIndexFile {
+	struct SpriteIndexFile *next;
+	IndexedSprite *sprites;
+	char *strings;
+} SpriteIndexFile;
+
+typedef struct IndexReader {
+	const uint8_t *pos;
+	const uint8_t *end;
+	char *strings;
+	bool error;
+} IndexReader;
+
+static struct {
+	ht_str2ptr_t sprites;
+	SpriteIndexFile *files;
+	bool enabled;
+} sprindex;
+
+static const uint8_t* read_bytes(IndexReader *r, size_t size) {
+	if(r->error || (size_t)(r->end - r->pos) < size) {
+		r->error = true;
+		return NULL;
+	}
+
+	const uint8_t *p = r->pos;
+	r->pos += size;
+	return p;
+}
+
+static uint16_t read_u16(IndexReader *r) {
+	const uint8_t *p = read_bytes(r, 2);
+	return p ? (uint16_t)(p[0] | p[1] << 8) : 0;
+}
+
+static uint32_t read_u32(IndexReader *r) {
+	const uint8_t *p = read_bytes(r, 4);
+	return p ? (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24 : 0;
+}
+
+static float read_f32(IndexReader *r) {
+	uint32_t u = read_u32(r);
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+static char* read_str(IndexReader *r) {
+	uint16_t len = read_u16(r);
+	const uint8_t *p = read_bytes(r, len);
+
+	if(!p) {
+		return NULL;
+	}
+
+	char *s = r->strings;
+	memcpy(s, p, len);
+	s[len] = 0;
+	r->strings += len + 1;
+	return s;
+}
+
+static bool parse_index(const char *path, const uint8_t *data, size_t size) {
+	IndexReader r = { .pos = data, .end = data + size };
+	const uint8_t *magic = read_bytes(&r, 8);
+
+	if(!magic || memcmp(magic, SPRITE_INDEX_MAGIC, 8)) {
+		log_warn("%s: not a sprite index", path);
+		return false;
+	}
+
+	uint32_t version = read_u32(&r);
+
+	if(version != SPRITE_INDEX_VERSION) {
+		log_warn("%s: unsupported version %u", path, version);
+		return false;
+	}
+
+	uint32_t num_textures = read_u32(&r);
+	uint32_t num_sprites = read_u32(&r);
+
+	// every record takes at least 2 bytes, which rules out absurd counts
+	if(r.error || num_textures > UINT16_MAX || num_textures > size / 2 || num_sprites > size / 2) {
+		log_warn("%s: corrupted header", path);
+		return false;
+	}
+
+	// the strings can't be longer than the file itself; +1 per string for the terminators
+	SpriteIndexFile *file = calloc(1, sizeof(*file));
+	file->strings = r.strings = malloc(size + num_textures + num_sprites);
+	file->sprites = calloc(num_sprites, sizeof(*file->sprites));
+	const char **textures = calloc(num_textures + 1, sizeof(*textures));
+
+	for(uint32_t i = 0; i < num_textures; ++i) {
+		textures[i] = read_str(&r);
+	}
+
+	for(uint32_t i = 0; i < num_sprites && !r.error; ++i) {
+		IndexedSprite *s = file->sprites + i;
+		char *name = read_str(&r);
+		uint16_t texture = read_u16(&r);
+		s->def_size = read_u32(&r);
+		s->def_crc = read_u32(&r);
+		s->entry.region.x = read_f32(&r);
+		s->entry.region.y = read_f32(&r);
+		s->entry.region.w = read_f32(&r);
+		s->entry.region.h = read_f32(&r);
+		s->entry.w = read_f32(&r);
+		s->entry.h = read_f32(&r);
+
+		if(r.error) {
+			break;
+		}
+
+		if(texture >= num_textures) {
+			r.error = true;
+			break;
+		}
+
+		s->entry.texture = textures[texture];
+
+		if(ht_get(&sprindex.sprites, name, NULL)) {
+			log_warn("%s: sprite '%s' is already defined by another index, ignoring", path, name);
+			continue;
+		}
+
+		ht_set(&sprindex.sprites, name, s);
+	}
+
+	free(textures);
+
+	if(r.error) {
+		// entries added so far stay valid; we just keep the file around
+		log_warn("%s: truncated or corrupted sprite index", path);
+	}
+
+	file->next = sprindex.files;
+	sprindex.files = file;
+
+	log_debug("%s: %u sprites", path, num_sprites);
+	return !r.error;
+}
+
+static void load_index(const char *path) {
+	SDL_RWops *rw = vfs_open(path, VFS_MODE_READ);
+
+	if(!rw) {
+		log_warn("VFS error: %s", vfs_get_error());
+		return;
+	}
+
+	int64_t size = SDL_RWsize(rw);
+
+	if(size <= 0) {
+		log_warn("%s: couldn't determine the file size", path);
+		SDL_RWclose(rw);
+		return;
+	}
+
+	uint8_t *data = malloc(size);
+
+	if(SDL_RWread(rw, data, size, 1) == 1) {
+		parse_index(path, data, size);
+	} else {
+		log_warn("%s: read error: %s", path, SDL_GetError());
+	}
+
+	free(data);
+	SDL_RWclose(rw);
+}
+
+static bool index_filter(const char *name) {
+	return strendswith(name, SPRITE_INDEX_EXTENSION);
+}
+
+void sprite_index_init(void) {
+	ht_create(&sprindex.sprites);
+	sprindex.enabled = env_get("TAISEI_SPRITE_INDEX", true);
+
+	if(!sprindex.enabled) {
+		return;
+	}
+
+	size_t num_files;
+	char **files = vfs_dir_list_sorted(SPRITE_PATH_PREFIX, &num_files, vfs_dir_list_order_ascending, index_filter);
+
+	if(!files) {
+		log_warn("VFS error: %s", vfs_get_error());
+		return;
+	}
+
+	for(size_t i = 0; i < num_files; ++i) {
+		char *path = strjoin(SPRITE_PATH_PREFIX, files[i], NULL);
+		load_index(path);
+		free(path);
+	}
+
+	vfs_dir_list_free(files, num_files);
+}
+
+void sprite_index_shutdown(void) {
+	ht_destroy(&sprindex.sprites);
+
+	for(SpriteIndexFile *next; sprindex.files; sprindex.files = next) {
+		next = sprindex.files->next;
+		free(sprindex.files->sprites);
+		free(sprindex.files->strings);
+		free(sprindex.files);
+	}
+}
+
+static bool def_matches(const char *path, IndexedSprite *s) {
+	// a size of 0 means the VFS backend doesn't know; the checksum decides then
+	VFSInfo info = vfs_query(path);
+
+	if(info.size && info.size != s->def_size) {
+		return false;
+	}
+
+	SDL_RWops *rw = vfs_open(path, VFS_MODE_READ);
+
+	if(!rw) {
+		return false;
+	}
+
+	// definitions are tiny; reading one is still much cheaper than parsing it
+	uint8_t buf[1024];
+	uint32_t crc = crc32(0, NULL, 0);
+	size_t total = 0;
+
+	for(size_t len; (len = SDL_RWread(rw, buf, 1, sizeof(buf))) > 0; total += len) {
+		crc = crc32(crc, buf, len);
+	}
+
+	SDL_RWclose(rw);
+	return total == s->def_size && crc == s->def_crc;
+}
+
+const SpriteIndexEntry* sprite_index_lookup(const char *name, const char *path) {
+	IndexedSprite *s = ht_get(&sprindex.sprites, name, NULL);
+
+	if(s == NULL) {
+		return NULL;
+	}
+
+	if(!def_matches(path, s)) {
+		log_debug("%s: definition differs from the sprite index, loading it directly", path);
+		return NULL;
+	}
+
+	return &s->entry;
+}
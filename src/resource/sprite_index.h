@@ -0,0 +1,36 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "util/geometry.h"
+
+/*
+ * Packed sprite definitions (.spridx files in res/gfx), generated by
+ * gen-atlas.py next to the .spr files. Each index covers a whole atlas and is
+ * read in one go at startup, so that atlas sprites don't need to be opened and
+ * parsed one by one.
+ *
+ * An entry is only used if the corresponding .spr file still has the size and
+ * CRC-32 it had when the index was generated; otherwise the .spr file has been
+ * edited or overridden, and takes precedence.
+ */
+
+typedef struct SpriteIndexEntry {
+	const char *texture;
+	FloatRect region;
+	float w; // 0 if unspecified
+	float h; // 0 if unspecified
+} SpriteIndexEntry;
+
+void sprite_index_init(void);
+void sprite_index_shutdown(void);
+
+// Returns NULL if the sprite at path must be loaded from its definition file.
+const SpriteIndexEntry* sprite_index_lookup(const char *name, const char *path) attr_nonnull(1, 2);
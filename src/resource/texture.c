@@ -14,6 +14,7 @@
 #include "video.h"
 #include "renderer/api.h"
 #include "util/pixmap.h"
+#include "texture_cache.h"
 
 static void* load_texture_begin(const char *path, uint flags);
 static void* load_texture_end(void *opaque, const char *path, uint flags);
@@ -30,6 +31,7 @@ ResourceHandler texture_res_handler = {
 		.begin_load = load_texture_begin,
 		.end_load = load_texture_end,
 		.unload = (ResourceUnloadProc)free_texture,
+		.init = texture_cache_init,
 	},
 };
 
@@ -250,6 +252,7 @@ static bool parse_format(const char *val, PixmapFormat *out) {
 typedef struct TextureLoadData {
 	Pixmap pixmap;
 	TextureParams params;
+	bool premultiplied;
 } TextureLoadData;
 
 static void* load_texture_begin(const char *path, uint flags) {
@@ -341,20 +344,30 @@ static void* load_texture_begin(const char *path, uint flags) {
 		}
 	}
 
-	if(!pixmap_load_file(source, &ld.pixmap)) {
-		free(source_allocated);
-		log_warn("%s: couldn't load texture image", source);
-		return NULL;
-	}
+	PixmapOrigin origin = r_supports(RFEAT_TEXTURE_BOTTOMLEFT_ORIGIN) ? PIXMAP_ORIGIN_BOTTOMLEFT : PIXMAP_ORIGIN_TOPLEFT;
 
-	free(source_allocated);
+	if(texture_cache_enabled()) {
+		if(!texture_cache_load(source, override_format, origin, TEXCACHE_PREMULTIPLY_ALPHA, &ld.pixmap)) {
+			free(source_allocated);
+			log_warn("%s: couldn't load texture image", source);
+			return NULL;
+		}
 
-	if(r_supports(RFEAT_TEXTURE_BOTTOMLEFT_ORIGIN)) {
-		pixmap_flip_to_origin_inplace(&ld.pixmap, PIXMAP_ORIGIN_BOTTOMLEFT);
+		// Already premultiplied on the CPU, so we can skip texture_post_load.
+		ld.premultiplied = true;
+		ld.params.mipmap_mode = TEX_MIPMAP_AUTO;
 	} else {
-		pixmap_flip_to_origin_inplace(&ld.pixmap, PIXMAP_ORIGIN_TOPLEFT);
+		if(!pixmap_load_file(source, &ld.pixmap)) {
+			free(source_allocated);
+			log_warn("%s: couldn't load texture image", source);
+			return NULL;
+		}
+
+		pixmap_flip_to_origin_inplace(&ld.pixmap, origin);
 	}
 
+	free(source_allocated);
+
 	override_format = override_format ? override_format : ld.pixmap.format;
 	ld.params.type = pixmap_format_to_texture_type(override_format);
 	log_debug("%s: %d channels, %d bits per channel, %s",
@@ -435,24 +448,28 @@ static void* load_texture_end(void *opaque, const char *path, uint flags) {
 	r_texture_set_debug_label(texture, basename);
 	r_texture_fill(texture, 0, &ld->pixmap);
 	free(ld->pixmap.data.untyped);
-	free(ld);
 
-	texture = texture_post_load(texture);
-	r_texture_set_debug_label(texture, basename);
+	if(!ld->premultiplied) {
+		texture = texture_post_load(texture);
+		r_texture_set_debug_label(texture, basename);
+	}
+
 	free(basename);
+	free(ld);
 
 	return texture;
 }
 
-Texture* get_tex(const char *name) {
+Texture* _get_tex(const char *name) {
+	return r_texture_get(name);
+}
+
+Texture* _get_tex_atom(ResourceAtom *name) {
 	return r_texture_get(name);
 }
 
 Texture* prefix_get_tex(const char *name, const char *prefix) {
-	char *full = strjoin(prefix, name, NULL);
-	Texture *tex = get_tex(full);
-	free(full);
-	return tex;
+	return get_tex(res_atom_prefixed(prefix, name));
 }
 
 static void free_texture(Texture *tex) {
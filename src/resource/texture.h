@@ -33,7 +33,9 @@ void fill_screen_p(Texture *tex);
 void loop_tex_line_p(complex a, complex b, float w, float t, Texture *texture);
 void loop_tex_line(complex a, complex b, float w, float t, const char *texture);
 
-Texture* get_tex(const char *name);
+Texture* _get_tex(const char *name);
+Texture* _get_tex_atom(ResourceAtom *name);
+#define get_tex(name) RES_NAME_GENERIC(name, _get_tex, _get_tex_atom)(name)
 Texture* prefix_get_tex(const char *name, const char *prefix);
 
 extern ResourceHandler texture_res_handler;
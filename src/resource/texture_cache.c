@@ -0,0 +1,223 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "texture_cache.h"
+#include "util.h"
+
+#define TEXCACHE_DIR "storage/cache/textures"
+#define TEXCACHE_EXTENSION ".pxc"
+#define TEXCACHE_MAGIC "TSPXCACH"
+#define TEXCACHE_VERSION 2
+#define TEXCACHE_BYTE_ORDER 0x01020304
+
+typedef struct TextureCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order; // rejects caches copied from a machine with a different endianness
+	uint64_t source_size;
+	int64_t source_mtime;
+	uint32_t source_path_len; // the path follows the header, without a terminating NUL
+	uint32_t format;
+	uint32_t origin;
+	uint32_t width;
+	uint32_t height;
+	uint32_t requested_format; // 0 if the decoded format was kept
+	uint32_t flags;
+	uint32_t reserved;
+	uint64_t data_size; // the pixel data follows the path
+} TextureCacheHeader;
+
+static struct {
+	bool enabled;
+} texcache;
+
+void texture_cache_init(void) {
+	texcache.enabled = env_get("TAISEI_TEXTURE_CACHE", true);
+
+	if(!texcache.enabled) {
+		return;
+	}
+
+	if(!vfs_mkdir("storage/cache") || !vfs_mkdir(TEXCACHE_DIR)) {
+		log_warn("Texture cache disabled: %s", vfs_get_error());
+		texcache.enabled = false;
+	}
+}
+
+bool texture_cache_enabled(void) {
+	return texcache.enabled;
+}
+
+static char* cache_path(const char *source_path) {
+	char *name = strdup(source_path);
+
+	for(char *c = name; *c; ++c) {
+		if(*c == '/' || *c == '\\' || *c == ':') {
+			*c = '_';
+		}
+	}
+
+	char *path = strfmt("%s/%s%s", TEXCACHE_DIR, name, TEXCACHE_EXTENSION);
+	free(name);
+	return path;
+}
+
+typedef struct TextureCacheKey {
+	const char *source_path;
+	VFSInfo info;
+	PixmapFormat format;
+	PixmapOrigin origin;
+	TextureCacheFlags flags;
+} TextureCacheKey;
+
+static bool header_matches(const TextureCacheHeader *hdr, const TextureCacheKey *key) {
+	if(
+		memcmp(hdr->magic, TEXCACHE_MAGIC, sizeof(hdr->magic)) ||
+		hdr->version != TEXCACHE_VERSION ||
+		hdr->byte_order != TEXCACHE_BYTE_ORDER ||
+		hdr->source_size != key->info.size ||
+		hdr->source_mtime != key->info.mtime ||
+		hdr->source_path_len != strlen(key->source_path) ||
+		hdr->requested_format != key->format ||
+		hdr->origin != key->origin ||
+		hdr->flags != key->flags
+	) {
+		return false;
+	}
+
+	// sanity check, so that a corrupted header can't make us allocate gigabytes
+	Pixmap px = { .width = hdr->width, .height = hdr->height, .format = hdr->format };
+	return PIXMAP_FORMAT_PIXEL_SIZE(hdr->format) > 0 && hdr->data_size == pixmap_data_size(&px);
+}
+
+static bool try_load_cached(const char *path, const TextureCacheKey *key, Pixmap *dst) {
+	SDL_RWops *rw = vfs_open(path, VFS_MODE_READ);
+
+	if(!rw) {
+		return false;
+	}
+
+	TextureCacheHeader hdr;
+	size_t path_len = strlen(key->source_path);
+	char path_buf[path_len + 1];
+
+	if(
+		SDL_RWread(rw, &hdr, sizeof(hdr), 1) != 1 ||
+		!header_matches(&hdr, key) ||
+		(path_len && SDL_RWread(rw, path_buf, path_len, 1) != 1) ||
+		memcmp(path_buf, key->source_path, path_len)
+	) {
+		SDL_RWclose(rw);
+		return false;
+	}
+
+	void *data = malloc(hdr.data_size);
+
+	if(SDL_RWread(rw, data, hdr.data_size, 1) != 1) {
+		log_warn("%s: truncated cache file", path);
+		free(data);
+		SDL_RWclose(rw);
+		return false;
+	}
+
+	SDL_RWclose(rw);
+
+	dst->data.untyped = data;
+	dst->width = hdr.width;
+	dst->height = hdr.height;
+	dst->format = hdr.format;
+	dst->origin = hdr.origin;
+
+	return true;
+}
+
+static void store_cached(const char *path, const TextureCacheKey *key, Pixmap *px) {
+	SDL_RWops *rw = vfs_open(path, VFS_MODE_WRITE);
+
+	if(!rw) {
+		log_warn("Couldn't write texture cache: %s", vfs_get_error());
+		return;
+	}
+
+	TextureCacheHeader hdr = {
+		.version = TEXCACHE_VERSION,
+		.byte_order = TEXCACHE_BYTE_ORDER,
+		.source_size = key->info.size,
+		.source_mtime = key->info.mtime,
+		.source_path_len = strlen(key->source_path),
+		.format = px->format,
+		.requested_format = key->format,
+		.origin = px->origin,
+		.flags = key->flags,
+		.width = px->width,
+		.height = px->height,
+		.data_size = pixmap_data_size(px),
+	};
+
+	memcpy(hdr.magic, TEXCACHE_MAGIC, sizeof(hdr.magic));
+
+	bool ok =
+		SDL_RWwrite(rw, &hdr, sizeof(hdr), 1) == 1 &&
+		(!hdr.source_path_len || SDL_RWwrite(rw, key->source_path, hdr.source_path_len, 1) == 1) &&
+		SDL_RWwrite(rw, px->data.untyped, hdr.data_size, 1) == 1;
+
+	SDL_RWclose(rw);
+
+	if(!ok) {
+		// a truncated file will fail the size check next time, so it's harmless
+		log_warn("%s: failed to write cache file", path);
+	}
+}
+
+bool texture_cache_load(const char *source_path, PixmapFormat format, PixmapOrigin origin, TextureCacheFlags flags, Pixmap *dst) {
+	TextureCacheKey key = {
+		.source_path = source_path,
+		.info = vfs_query(source_path),
+		.format = format,
+		.origin = origin,
+		.flags = flags,
+	};
+
+	// without a size and mtime we can't tell whether the cache is stale
+	bool cacheable = texcache.enabled && key.info.exists && key.info.size && key.info.mtime;
+	char *path = NULL;
+
+	if(cacheable) {
+		path = cache_path(source_path);
+
+		if(try_load_cached(path, &key, dst)) {
+			log_debug("%s: loaded from cache", source_path);
+			free(path);
+			return true;
+		}
+	}
+
+	if(!pixmap_load_file(source_path, dst)) {
+		free(path);
+		return false;
+	}
+
+	if(format && format != dst->format) {
+		pixmap_convert_inplace_realloc(dst, format);
+	}
+
+	pixmap_flip_to_origin_inplace(dst, origin);
+
+	if(flags & TEXCACHE_PREMULTIPLY_ALPHA) {
+		pixmap_premultiply_alpha_inplace(dst);
+	}
+
+	if(cacheable) {
+		store_cached(path, &key, dst);
+		free(path);
+	}
+
+	return true;
+}
@@ -0,0 +1,33 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "util/pixmap.h"
+
+/*
+ * On-disk cache of decoded texture images, stored under storage/cache/textures.
+ *
+ * Entries hold the final pixel data as uploaded to the GPU: flipped to the
+ * renderer's origin, converted to the requested format and, if asked for, with
+ * premultiplied alpha. They are keyed by the source path, size and modification
+ * time, and by all of the load parameters.
+ */
+
+typedef enum TextureCacheFlags {
+	TEXCACHE_PREMULTIPLY_ALPHA = (1 << 0),
+} TextureCacheFlags;
+
+void texture_cache_init(void);
+
+bool texture_cache_enabled(void);
+
+// Loads the image at source_path in the given format (0 keeps the decoded one) and
+// origin, from the cache if possible. Updates the cache on a miss.
+bool texture_cache_load(const char *source_path, PixmapFormat format, PixmapOrigin origin, TextureCacheFlags flags, Pixmap *dst) attr_nonnull(1, 5) attr_nodiscard;
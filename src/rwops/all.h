@@ -13,6 +13,7 @@
 #include "rwops_zlib.h"
 #include "rwops_segment.h"
 #include "rwops_autobuf.h"
+#include "rwops_crc32.h"
 #include "rwops_pipe.h"
 
 #ifdef TAISEI_BUILDCONF_USE_ZIP
@@ -0,0 +1,128 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include <zlib.h>
+#include "rwops_crc32.h"
+#include "util.h"
+
+typedef struct CRCCheck {
+	SDL_RWops *wrapped;
+	uint64_t size;
+	uint64_t pos;
+	uint32_t expected;
+	uint32_t crc;
+	bool verify;
+	bool autoclose;
+} CRCCheck;
+
+#define CRCCHECK(rw) ((CRCCheck*)((rw)->hidden.unknown.data1))
+
+static int64_t crc32check_seek(SDL_RWops *rw, int64_t offset, int whence) {
+	CRCCheck *c = CRCCHECK(rw);
+
+	if(!offset && whence == RW_SEEK_CUR) {
+		return c->pos;
+	}
+
+	int64_t result = SDL_RWseek(c->wrapped, offset, whence);
+
+	if(result >= 0 && result != c->pos) {
+		// no longer a sequential read; there is no way to check the data we skipped over
+		c->verify = false;
+		c->pos = result;
+	}
+
+	return result;
+}
+
+static int64_t crc32check_size(SDL_RWops *rw) {
+	return SDL_RWsize(CRCCHECK(rw)->wrapped);
+}
+
+static size_t crc32check_read(SDL_RWops *rw, void *ptr, size_t size, size_t maxnum) {
+	CRCCheck *c = CRCCHECK(rw);
+	size_t num = SDL_RWread(c->wrapped, ptr, size, maxnum);
+
+	if(!c->verify) {
+		c->pos += num * size;
+		return num;
+	}
+
+	for(size_t len = num * size, chunk; len; len -= chunk, ptr = (uint8_t*)ptr + chunk) {
+		chunk = len < UINT_MAX ? len : UINT_MAX;
+		c->crc = crc32(c->crc, ptr, chunk);
+	}
+
+	c->pos += num * size;
+
+	if(c->pos == c->size) {
+		c->verify = false;
+
+		if(c->crc != c->expected) {
+			log_warn("CRC mismatch: expected %08x, got %08x", c->expected, c->crc);
+			SDL_SetError("CRC mismatch");
+			return 0;
+		}
+	}
+
+	return num;
+}
+
+static size_t crc32check_write(SDL_RWops *rw, const void *ptr, size_t size, size_t maxnum) {
+	SDL_SetError("Can't write to a CRC-checked stream");
+	return 0;
+}
+
+static int crc32check_close(SDL_RWops *rw) {
+	if(rw) {
+		CRCCheck *c = CRCCHECK(rw);
+
+		if(c->autoclose) {
+			SDL_RWclose(c->wrapped);
+		}
+
+		free(c);
+		SDL_FreeRW(rw);
+	}
+
+	return 0;
+}
+
+SDL_RWops* SDL_RWWrapCRC32Check(SDL_RWops *src, uint64_t size, uint32_t crc, bool autoclose) {
+	if(!src) {
+		return NULL;
+	}
+
+	SDL_RWops *rw = SDL_AllocRW();
+
+	if(!rw) {
+		return NULL;
+	}
+
+	memset(rw, 0, sizeof(SDL_RWops));
+
+	rw->type = SDL_RWOPS_UNKNOWN;
+	rw->seek = crc32check_seek;
+	rw->size = crc32check_size;
+	rw->read = crc32check_read;
+	rw->write = crc32check_write;
+	rw->close = crc32check_close;
+
+	CRCCheck *c = calloc(1, sizeof(CRCCheck));
+	c->wrapped = src;
+	c->size = size;
+	c->expected = crc;
+	c->crc = crc32(0, NULL, 0);
+	c->verify = true;
+	c->autoclose = autoclose;
+
+	rw->hidden.unknown.data1 = c;
+	return rw;
+}
@@ -0,0 +1,19 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <SDL.h>
+
+/*
+ * Read-only wrapper that verifies the CRC-32 of a stream of a known size.
+ * The checksum is accumulated as the data is read; the read that reaches the end fails if it doesn't match.
+ * Verification is skipped if the stream is not read sequentially from the start.
+ */
+SDL_RWops* SDL_RWWrapCRC32Check(SDL_RWops *src, uint64_t size, uint32_t crc, bool autoclose);
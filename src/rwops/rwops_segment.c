@@ -173,7 +173,7 @@ static int segment_close(SDL_RWops *rw) {
 }
 
 SDL_RWops* SDL_RWWrapSegment(SDL_RWops *src, size_t start, size_t end, bool autoclose) {
-	assert(end > start);
+	assert(end >= start);
 
 	SDL_RWops *rw = SDL_AllocRW();
 
@@ -265,7 +265,7 @@ static size_t inflate_read(SDL_RWops *rw, void *ptr, size_t size, size_t maxnum)
 	}
 
 	z->pos += (totalsize - z->stream->avail_out);
-	return (totalsize - z->stream->avail_out) / maxnum;
+	return (totalsize - z->stream->avail_out) / size;
 }
 
 static size_t inflate_write(SDL_RWops *rw, const void *ptr, size_t size, size_t maxnum) {
@@ -273,7 +273,7 @@ static size_t inflate_write(SDL_RWops *rw, const void *ptr, size_t size, size_t
 	return 0;
 }
 
-SDL_RWops* SDL_RWWrapZReader(SDL_RWops *src, size_t bufsize, bool autoclose) {
+static SDL_RWops* inflate_alloc(SDL_RWops *src, size_t bufsize, bool autoclose, int window_bits) {
 	SDL_RWops *rw = common_alloc(src, bufsize, autoclose);
 
 	if(!rw) {
@@ -286,11 +286,20 @@ SDL_RWops* SDL_RWWrapZReader(SDL_RWops *src, size_t bufsize, bool autoclose) {
 	ZData *z = ZDATA(rw);
 	z->type = TYPE_INFLATE;
 
-	inflateInit(ZDATA(rw)->stream);
+	inflateInit2(ZDATA(rw)->stream, window_bits);
 
 	return rw;
 }
 
+SDL_RWops* SDL_RWWrapZReader(SDL_RWops *src, size_t bufsize, bool autoclose) {
+	return inflate_alloc(src, bufsize, autoclose, MAX_WBITS);
+}
+
+SDL_RWops* SDL_RWWrapZReaderRaw(SDL_RWops *src, size_t bufsize, bool autoclose) {
+	// negative window bits: headerless deflate data, as stored in zip archives
+	return inflate_alloc(src, bufsize, autoclose, -MAX_WBITS);
+}
+
 SDL_RWops* SDL_RWWrapZWriter(SDL_RWops *src, size_t bufsize, bool autoclose) {
 	SDL_RWops *rw = common_alloc(src, bufsize, autoclose);
 
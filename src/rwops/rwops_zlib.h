@@ -13,5 +13,6 @@
 #include <zlib.h>
 
 SDL_RWops* SDL_RWWrapZReader(SDL_RWops *src, size_t bufsize, bool autoclose);
+SDL_RWops* SDL_RWWrapZReaderRaw(SDL_RWops *src, size_t bufsize, bool autoclose);
 SDL_RWops* SDL_RWWrapZWriter(SDL_RWops *src, size_t bufsize, bool autoclose);
 z_stream* SDL_RWGetZStream(SDL_RWops *src);
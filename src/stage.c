@@ -20,11 +20,14 @@
 #include "player.h"
 #include "menu/ingamemenu.h"
 #include "menu/gameovermenu.h"
+#include "menu/mainmenu.h"
 #include "audio.h"
 #include "log.h"
 #include "stagetext.h"
 #include "stagedraw.h"
 #include "stageobjects.h"
+#include "collision_grid.h"
+#include "benchmark.h"
 
 #ifdef DEBUG
 	#define DPSTEST
@@ -111,6 +114,7 @@ void stage_init_array(void) {
 	add_stage(0x40|0, &stage_dpstest_single_procs, STAGE_SPECIAL, "DPS Test", "Single target", NULL, D_Normal);
 	add_stage(0x40|1, &stage_dpstest_multi_procs, STAGE_SPECIAL, "DPS Test", "Multiple targets", NULL, D_Normal);
 	add_stage(0x40|2, &stage_dpstest_boss_procs, STAGE_SPECIAL, "DPS Test", "Boss", NULL, D_Normal);
+	add_stage(0x40|3, &stage_dpstest_collision_procs, STAGE_SPECIAL, "DPS Test", "Collision stress", NULL, D_Normal);
 #endif
 
 	// generate spellpractice stages
@@ -418,17 +422,34 @@ void stage_input(void) {
 }
 
 static void stage_logic(void) {
+	// stage events may have moved things around; any lazily built grid is stale
+	// after each phase that moves enemies or the boss
+	collision_grid_invalidate();
+
+	benchmark_phase(BENCHMARK_PHASE_PLAYER);
 	player_logic(&global.plr);
 
+	benchmark_phase(BENCHMARK_PHASE_BOSS);
 	process_boss(&global.boss);
+	collision_grid_invalidate();
+	benchmark_phase(BENCHMARK_PHASE_ENEMIES);
 	process_enemies(&global.enemies);
+	collision_grid_invalidate();
+	benchmark_phase(BENCHMARK_PHASE_PROJECTILES);
+	collision_grid_rebuild();
 	process_projectiles(&global.projs, true);
+	collision_grid_invalidate();
+	benchmark_phase(BENCHMARK_PHASE_ITEMS);
 	process_items();
+	benchmark_phase(BENCHMARK_PHASE_LASERS);
 	process_lasers();
+	benchmark_phase(BENCHMARK_PHASE_PARTICLES);
 	process_projectiles(&global.particles, false);
+	benchmark_phase(BENCHMARK_PHASE_NONE);
 	process_dialog(&global.dialog);
 
 	update_sounds();
+	collision_grid_stats_frame();
 
 	global.frames++;
 
@@ -544,7 +565,22 @@ void stage_finish(int gameover) {
 	}
 }
 
+static void stage_preload_progress(uint num_done, uint num_total, void *arg) {
+	hrtime_t *last_draw_time = arg;
+	hrtime_t now = time_get();
+
+	// don't let vsync throttle the loading
+	if(now - *last_draw_time < 1.0 / 30.0 && num_done < num_total) {
+		return;
+	}
+
+	*last_draw_time = now;
+	draw_loading_screen_progress(num_done / (double)num_total);
+}
+
 static void stage_preload(void) {
+	resource_preload_begin();
+
 	difficulty_preload();
 	projectiles_preload();
 	player_preload();
@@ -557,6 +593,18 @@ static void stage_preload(void) {
 	}
 
 	global.stage->procs->preload();
+
+	ResourcePreloadStats stats;
+	hrtime_t last_draw_time = 0;
+	resource_preload_finish(stage_preload_progress, &last_draw_time, &stats);
+
+	log_info("Stage %X: preloaded %u resources in %.1f ms (critical path: %.1f ms, total work: %.1f ms)",
+		global.stage->id,
+		stats.num_resources,
+		stats.total_time * 1e3,
+		stats.critical_path_time * 1e3,
+		stats.work_time * 1e3
+	);
 }
 
 static void display_stage_title(StageInfo *info) {
@@ -603,6 +651,7 @@ static FrameAction stage_logic_frame(void *arg) {
 	StageFrameState *fstate = arg;
 	StageInfo *stage = fstate->stage;
 
+	benchmark_frame();
 	stage_update_fps(fstate);
 
 	if(global.shake_view_fade) {
@@ -629,6 +678,7 @@ static FrameAction stage_logic_frame(void *arg) {
 
 	replay_stage_check_desync(global.replay_stage, global.frames, (tsrand() ^ global.plr.points) & 0xFFFF, global.replaymode);
 	stage_logic();
+	stage_objpools_collect();
 
 	if(fstate->transition_delay) {
 		if(!--fstate->transition_delay) {
@@ -657,6 +707,7 @@ static FrameAction stage_render_frame(void *arg) {
 	StageFrameState *fstate = arg;
 	StageInfo *stage = fstate->stage;
 
+	benchmark_phase(BENCHMARK_PHASE_RENDER);
 	tsrand_lock(&global.rand_game);
 	tsrand_switch(&global.rand_visual);
 	BEGIN_DRAW_CODE();
@@ -665,6 +716,7 @@ static FrameAction stage_render_frame(void *arg) {
 	tsrand_unlock(&global.rand_game);
 	tsrand_switch(&global.rand_game);
 	draw_transition();
+	benchmark_phase(BENCHMARK_PHASE_NONE);
 
 	return RFRAME_SWAP;
 }
@@ -690,6 +742,7 @@ void stage_loop(StageInfo *stage) {
 	global.stage = stage;
 
 	stage_objpools_alloc();
+	collision_grid_init();
 	stage_preload();
 	stage_draw_init();
 
@@ -743,6 +796,7 @@ void stage_loop(StageInfo *stage) {
 
 	StageFrameState fstate = { .stage = stage };
 	loop_at_fps(stage_logic_frame, stage_render_frame, &fstate, FPS);
+	benchmark_stage_end();
 
 	if(global.replaymode == REPLAY_RECORD) {
 		replay_stage_event(global.replay_stage, global.frames, EV_OVER, 0);
@@ -759,6 +813,7 @@ void stage_loop(StageInfo *stage) {
 	tsrand_switch(&global.rand_visual);
 	free_all_refs();
 	ent_shutdown();
+	collision_grid_shutdown();
 	stage_objpools_free();
 	stop_sounds();
 
@@ -455,7 +455,7 @@ static void draw_spellbg(int t) {
 		r_mat_scale(f,f,f);
 	}
 
-	draw_sprite(0, 0, "boss_spellcircle0");
+	draw_sprite(0, 0, RES_ATOM("boss_spellcircle0"));
 	r_mat_pop();
 
 	float delay = ATTACK_START_DELAY;
@@ -665,7 +665,7 @@ static bool stage_draw_predicate(EntityInterface *ent) {
 }
 
 static void stage_draw_objects(void) {
-	r_shader("sprite_default");
+	r_shader(RES_ATOM("sprite_default"));
 
 	if(global.boss) {
 		draw_boss_background(global.boss);
@@ -864,10 +864,16 @@ static void stage_draw_hud_objpool_stats(float x, float y, float width) {
 	r_shader("text_default");
 	for(ObjectPool **pool = &stage_object_pools.first; pool <= last; ++pool) {
 		ObjectPoolStats stats;
-		char buf[32];
+		char buf[64];
 		objpool_get_stats(*pool, &stats);
 
-		snprintf(buf, sizeof(buf), "%zu | %5zu", stats.usage, stats.peak_usage);
+		snprintf(buf, sizeof(buf), "%zu/%zu | %5zu | %3i%% | %5.2fus",
+			stats.usage,
+			stats.capacity,
+			stats.peak_usage,
+			(int)(stats.fragmentation * 100),
+			stats.alloc_time_avg * 1e6
+		);
 		// draw_text(ALIGN_LEFT  | AL_Flag_NoAdjust, (int)x,           (int)y, stats.tag, font);
 		// draw_text(ALIGN_RIGHT | AL_Flag_NoAdjust, (int)(x + width), (int)y, buf,       font);
 		// y += stringheight(buf, font) * 1.1;
@@ -1127,7 +1133,7 @@ static void stage_draw_framerate_graphs(void) {
 
 void stage_draw_hud(void) {
 	// Background
-	draw_sprite(SCREEN_W/2.0, SCREEN_H/2.0, "hud");
+	draw_sprite(SCREEN_W/2.0, SCREEN_H/2.0, RES_ATOM("hud"));
 
 	// Set up positions of most HUD elements
 	static struct labels_s labels = {
@@ -1221,7 +1227,7 @@ void stage_draw_hud(void) {
 			red = 0;
 		
 		r_color4(1 - red, 1 - red, 1 - red, 1 - red);
-		draw_sprite(VIEWPORT_X+creal(global.boss->pos), 590, "boss_indicator");
+		draw_sprite(VIEWPORT_X+creal(global.boss->pos), 590, RES_ATOM("boss_indicator"));
 		r_color4(1, 1, 1, 1);
 	}
 }
@@ -14,7 +14,10 @@
 #include "enemy.h"
 #include "laser.h"
 #include "aniplayer.h"
+#include "global.h"
+#include "util/kvparser.h"
 
+// Default capacities, used when there is no recorded peak usage for the stage
 #define MAX_projectiles             1024
 #define MAX_items                   MAX_projectiles
 #define MAX_enemies                 64
@@ -26,22 +29,127 @@
 	OBJECT_POOL(Enemy, enemies) \
 	OBJECT_POOL(Laser, lasers) \
 
+/*
+ * Peak usage of every pool is recorded per stage, and used to size the pools
+ * the next time the stage is played. The file contains lines like:
+ *
+ * 	<stage id>.<pool name> = <peak usage>
+ */
+#define OBJPOOL_STATS_FILE          "storage/objpools.stats"
+
+// Headroom on top of the recorded peak, in percent
+#define OBJPOOL_PEAK_HEADROOM       25
+
 StageObjectPools stage_object_pools;
 
+static bool objpool_stats_store(const char *key, const char *val, void *data) {
+	ht_str2int_set(data, key, strtoll(val, NULL, 10));
+	return true;
+}
+
+static void objpool_stats_load(ht_str2int_t *stats) {
+	ht_str2int_create(stats);
+
+	if(!vfs_query(OBJPOOL_STATS_FILE).exists) {
+		return;
+	}
+
+	SDL_RWops *file = vfs_open(OBJPOOL_STATS_FILE, VFS_MODE_READ);
+
+	if(!file) {
+		log_warn("Couldn't open the object pool stats file: %s", vfs_get_error());
+		return;
+	}
+
+	parse_keyvalue_stream_cb(file, objpool_stats_store, stats);
+	SDL_RWclose(file);
+}
+
+static void objpool_stats_save(ht_str2int_t *stats) {
+	SDL_RWops *file = vfs_open(OBJPOOL_STATS_FILE, VFS_MODE_WRITE);
+
+	if(!file) {
+		log_warn("Couldn't open the object pool stats file: %s", vfs_get_error());
+		return;
+	}
+
+	ht_str2int_iter_t iter;
+	ht_str2int_iter_begin(stats, &iter);
+
+	while(iter.has_data) {
+		SDL_RWprintf(file, "%s = %"PRIi64"\n", iter.key, iter.value);
+		ht_str2int_iter_next(&iter);
+	}
+
+	ht_str2int_iter_end(&iter);
+	SDL_RWclose(file);
+}
+
+static size_t objpool_initial_capacity(ht_str2int_t *stats, const char *name, size_t fallback) {
+	char key[64];
+	snprintf(key, sizeof(key), "%u.%s", global.stage->id, name);
+	int64_t peak = ht_str2int_get(stats, key, 0);
+
+	if(peak <= 0) {
+		return fallback;
+	}
+
+	return peak + peak * OBJPOOL_PEAK_HEADROOM / 100;
+}
+
+static bool objpool_record_peak(ht_str2int_t *stats, const char *name, ObjectPool *pool) {
+	ObjectPoolStats pstats;
+	objpool_get_stats(pool, &pstats);
+
+	char key[64];
+	snprintf(key, sizeof(key), "%u.%s", global.stage->id, name);
+
+	if(ht_str2int_get(stats, key, 0) >= (int64_t)pstats.peak_usage) {
+		return false;
+	}
+
+	ht_str2int_set(stats, key, pstats.peak_usage);
+	return true;
+}
+
 void stage_objpools_alloc(void) {
+	ht_str2int_t stats;
+	objpool_stats_load(&stats);
+
 	stage_object_pools = (StageObjectPools){
 		#define OBJECT_POOL(type,field) \
-			.field = OBJPOOL_ALLOC(type, MAX_##field),
+			.field = OBJPOOL_ALLOC(type, objpool_initial_capacity(&stats, #field, MAX_##field)),
 
 		OBJECT_POOLS
 		#undef OBJECT_POOL
 	};
+
+	ht_str2int_destroy(&stats);
+}
+
+void stage_objpools_collect(void) {
+	#define OBJECT_POOL(type,field) \
+		objpool_collect(stage_object_pools.field);
+
+	OBJECT_POOLS
+	#undef OBJECT_POOL
 }
 
 void stage_objpools_free(void) {
+	ht_str2int_t stats;
+	bool changed = false;
+	objpool_stats_load(&stats);
+
 	#define OBJECT_POOL(type,field) \
+		changed |= objpool_record_peak(&stats, #field, stage_object_pools.field); \
 		objpool_free(stage_object_pools.field);
 
 	OBJECT_POOLS
 	#undef OBJECT_POOL
+
+	if(changed) {
+		objpool_stats_save(&stats);
+	}
+
+	ht_str2int_destroy(&stats);
 }
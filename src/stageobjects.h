@@ -27,4 +27,5 @@ typedef struct StageObjectPools {
 extern StageObjectPools stage_object_pools;
 
 void stage_objpools_alloc(void);
+void stage_objpools_collect(void);
 void stage_objpools_free(void);
@@ -69,6 +69,20 @@ static void stage_dpstest_boss_events(void) {
 	}
 }
 
+static void stage_dpstest_collision_events(void) {
+	TIMER(&global.timer);
+
+	// Lots of targets spread across the viewport, to stress the collision broadphase.
+	AT(0) {
+		for(int row = 0; row < 6; ++row) {
+			for(int col = 0; col < 8; ++col) {
+				complex pos = (col + 0.5) * VIEWPORT_W / 8 + (row + 0.5) * VIEWPORT_H / 10 * I;
+				create_enemy1c(pos, DPSTEST_HP, (row & 1) ? Fairy : Swirl, dpstest_dummy, 0);
+			}
+		}
+	}
+}
+
 StageProcs stage_dpstest_single_procs = {
 	.begin = dpstest_stub_proc,
 	.preload = dpstest_stub_proc,
@@ -98,3 +112,13 @@ StageProcs stage_dpstest_boss_procs = {
 	.event = stage_dpstest_boss_events,
 	.shader_rules = (ShaderRule[]) { NULL },
 };
+
+StageProcs stage_dpstest_collision_procs = {
+	.begin = dpstest_stub_proc,
+	.preload = dpstest_stub_proc,
+	.end = dpstest_stub_proc,
+	.draw = dpstest_stub_proc,
+	.update = dpstest_stub_proc,
+	.event = stage_dpstest_collision_events,
+	.shader_rules = (ShaderRule[]) { NULL },
+};
@@ -14,3 +14,4 @@
 extern StageProcs stage_dpstest_single_procs;
 extern StageProcs stage_dpstest_multi_procs;
 extern StageProcs stage_dpstest_boss_procs;
+extern StageProcs stage_dpstest_collision_procs;
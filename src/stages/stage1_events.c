@@ -864,16 +864,17 @@ int stage1_burst(Enemy *e, int time) {
 	}
 
 	AT(60) {
-		int i = 0;
 		int n = 1.5*global.diff-1;
 
+		ProjRingParams fan = {
+			.speed = 2+0.1*global.diff,
+			.angle = carg(global.plr.pos - e->pos),
+			.step = 0.2,
+			.first = -n,
+		};
+
 		play_sound("shot1");
-		for(i = -n; i <= n; i++) {
-			PROJECTILE("crystal", e->pos, RGB(0.2, 0.3, 0.5), asymptotic, {
-				(2+0.1*global.diff)*cexp(I*(carg(global.plr.pos - e->pos) + 0.2*i)),
-				5
-			});
-		}
+		PROJECTILES(2*n+1, proj_init_ring, &fan, "crystal", e->pos, RGB(0.2, 0.3, 0.5), asymptotic, { 0, 5 });
 
 		e->moving = true;
 		e->dir = creal(e->args[0]) < 0;
@@ -1028,24 +1029,16 @@ int stage1_instantcircle(Enemy *e, int t) {
 	}
 
 	AT(150) {
+		ProjRingParams ring = { .speed = 1.5, .step = 2*M_PI/(20.0+global.diff) };
 		play_sound("shot_special1");
-		for(int i = 0; i < 20+2*global.diff; i++) {
-			PROJECTILE("rice", e->pos, RGB(0.6, 0.2, 0.7), asymptotic, {
-				1.5*cexp(I*2*M_PI/(20.0+global.diff)*i),
-				2.0
-			});
-		}
+		PROJECTILES(20+2*global.diff, proj_init_ring, &ring, "rice", e->pos, RGB(0.6, 0.2, 0.7), asymptotic, { 0, 2.0 });
 	}
 
 	AT(170) {
 		if(global.diff > D_Easy) {
+			ProjRingParams ring = { .speed = 3, .step = 2*M_PI/(20.0+global.diff) };
 			play_sound("shot_special1");
-			for(int i = 0; i < 20+3*global.diff; i++) {
-				PROJECTILE("rice", e->pos, RGB(0.6, 0.2, 0.7), asymptotic, {
-					3*cexp(I*2*M_PI/(20.0+global.diff)*i),
-					3.0
-				});
-			}
+			PROJECTILES(20+3*global.diff, proj_init_ring, &ring, "rice", e->pos, RGB(0.6, 0.2, 0.7), asymptotic, { 0, 3.0 });
 		}
 	}
 
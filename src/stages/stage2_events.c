@@ -252,6 +252,12 @@ int wriggle_bug(Projectile *p, int t) {
 	return ACTION_NONE;
 }
 
+static void wriggle_small_storm_ring(ProjArgs *args, uint index, void *userdata) {
+	int i = index;
+	// Not proj_init_ring: step*i rounds differently from this, which would desync existing replays.
+	args->args[0] = 2*cexp(I*i*2*M_PI/(10+global.diff));
+}
+
 void wriggle_small_storm(Boss *w, int time) {
 	int t = time % 400;
 	TIMER(&t);
@@ -275,15 +281,8 @@ void wriggle_small_storm(Boss *w, int time) {
 	}
 
 	if(!(t%200)) {
-		int i;
 		play_sound("shot_special1");
-
-		for(i = 0; i < 10+global.diff; i++) {
-			PROJECTILE("bigball", w->pos, RGB(0.1,0.3,0.0), asymptotic, {
-				2*cexp(I*i*2*M_PI/(10+global.diff)),
-				2
-			});
-		}
+		PROJECTILES(10+global.diff, wriggle_small_storm_ring, NULL, "bigball", w->pos, RGB(0.1,0.3,0.0), asymptotic, { 0, 2 });
 	}
 }
 
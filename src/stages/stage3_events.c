@@ -557,6 +557,18 @@ static void scuttle_lethbite(Boss *boss, int time) {
 	}
 }
 
+typedef struct ScuttleSpiral {
+	int time;
+	int cnt;
+	float angle_ofs;
+} ScuttleSpiral;
+
+static void scuttle_init_spiral_proj(ProjArgs *args, uint index, void *userdata) {
+	ScuttleSpiral *s = userdata;
+	int i = index;
+	args->args[0] = (0.5 + 3 * psin(s->time + M_PI/3*2*i)) * cexp(I*(s->angle_ofs + s->time / 20.0 + M_PI/s->cnt*i*2));
+}
+
 void scuttle_deadly_dance(Boss *boss, int time) {
 	int i;
 	TIMER(&time)
@@ -600,13 +612,8 @@ void scuttle_deadly_dance(Boss *boss, int time) {
 		}
 
 		if(global.diff > D_Easy && !(time % 35)) {
-			int cnt = global.diff * 2;
-			for(i = 0; i < cnt; ++i) {
-				PROJECTILE("ball", boss->pos, RGB(1.0, 1.0, 0.3), asymptotic, {
-					(0.5 + 3 * psin(time + M_PI/3*2*i)) * cexp(I*(angle_ofs + time / 20.0 + M_PI/cnt*i*2)),
-					1.5
-				});
-			}
+			ScuttleSpiral spiral = { .time = time, .cnt = global.diff * 2, .angle_ofs = angle_ofs };
+			PROJECTILES(spiral.cnt, scuttle_init_spiral_proj, &spiral, "ball", boss->pos, RGB(1.0, 1.0, 0.3), asymptotic, { 0, 1.5 });
 
 			play_sound("shot1");
 		}
@@ -837,7 +837,7 @@ void elly_spawn_baryons(complex pos) {
 	}
 
 	first->args[1] = add_ref(last);
-	e = create_enemy2c(pos, ENEMY_IMMUNE, BaryonCenter, baryon_center, 0, add_ref(first) + I*add_ref(middle));
+	e = create_enemy2c(pos, ENEMY_IMMUNE, BaryonCenter, baryon_center, 0, CMPLX(add_ref(first), add_ref(middle)));
 	e->ent.draw_layer = LAYER_BACKGROUND;
 }
 
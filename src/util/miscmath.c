@@ -11,6 +11,8 @@
 #include "miscmath.h"
 #include "assert.h"
 
+#include <string.h>
+
 double approach(double v, double t, double d) {
 	if(v < t) {
 		v += d;
@@ -133,6 +135,55 @@ float normpdf(float x, float sigma) {
     return 0.39894 * exp(-0.5 * pow(x, 2) / pow(sigma, 2)) / sigma;
 }
 
+uint16_t f32_to_f16(float f) {
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t exp = (x >> 23) & 0xff;
+	uint32_t mant = x & 0x7fffff;
+
+	if(exp == 0xff) {
+		// infinity or NaN
+		return sign | 0x7c00 | (mant ? 0x200 : 0);
+	}
+
+	int32_t e = (int32_t)exp - 127 + 15;
+
+	if(e >= 0x1f) {
+		return sign | 0x7c00;
+	}
+
+	if(e <= 0) {
+		if(e < -10) {
+			return sign;
+		}
+
+		// subnormal
+		mant |= 0x800000;
+		uint32_t shift = 14 - e;
+		uint32_t h = mant >> shift;
+		uint32_t rem = mant & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+
+		if(rem > halfway || (rem == halfway && (h & 1))) {
+			++h;
+		}
+
+		return sign | h;
+	}
+
+	uint32_t h = ((uint32_t)e << 10) | (mant >> 13);
+	uint32_t rem = mant & 0x1fff;
+
+	// a carry out of the mantissa correctly bumps the exponent (up to infinity)
+	if(rem > 0x1000 || (rem == 0x1000 && (h & 1))) {
+		++h;
+	}
+
+	return sign | h;
+}
+
 void gaussian_kernel_1d(size_t size, float sigma, float kernel[size]) {
 	assert(size & 1);
 
@@ -30,6 +30,7 @@ float smoothreclamp(float x, float old_min, float old_max, float new_min, float
 float sanitize_scale(float scale) attr_const;
 float normpdf(float x, float sigma) attr_const;
 void gaussian_kernel_1d(size_t size, float sigma, float kernel[size]) attr_nonnull(3);
+uint16_t f32_to_f16(float f) attr_const; // IEEE half precision, rounded to nearest even
 
 #define topow2(x) (_Generic((x), \
 	uint32_t: topow2_u32, \
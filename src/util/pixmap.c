@@ -11,8 +11,10 @@
 #include "pixmap.h"
 #include "util.h"
 #include "pixmap_loaders/loaders.h"
+#include "pixmap_sse41.h"
 
 // NOTE: this is pretty stupid and not at all optimized, patches welcome
+// (the common cases have specialized kernels below, see fast_conversion_table)
 
 #define _CONV_FUNCNAME	convert_u8_to_u8
 #define _CONV_IN_MAX	UINT8_MAX
@@ -179,6 +181,125 @@ static struct conversion_def* find_conversion(uint depth_in, uint depth_out) {
 	log_fatal("Pixmap conversion for %upbc -> %upbc undefined, please add", depth_in, depth_out);
 }
 
+/*
+ * Specialized kernels for the conversions that actually show up at load time
+ * (atlas pages, font glyphs, float render targets). They have no per-element
+ * branching and must produce exactly the same output as the generic code.
+ *
+ * Elementwise kernels convert num_pixels * layout elements between two
+ * formats with the same layout; the others take a pixel count.
+ */
+
+typedef void (*fastconvfunc_t)(size_t count, const void *in, void *out);
+
+static void fastconv_rgb8_to_rgba8(size_t num_pixels, const void *vin, void *vout) {
+	const uint8_t *in = vin;
+	uint8_t *out = vout;
+
+	for(size_t i = 0; i < num_pixels; ++i, in += 3, out += 4) {
+		out[0] = in[0];
+		out[1] = in[1];
+		out[2] = in[2];
+		out[3] = UINT8_MAX;
+	}
+}
+
+static void fastconv_rgba8_to_r8(size_t num_pixels, const void *vin, void *vout) {
+	const uint8_t *in = vin;
+	uint8_t *out = vout;
+
+	for(size_t i = 0; i < num_pixels; ++i) {
+		out[i] = in[i * 4];
+	}
+}
+
+static void fastconv_u8_to_f32(size_t num_elements, const void *vin, void *vout) {
+	const uint8_t *in = vin;
+	float *out = vout;
+
+	for(size_t i = 0; i < num_elements; ++i) {
+		out[i] = in[i] * (1.0f / UINT8_MAX);
+	}
+}
+
+static void fastconv_f32_to_u8(size_t num_elements, const void *vin, void *vout) {
+	const float *in = vin;
+	uint8_t *out = vout;
+
+	for(size_t i = 0; i < num_elements; ++i) {
+		float f = in[i];
+		f = f > 0 ? (f < 1 ? f : 1) : 0;
+		// the product is exact in double, so +0.5 and truncation is round()
+		out[i] = (uint8_t)(f * (double)UINT8_MAX + 0.5);
+	}
+}
+
+static void fastconv_u16_to_u8(size_t num_elements, const void *vin, void *vout) {
+	const uint16_t *in = vin;
+	uint8_t *out = vout;
+
+	for(size_t i = 0; i < num_elements; ++i) {
+		// equals round(x / 257) for all 16-bit x
+		out[i] = (in[i] * 255u + 32895u) >> 16;
+	}
+}
+
+#ifdef TAISEI_BUILDCONF_USE_SSE41
+	#define FASTCONV_SIMD(func) pixmap_convert_##func##_sse41
+#else
+	#define FASTCONV_SIMD(func) NULL
+#endif
+
+#define FASTCONV(in, out, func, elementwise) \
+	{ PIXMAP_FORMAT_##in, PIXMAP_FORMAT_##out, fastconv_##func, FASTCONV_SIMD(func), elementwise }
+
+#define FASTCONV_ELEMENTWISE(in, out, func) \
+	FASTCONV(R##in,    R##out,    func, true), \
+	FASTCONV(RG##in,   RG##out,   func, true), \
+	FASTCONV(RGB##in,  RGB##out,  func, true), \
+	FASTCONV(RGBA##in, RGBA##out, func, true)
+
+struct fast_conversion_def {
+	PixmapFormat format_in;
+	PixmapFormat format_out;
+	fastconvfunc_t func;
+	fastconvfunc_t func_simd;
+	bool elementwise;
+};
+
+static struct fast_conversion_def fast_conversion_table[] = {
+	FASTCONV(RGB8, RGBA8, rgb8_to_rgba8, false),
+	FASTCONV(RGBA8, R8, rgba8_to_r8, false),
+	FASTCONV_ELEMENTWISE(8, 32F, u8_to_f32),
+	FASTCONV_ELEMENTWISE(32F, 8, f32_to_u8),
+	FASTCONV_ELEMENTWISE(16, 8, u16_to_u8),
+	{ 0 }
+};
+
+static struct fast_conversion_def* find_fast_conversion(PixmapFormat format_in, PixmapFormat format_out) {
+	for(struct fast_conversion_def *cv = fast_conversion_table; cv->func; ++cv) {
+		if(cv->format_in == format_in && cv->format_out == format_out) {
+			return cv;
+		}
+	}
+
+	return NULL;
+}
+
+static bool have_simd(void) {
+#ifdef TAISEI_BUILDCONF_USE_SSE41
+	static int have_sse41 = -1;
+
+	if(have_sse41 < 0) {
+		have_sse41 = SDL_HasSSE41();
+	}
+
+	return have_sse41;
+#else
+	return false;
+#endif
+}
+
 static void* default_pixel(uint depth) {
 	static uint8_t  default_u8[]  = { 0, 0, 0, UINT8_MAX  };
 	static uint16_t default_u16[] = { 0, 0, 0, UINT16_MAX };
@@ -217,19 +338,8 @@ static void pixmap_copy_meta(const Pixmap *src, Pixmap *dst) {
 	dst->origin = src->origin;
 }
 
-void pixmap_convert(const Pixmap *src, Pixmap *dst, PixmapFormat format) {
+static void pixmap_convert_generic(const Pixmap *src, Pixmap *dst, PixmapFormat format) {
 	size_t num_pixels = src->width * src->height;
-	size_t pixel_size = PIXMAP_FORMAT_PIXEL_SIZE(format);
-
-	assert(dst->data.untyped != NULL);
-	pixmap_copy_meta(src, dst);
-
-	if(src->format == format) {
-		memcpy(dst->data.untyped, src->data.untyped, num_pixels * pixel_size);
-		return;
-	}
-
-	dst->format = format;
 
 	struct conversion_def *cv = find_conversion(
 		PIXMAP_FORMAT_DEPTH(src->format) | (PIXMAP_FORMAT_IS_FLOAT(src->format) * DEPTH_FLOAT_BIT),
@@ -246,6 +356,86 @@ void pixmap_convert(const Pixmap *src, Pixmap *dst, PixmapFormat format) {
 	);
 }
 
+static void pixmap_convert_fast(const Pixmap *src, Pixmap *dst, struct fast_conversion_def *cv, fastconvfunc_t func) {
+	size_t count = src->width * src->height;
+
+	if(cv->elementwise) {
+		count *= PIXMAP_FORMAT_LAYOUT(src->format);
+	}
+
+	func(count, src->data.untyped, dst->data.untyped);
+}
+
+void pixmap_convert(const Pixmap *src, Pixmap *dst, PixmapFormat format) {
+	size_t num_pixels = src->width * src->height;
+	size_t pixel_size = PIXMAP_FORMAT_PIXEL_SIZE(format);
+
+	assert(dst->data.untyped != NULL);
+	pixmap_copy_meta(src, dst);
+
+	if(src->format == format) {
+		memcpy(dst->data.untyped, src->data.untyped, num_pixels * pixel_size);
+		return;
+	}
+
+	dst->format = format;
+
+	struct fast_conversion_def *cv = find_fast_conversion(src->format, format);
+
+	if(cv == NULL) {
+		pixmap_convert_generic(src, dst, format);
+	} else if(cv->func_simd && have_simd()) {
+		pixmap_convert_fast(src, dst, cv, cv->func_simd);
+	} else {
+		pixmap_convert_fast(src, dst, cv, cv->func);
+	}
+}
+
+bool pixmap_convert_via(const Pixmap *src, Pixmap *dst, PixmapFormat format, PixmapConversionPath path) {
+	assert(dst->data.untyped != NULL);
+
+	if(src->format == format) {
+		return false;
+	}
+
+	struct fast_conversion_def *cv = find_fast_conversion(src->format, format);
+	fastconvfunc_t func = NULL;
+
+	switch(path) {
+		case PIXMAP_CONVERSION_GENERIC:
+			break;
+
+		case PIXMAP_CONVERSION_SCALAR:
+			if(cv == NULL) {
+				return false;
+			}
+
+			func = cv->func;
+			break;
+
+		case PIXMAP_CONVERSION_SIMD:
+			if(cv == NULL || cv->func_simd == NULL || !have_simd()) {
+				return false;
+			}
+
+			func = cv->func_simd;
+			break;
+
+		default: UNREACHABLE;
+	}
+
+	pixmap_copy_meta(src, dst);
+	dst->format = format;
+
+	if(func) {
+		pixmap_convert_fast(src, dst, cv, func);
+	} else {
+		pixmap_convert_generic(src, dst, format);
+	}
+
+	return true;
+}
+
 void pixmap_convert_alloc(const Pixmap *src, Pixmap *dst, PixmapFormat format) {
 	dst->data.untyped = pixmap_alloc_buffer_for_conversion(src, format);
 	pixmap_convert(src, dst, format);
@@ -339,6 +529,57 @@ void pixmap_flip_to_origin_inplace(Pixmap *src, PixmapOrigin origin) {
 	src->origin = origin;
 }
 
+void pixmap_premultiply_alpha_inplace(Pixmap *px) {
+	if(PIXMAP_FORMAT_LAYOUT(px->format) != PIXMAP_LAYOUT_RGBA) {
+		return;
+	}
+
+	size_t num_pixels = px->width * px->height;
+
+	switch(px->format) {
+		case PIXMAP_FORMAT_RGBA8: {
+			for(PixelRGBA8 *p = px->data.rgba8, *end = p + num_pixels; p < end; ++p) {
+				uint a = p->a;
+				p->r = (p->r * a + 127) / 255;
+				p->g = (p->g * a + 127) / 255;
+				p->b = (p->b * a + 127) / 255;
+			}
+			break;
+		}
+
+		case PIXMAP_FORMAT_RGBA16: {
+			for(PixelRGBA16 *p = px->data.rgba16, *end = p + num_pixels; p < end; ++p) {
+				uint32_t a = p->a;
+				p->r = (p->r * a + 32767) / 65535;
+				p->g = (p->g * a + 32767) / 65535;
+				p->b = (p->b * a + 32767) / 65535;
+			}
+			break;
+		}
+
+		case PIXMAP_FORMAT_RGBA32: {
+			for(PixelRGBA32 *p = px->data.rgba32, *end = p + num_pixels; p < end; ++p) {
+				uint64_t a = p->a;
+				p->r = (p->r * a + UINT32_MAX / 2) / UINT32_MAX;
+				p->g = (p->g * a + UINT32_MAX / 2) / UINT32_MAX;
+				p->b = (p->b * a + UINT32_MAX / 2) / UINT32_MAX;
+			}
+			break;
+		}
+
+		case PIXMAP_FORMAT_RGBA32F: {
+			for(PixelRGBA32F *p = px->data.rgba32f, *end = p + num_pixels; p < end; ++p) {
+				p->r *= p->a;
+				p->g *= p->a;
+				p->b *= p->a;
+			}
+			break;
+		}
+
+		default: UNREACHABLE;
+	}
+}
+
 bool pixmap_load_stream_tga(SDL_RWops *stream, Pixmap *dst) {
 	return false;
 }
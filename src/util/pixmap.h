@@ -151,6 +151,18 @@ void pixmap_convert(const Pixmap *src, Pixmap *dst, PixmapFormat format) attr_no
 void pixmap_convert_alloc(const Pixmap *src, Pixmap *dst, PixmapFormat format) attr_nonnull(1, 2);
 void pixmap_convert_inplace_realloc(Pixmap *src, PixmapFormat format);
 
+typedef enum PixmapConversionPath {
+	PIXMAP_CONVERSION_GENERIC, // per-element code that handles any pair of formats
+	PIXMAP_CONVERSION_SCALAR,  // specialized portable kernels for common cases
+	PIXMAP_CONVERSION_SIMD,    // SSE4.1 versions of the specialized kernels
+} PixmapConversionPath;
+
+// Like pixmap_convert, but forces a particular implementation. Returns false if
+// it isn't available for this pair of formats (or on this CPU), and leaves dst
+// untouched in that case. pixmap_convert picks the fastest one automatically;
+// this is for equivalence checks and benchmarks.
+bool pixmap_convert_via(const Pixmap *src, Pixmap *dst, PixmapFormat format, PixmapConversionPath path) attr_nonnull(1, 2);
+
 void pixmap_flip_y(const Pixmap *src, Pixmap *dst) attr_nonnull(1, 2);
 void pixmap_flip_y_alloc(const Pixmap *src, Pixmap *dst) attr_nonnull(1, 2);
 void pixmap_flip_y_inplace(Pixmap *src) attr_nonnull(1);
@@ -159,6 +171,10 @@ void pixmap_flip_to_origin(const Pixmap *src, Pixmap *dst, PixmapOrigin origin)
 void pixmap_flip_to_origin_alloc(const Pixmap *src, Pixmap *dst, PixmapOrigin origin) attr_nonnull(1, 2);
 void pixmap_flip_to_origin_inplace(Pixmap *src, PixmapOrigin origin) attr_nonnull(1);
 
+// Multiplies the color channels by alpha, rounding like the GPU does for normalized formats.
+// Does nothing for formats without an alpha channel.
+void pixmap_premultiply_alpha_inplace(Pixmap *px) attr_nonnull(1);
+
 size_t pixmap_data_size(const Pixmap *px) attr_nonnull(1);
 
 bool pixmap_load_file(const char *path, Pixmap *dst) attr_nonnull(1, 2) attr_nodiscard;
@@ -0,0 +1,150 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include <immintrin.h>
+#include "pixmap_sse41.h"
+
+/*
+ * Each kernel handles the bulk of the buffer with SIMD and finishes the
+ * remainder with the same formula as the scalar kernel in pixmap.c.
+ */
+
+void pixmap_convert_rgb8_to_rgba8_sse41(size_t num_pixels, const void *vin, void *vout) {
+	const uint8_t *in = vin;
+	uint8_t *out = vout;
+	size_t i = 0;
+
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+
+	// 4 pixels per iteration, but each load reads 16 bytes (5.33 pixels)
+	for(; i + 6 <= num_pixels; i += 4) {
+		__m128i px = _mm_loadu_si128((const __m128i*)(in + i * 3));
+		px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), alpha);
+		_mm_storeu_si128((__m128i*)(out + i * 4), px);
+	}
+
+	for(; i < num_pixels; ++i) {
+		out[i * 4 + 0] = in[i * 3 + 0];
+		out[i * 4 + 1] = in[i * 3 + 1];
+		out[i * 4 + 2] = in[i * 3 + 2];
+		out[i * 4 + 3] = UINT8_MAX;
+	}
+}
+
+void pixmap_convert_rgba8_to_r8_sse41(size_t num_pixels, const void *vin, void *vout) {
+	const uint8_t *in = vin;
+	uint8_t *out = vout;
+	size_t i = 0;
+
+	const __m128i mask = _mm_set1_epi32(0xff);
+
+	for(; i + 16 <= num_pixels; i += 16) {
+		const __m128i *src = (const __m128i*)(in + i * 4);
+		__m128i a = _mm_and_si128(_mm_loadu_si128(src + 0), mask);
+		__m128i b = _mm_and_si128(_mm_loadu_si128(src + 1), mask);
+		__m128i c = _mm_and_si128(_mm_loadu_si128(src + 2), mask);
+		__m128i d = _mm_and_si128(_mm_loadu_si128(src + 3), mask);
+		__m128i ab = _mm_packus_epi32(a, b);
+		__m128i cd = _mm_packus_epi32(c, d);
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(ab, cd));
+	}
+
+	for(; i < num_pixels; ++i) {
+		out[i] = in[i * 4];
+	}
+}
+
+void pixmap_convert_u8_to_f32_sse41(size_t num_elements, const void *vin, void *vout) {
+	const uint8_t *in = vin;
+	float *out = vout;
+	size_t i = 0;
+
+	const __m128 scale = _mm_set1_ps(1.0f / UINT8_MAX);
+
+	for(; i + 16 <= num_elements; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+
+		for(int j = 0; j < 4; ++j) {
+			__m128 f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(v));
+			_mm_storeu_ps(out + i + j * 4, _mm_mul_ps(f, scale));
+			v = _mm_srli_si128(v, 4);
+		}
+	}
+
+	for(; i < num_elements; ++i) {
+		out[i] = in[i] * (1.0f / UINT8_MAX);
+	}
+}
+
+static inline __m128i f32_to_i32_rounded(__m128 f) {
+	// max/min return the second operand for NaNs, so those end up as 0
+	f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+
+	// Scale in double precision, which is exact here; float could round an
+	// x.4999 product up to x.5 and disagree with round() in the generic path.
+	const __m128d scale = _mm_set1_pd(UINT8_MAX);
+	const __m128d half = _mm_set1_pd(0.5);
+	__m128d lo = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(f), scale), half);
+	__m128d hi = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(f, f)), scale), half);
+
+	// truncation + 0.5 == round() for non-negative values
+	return _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+}
+
+void pixmap_convert_f32_to_u8_sse41(size_t num_elements, const void *vin, void *vout) {
+	const float *in = vin;
+	uint8_t *out = vout;
+	size_t i = 0;
+
+	for(; i + 16 <= num_elements; i += 16) {
+		__m128i a = f32_to_i32_rounded(_mm_loadu_ps(in + i + 0));
+		__m128i b = f32_to_i32_rounded(_mm_loadu_ps(in + i + 4));
+		__m128i c = f32_to_i32_rounded(_mm_loadu_ps(in + i + 8));
+		__m128i d = f32_to_i32_rounded(_mm_loadu_ps(in + i + 12));
+		__m128i ab = _mm_packus_epi32(a, b);
+		__m128i cd = _mm_packus_epi32(c, d);
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(ab, cd));
+	}
+
+	for(; i < num_elements; ++i) {
+		float f = in[i];
+		f = f > 0 ? (f < 1 ? f : 1) : 0;
+		out[i] = (uint8_t)(f * (double)UINT8_MAX + 0.5);
+	}
+}
+
+static inline __m128i u16_to_u8_rounded(__m128i x) {
+	// round(x / 257) == (x * 255 + 32895) >> 16 for all 16-bit x
+	__m128i t = _mm_sub_epi32(_mm_slli_epi32(x, 8), x);
+	return _mm_srli_epi32(_mm_add_epi32(t, _mm_set1_epi32(32895)), 16);
+}
+
+void pixmap_convert_u16_to_u8_sse41(size_t num_elements, const void *vin, void *vout) {
+	const uint16_t *in = vin;
+	uint8_t *out = vout;
+	size_t i = 0;
+
+	for(; i + 16 <= num_elements; i += 16) {
+		__m128i v0 = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i v1 = _mm_loadu_si128((const __m128i*)(in + i + 8));
+		__m128i a = u16_to_u8_rounded(_mm_cvtepu16_epi32(v0));
+		__m128i b = u16_to_u8_rounded(_mm_cvtepu16_epi32(_mm_srli_si128(v0, 8)));
+		__m128i c = u16_to_u8_rounded(_mm_cvtepu16_epi32(v1));
+		__m128i d = u16_to_u8_rounded(_mm_cvtepu16_epi32(_mm_srli_si128(v1, 8)));
+		__m128i ab = _mm_packus_epi32(a, b);
+		__m128i cd = _mm_packus_epi32(c, d);
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(ab, cd));
+	}
+
+	for(; i < num_elements; ++i) {
+		out[i] = (in[i] * 255u + 32895u) >> 16;
+	}
+}
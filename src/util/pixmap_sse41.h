@@ -0,0 +1,24 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+/*
+ * SSE4.1 versions of the specialized pixmap conversion kernels in pixmap.c.
+ * Callers must check SDL_HasSSE41() first. The results are bit-exact with the
+ * generic conversion code.
+ */
+
+#ifdef TAISEI_BUILDCONF_USE_SSE41
+	void pixmap_convert_rgb8_to_rgba8_sse41(size_t num_pixels, const void *in, void *out) attr_hot;
+	void pixmap_convert_rgba8_to_r8_sse41(size_t num_pixels, const void *in, void *out) attr_hot;
+	void pixmap_convert_u8_to_f32_sse41(size_t num_elements, const void *in, void *out) attr_hot;
+	void pixmap_convert_f32_to_u8_sse41(size_t num_elements, const void *in, void *out) attr_hot;
+	void pixmap_convert_u16_to_u8_sse41(size_t num_elements, const void *in, void *out) attr_hot;
+#endif
@@ -0,0 +1,82 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "private.h"
+
+#ifdef TAISEI_BUILDCONF_HAVE_MMAP
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+const void* vfs_node_map(VFSNode *node, size_t *out_size) {
+#ifdef TAISEI_BUILDCONF_HAVE_MMAP
+	char *path = vfs_node_syspath(node);
+
+	if(!path) {
+		return NULL;
+	}
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	free(path);
+
+	if(fd < 0) {
+		return NULL;
+	}
+
+	struct stat st;
+	void *map = NULL;
+
+	if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if(map == MAP_FAILED) {
+			log_debug("mmap() failed: %s", strerror(errno));
+			map = NULL;
+		} else {
+			*out_size = st.st_size;
+		}
+	}
+
+	close(fd);
+	return map;
+#else
+	return NULL;
+#endif
+}
+
+void vfs_unmap(const void *map, size_t size) {
+#ifdef TAISEI_BUILDCONF_HAVE_MMAP
+	if(map) {
+		munmap((void*)map, size);
+	}
+#endif
+}
+
+void vfs_map_prefetch(const void *map, size_t offset, size_t size) {
+#ifdef TAISEI_BUILDCONF_HAVE_MMAP
+	static size_t page_size;
+
+	if(!page_size) {
+		long sz = sysconf(_SC_PAGESIZE);
+		page_size = sz > 0 ? sz : 4096;
+	}
+
+	// madvise wants a page-aligned address
+	size_t misalign = offset % page_size;
+	int err = posix_madvise((char*)map + offset - misalign, size + misalign, POSIX_MADV_WILLNEED);
+
+	if(err) {
+		log_debug("posix_madvise() failed: %s", strerror(err));
+	}
+#endif
+}
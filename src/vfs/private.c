@@ -10,9 +10,25 @@
 
 #include "private.h"
 #include "vdir.h"
+#include "hashtable.h"
+
+#include <stdatomic.h>
 
 VFSNode *vfs_root;
 
+static struct {
+	atomic_uint_fast64_t lookups;
+	atomic_uint_fast64_t cache_hits;
+	atomic_uint_fast64_t cache_misses;
+	atomic_uint_fast64_t ticks;
+} vfs_stats;
+
+static struct {
+	SDL_mutex *mutex;
+	SDL_RWops *out;
+	ht_str2int_t seen;
+} vfs_trace;
+
 typedef struct vfs_tls_s {
 	char *error_str;
 } vfs_tls_t;
@@ -54,9 +70,53 @@ static vfs_tls_t* vfs_tls_get(void) {
 	return vfs_tls_fallback;
 }
 
+static void vfs_trace_init(void) {
+	const char *path = env_get("TAISEI_VFS_TRACE", "");
+
+	if(!*path) {
+		return;
+	}
+
+	if(!(vfs_trace.out = SDL_RWFromFile(path, "w"))) {
+		log_warn("Can't open VFS trace file '%s': %s", path, SDL_GetError());
+		return;
+	}
+
+	vfs_trace.mutex = SDL_CreateMutex();
+	ht_create(&vfs_trace.seen);
+}
+
+static void vfs_trace_shutdown(void) {
+	if(!vfs_trace.out) {
+		return;
+	}
+
+	SDL_RWclose(vfs_trace.out);
+	SDL_DestroyMutex(vfs_trace.mutex);
+	ht_destroy(&vfs_trace.seen);
+	memset(&vfs_trace, 0, sizeof(vfs_trace));
+}
+
+void vfs_trace_open(const char *path) {
+	if(!vfs_trace.out) {
+		return;
+	}
+
+	SDL_LockMutex(vfs_trace.mutex);
+
+	if(!ht_lookup(&vfs_trace.seen, path, NULL)) {
+		ht_set(&vfs_trace.seen, path, 1);
+		SDL_RWwrite(vfs_trace.out, path, 1, strlen(path));
+		SDL_RWwrite(vfs_trace.out, "\n", 1, 1);
+	}
+
+	SDL_UnlockMutex(vfs_trace.mutex);
+}
+
 void vfs_init(void) {
 	vfs_root = vfs_alloc();
 	vfs_vdir_init(vfs_root);
+	vfs_trace_init();
 
 	vfs_tls_id = SDL_TLSCreate();
 
@@ -80,6 +140,7 @@ void vfs_shutdown(void) {
 
 	vfs_decref(vfs_root);
 	vfs_tls_free(vfs_tls_fallback);
+	vfs_trace_shutdown();
 
 	vfs_root = NULL;
 	vfs_tls_id = 0;
@@ -137,6 +198,36 @@ VFSNode* vfs_locate(VFSNode *root, const char *path) {
 	return vfs_node_locate(root, path);
 }
 
+VFSNode* vfs_lookup(const char *path) {
+	uint64_t start = SDL_GetPerformanceCounter();
+	VFSNode *node = vfs_locate(vfs_root, path);
+	atomic_fetch_add_explicit(&vfs_stats.ticks, SDL_GetPerformanceCounter() - start, memory_order_relaxed);
+	atomic_fetch_add_explicit(&vfs_stats.lookups, 1, memory_order_relaxed);
+	return node;
+}
+
+void vfs_stats_cache_hit(void) {
+	atomic_fetch_add_explicit(&vfs_stats.cache_hits, 1, memory_order_relaxed);
+}
+
+void vfs_stats_cache_miss(void) {
+	atomic_fetch_add_explicit(&vfs_stats.cache_misses, 1, memory_order_relaxed);
+}
+
+void vfs_get_stats(VFSStats *stats) {
+	stats->lookups = atomic_load_explicit(&vfs_stats.lookups, memory_order_relaxed);
+	stats->cache_hits = atomic_load_explicit(&vfs_stats.cache_hits, memory_order_relaxed);
+	stats->cache_misses = atomic_load_explicit(&vfs_stats.cache_misses, memory_order_relaxed);
+	stats->time = atomic_load_explicit(&vfs_stats.ticks, memory_order_relaxed) / (double)SDL_GetPerformanceFrequency();
+}
+
+void vfs_reset_stats(void) {
+	atomic_store_explicit(&vfs_stats.lookups, 0, memory_order_relaxed);
+	atomic_store_explicit(&vfs_stats.cache_hits, 0, memory_order_relaxed);
+	atomic_store_explicit(&vfs_stats.cache_misses, 0, memory_order_relaxed);
+	atomic_store_explicit(&vfs_stats.ticks, 0, memory_order_relaxed);
+}
+
 bool vfs_mount(VFSNode *root, const char *mountpoint, VFSNode *subtree) {
 	VFSNode *mpnode;
 	char buf[2][strlen(mountpoint)+1];
@@ -53,6 +53,15 @@ bool vfs_mount(VFSNode *root, const char *mountpoint, VFSNode *subtree) attr_non
 bool vfs_mount_or_decref(VFSNode *root, const char *mountpoint, VFSNode *subtree) attr_nonnull(1, 3) attr_nodiscard;
 VFSNode* vfs_locate(VFSNode *root, const char *path) attr_nonnull(1, 2) attr_nodiscard;
 
+// vfs_locate from the root, for the public API; counted in VFSStats
+VFSNode* vfs_lookup(const char *path) attr_nonnull(1) attr_nodiscard;
+
+// Records the first time a file is opened for reading, if TAISEI_VFS_TRACE is set
+void vfs_trace_open(const char *path) attr_nonnull(1);
+
+void vfs_stats_cache_hit(void);
+void vfs_stats_cache_miss(void);
+
 // Light wrappers around the virtual functions, safe to call even on nodes that
 // don't implement the corresponding method. "free" is not included, there should
 // be no reason to call it. It wouldn't do what you'd expect anyway; use vfs_decref.
@@ -67,5 +76,13 @@ void vfs_node_iter_stop(VFSNode *node, void **opaque) attr_nonnull(1);
 bool vfs_node_mkdir(VFSNode *parent, const char *subdir) attr_nonnull(1);
 SDL_RWops* vfs_node_open(VFSNode *filenode, VFSOpenMode mode) attr_nonnull(1);
 
+// Read-only memory mapping of a node backed by a regular file on the real filesystem.
+// Returns NULL if the node has no system path, or if mapping is not supported on this platform.
+const void* vfs_node_map(VFSNode *node, size_t *out_size) attr_nonnull(1, 2) attr_nodiscard;
+void vfs_unmap(const void *map, size_t size);
+
+// Hints the OS to start reading a range of a mapping in, ahead of its use.
+void vfs_map_prefetch(const void *map, size_t offset, size_t size) attr_nonnull(1);
+
 void vfs_hook_on_shutdown(VFSShutdownHandler, void *arg);
 void vfs_print_tree_recurse(SDL_RWops *dest, VFSNode *root, char *prefix, const char *name) attr_nonnull(1, 2, 3, 4);
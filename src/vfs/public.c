@@ -22,7 +22,7 @@ bool vfs_mount_alias(const char *dst, const char *src) {
 	dst = vfs_path_normalize(dst, dstbuf);
 	src = vfs_path_normalize(src, srcbuf);
 
-	VFSNode *srcnode = vfs_locate(vfs_root, src);
+	VFSNode *srcnode = vfs_lookup(src);
 
 	if(!srcnode) {
 		vfs_set_error("Node '%s' does not exist", src);
@@ -36,7 +36,7 @@ bool vfs_unmount(const char *path) {
 	char p[strlen(path)+1], *parent, *subdir;
 	path = vfs_path_normalize(path, p);
 	vfs_path_split_right(p, &parent, &subdir);
-	VFSNode *node = vfs_locate(vfs_root, parent);
+	VFSNode *node = vfs_lookup(parent);
 
 	if(node) {
 		bool result = vfs_node_unmount(node, subdir);
@@ -52,13 +52,15 @@ SDL_RWops* vfs_open(const char *path, VFSOpenMode mode) {
 	SDL_RWops *rwops = NULL;
 	char p[strlen(path)+1];
 	path = vfs_path_normalize(path, p);
-	VFSNode *node = vfs_locate(vfs_root, path);
+	VFSNode *node = vfs_lookup(path);
 
 	if(node) {
 		assert(node->funcs != NULL);
 
 		if(!(rwops = vfs_node_open(node, mode))) {
 			vfs_set_error("Can't open '%s': %s", path, vfs_get_error());
+		} else if(!(mode & VFS_MODE_WRITE)) {
+			vfs_trace_open(path);
 		}
 
 		vfs_decref(node);
@@ -72,7 +74,7 @@ SDL_RWops* vfs_open(const char *path, VFSOpenMode mode) {
 VFSInfo vfs_query(const char *path) {
 	char p[strlen(path)+1];
 	path = vfs_path_normalize(path, p);
-	VFSNode *node = vfs_locate(vfs_root, path);
+	VFSNode *node = vfs_lookup(path);
 
 	if(node) {
 		// expected to set error on failure
@@ -92,7 +94,7 @@ VFSInfo vfs_query(const char *path) {
 bool vfs_mkdir(const char *path) {
 	char p[strlen(path)+1];
 	path = vfs_path_normalize(path, p);
-	VFSNode *node = vfs_locate(vfs_root, path);
+	VFSNode *node = vfs_lookup(path);
 	bool ok = false;
 
 	if(node) {
@@ -106,7 +108,7 @@ bool vfs_mkdir(const char *path) {
 
 	char *parent, *subdir;
 	vfs_path_split_right(p, &parent, &subdir);
-	node = vfs_locate(vfs_root, parent);
+	node = vfs_lookup(parent);
 
 	if(node) {
 		ok = vfs_node_mkdir(node, subdir);
@@ -128,7 +130,7 @@ void vfs_mkdir_required(const char *path) {
 char* vfs_repr(const char *path, bool try_syspath) {
 	char buf[strlen(path)+1];
 	path = vfs_path_normalize(path, buf);
-	VFSNode *node = vfs_locate(vfs_root, path);
+	VFSNode *node = vfs_lookup(path);
 
 	if(node) {
 		char *p = vfs_node_repr(node, try_syspath);
@@ -148,7 +150,7 @@ bool vfs_print_tree(SDL_RWops *dest, const char *path) {
 		*trail = 0;
 	}
 
-	VFSNode *node = vfs_locate(vfs_root, p);
+	VFSNode *node = vfs_lookup(p);
 
 	if(!node) {
 		vfs_set_error("Node '%s' does not exist", path);
@@ -167,7 +169,7 @@ bool vfs_print_tree(SDL_RWops *dest, const char *path) {
 VFSDir* vfs_dir_open(const char *path) {
 	char p[strlen(path)+1];
 	path = vfs_path_normalize(path, p);
-	VFSNode *node = vfs_locate(vfs_root, path);
+	VFSNode *node = vfs_lookup(path);
 
 	if(node) {
 		if(node->funcs->iter && vfs_node_query(node).is_dir) {
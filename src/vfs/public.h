@@ -14,6 +14,7 @@
 #include "syspath_public.h"
 #include "union_public.h"
 #include "zipfile_public.h"
+#include "tpkfile_public.h"
 #include "readonly_wrapper_public.h"
 
 typedef struct VFSInfo {
@@ -21,6 +22,10 @@ typedef struct VFSInfo {
 	uchar exists      : 1;
 	uchar is_dir      : 1;
 	uchar is_readonly : 1;
+
+	// 0 if not known
+	uint64_t size;
+	int64_t mtime;
 } VFSInfo;
 
 #define VFSINFO_ERROR ((VFSInfo) { .error = true, 0 })
@@ -35,6 +40,18 @@ typedef enum VFSOpenMode {
 
 typedef struct VFSDir VFSDir;
 
+typedef struct VFSStats {
+	// path lookups done by the functions below
+	uint64_t lookups;
+
+	// lookups in unions with a lookup cache (see vfs_create_union_mountpoint)
+	uint64_t cache_hits;
+	uint64_t cache_misses;
+
+	// total time spent on lookups, in seconds
+	double time;
+} VFSStats;
+
 SDL_RWops* vfs_open(const char *path, VFSOpenMode mode);
 VFSInfo vfs_query(const char *path);
 
@@ -63,3 +80,5 @@ bool vfs_print_tree(SDL_RWops *dest, const char *path) attr_nonnull(1, 2);
 void vfs_init(void);
 void vfs_shutdown(void);
 const char* vfs_get_error(void) attr_returns_nonnull;
+void vfs_get_stats(VFSStats *stats) attr_nonnull(1);
+void vfs_reset_stats(void);
@@ -60,6 +60,7 @@ static struct pkg_loader_t {
 	bool (*mount)(const char *mp, const char *arg);
 } pkg_loaders[] = {
 	{ ".zip",       vfs_mount_zipfile },
+	{ ".tpk",       vfs_mount_tpkfile },
 	{ ".pkgdir",    vfs_mount_pkgdir  },
 	{ NULL },
 };
@@ -191,4 +192,8 @@ void vfs_setup(bool silent) {
 
 	vfs_unmount("resdirs");
 	vfs_unmount("respkgs");
+
+	if(env_get("TAISEI_VFS_CACHE", true) && !vfs_build_index("res")) {
+		log_warn("Couldn't index resources: %s", vfs_get_error());
+	}
 }
@@ -33,6 +33,8 @@ static VFSInfo vfs_syspath_query(VFSNode *node) {
 	if(stat(node->_path_, &fstat) >= 0) {
 		i.exists = true;
 		i.is_dir = S_ISDIR(fstat.st_mode);
+		i.size = fstat.st_size;
+		i.mtime = fstat.st_mtime;
 	}
 
 	return i;
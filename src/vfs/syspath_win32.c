@@ -61,15 +61,20 @@ static VFSInfo vfs_syspath_query(VFSNode *node) {
 		return i;
 	}
 
-	DWORD attrib = GetFileAttributes(node->_wpath_);
+	WIN32_FILE_ATTRIBUTE_DATA attrdata;
 
-	if(attrib == INVALID_FILE_ATTRIBUTES) {
+	if(!GetFileAttributesEx(node->_wpath_, GetFileExInfoStandard, &attrdata)) {
 		vfs_set_error_win32();
 		return VFSINFO_ERROR;
 	}
 
 	i.exists = true;
-	i.is_dir = (bool)(attrib & FILE_ATTRIBUTE_DIRECTORY);
+	i.is_dir = (bool)(attrdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
+	i.size = ((uint64_t)attrdata.nFileSizeHigh << 32) | attrdata.nFileSizeLow;
+
+	// FILETIME counts 100ns intervals since 1601-01-01
+	uint64_t ft = ((uint64_t)attrdata.ftLastWriteTime.dwHighDateTime << 32) | attrdata.ftLastWriteTime.dwLowDateTime;
+	i.mtime = (int64_t)(ft / 10000000) - 11644473600LL;
 
 	return i;
 }
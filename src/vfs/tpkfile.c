@@ -0,0 +1,425 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "tpkfile.h"
+#include "tpkfile_impl.h"
+#include "rwops/all.h"
+
+#define TPK_INFLATE_BUFSIZE 8192
+
+static inline uint16_t vfs_tpk_le16(const uint8_t *p) {
+	return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static inline uint32_t vfs_tpk_le32(const uint8_t *p) {
+	return (uint32_t)vfs_tpk_le16(p) | ((uint32_t)vfs_tpk_le16(p + 2) << 16);
+}
+
+static inline uint64_t vfs_tpk_le64(const uint8_t *p) {
+	return (uint64_t)vfs_tpk_le32(p) | ((uint64_t)vfs_tpk_le32(p + 4) << 32);
+}
+
+uint64_t vfs_tpk_hash(const char *path) {
+	// FNV-1a; must match scripts/pack-tpk.py
+	uint64_t h = 0xcbf29ce484222325ull;
+
+	for(const uint8_t *p = (const uint8_t*)path; *p; ++p) {
+		h ^= *p;
+		h *= 0x100000001b3ull;
+	}
+
+	return h;
+}
+
+static void vfs_tpkfile_free(VFSNode *node) {
+	VFSTpkFileData *tdata = node->data1;
+
+	if(!tdata) {
+		return;
+	}
+
+	if(tdata->source) {
+		vfs_decref(tdata->source);
+	}
+
+	vfs_unmap(tdata->map, tdata->map_size);
+	free(tdata->entries);
+	free(tdata->groups);
+	free(tdata->strings);
+	free(tdata);
+}
+
+static VFSInfo vfs_tpkfile_query(VFSNode *node) {
+	return (VFSInfo) {
+		.exists = true,
+		.is_dir = true,
+		.is_readonly = true,
+	};
+}
+
+static char* vfs_tpkfile_syspath(VFSNode *node) {
+	VFSTpkFileData *tdata = node->data1;
+	return vfs_node_syspath(tdata->source);
+}
+
+static char* vfs_tpkfile_repr(VFSNode *node) {
+	VFSTpkFileData *tdata = node->data1;
+	char *srcrepr = vfs_node_repr(tdata->source, false);
+	char *tpkrepr = strfmt("package %s", srcrepr);
+	free(srcrepr);
+	return tpkrepr;
+}
+
+static const VFSTpkEntry* vfs_tpkfile_find(VFSTpkFileData *tdata, const char *path) {
+	uint64_t hash = vfs_tpk_hash(path);
+	size_t lo = 0, hi = tdata->num_entries;
+
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if(tdata->entries[mid].hash < hash) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	for(; lo < tdata->num_entries && tdata->entries[lo].hash == hash; ++lo) {
+		if(!strcmp(tdata->entries[lo].name, path)) {
+			return tdata->entries + lo;
+		}
+	}
+
+	return NULL;
+}
+
+static VFSNode* vfs_tpkfile_locate(VFSNode *node, const char *path) {
+	const VFSTpkEntry *e = vfs_tpkfile_find(node->data1, path);
+
+	if(!e) {
+		return NULL;
+	}
+
+	VFSNode *n = vfs_alloc();
+	vfs_tpkpath_init(n, node, e);
+	return n;
+}
+
+const char* vfs_tpkfile_iter_shared(VFSTpkFileData *tdata, const char *prefix, void **opaque) {
+	size_t *idx = *opaque;
+	size_t prefix_len = strlen(prefix);
+
+	if(!idx) {
+		*opaque = idx = calloc(1, sizeof(*idx));
+	}
+
+	while(*idx < tdata->num_entries) {
+		const char *name = tdata->entries[(*idx)++].name;
+
+		if(prefix_len) {
+			if(strncmp(name, prefix, prefix_len) || name[prefix_len] != '/') {
+				continue;
+			}
+
+			name += prefix_len + 1;
+		}
+
+		if(*name && !strchr(name, '/')) {
+			return name;
+		}
+	}
+
+	return NULL;
+}
+
+static const char* vfs_tpkfile_iter(VFSNode *node, void **opaque) {
+	return vfs_tpkfile_iter_shared(node->data1, "", opaque);
+}
+
+void vfs_tpkfile_iter_stop(VFSNode *node, void **opaque) {
+	free(*opaque);
+	*opaque = NULL;
+}
+
+static VFSNodeFuncs vfs_funcs_tpkfile = {
+	.repr = vfs_tpkfile_repr,
+	.query = vfs_tpkfile_query,
+	.free = vfs_tpkfile_free,
+	.syspath = vfs_tpkfile_syspath,
+	.locate = vfs_tpkfile_locate,
+	.iter = vfs_tpkfile_iter,
+	.iter_stop = vfs_tpkfile_iter_stop,
+};
+
+static void vfs_tpkfile_prefetch(VFSTpkFileData *tdata, const VFSTpkEntry *e) {
+	if(!tdata->map || !e->group) {
+		return;
+	}
+
+	VFSTpkGroup *g = tdata->groups + e->group - 1;
+
+	if(SDL_AtomicCAS(&g->prefetched, 0, 1)) {
+		vfs_map_prefetch(tdata->map, g->offset, g->size);
+	}
+}
+
+SDL_RWops* vfs_tpkfile_open_entry(VFSNode *tpknode, const VFSTpkEntry *e, VFSOpenMode mode) {
+	VFSTpkFileData *tdata = tpknode->data1;
+
+	if(mode & VFS_MODE_WRITE) {
+		vfs_set_error("Packages are read-only");
+		return NULL;
+	}
+
+	if(e->flags & TPK_FLAG_DIR) {
+		vfs_set_error("Is a directory");
+		return NULL;
+	}
+
+	vfs_tpkfile_prefetch(tdata, e);
+
+	SDL_RWops *rw;
+
+	if(tdata->map) {
+		if(!e->stored_size) {
+			// SDL refuses to create zero-sized memory streams
+			return SDL_RWWrapSegment(SDL_RWFromConstMem(tdata->map, tdata->map_size), 0, 0, true);
+		}
+
+		rw = SDL_RWFromConstMem(tdata->map + e->offset, e->stored_size);
+	} else {
+		SDL_RWops *stream = vfs_node_open(tdata->source, VFS_MODE_READ);
+
+		if(!stream) {
+			return NULL;
+		}
+
+		SDL_RWseek(stream, e->offset, RW_SEEK_SET);
+		rw = SDL_RWWrapSegment(stream, e->offset, e->offset + e->stored_size, true);
+	}
+
+	if(e->method == TPK_METHOD_DEFLATE) {
+		rw = SDL_RWWrapZReaderRaw(rw, TPK_INFLATE_BUFSIZE, true);
+	}
+
+	rw = SDL_RWWrapCRC32Check(rw, e->size, e->crc32, true);
+
+	if(!(mode & VFS_MODE_SEEKABLE) || e->method == TPK_METHOD_RAW) {
+		return rw;
+	}
+
+	SDL_RWops *bufrw = SDL_RWCopyToBuffer(rw);
+	SDL_RWclose(rw);
+
+	if(SDL_RWsize(bufrw) != e->size) {
+		vfs_set_error("Failed to read '%s': %s", e->name, SDL_GetError());
+		SDL_RWclose(bufrw);
+		return NULL;
+	}
+
+	return bufrw;
+}
+
+static const char* vfs_tpkfile_parse(VFSTpkFileData *tdata, const uint8_t *hdr, const uint8_t *meta, uint64_t meta_offset) {
+	uint64_t num_entries = vfs_tpk_le32(hdr + 12);
+	uint64_t num_groups = vfs_tpk_le32(hdr + 16);
+	uint64_t entries_offset = vfs_tpk_le64(hdr + 24) - meta_offset;
+	uint64_t groups_offset = vfs_tpk_le64(hdr + 32) - meta_offset;
+	uint64_t strings_offset = vfs_tpk_le64(hdr + 40) - meta_offset;
+	uint64_t strings_size = vfs_tpk_le64(hdr + 48);
+	const char *strings = (const char*)meta + strings_offset;
+
+	if(tdata->strings) {
+		strings = tdata->strings;
+	}
+
+	tdata->entries = calloc(num_entries, sizeof(*tdata->entries));
+	tdata->groups = calloc(num_groups, sizeof(*tdata->groups));
+	tdata->num_entries = num_entries;
+	tdata->num_groups = num_groups;
+
+	for(size_t i = 0; i < num_groups; ++i) {
+		const uint8_t *p = meta + groups_offset + i * TPK_GROUP_SIZE;
+		VFSTpkGroup *g = tdata->groups + i;
+		g->offset = vfs_tpk_le64(p);
+		g->size = vfs_tpk_le64(p + 8);
+
+		if(g->offset > tdata->archive_size || g->size > tdata->archive_size - g->offset) {
+			return "bad group table";
+		}
+	}
+
+	for(size_t i = 0; i < num_entries; ++i) {
+		const uint8_t *p = meta + entries_offset + i * TPK_ENTRY_SIZE;
+		VFSTpkEntry *e = tdata->entries + i;
+		uint32_t name_offset = vfs_tpk_le32(p + 32);
+		uint16_t name_len = vfs_tpk_le16(p + 36);
+
+		e->hash = vfs_tpk_le64(p);
+		e->offset = vfs_tpk_le64(p + 8);
+		e->size = vfs_tpk_le64(p + 16);
+		e->stored_size = vfs_tpk_le64(p + 24);
+		e->method = p[38];
+		e->flags = p[39];
+		e->group = vfs_tpk_le32(p + 40);
+		e->crc32 = vfs_tpk_le32(p + 44);
+		e->mtime = (int64_t)vfs_tpk_le64(p + 48);
+
+		if((uint64_t)name_offset + name_len >= strings_size || strings[name_offset + name_len]) {
+			return "bad entry name";
+		}
+
+		e->name = strings + name_offset;
+
+		if(i > 0 && e->hash < e[-1].hash) {
+			return "entry table is not sorted";
+		}
+
+		if(e->offset > tdata->archive_size || e->stored_size > tdata->archive_size - e->offset) {
+			return "entry data out of bounds";
+		}
+
+		if(e->method != TPK_METHOD_RAW && e->method != TPK_METHOD_DEFLATE) {
+			return "unsupported storage method";
+		}
+
+		if(e->method == TPK_METHOD_RAW && e->size != e->stored_size) {
+			return "bad entry size";
+		}
+
+		if(e->group > num_groups) {
+			return "bad entry group";
+		}
+	}
+
+	return NULL;
+}
+
+static const char* vfs_tpkfile_read_index(VFSTpkFileData *tdata) {
+	SDL_RWops *stream = NULL;
+	uint8_t hdr_buf[TPK_HEADER_SIZE];
+	const uint8_t *hdr = hdr_buf;
+
+	if(tdata->map) {
+		tdata->archive_size = tdata->map_size;
+		hdr = tdata->map;
+	} else {
+		if(!(stream = vfs_node_open(tdata->source, VFS_MODE_READ))) {
+			return "can't open file";
+		}
+
+		int64_t size = SDL_RWsize(stream);
+		tdata->archive_size = size < 0 ? 0 : size;
+
+		if(SDL_RWread(stream, hdr_buf, 1, sizeof(hdr_buf)) != sizeof(hdr_buf)) {
+			SDL_RWclose(stream);
+			return "read error";
+		}
+	}
+
+	if(tdata->archive_size < TPK_HEADER_SIZE || memcmp(hdr, TPK_MAGIC, 8)) {
+		if(stream) {
+			SDL_RWclose(stream);
+		}
+
+		return "not a Taisei package";
+	}
+
+	if(vfs_tpk_le32(hdr + 8) != TPK_VERSION) {
+		if(stream) {
+			SDL_RWclose(stream);
+		}
+
+		return "unsupported package version";
+	}
+
+	// The metadata (entry table, group table, string pool) is contiguous and precedes the data section.
+	uint64_t num_entries = vfs_tpk_le32(hdr + 12);
+	uint64_t num_groups = vfs_tpk_le32(hdr + 16);
+	uint64_t entries_offset = vfs_tpk_le64(hdr + 24);
+	uint64_t groups_offset = vfs_tpk_le64(hdr + 32);
+	uint64_t strings_offset = vfs_tpk_le64(hdr + 40);
+	uint64_t strings_size = vfs_tpk_le64(hdr + 48);
+	uint64_t archive_size = tdata->archive_size;
+
+	// every offset is checked against the archive size before anything is added to it, so nothing can wrap
+	if(
+		entries_offset < TPK_HEADER_SIZE ||
+		entries_offset > archive_size ||
+		num_entries > (archive_size - entries_offset) / TPK_ENTRY_SIZE ||
+		groups_offset < entries_offset + num_entries * TPK_ENTRY_SIZE ||
+		groups_offset > archive_size ||
+		num_groups > (archive_size - groups_offset) / TPK_GROUP_SIZE ||
+		strings_offset < groups_offset + num_groups * TPK_GROUP_SIZE ||
+		strings_offset > archive_size ||
+		strings_size > archive_size - strings_offset ||
+		strings_offset + strings_size - entries_offset > SIZE_MAX
+	) {
+		if(stream) {
+			SDL_RWclose(stream);
+		}
+
+		return "corrupted header";
+	}
+
+	const char *err;
+
+	if(tdata->map) {
+		err = vfs_tpkfile_parse(tdata, hdr, tdata->map, 0);
+	} else {
+		size_t meta_size = strings_offset + strings_size - entries_offset;
+		uint8_t *meta = malloc(meta_size);
+
+		if(
+			SDL_RWseek(stream, entries_offset, RW_SEEK_SET) != (int64_t)entries_offset ||
+			SDL_RWread(stream, meta, 1, meta_size) != meta_size
+		) {
+			err = "read error";
+		} else {
+			// keep the string pool around; entry names point into it
+			tdata->strings = malloc(strings_size);
+			memcpy(tdata->strings, meta + (strings_offset - entries_offset), strings_size);
+			err = vfs_tpkfile_parse(tdata, hdr, meta, entries_offset);
+		}
+
+		free(meta);
+		SDL_RWclose(stream);
+	}
+
+	return err;
+}
+
+bool vfs_tpkfile_init(VFSNode *node, VFSNode *source) {
+	VFSNode backup;
+	memcpy(&backup, node, sizeof(VFSNode));
+
+	VFSTpkFileData *tdata = calloc(1, sizeof(VFSTpkFileData));
+	tdata->source = source;
+	tdata->map = vfs_node_map(source, &tdata->map_size);
+
+	node->data1 = tdata;
+	node->funcs = &vfs_funcs_tpkfile;
+
+	const char *err = vfs_tpkfile_read_index(tdata);
+	char *r = vfs_node_repr(source, true);
+
+	if(err) {
+		vfs_set_error("Failed to open package '%s': %s", r, err);
+		free(r);
+		tdata->source = NULL; // don't decref it
+		node->funcs->free(node);
+		memcpy(node, &backup, sizeof(VFSNode));
+		return false;
+	}
+
+	log_debug("%s: %zu entries%s", r, tdata->num_entries, tdata->map ? " (memory-mapped)" : "");
+	free(r);
+	return true;
+}
@@ -0,0 +1,111 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "private.h"
+
+/*
+ * Taisei package (.tpk) format, as written by scripts/pack-tpk.py.
+ * All integers are little-endian.
+ *
+ *  Header (64 bytes, at offset 0):
+ *     0  char[8]  magic "TAISEIPK"
+ *     8  u32      version
+ *    12  u32      number of entries
+ *    16  u32      number of groups
+ *    20  u32      reserved
+ *    24  u64      offset of the entry table
+ *    32  u64      offset of the group table
+ *    40  u64      offset of the string pool
+ *    48  u64      size of the string pool
+ *    56  u64      offset of the data section (page-aligned)
+ *
+ *  Entry (56 bytes), sorted by hash, then by name:
+ *     0  u64      FNV-1a hash of the normalized path
+ *     8  u64      data offset
+ *    16  u64      uncompressed size
+ *    24  u64      stored size
+ *    32  u32      name offset in the string pool (names are NUL-terminated)
+ *    36  u16      name length, excluding the terminator
+ *    38  u8       storage method (TPK_METHOD_*)
+ *    39  u8       flags (TPK_FLAG_*)
+ *    40  u32      group index + 1, or 0 if none
+ *    44  u32      CRC-32 of the uncompressed data
+ *    48  i64      modification time of the source file (UNIX time), or 0 for directories
+ *
+ *  Group (16 bytes): u64 offset, u64 size of a contiguous data range.
+ *  Groups are sets of files that are loaded together (e.g. a texture atlas);
+ *  the whole range is prefetched when any member is opened.
+ *
+ * Raw entries start on a 4 KiB boundary, so they can be used directly from a memory mapping.
+ * Data is laid out in the order it's first used during startup, making cold loads sequential.
+ */
+
+#define TPK_MAGIC "TAISEIPK"
+#define TPK_VERSION 2
+
+#define TPK_HEADER_SIZE 64
+#define TPK_ENTRY_SIZE 56
+#define TPK_GROUP_SIZE 16
+
+enum {
+	TPK_METHOD_RAW = 0,
+	TPK_METHOD_DEFLATE = 1,
+};
+
+enum {
+	TPK_FLAG_DIR = (1 << 0),
+};
+
+typedef struct VFSTpkEntry {
+	uint64_t hash;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t stored_size;
+	int64_t mtime;
+	const char *name;
+	uint32_t group;
+	uint32_t crc32;
+	uint8_t method;
+	uint8_t flags;
+} VFSTpkEntry;
+
+typedef struct VFSTpkGroup {
+	uint64_t offset;
+	uint64_t size;
+	SDL_atomic_t prefetched;
+} VFSTpkGroup;
+
+typedef struct VFSTpkFileData {
+	VFSNode *source;
+
+	// Immutable after vfs_tpkfile_init; safe to read from any thread.
+	VFSTpkEntry *entries;
+	size_t num_entries;
+	VFSTpkGroup *groups;
+	size_t num_groups;
+	char *strings; // NULL if names point into the mapping
+
+	const uint8_t *map;
+	size_t map_size;
+	uint64_t archive_size;
+} VFSTpkFileData;
+
+typedef struct VFSTpkPathData {
+	VFSNode *tpknode;
+	const VFSTpkEntry *entry;
+} VFSTpkPathData;
+
+uint64_t vfs_tpk_hash(const char *path);
+const char* vfs_tpkfile_iter_shared(VFSTpkFileData *tdata, const char *prefix, void **opaque);
+void vfs_tpkfile_iter_stop(VFSNode *node, void **opaque);
+SDL_RWops* vfs_tpkfile_open_entry(VFSNode *tpknode, const VFSTpkEntry *entry, VFSOpenMode mode);
+
+void vfs_tpkpath_init(VFSNode *node, VFSNode *tpknode, const VFSTpkEntry *entry);
@@ -0,0 +1,38 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "tpkfile.h"
+
+bool vfs_mount_tpkfile(const char *mountpoint, const char *tpkpath) {
+	char p[strlen(tpkpath)+1];
+	tpkpath = vfs_path_normalize(tpkpath, p);
+	VFSNode *node = vfs_locate(vfs_root, tpkpath);
+
+	if(!node) {
+		vfs_set_error("Node '%s' does not exist", tpkpath);
+		return false;
+	}
+
+	VFSNode *tnode = vfs_alloc();
+
+	if(!vfs_tpkfile_init(tnode, node)) {
+		vfs_decref(tnode);
+		vfs_decref(node);
+		return false;
+	}
+
+	if(!vfs_mount(vfs_root, mountpoint, tnode)) {
+		// tnode owns the reference to node now, and releases it when freed
+		vfs_decref(tnode);
+		return false;
+	}
+
+	return true;
+}
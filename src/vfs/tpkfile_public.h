@@ -0,0 +1,13 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+bool vfs_mount_tpkfile(const char *mountpoint, const char *tpkpath)
+	attr_nonnull(1, 2) attr_nodiscard;
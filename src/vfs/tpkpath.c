@@ -0,0 +1,98 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "tpkfile.h"
+#include "tpkfile_impl.h"
+#include "syspath.h"
+
+static void vfs_tpkpath_free(VFSNode *node) {
+	free(node->data1);
+}
+
+static bool vfs_tpkpath_is_dir(VFSNode *node) {
+	VFSTpkPathData *tdata = node->data1;
+	return tdata->entry->flags & TPK_FLAG_DIR;
+}
+
+static char* vfs_tpkpath_repr(VFSNode *node) {
+	VFSTpkPathData *tdata = node->data1;
+	char *tpkrepr = vfs_node_repr(tdata->tpknode, false);
+	char *tpathrepr = strfmt("%s '%s' in %s",
+		vfs_tpkpath_is_dir(node) ? "directory" : "file", tdata->entry->name, tpkrepr);
+	free(tpkrepr);
+	return tpathrepr;
+}
+
+static char* vfs_tpkpath_syspath(VFSNode *node) {
+	VFSTpkPathData *tdata = node->data1;
+	char *tpkpath = vfs_node_repr(tdata->tpknode, true);
+	char *subpath = strfmt("%s%c%s", tpkpath, vfs_syspath_preferred_separator, tdata->entry->name);
+	free(tpkpath);
+	return subpath;
+}
+
+static VFSInfo vfs_tpkpath_query(VFSNode *node) {
+	VFSTpkPathData *tdata = node->data1;
+
+	return (VFSInfo) {
+		.exists = true,
+		.is_dir = vfs_tpkpath_is_dir(node),
+		.is_readonly = true,
+		.size = tdata->entry->size,
+		.mtime = tdata->entry->mtime,
+	};
+}
+
+static VFSNode* vfs_tpkpath_locate(VFSNode *node, const char *path) {
+	VFSTpkPathData *tdata = node->data1;
+
+	const char *mypath = tdata->entry->name;
+	char fullpath[strlen(mypath) + strlen(path) + 2];
+	snprintf(fullpath, sizeof(fullpath), "%s%c%s", mypath, VFS_PATH_SEP, path);
+	vfs_path_normalize_inplace(fullpath);
+
+	return vfs_locate(tdata->tpknode, fullpath);
+}
+
+static const char* vfs_tpkpath_iter(VFSNode *node, void **opaque) {
+	VFSTpkPathData *tdata = node->data1;
+
+	if(!vfs_tpkpath_is_dir(node)) {
+		return NULL;
+	}
+
+	return vfs_tpkfile_iter_shared(tdata->tpknode->data1, tdata->entry->name, opaque);
+}
+
+#define vfs_tpkpath_iter_stop vfs_tpkfile_iter_stop
+
+static SDL_RWops* vfs_tpkpath_open(VFSNode *node, VFSOpenMode mode) {
+	VFSTpkPathData *tdata = node->data1;
+	return vfs_tpkfile_open_entry(tdata->tpknode, tdata->entry, mode);
+}
+
+static VFSNodeFuncs vfs_funcs_tpkpath = {
+	.repr = vfs_tpkpath_repr,
+	.query = vfs_tpkpath_query,
+	.free = vfs_tpkpath_free,
+	.syspath = vfs_tpkpath_syspath,
+	.locate = vfs_tpkpath_locate,
+	.iter = vfs_tpkpath_iter,
+	.iter_stop = vfs_tpkpath_iter_stop,
+	.open = vfs_tpkpath_open,
+};
+
+void vfs_tpkpath_init(VFSNode *node, VFSNode *tpknode, const VFSTpkEntry *entry) {
+	VFSTpkPathData *tdata = calloc(1, sizeof(VFSTpkPathData));
+	tdata->tpknode = tpknode;
+	tdata->entry = entry;
+	node->data1 = tdata;
+	node->funcs = &vfs_funcs_tpkpath;
+}
@@ -10,8 +10,35 @@
 
 #include "union.h"
 
-#define _members_ data1
-#define _primary_member_ data2
+/*
+ * Unions created with a lookup cache remember the result of every path lookup,
+ * including failed ones, while all of their members are read-only: read-only
+ * members can't change through the VFS, so the results stay valid until
+ * something is mounted into the union itself.
+ *
+ * vfs_union_build_index() fills the cache with every path in the union up
+ * front. After that, a path that isn't in the cache doesn't exist, and
+ * no lookup ever has to probe the members.
+ */
+
+typedef struct VFSUnionCache {
+	SDL_mutex *mutex;
+
+	// path -> VFSNode (referenced by the cache), or NULL if the path doesn't exist
+	ht_str2ptr_t nodes;
+
+	// true if nodes contains every existing path
+	bool complete;
+} VFSUnionCache;
+
+typedef struct VFSUnionData {
+	ListContainer *members;
+	VFSNode *primary_member;
+	uint num_writable_members;
+	VFSUnionCache *cache;
+} VFSUnionData;
+
+#define UNION_DATA(n) ((VFSUnionData*)(n)->data1)
 
 static bool vfs_union_mount_internal(VFSNode *unode, const char *mountpoint, VFSNode *mountee, VFSInfo info, bool seterror);
 
@@ -23,60 +50,167 @@ static void* vfs_union_delete_callback(List **list, List *elem, void *arg) {
 	return NULL;
 }
 
-static void vfs_union_free(VFSNode *node) {
-	list_foreach((ListContainer**)&node->_members_, vfs_union_delete_callback, NULL);
+static void vfs_union_cache_clear(VFSUnionCache *cache) {
+	ht_str2ptr_iter_t iter;
+	ht_iter_begin(&cache->nodes, &iter);
+
+	for(; iter.has_data; ht_iter_next(&iter)) {
+		vfs_decref(iter.value);
+	}
+
+	ht_iter_end(&iter);
+	ht_unset_all(&cache->nodes);
+	cache->complete = false;
 }
 
-static VFSNode* vfs_union_locate(VFSNode *node, const char *path) {
-	VFSNode *u = vfs_alloc();
-	vfs_union_init(u); // uniception!
+static void vfs_union_invalidate(VFSNode *node) {
+	VFSUnionCache *cache = UNION_DATA(node)->cache;
+
+	if(cache) {
+		SDL_LockMutex(cache->mutex);
+		vfs_union_cache_clear(cache);
+		SDL_UnlockMutex(cache->mutex);
+	}
+}
+
+static void vfs_union_free(VFSNode *node) {
+	VFSUnionData *udata = UNION_DATA(node);
+	VFSUnionCache *cache = udata->cache;
+
+	if(cache) {
+		vfs_union_cache_clear(cache);
+		ht_destroy(&cache->nodes);
+		SDL_DestroyMutex(cache->mutex);
+		free(cache);
+	}
+
+	list_foreach(&udata->members, vfs_union_delete_callback, NULL);
+	free(udata);
+}
 
-	VFSInfo prim_info = VFSINFO_ERROR;
-	ListContainer *first = node->_members_;
-	ListContainer *last = first;
-	ListContainer *c;
+static VFSNode* vfs_union_resolve(VFSNode *node, const char *path) {
+	VFSUnionData *udata = UNION_DATA(node);
+	ListContainer *last = udata->members;
+	uint num_members = 0;
 
-	for(c = first; c; c = c->next) {
+	for(ListContainer *c = udata->members; c; c = c->next) {
 		last = c;
+		++num_members;
 	}
 
-	for(c = last; c; c = c->prev) {
-		VFSNode *n = c->data;
-		VFSNode *o = vfs_locate(n, path);
+	if(!num_members) {
+		return NULL;
+	}
+
+	// lowest priority first
+	VFSNode *found[num_members];
+	VFSInfo found_info[num_members];
+	uint num_found = 0;
+
+	for(ListContainer *c = last; c; c = c->prev) {
+		VFSNode *o = vfs_locate(c->data, path);
 
 		if(o) {
 			VFSInfo i = vfs_node_query(o);
 
-			if(vfs_union_mount_internal(u, NULL, o, i, false)) {
-				prim_info = i;
+			if(i.exists) {
+				found[num_found] = o;
+				found_info[num_found] = i;
+				++num_found;
 			} else {
 				vfs_decref(o);
 			}
 		}
 	}
 
-	if(u->_primary_member_) {
-		if(!((List*)(u->_members_))->next || !prim_info.is_dir) {
-			// the temporary union contains just one member, or doesn't represent a directory
-			// in those cases it's just a useless wrapper, so let's just return the primary member directly
-			VFSNode *n = u->_primary_member_;
+	if(!num_found) {
+		// all in vain...
+		return NULL;
+	}
+
+	VFSNode *primary = found[num_found - 1];
+
+	if(num_found == 1 || !found_info[num_found - 1].is_dir) {
+		// just one member, or not a directory: a union wrapper would be useless,
+		// so return the primary member directly
+		for(uint i = 0; i < num_found - 1; ++i) {
+			vfs_decref(found[i]);
+		}
+
+		return primary;
+	}
+
+	VFSNode *u = vfs_alloc();
+	vfs_union_init(u); // uniception!
+
+	for(uint i = 0; i < num_found; ++i) {
+		vfs_union_mount_internal(u, NULL, found[i], found_info[i], false);
+	}
+
+	return u;
+}
+
+static VFSNode* vfs_union_locate(VFSNode *node, const char *path) {
+	VFSUnionData *udata = UNION_DATA(node);
+	VFSUnionCache *cache = udata->cache;
+
+	if(!cache || udata->num_writable_members) {
+		return vfs_union_resolve(node, path);
+	}
+
+	VFSNode *n = NULL;
+	SDL_LockMutex(cache->mutex);
 
-			// incref primary member to keep it alive
+	if(ht_lookup(&cache->nodes, path, (void**)&n) || cache->complete) {
+		if(n) {
 			vfs_incref(n);
+		}
 
-			// destroy the wrapper, also decrefs n
-			vfs_decref(u);
+		SDL_UnlockMutex(cache->mutex);
+		vfs_stats_cache_hit();
+		return n;
+	}
 
-			// no need to incref n, vfs_locate did that for us earlier
-			return n;
+	SDL_UnlockMutex(cache->mutex);
+	vfs_stats_cache_miss();
+
+	n = vfs_union_resolve(node, path);
+
+	SDL_LockMutex(cache->mutex);
+
+	if(!ht_lookup(&cache->nodes, path, NULL)) {
+		if(n) {
+			vfs_incref(n);
 		}
-	} else {
-		// all in vain...
-		vfs_decref(u);
-		u = NULL;
+
+		ht_set(&cache->nodes, path, n);
 	}
 
-	return u;
+	SDL_UnlockMutex(cache->mutex);
+
+	return n;
+}
+
+static void vfs_union_index_recurse(VFSUnionCache *cache, VFSNode *unode, VFSNode *dir, const char *prefix) {
+	void *o = NULL;
+
+	for(const char *name; (name = vfs_node_iter(dir, &o));) {
+		char path[strlen(prefix) + strlen(name) + 2];
+		snprintf(path, sizeof(path), "%s%s%s", prefix, *prefix ? (char[]){VFS_PATH_SEP, 0} : "", name);
+
+		if(ht_lookup(&cache->nodes, path, NULL)) {
+			continue;
+		}
+
+		VFSNode *n = vfs_union_resolve(unode, path);
+		ht_set(&cache->nodes, path, n);
+
+		if(n && vfs_node_query(n).is_dir) {
+			vfs_union_index_recurse(cache, unode, n, path);
+		}
+	}
+
+	vfs_node_iter_stop(dir, &o);
 }
 
 typedef struct VFSUnionIterData {
@@ -91,7 +225,7 @@ static const char* vfs_union_iter(VFSNode *node, void **opaque) {
 
 	if(!i) {
 		i = malloc(sizeof(VFSUnionIterData));
-		i->current = node->_members_;
+		i->current = UNION_DATA(node)->members;
 		i->opaque = NULL;
 		ht_create(&i->visited);
 		*opaque = i;
@@ -131,10 +265,12 @@ static void vfs_union_iter_stop(VFSNode *node, void **opaque) {
 }
 
 static VFSInfo vfs_union_query(VFSNode *node) {
-	if(node->_primary_member_) {
-		VFSInfo i = vfs_node_query(node->_primary_member_);
-		// can't trust the primary member here, others might be writable'
-		i.is_readonly = false;
+	VFSUnionData *udata = UNION_DATA(node);
+
+	if(udata->primary_member) {
+		VFSInfo i = vfs_node_query(udata->primary_member);
+		// can't trust the primary member here, others might be writable
+		i.is_readonly = !udata->num_writable_members;
 		return i;
 	}
 
@@ -160,9 +296,15 @@ static bool vfs_union_mount_internal(VFSNode *unode, const char *mountpoint, VFS
 		return false;
 	}
 
-	list_push((ListContainer**)&unode->_members_, list_wrap_container(mountee));
-	unode->_primary_member_ = mountee;
+	VFSUnionData *udata = UNION_DATA(unode);
+	list_push(&udata->members, list_wrap_container(mountee));
+	udata->primary_member = mountee;
 
+	if(!info.is_readonly) {
+		++udata->num_writable_members;
+	}
+
+	vfs_union_invalidate(unode);
 	return true;
 }
 
@@ -176,7 +318,7 @@ static bool vfs_union_mount(VFSNode *unode, const char *mountpoint, VFSNode *mou
 }
 
 static SDL_RWops* vfs_union_open(VFSNode *unode, VFSOpenMode mode) {
-	VFSNode *n = unode->_primary_member_;
+	VFSNode *n = UNION_DATA(unode)->primary_member;
 
 	if(n) {
 		return vfs_node_open(n, mode);
@@ -190,7 +332,7 @@ static SDL_RWops* vfs_union_open(VFSNode *unode, VFSOpenMode mode) {
 static char* vfs_union_repr(VFSNode *node) {
 	char *mlist = strdup("union: "), *r;
 
-	for(ListContainer *c = node->_members_; c; c = c->next) {
+	for(ListContainer *c = UNION_DATA(node)->members; c; c = c->next) {
 		VFSNode *n = c->data;
 
 		strappend(&mlist, r = vfs_node_repr(n, false));
@@ -205,7 +347,7 @@ static char* vfs_union_repr(VFSNode *node) {
 }
 
 static char* vfs_union_syspath(VFSNode *node) {
-	VFSNode *n = node->_primary_member_;
+	VFSNode *n = UNION_DATA(node)->primary_member;
 
 	if(n) {
 		return vfs_node_syspath(n);
@@ -216,9 +358,10 @@ static char* vfs_union_syspath(VFSNode *node) {
 }
 
 static bool vfs_union_mkdir(VFSNode *node, const char *subdir) {
-	VFSNode *n = node->_primary_member_;
+	VFSNode *n = UNION_DATA(node)->primary_member;
 
 	if(n) {
+		vfs_union_invalidate(node);
 		return vfs_node_mkdir(n, subdir);
 	}
 
@@ -239,7 +382,62 @@ static VFSNodeFuncs vfs_funcs_union = {
 	.open = vfs_union_open,
 };
 
+bool vfs_union_build_index(VFSNode *node) {
+	if(node->funcs != &vfs_funcs_union) {
+		vfs_set_error("Not a union");
+		return false;
+	}
+
+	VFSUnionData *udata = UNION_DATA(node);
+	VFSUnionCache *cache = udata->cache;
+
+	if(!cache) {
+		vfs_set_error("Union has no lookup cache");
+		return false;
+	}
+
+	if(udata->num_writable_members) {
+		vfs_set_error("Union has writable members");
+		return false;
+	}
+
+	SDL_LockMutex(cache->mutex);
+	vfs_union_cache_clear(cache);
+	vfs_union_index_recurse(cache, node, node, "");
+	cache->complete = true;
+	uint num_entries = 0;
+
+	ht_str2ptr_iter_t iter;
+	ht_iter_begin(&cache->nodes, &iter);
+
+	for(; iter.has_data; ht_iter_next(&iter)) {
+		++num_entries;
+	}
+
+	ht_iter_end(&iter);
+	SDL_UnlockMutex(cache->mutex);
+
+	log_debug("Indexed %u paths", num_entries);
+	return true;
+}
+
 void vfs_union_init(VFSNode *node) {
 	node->funcs = &vfs_funcs_union;
-	node->data1 = node->data2 = NULL;
+	node->data1 = calloc(1, sizeof(VFSUnionData));
+}
+
+void vfs_union_init_cached(VFSNode *node) {
+	vfs_union_init(node);
+
+	VFSUnionCache *cache = calloc(1, sizeof(VFSUnionCache));
+	ht_create(&cache->nodes);
+
+	if(!(cache->mutex = SDL_CreateMutex())) {
+		log_warn("SDL_CreateMutex() failed: %s", SDL_GetError());
+		ht_destroy(&cache->nodes);
+		free(cache);
+		return;
+	}
+
+	UNION_DATA(node)->cache = cache;
 }
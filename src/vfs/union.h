@@ -13,3 +13,5 @@
 #include "union_public.h"
 
 void vfs_union_init(VFSNode *node);
+void vfs_union_init_cached(VFSNode *node);
+bool vfs_union_build_index(VFSNode *node);
@@ -12,6 +12,27 @@
 
 bool vfs_create_union_mountpoint(const char *mountpoint) {
 	VFSNode *unode = vfs_alloc();
-	vfs_union_init(unode);
+
+	if(env_get("TAISEI_VFS_CACHE", true)) {
+		vfs_union_init_cached(unode);
+	} else {
+		vfs_union_init(unode);
+	}
+
 	return vfs_mount_or_decref(vfs_root, mountpoint, unode);
 }
+
+bool vfs_build_index(const char *mountpoint) {
+	char buf[strlen(mountpoint)+1];
+	mountpoint = vfs_path_normalize(mountpoint, buf);
+	VFSNode *unode = vfs_locate(vfs_root, mountpoint);
+
+	if(!unode) {
+		vfs_set_error("Node '%s' does not exist", mountpoint);
+		return false;
+	}
+
+	bool result = vfs_union_build_index(unode);
+	vfs_decref(unode);
+	return result;
+}
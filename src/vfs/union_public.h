@@ -9,5 +9,12 @@
 #pragma once
 #include "taisei.h"
 
+// Unions get a lookup cache unless TAISEI_VFS_CACHE=0.
 bool vfs_create_union_mountpoint(const char *mountpoint)
 	attr_nonnull(1);
+
+// Indexes every path in a union with a lookup cache, so that lookups of paths
+// that don't exist don't have to probe the members either. Fails if any of the
+// members are writable.
+bool vfs_build_index(const char *mountpoint)
+	attr_nonnull(1);
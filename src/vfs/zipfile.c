@@ -10,6 +10,25 @@
 
 #include "zipfile.h"
 #include "zipfile_impl.h"
+#include "rwops/all.h"
+
+#define VFS_ZIP_SIG_LOCAL_HEADER    0x04034b50
+#define VFS_ZIP_SIG_CENTRAL_HEADER  0x02014b50
+#define VFS_ZIP_SIG_EOCD            0x06054b50
+#define VFS_ZIP_SIG_EOCD64          0x06064b50
+#define VFS_ZIP_SIG_EOCD64_LOCATOR  0x07064b50
+
+#define VFS_ZIP_LOCAL_HEADER_SIZE   30
+#define VFS_ZIP_CENTRAL_HEADER_SIZE 46
+#define VFS_ZIP_EOCD_SIZE           22
+#define VFS_ZIP_EOCD64_SIZE         56
+#define VFS_ZIP_EOCD64_LOCATOR_SIZE 20
+#define VFS_ZIP_MAX_COMMENT_SIZE    0xFFFF
+
+#define VFS_ZIP_EXTRA_ZIP64         0x0001
+#define VFS_ZIP_FLAG_ENCRYPTED      0x0001
+
+#define VFS_ZIP_INFLATE_BUFSIZE     8192
 
 static VFSZipFileTLS* vfs_zipfile_get_tls(VFSNode *node, bool create);
 
@@ -147,6 +166,12 @@ static void vfs_zipfile_free(VFSNode *node) {
 				vfs_decref(zdata->source);
 			}
 
+			for(size_t i = 0; i < zdata->num_entries; ++i) {
+				free(zdata->entries[i].name);
+			}
+
+			vfs_unmap(zdata->map, zdata->map_size);
+			free(zdata->entries);
 			ht_destroy(&zdata->pathmap);
 			free(zdata);
 		}
@@ -175,28 +200,23 @@ static char* vfs_zipfile_repr(VFSNode *node) {
 }
 
 static VFSNode* vfs_zipfile_locate(VFSNode *node, const char *path) {
-	VFSZipFileTLS *tls = vfs_zipfile_get_tls(node, true);
 	VFSZipFileData *zdata = node->data1;
 	int64_t idx;
 
 	if(!ht_lookup(&zdata->pathmap, path, &idx)) {
-		idx = zip_name_locate(tls->zip, path, 0);
-	}
-
-	if(idx < 0) {
 		return NULL;
 	}
 
 	VFSNode *n = vfs_alloc();
-	vfs_zippath_init(n, node, tls, idx);
+	vfs_zippath_init(n, node, idx);
 	return n;
 }
 
-const char* vfs_zipfile_iter_shared(VFSNode *node, VFSZipFileData *zdata, VFSZipFileIterData *idata, VFSZipFileTLS *tls) {
+const char* vfs_zipfile_iter_shared(VFSNode *node, VFSZipFileData *zdata, VFSZipFileIterData *idata) {
 	const char *r = NULL;
 
 	for(; !r && idata->idx < idata->num; ++idata->idx) {
-		const char *p = zip_get_name(tls->zip, idata->idx, 0);
+		const char *p = zdata->entries[idata->idx].name;
 		const char *p_original = p;
 
 		if(idata->prefix) {
@@ -249,14 +269,13 @@ const char* vfs_zipfile_iter_shared(VFSNode *node, VFSZipFileData *zdata, VFSZip
 static const char* vfs_zipfile_iter(VFSNode *node, void **opaque) {
 	VFSZipFileData *zdata = node->data1;
 	VFSZipFileIterData *idata = *opaque;
-	VFSZipFileTLS *tls = vfs_zipfile_get_tls(node, true);
 
 	if(!idata) {
 		*opaque = idata = calloc(1, sizeof(VFSZipFileIterData));
-		idata->num = zip_get_num_entries(tls->zip, 0);
+		idata->num = zdata->num_entries;
 	}
 
-	return vfs_zipfile_iter_shared(node, zdata, idata, tls);
+	return vfs_zipfile_iter_shared(node, zdata, idata);
 }
 
 void vfs_zipfile_iter_stop(VFSNode *node, void **opaque) {
@@ -282,15 +301,258 @@ static VFSNodeFuncs vfs_funcs_zipfile = {
 	//.open = vfs_zipfile_open,
 };
 
-static void vfs_zipfile_init_pathmap(VFSNode *node) {
+static inline uint16_t vfs_zip_le16(const uint8_t *p) {
+	return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static inline uint32_t vfs_zip_le32(const uint8_t *p) {
+	return (uint32_t)vfs_zip_le16(p) | ((uint32_t)vfs_zip_le16(p + 2) << 16);
+}
+
+static inline uint64_t vfs_zip_le64(const uint8_t *p) {
+	return (uint64_t)vfs_zip_le32(p) | ((uint64_t)vfs_zip_le32(p + 4) << 32);
+}
+
+static uint64_t vfs_zipfile_archive_size(VFSZipFileData *zdata, SDL_RWops *stream) {
+	if(zdata->map) {
+		return zdata->map_size;
+	}
+
+	int64_t size = SDL_RWsize(stream);
+	return size < 0 ? 0 : size;
+}
+
+/*
+ * Returns a pointer to [size] bytes of the archive at [offset]. If the archive is memory-mapped,
+ * this points directly into the mapping; otherwise the data is read from [stream] into [buf].
+ */
+static const uint8_t* vfs_zipfile_fetch(VFSZipFileData *zdata, SDL_RWops *stream, uint64_t offset, size_t size, uint8_t *buf) {
+	if(zdata->map) {
+		if(offset > zdata->map_size || size > zdata->map_size - offset) {
+			return NULL;
+		}
+
+		return zdata->map + offset;
+	}
+
+	if(SDL_RWseek(stream, offset, RW_SEEK_SET) != (int64_t)offset) {
+		return NULL;
+	}
+
+	if(SDL_RWread(stream, buf, 1, size) != size) {
+		return NULL;
+	}
+
+	return buf;
+}
+
+static time_t vfs_zipfile_dostime(uint16_t dtime, uint16_t ddate) {
+	struct tm tm = {
+		.tm_year = ((ddate >> 9) & 127) + 80,
+		.tm_mon = ((ddate >> 5) & 15) - 1,
+		.tm_mday = ddate & 31,
+		.tm_hour = (dtime >> 11) & 31,
+		.tm_min = (dtime >> 5) & 63,
+		.tm_sec = (dtime << 1) & 62,
+		.tm_isdst = -1,
+	};
+
+	return mktime(&tm);
+}
+
+static void vfs_zipfile_read_zip64_extra(VFSZipFileEntry *e, const uint8_t *extra, size_t extra_len) {
+	while(extra_len >= 4) {
+		uint16_t id = vfs_zip_le16(extra);
+		uint16_t size = vfs_zip_le16(extra + 2);
+
+		extra += 4;
+		extra_len -= 4;
+
+		if(size > extra_len) {
+			return;
+		}
+
+		if(id == VFS_ZIP_EXTRA_ZIP64) {
+			// only the fields that overflowed in the central header are present, in this order
+			const uint8_t *f = extra, *fend = extra + size;
+
+			if(e->size == UINT32_MAX && fend - f >= 8) {
+				e->size = vfs_zip_le64(f);
+				f += 8;
+			}
+
+			if(e->comp_size == UINT32_MAX && fend - f >= 8) {
+				e->comp_size = vfs_zip_le64(f);
+				f += 8;
+			}
+
+			if(e->header_offset == UINT32_MAX && fend - f >= 8) {
+				e->header_offset = vfs_zip_le64(f);
+			}
+
+			return;
+		}
+
+		extra += size;
+		extra_len -= size;
+	}
+}
+
+static const char* vfs_zipfile_parse_entries(VFSZipFileData *zdata, const uint8_t *cd, size_t cd_size, size_t num_entries) {
+	const uint8_t *p = cd, *end = cd + cd_size;
+
+	zdata->entries = calloc(num_entries, sizeof(*zdata->entries));
+
+	for(size_t i = 0; i < num_entries; ++i) {
+		if(end - p < VFS_ZIP_CENTRAL_HEADER_SIZE || vfs_zip_le32(p) != VFS_ZIP_SIG_CENTRAL_HEADER) {
+			return "corrupted central directory";
+		}
+
+		uint16_t name_len = vfs_zip_le16(p + 28);
+		uint16_t extra_len = vfs_zip_le16(p + 30);
+		uint16_t comment_len = vfs_zip_le16(p + 32);
+		size_t record_size = VFS_ZIP_CENTRAL_HEADER_SIZE + name_len + extra_len + comment_len;
+
+		if((size_t)(end - p) < record_size) {
+			return "corrupted central directory";
+		}
+
+		const uint8_t *name = p + VFS_ZIP_CENTRAL_HEADER_SIZE;
+		VFSZipFileEntry *e = zdata->entries + i;
+
+		e->flags = vfs_zip_le16(p + 8);
+		e->comp_method = vfs_zip_le16(p + 10);
+		e->mtime = vfs_zipfile_dostime(vfs_zip_le16(p + 12), vfs_zip_le16(p + 14));
+		e->crc32 = vfs_zip_le32(p + 16);
+		e->comp_size = vfs_zip_le32(p + 20);
+		e->size = vfs_zip_le32(p + 24);
+		e->header_offset = vfs_zip_le32(p + 42);
+		vfs_zipfile_read_zip64_extra(e, name + name_len, extra_len);
+
+		e->name = malloc(name_len + 1);
+		memcpy(e->name, name, name_len);
+		e->name[name_len] = 0;
+		e->is_dir = name_len > 0 && name[name_len - 1] == '/';
+
+		zdata->num_entries = i + 1;
+		p += record_size;
+	}
+
+	return NULL;
+}
+
+static const char* vfs_zipfile_read_directory(VFSZipFileData *zdata, SDL_RWops *stream) {
+	uint64_t archive_size = vfs_zipfile_archive_size(zdata, stream);
+	size_t tail_size = archive_size;
+
+	if(tail_size > VFS_ZIP_EOCD_SIZE + VFS_ZIP_MAX_COMMENT_SIZE) {
+		tail_size = VFS_ZIP_EOCD_SIZE + VFS_ZIP_MAX_COMMENT_SIZE;
+	}
+
+	if(tail_size < VFS_ZIP_EOCD_SIZE) {
+		return "not a zip archive";
+	}
+
+	uint8_t *tail_buf = zdata->map ? NULL : malloc(tail_size);
+	uint64_t tail_offset = archive_size - tail_size;
+	const uint8_t *tail = vfs_zipfile_fetch(zdata, stream, tail_offset, tail_size, tail_buf);
+
+	if(!tail) {
+		free(tail_buf);
+		return "read error";
+	}
+
+	// the end of central directory record is followed by a variable-length comment, so scan backwards for it
+	const uint8_t *eocd = NULL;
+
+	for(size_t i = tail_size - VFS_ZIP_EOCD_SIZE + 1; i--;) {
+		if(
+			vfs_zip_le32(tail + i) == VFS_ZIP_SIG_EOCD &&
+			i + VFS_ZIP_EOCD_SIZE + vfs_zip_le16(tail + i + 20) <= tail_size
+		) {
+			eocd = tail + i;
+			break;
+		}
+	}
+
+	if(!eocd) {
+		free(tail_buf);
+		return "not a zip archive";
+	}
+
+	uint64_t eocd_offset = tail_offset + (eocd - tail);
+	uint64_t num_entries = vfs_zip_le16(eocd + 10);
+	uint64_t cd_size = vfs_zip_le32(eocd + 12);
+	uint64_t cd_offset = vfs_zip_le32(eocd + 16);
+	free(tail_buf);
+
+	if(num_entries == UINT16_MAX || cd_size == UINT32_MAX || cd_offset == UINT32_MAX) {
+		uint8_t locator_buf[VFS_ZIP_EOCD64_LOCATOR_SIZE];
+		uint8_t eocd64_buf[VFS_ZIP_EOCD64_SIZE];
+		const uint8_t *locator = NULL, *eocd64 = NULL;
+
+		if(eocd_offset >= VFS_ZIP_EOCD64_LOCATOR_SIZE) {
+			locator = vfs_zipfile_fetch(zdata, stream, eocd_offset - VFS_ZIP_EOCD64_LOCATOR_SIZE, sizeof(locator_buf), locator_buf);
+		}
+
+		if(locator && vfs_zip_le32(locator) == VFS_ZIP_SIG_EOCD64_LOCATOR) {
+			eocd64 = vfs_zipfile_fetch(zdata, stream, vfs_zip_le64(locator + 8), sizeof(eocd64_buf), eocd64_buf);
+		}
+
+		if(!eocd64 || vfs_zip_le32(eocd64) != VFS_ZIP_SIG_EOCD64) {
+			return "bad zip64 end of central directory record";
+		}
+
+		num_entries = vfs_zip_le64(eocd64 + 32);
+		cd_size = vfs_zip_le64(eocd64 + 40);
+		cd_offset = vfs_zip_le64(eocd64 + 48);
+	}
+
+	if(cd_offset > eocd_offset || cd_size > eocd_offset - cd_offset || cd_size > SIZE_MAX) {
+		return "bad central directory location";
+	}
+
+	if(num_entries > cd_size / VFS_ZIP_CENTRAL_HEADER_SIZE) {
+		return "corrupted central directory";
+	}
+
+	if(!num_entries) {
+		return NULL;
+	}
+
+	uint8_t *cd_buf = zdata->map ? NULL : malloc(cd_size);
+	const uint8_t *cd = vfs_zipfile_fetch(zdata, stream, cd_offset, cd_size, cd_buf);
+	const char *err = cd ? vfs_zipfile_parse_entries(zdata, cd, cd_size, num_entries) : "read error";
+	free(cd_buf);
+
+	return err;
+}
+
+static bool vfs_zipfile_build_index(VFSNode *node) {
 	VFSZipFileData *zdata = node->data1;
-	VFSZipFileTLS *tls = vfs_zipfile_get_tls(node, true);
-	zip_int64_t num = zip_get_num_entries(tls->zip, 0);
+	SDL_RWops *stream = NULL;
 
-	ht_create(&zdata->pathmap);
+	if(!zdata->map && !(stream = vfs_node_open(zdata->source, VFS_MODE_READ))) {
+		return false;
+	}
+
+	const char *err = vfs_zipfile_read_directory(zdata, stream);
 
-	for(zip_int64_t i = 0; i < num; ++i) {
-		const char *original = zip_get_name(tls->zip, i, 0);
+	if(stream) {
+		SDL_RWclose(stream);
+	}
+
+	if(err) {
+		char *r = vfs_node_repr(zdata->source, true);
+		vfs_set_error("Failed to open zip archive '%s': %s", r, err);
+		free(r);
+		return false;
+	}
+
+	// FIXME: Taisei currently doesn't handle zip files without explicit directory entries correctly (file listing will not work)
+
+	for(size_t i = 0; i < zdata->num_entries; ++i) {
+		const char *original = zdata->entries[i].name;
 		char normalized[strlen(original) + 1];
 
 		vfs_path_normalize(original, normalized);
@@ -302,10 +564,110 @@ static void vfs_zipfile_init_pathmap(VFSNode *node) {
 			}
 		}
 
-		if(strcmp(original, normalized)) {
+		// if a name occurs more than once, the first entry wins
+		if(!ht_lookup(&zdata->pathmap, normalized, NULL)) {
 			ht_set(&zdata->pathmap, normalized, i);
 		}
 	}
+
+	return true;
+}
+
+static SDL_RWops* vfs_zipfile_open_entry_libzip(VFSNode *zipnode, size_t idx, VFSOpenMode mode) {
+	VFSZipFileTLS *tls = vfs_zipfile_get_tls(zipnode, true);
+
+	if(!tls) {
+		return NULL;
+	}
+
+	zip_file_t *zipfile = zip_fopen_index(tls->zip, idx, 0);
+
+	if(!zipfile) {
+		vfs_set_error("ZIP error: %s", zip_error_strerror(&tls->error));
+		return NULL;
+	}
+
+	SDL_RWops *ziprw = SDL_RWFromZipFile(zipfile, true);
+	assert(ziprw != NULL);
+
+	if(!(mode & VFS_MODE_SEEKABLE)) {
+		return ziprw;
+	}
+
+	SDL_RWops *bufrw = SDL_RWCopyToBuffer(ziprw);
+	SDL_RWclose(ziprw);
+	return bufrw;
+}
+
+SDL_RWops* vfs_zipfile_open_entry(VFSNode *zipnode, size_t idx, VFSOpenMode mode) {
+	VFSZipFileData *zdata = zipnode->data1;
+	const VFSZipFileEntry *e = zdata->entries + idx;
+
+	if(
+		(e->flags & VFS_ZIP_FLAG_ENCRYPTED) ||
+		(e->comp_method != ZIP_CM_STORE && e->comp_method != ZIP_CM_DEFLATE) ||
+		!e->size
+	) {
+		return vfs_zipfile_open_entry_libzip(zipnode, idx, mode);
+	}
+
+	SDL_RWops *stream = NULL;
+
+	if(!zdata->map && !(stream = vfs_node_open(zdata->source, VFS_MODE_READ))) {
+		return NULL;
+	}
+
+	uint8_t header_buf[VFS_ZIP_LOCAL_HEADER_SIZE];
+	const uint8_t *header = vfs_zipfile_fetch(zdata, stream, e->header_offset, sizeof(header_buf), header_buf);
+	uint64_t data_offset = 0;
+
+	if(header && vfs_zip_le32(header) == VFS_ZIP_SIG_LOCAL_HEADER) {
+		data_offset = e->header_offset + VFS_ZIP_LOCAL_HEADER_SIZE + vfs_zip_le16(header + 26) + vfs_zip_le16(header + 28);
+	}
+
+	uint64_t archive_size = vfs_zipfile_archive_size(zdata, stream);
+
+	if(!data_offset || data_offset > archive_size || e->comp_size > archive_size - data_offset) {
+		vfs_set_error("ZIP error: bad local header for '%s'", e->name);
+
+		if(stream) {
+			SDL_RWclose(stream);
+		}
+
+		return NULL;
+	}
+
+	SDL_RWops *rw;
+
+	if(zdata->map) {
+		// reads are served straight from the mapping; nothing is copied for stored entries
+		rw = SDL_RWFromConstMem(zdata->map + data_offset, e->comp_size);
+	} else {
+		SDL_RWseek(stream, data_offset, RW_SEEK_SET);
+		rw = SDL_RWWrapSegment(stream, data_offset, data_offset + e->comp_size, true);
+	}
+
+	if(e->comp_method == ZIP_CM_DEFLATE) {
+		rw = SDL_RWWrapZReaderRaw(rw, VFS_ZIP_INFLATE_BUFSIZE, true);
+	}
+
+	// libzip used to verify this for us
+	rw = SDL_RWWrapCRC32Check(rw, e->size, e->crc32, true);
+
+	if(!(mode & VFS_MODE_SEEKABLE) || e->comp_method == ZIP_CM_STORE) {
+		return rw;
+	}
+
+	SDL_RWops *bufrw = SDL_RWCopyToBuffer(rw);
+	SDL_RWclose(rw);
+
+	if(SDL_RWsize(bufrw) != e->size) {
+		vfs_set_error("ZIP error: failed to read '%s': %s", e->name, SDL_GetError());
+		SDL_RWclose(bufrw);
+		return NULL;
+	}
+
+	return bufrw;
 }
 
 static VFSZipFileTLS* vfs_zipfile_get_tls(VFSNode *node, bool create) {
@@ -322,8 +684,6 @@ static VFSZipFileTLS* vfs_zipfile_get_tls(VFSNode *node, bool create) {
 	zip_source_t *src = zip_source_function_create(vfs_zipfile_srcfunc, node, &tls->error);
 	zip_t *zip = tls->zip = zip_open_from_source(src, ZIP_RDONLY, &tls->error);
 
-	// FIXME: Taisei currently doesn't handle zip files without explicit directory entries correctly (file listing will not work)
-
 	if(!zip) {
 		char *r = vfs_node_repr(zdata->source, true);
 		vfs_set_error("Failed to open zip archive '%s': %s", r, zip_error_strerror(&tls->error));
@@ -344,6 +704,7 @@ bool vfs_zipfile_init(VFSNode *node, VFSNode *source) {
 	VFSZipFileData *zdata = calloc(1, sizeof(VFSZipFileData));
 	zdata->source = source;
 	zdata->tls_id = SDL_TLSCreate();
+	ht_create(&zdata->pathmap);
 
 	node->data1 = zdata;
 	node->funcs = &vfs_funcs_zipfile;
@@ -353,11 +714,12 @@ bool vfs_zipfile_init(VFSNode *node, VFSNode *source) {
 		goto error;
 	}
 
-	if(!vfs_zipfile_get_tls(node, true)) {
+	zdata->map = vfs_node_map(source, &zdata->map_size);
+
+	if(!vfs_zipfile_build_index(node)) {
 		goto error;
 	}
 
-	vfs_zipfile_init_pathmap(node);
 	return true;
 
 error:
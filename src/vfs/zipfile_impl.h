@@ -21,9 +21,32 @@ typedef struct VFSZipFileTLS {
 	zip_error_t error;
 } VFSZipFileTLS;
 
+typedef struct VFSZipFileEntry {
+	char *name; // as stored in the archive
+	uint64_t header_offset;
+	uint64_t size;
+	uint64_t comp_size;
+	time_t mtime;
+	uint32_t crc32;
+	uint16_t comp_method;
+	uint16_t flags;
+	bool is_dir;
+} VFSZipFileEntry;
+
 typedef struct VFSZipFileData {
 	VFSNode *source;
+
+	// Parsed once from the central directory in vfs_zipfile_init and never modified
+	// afterwards, so it can be read from any thread without locking.
+	VFSZipFileEntry *entries;
+	size_t num_entries;
 	ht_str2int_t pathmap;
+
+	// Read-only mapping of the whole archive, if the source is a regular file and mmap is available.
+	const uint8_t *map;
+	size_t map_size;
+
+	// Per-thread libzip handles; only used for entries we can't read directly (encrypted, exotic compression).
 	SDL_TLSID tls_id;
 } VFSZipFileData;
 
@@ -35,16 +58,17 @@ typedef struct VFSZipFileIterData {
 	char *allocated;
 } VFSZipFileIterData;
 
-const char* vfs_zipfile_iter_shared(VFSNode *node, VFSZipFileData *zdata, VFSZipFileIterData *idata, VFSZipFileTLS *tls);
+const char* vfs_zipfile_iter_shared(VFSNode *node, VFSZipFileData *zdata, VFSZipFileIterData *idata);
 void vfs_zipfile_iter_stop(VFSNode *node, void **opaque);
+SDL_RWops* vfs_zipfile_open_entry(VFSNode *zipnode, size_t idx, VFSOpenMode mode);
 
 /* zippath */
 
 typedef struct VFSZipPathData {
 	VFSNode *zipnode;
-	VFSZipFileTLS *tls;
-	uint64_t index;
+	const VFSZipFileEntry *entry;
+	size_t index;
 	VFSInfo info;
 } VFSZipPathData;
 
-void vfs_zippath_init(VFSNode *node, VFSNode *zipnode, VFSZipFileTLS *tls, zip_int64_t idx);
+void vfs_zippath_init(VFSNode *node, VFSNode *zipnode, size_t idx);
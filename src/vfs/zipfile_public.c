@@ -29,8 +29,8 @@ bool vfs_mount_zipfile(const char *mountpoint, const char *zippath) {
 	}
 
 	if(!vfs_mount(vfs_root, mountpoint, znode)) {
+		// znode owns the reference to node now, and releases it when freed
 		vfs_decref(znode);
-		vfs_decref(node);
 		return false;
 	}
 
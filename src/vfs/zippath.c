@@ -15,7 +15,7 @@
 
 static const char* vfs_zippath_name(VFSNode *node) {
 	VFSZipPathData *zdata = node->data1;
-	return zip_get_name(zdata->tls->zip, zdata->index, 0);
+	return zdata->entry->name;
 }
 
 static void vfs_zippath_free(VFSNode *node) {
@@ -65,14 +65,14 @@ static const char* vfs_zippath_iter(VFSNode *node, void **opaque) {
 
 	if(!idata) {
 		idata = calloc(1, sizeof(VFSZipFileIterData));
-		idata->num = zip_get_num_entries(zdata->tls->zip, 0);
+		idata->num = ((VFSZipFileData*)zdata->zipnode->data1)->num_entries;
 		idata->idx = zdata->index;
 		idata->prefix = vfs_zippath_name(node);
 		idata->prefix_len = strlen(idata->prefix);
 		*opaque = idata;
 	}
 
-	return vfs_zipfile_iter_shared(node, zdata->zipnode->data1, idata, zdata->tls);
+	return vfs_zipfile_iter_shared(node, zdata->zipnode->data1, idata);
 }
 
 #define vfs_zippath_iter_stop vfs_zipfile_iter_stop
@@ -84,23 +84,7 @@ static SDL_RWops* vfs_zippath_open(VFSNode *node, VFSOpenMode mode) {
 	}
 
 	VFSZipPathData *zdata = node->data1;
-	zip_file_t *zipfile = zip_fopen_index(zdata->tls->zip, zdata->index, 0);
-
-	if(!zipfile) {
-		vfs_set_error("ZIP error: %s", zip_error_strerror(&zdata->tls->error));
-		return NULL;
-	}
-
-	SDL_RWops *ziprw = SDL_RWFromZipFile(zipfile, true);
-	assert(ziprw != NULL);
-
-	if(!(mode & VFS_MODE_SEEKABLE)) {
-		return ziprw;
-	}
-
-	SDL_RWops *bufrw = SDL_RWCopyToBuffer(ziprw);
-	SDL_RWclose(ziprw);
-	return bufrw;
+	return vfs_zipfile_open_entry(zdata->zipnode, zdata->index, mode);
 }
 
 static VFSNodeFuncs vfs_funcs_zippath = {
@@ -116,18 +100,22 @@ static VFSNodeFuncs vfs_funcs_zippath = {
 	.open = vfs_zippath_open,
 };
 
-void vfs_zippath_init(VFSNode *node, VFSNode *zipnode, VFSZipFileTLS *tls, zip_int64_t idx) {
+void vfs_zippath_init(VFSNode *node, VFSNode *zipnode, size_t idx) {
+	VFSZipFileData *zipdata = zipnode->data1;
 	VFSZipPathData *zdata = calloc(1, sizeof(VFSZipPathData));
 	zdata->zipnode = zipnode;
-	zdata->tls = tls;
+	zdata->entry = zipdata->entries + idx;
 	zdata->index = idx;
 	node->data1 = zdata;
 
 	zdata->info.exists = true;
 	zdata->info.is_readonly = true;
 
-	if('/' == *(strchr(vfs_zippath_name(node), 0) - 1)) {
+	if(zdata->entry->is_dir) {
 		zdata->info.is_dir = true;
+	} else {
+		zdata->info.size = zdata->entry->size;
+		zdata->info.mtime = zdata->entry->mtime;
 	}
 
 	node->funcs = &vfs_funcs_zippath;
@@ -130,15 +130,18 @@ static const char* modeflagsstr(uint32_t flags) {
 }
 
 static void video_new_window_internal(int w, int h, uint32_t flags, bool fallback) {
-	if(video.window) {
-		SDL_DestroyWindow(video.window);
-		video.window = NULL;
-	}
+	// The old window is destroyed only after the new one exists, so that the
+	// renderer can move its context over (possibly from another thread).
+	SDL_Window *old_window = video.window;
 
 	char title[sizeof(WINDOW_TITLE) + strlen(TAISEI_VERSION) + 2];
 	snprintf(title, sizeof(title), "%s v%s", WINDOW_TITLE, TAISEI_VERSION);
 	video.window = r_create_window(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, w, h, flags);
 
+	if(old_window) {
+		SDL_DestroyWindow(old_window);
+	}
+
 	if(video.window) {
 		SDL_SetWindowMinimumSize(video.window, SCREEN_W / 4, SCREEN_H / 4);
 		video_update_mode_settings();